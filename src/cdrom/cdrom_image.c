@@ -270,6 +270,8 @@ cdrom_image_open(cdrom_t *dev, const wchar_t *fn)
     if (!cdi_set_device(img, fn))
 	return image_open_abort(dev);
 
+    cdi_set_readahead(img, dev->readahead);
+
     /* All good, reset state. */
     if (! wcscasecmp(plat_get_extension((wchar_t *) fn), L"ISO"))
 	dev->cd_status = CD_STATUS_DATA_ONLY;
@@ -27,10 +27,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <ctype.h>
-#ifdef _WIN32
-# include <string.h>
-#else
+#ifndef _WIN32
 # include <libgen.h>
 #endif
 #include <wchar.h>
@@ -175,8 +174,11 @@ bin_init(const wchar_t *filename, int *error)
 static track_file_t *
 track_file_init(const wchar_t *filename, int *error)
 {
-    /* Current we only support .BIN files, either combined or one per
-       track. In the future, more is planned. */
+    /* .BIN files, either combined or one per track, plain or
+       compressed. */
+    if (cdz_detect(filename))
+	return cdz_init(filename, error);
+
     return bin_init(filename, error);
 }
 
@@ -199,6 +201,22 @@ track_file_close(track_t *trk)
 
 
 /* Root functions. */
+static void
+cdi_ra_lock(cd_img_t *cdi)
+{
+    if (cdi->ra_lock != NULL)
+	thread_wait_mutex(cdi->ra_lock);
+}
+
+
+static void
+cdi_ra_unlock(cd_img_t *cdi)
+{
+    if (cdi->ra_lock != NULL)
+	thread_release_mutex(cdi->ra_lock);
+}
+
+
 static void
 cdi_clear_tracks(cd_img_t *cdi)
 {
@@ -226,6 +244,13 @@ cdi_clear_tracks(cd_img_t *cdi)
 
     /* Mark that there's no tracks. */
     cdi->tracks_num = 0;
+    cdi->last_track = 0;
+
+    /* The files are gone, so is whatever was read ahead from them. */
+    cdi_ra_lock(cdi);
+    cdi->ra_file = NULL;
+    cdi->ra_len = 0;
+    cdi_ra_unlock(cdi);
 }
 
 
@@ -233,10 +258,103 @@ void
 cdi_close(cd_img_t *cdi)
 {
     cdi_clear_tracks(cdi);
+    if (cdi->ra_buf != NULL)
+	free(cdi->ra_buf);
+    if (cdi->ra_lock != NULL)
+	thread_close_mutex(cdi->ra_lock);
     free(cdi);
 }
 
 
+void
+cdi_set_readahead(cd_img_t *cdi, uint32_t sectors)
+{
+    if (cdi->ra_lock == NULL)
+	cdi->ra_lock = thread_create_mutex();
+
+    cdi_ra_lock(cdi);
+
+    if (cdi->ra_buf != NULL) {
+	free(cdi->ra_buf);
+	cdi->ra_buf = NULL;
+    }
+
+    cdi->ra_file = NULL;
+    cdi->ra_len = 0;
+    cdi->ra_size = 0;
+
+    if (sectors != 0) {
+	cdi->ra_buf = (uint8_t *) malloc(sectors * 2448);
+	if (cdi->ra_buf != NULL)
+		cdi->ra_size = sectors * 2448;
+    }
+
+    cdi_ra_unlock(cdi);
+}
+
+
+/* Read from a track file, through the read-ahead cache. When a read
+   continues where the previous one ended, the cache is refilled with
+   a whole block, so streaming reads turn into a few large host reads;
+   other reads go straight to the file. Must be called with the lock
+   held, as the CD audio thread reads through the same cache. */
+static int
+cdi_file_read_locked(cd_img_t *cdi, track_file_t *file, uint8_t *buffer, uint64_t seek, size_t count)
+{
+    uint64_t len;
+    int sequential;
+
+    /* Cooked reads from raw tracks skip the sector headers, so allow
+       a gap of up to one sector. */
+    sequential = (seek >= cdi->ra_next) && ((seek - cdi->ra_next) <= 2448);
+    cdi->ra_next = seek + count;
+
+    if ((cdi->ra_size == 0) || (count >= cdi->ra_size))
+	return file->read(file, buffer, seek, count);
+
+    if ((file == cdi->ra_file) && (seek >= cdi->ra_start) &&
+	((seek + count) <= (cdi->ra_start + cdi->ra_len))) {
+	memcpy(buffer, cdi->ra_buf + (seek - cdi->ra_start), count);
+	return 1;
+    }
+
+    if (!sequential)
+	return file->read(file, buffer, seek, count);
+
+    if (file != cdi->ra_file) {
+	cdi->ra_file = file;
+	cdi->ra_file_len = file->get_length(file);
+    }
+
+    len = cdi->ra_size;
+    if ((seek + len) > cdi->ra_file_len)
+	len = (seek < cdi->ra_file_len) ? (cdi->ra_file_len - seek) : 0;
+
+    cdi->ra_len = 0;
+    if ((len < count) || !file->read(file, cdi->ra_buf, seek, len))
+	return file->read(file, buffer, seek, count);
+
+    cdi->ra_start = seek;
+    cdi->ra_len = (uint32_t) len;
+    memcpy(buffer, cdi->ra_buf, count);
+
+    return 1;
+}
+
+
+static int
+cdi_file_read(cd_img_t *cdi, track_file_t *file, uint8_t *buffer, uint64_t seek, size_t count)
+{
+    int ret;
+
+    cdi_ra_lock(cdi);
+    ret = cdi_file_read_locked(cdi, file, buffer, seek, count);
+    cdi_ra_unlock(cdi);
+
+    return ret;
+}
+
+
 int
 cdi_set_device(cd_img_t *cdi, const wchar_t *path)
 {
@@ -315,23 +433,35 @@ cdi_get_audio_track_info_lba(cd_img_t *cdi, int end, int track, int *track_num,
 int
 cdi_get_track(cd_img_t *cdi, uint32_t sector)
 {
-    int i;
-    track_t *cur, *next;
+    int lo, hi, mid, i = cdi->last_track;
 
     /* There must be at least two tracks - data and lead out. */
     if (cdi->tracks_num < 2)
 	return -1;
 
-    /* This has a problem - the code skips the last track, which is
-       lead out - is that correct? */
-    for (i = 0; i < (cdi->tracks_num - 1); i++) {
-	cur = &cdi->tracks[i];
-	next = &cdi->tracks[i + 1];
-	if ((cur->start <= sector) && (sector < next->start))
-		return cur->number;
+    /* Reads mostly stay within the same track. The last track is the
+       lead out and is never returned. */
+    if ((i >= (cdi->tracks_num - 1)) || (cdi->tracks[i].start > sector) ||
+	(sector >= cdi->tracks[i + 1].start)) {
+	/* Find the last track that starts at or before the sector. */
+	lo = 0;
+	hi = cdi->tracks_num - 2;
+	while (lo < hi) {
+		mid = (lo + hi + 1) >> 1;
+		if (cdi->tracks[mid].start <= sector)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	i = lo;
+	if ((cdi->tracks[i].start > sector) || (sector >= cdi->tracks[i + 1].start))
+		return -1;
+
+	cdi->last_track = i;
     }
 
-    return -1;
+    return cdi->tracks[i].number;
 }
 
 
@@ -401,7 +531,7 @@ cdi_read_sector(cd_img_t *cdi, uint8_t *buffer, int raw, uint32_t sector)
 
     if (raw && !track_is_raw) {
 	memset(buffer, 0x00, 2448);
-    	ret = trk->file->read(trk->file, buffer + offset, seek, length);
+    	ret = cdi_file_read(cdi, trk->file, buffer + offset, seek, length);
 	if (!ret)
 		return 0;
 	/* Construct the rest of the raw sector. */
@@ -415,36 +545,54 @@ cdi_read_sector(cd_img_t *cdi, uint8_t *buffer, int raw, uint32_t sector)
 	buffer[15] = trk->mode2 ? 2 : 1;	/* Data, should reflect the actual sector type. */
 	return 1;
     } else if (!raw && track_is_raw)
-    	return trk->file->read(trk->file, buffer, seek + offset, length);
+    	return cdi_file_read(cdi, trk->file, buffer, seek + offset, length);
     else
-    	return trk->file->read(trk->file, buffer, seek, length);
+    	return cdi_file_read(cdi, trk->file, buffer, seek, length);
 }
 
 
 int
 cdi_read_sectors(cd_img_t *cdi, uint8_t *buffer, int raw, uint32_t sector, uint32_t num)
 {
-    int sector_size, success = 1;
-    uint8_t *buf;
-    uint32_t buf_len, i;
+    uint8_t temp[2448];
+    int sector_size, track;
+    uint32_t i, run;
+    uint64_t seek;
+    track_t *trk;
 
     /* TODO: This fails to account for Mode 2. Shouldn't we have a function 
 	     to get sector size? */
     sector_size = raw ? RAW_SECTOR_SIZE : COOKED_SECTOR_SIZE;
-    buf_len = num * sector_size;
-    buf = (uint8_t *) malloc(buf_len * sizeof(uint8_t));
 
-    for (i = 0; i < num; i++) {
-	success = cdi_read_sector(cdi, &buf[i * sector_size], raw, sector + i);
-	if (!success)
-		break;
-    }
+    for (i = 0; i < num; i += run) {
+	track = cdi_get_track(cdi, sector + i) - 1;
+	if (track < 0)
+		return 0;
 
-    memcpy((void *) buffer, buf, buf_len);
-    free(buf);
-    buf = NULL;
+	trk = &cdi->tracks[track];
+	run = 1;
 
-    return success;
+	if ((raw && (trk->sector_size == RAW_SECTOR_SIZE)) ||
+	    (!raw && (trk->sector_size == COOKED_SECTOR_SIZE) && !trk->mode2)) {
+		/* Stored just like requested, read the rest of the track
+		   in one go straight into the buffer. */
+		run = num - i;
+		if ((sector + i + run) > cdi->tracks[track + 1].start)
+			run = (uint32_t) (cdi->tracks[track + 1].start - (sector + i));
+
+		seek = trk->skip + (((uint64_t) (sector + i) - trk->start) * trk->sector_size);
+		if (!cdi_file_read(cdi, trk->file, &buffer[i * sector_size], seek, run * sector_size))
+			return 0;
+	} else {
+		/* The sector has to be built, which may need more room
+		   than the caller's slot. */
+		if (!cdi_read_sector(cdi, temp, raw, sector + i))
+			return 0;
+		memcpy(&buffer[i * sector_size], temp, sector_size);
+	}
+    }
+
+    return 1;
 }
 
 
@@ -464,7 +612,7 @@ cdi_read_sector_sub(cd_img_t *cdi, uint8_t *buffer, uint32_t sector)
     if (trk->sector_size != 2448)
 	return 0;
 
-    return trk->file->read(trk->file, buffer, seek, 2448);
+    return cdi_file_read(cdi, trk->file, buffer, seek, 2448);
 }
 
 
@@ -559,7 +707,7 @@ cdi_load_iso(cd_img_t *cdi, const wchar_t *filename)
     memset(&trk, 0, sizeof(track_t));
 
     /* Data track (shouldn't there be a lead in track?). */
-    trk.file = bin_init(filename, &error);
+    trk.file = track_file_init(filename, &error);
     if (error) {
 	if ((trk.file != NULL) && (trk.file->close != NULL))
 		trk.file->close(trk.file);
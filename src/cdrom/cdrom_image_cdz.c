@@ -0,0 +1,508 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Compressed CD-ROM image track files.
+ *
+ *		A compressed file stands in for any ISO or BIN file, and
+ *		is recognized by its magic rather than by its name. The
+ *		original file is split into hunks of CDZ_HUNK_SIZE bytes,
+ *		each compressed with LZF, or stored as-is when it does not
+ *		compress:
+ *
+ *		  0	magic "86BoxCDZ"
+ *		  8	uint32 version
+ *		  12	uint32 hunk size
+ *		  16	uint64 length of the original file
+ *		  24	uint32 number of hunks
+ *		  28	uint32 reserved
+ *		  32	hunk table, per hunk: uint64 offset,
+ *			uint32 length, uint32 flags
+ *
+ *		All values are little endian, and are packed and unpacked
+ *		byte by byte so the files are the same on every host.
+ */
+#define _LARGEFILE_SOURCE
+#define _LARGEFILE64_SOURCE
+#define __STDC_FORMAT_MACROS
+#include <stdarg.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/plat.h>
+#include <86box/cdrom_image_backend.h>
+#include <lzf.h>
+
+
+#define CDZ_MAGIC		"86BoxCDZ"
+#define CDZ_VERSION		1
+
+#define CDZ_HUNK_SIZE		65536
+#define CDZ_CACHE_HUNKS		16		/* decompressed hunks kept */
+
+#define CDZ_HUNK_STORED		0x01		/* not compressed */
+
+#define CDZ_HEADER_SIZE		32		/* on disk */
+#define CDZ_ENTRY_SIZE		16
+
+
+typedef struct {
+    char	magic[8];
+    uint32_t	version,
+		hunk_size;
+    uint64_t	length;
+    uint32_t	hunks,
+		reserved;
+} cdz_header_t;
+
+typedef struct {
+    uint64_t	offset;
+    uint32_t	length,
+		flags;
+} cdz_hunk_t;
+
+typedef struct {
+    int		valid;
+    uint32_t	hunk,
+		used;		/* LRU stamp */
+    uint8_t	*buf;
+} cdz_cache_t;
+
+typedef struct {
+    track_file_t tf;		/* must be first */
+
+    cdz_header_t hdr;
+    cdz_hunk_t	*table;
+    uint8_t	*cbuf;		/* compressed hunk being read */
+
+    cdz_cache_t	cache[CDZ_CACHE_HUNKS];
+    uint32_t	stamp;
+} cdz_t;
+
+
+#ifdef ENABLE_CDROM_IMAGE_CDZ_LOG
+int cdrom_image_cdz_do_log = ENABLE_CDROM_IMAGE_CDZ_LOG;
+
+
+static void
+cdz_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (cdrom_image_cdz_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define cdz_log(fmt, ...)
+#endif
+
+
+static void
+cdz_put(uint8_t *b, uint64_t val, int bytes)
+{
+    int i;
+
+    for (i = 0; i < bytes; i++)
+	b[i] = (uint8_t) (val >> (i << 3));
+}
+
+
+static uint64_t
+cdz_get(const uint8_t *b, int bytes)
+{
+    uint64_t val = 0ULL;
+    int i;
+
+    for (i = (bytes - 1); i >= 0; i--)
+	val = (val << 8) | b[i];
+
+    return val;
+}
+
+
+static void
+cdz_header_pack(const cdz_header_t *hdr, uint8_t *b)
+{
+    memcpy(b, hdr->magic, 8);
+    cdz_put(b + 8, hdr->version, 4);
+    cdz_put(b + 12, hdr->hunk_size, 4);
+    cdz_put(b + 16, hdr->length, 8);
+    cdz_put(b + 24, hdr->hunks, 4);
+    cdz_put(b + 28, hdr->reserved, 4);
+}
+
+
+static void
+cdz_header_unpack(cdz_header_t *hdr, const uint8_t *b)
+{
+    memcpy(hdr->magic, b, 8);
+    hdr->version = (uint32_t) cdz_get(b + 8, 4);
+    hdr->hunk_size = (uint32_t) cdz_get(b + 12, 4);
+    hdr->length = cdz_get(b + 16, 8);
+    hdr->hunks = (uint32_t) cdz_get(b + 24, 4);
+    hdr->reserved = (uint32_t) cdz_get(b + 28, 4);
+}
+
+
+static void
+cdz_table_pack(const cdz_hunk_t *table, uint32_t hunks, uint8_t *b)
+{
+    uint32_t i;
+
+    for (i = 0; i < hunks; i++, b += CDZ_ENTRY_SIZE) {
+	cdz_put(b, table[i].offset, 8);
+	cdz_put(b + 8, table[i].length, 4);
+	cdz_put(b + 12, table[i].flags, 4);
+    }
+}
+
+
+static void
+cdz_table_unpack(cdz_hunk_t *table, uint32_t hunks, const uint8_t *b)
+{
+    uint32_t i;
+
+    for (i = 0; i < hunks; i++, b += CDZ_ENTRY_SIZE) {
+	table[i].offset = cdz_get(b, 8);
+	table[i].length = (uint32_t) cdz_get(b + 8, 4);
+	table[i].flags = (uint32_t) cdz_get(b + 12, 4);
+    }
+}
+
+
+/* Return the decompressed data of a hunk, from the cache if possible. */
+static uint8_t *
+cdz_get_hunk(cdz_t *dev, uint32_t hunk)
+{
+    cdz_cache_t *slot = &dev->cache[0];
+    cdz_hunk_t *h = &dev->table[hunk];
+    uint32_t size;
+    int i;
+
+    for (i = 0; i < CDZ_CACHE_HUNKS; i++) {
+	if (dev->cache[i].valid && (dev->cache[i].hunk == hunk)) {
+		dev->cache[i].used = ++dev->stamp;
+		return dev->cache[i].buf;
+	}
+
+	/* Evict the least recently used hunk. */
+	if (!dev->cache[i].valid)
+		slot = &dev->cache[i];
+	else if (slot->valid && (dev->cache[i].used < slot->used))
+		slot = &dev->cache[i];
+    }
+
+    size = dev->hdr.hunk_size;
+    if (hunk == (dev->hdr.hunks - 1))
+	size = (uint32_t) (dev->hdr.length - ((uint64_t) hunk * dev->hdr.hunk_size));
+
+    slot->valid = 0;
+
+    if (fseeko64(dev->tf.file, h->offset, SEEK_SET) == -1)
+	return NULL;
+
+    if (h->flags & CDZ_HUNK_STORED) {
+	if ((h->length != size) || (fread(slot->buf, 1, size, dev->tf.file) != size))
+		return NULL;
+    } else {
+	if ((h->length > dev->hdr.hunk_size) ||
+	    (fread(dev->cbuf, 1, h->length, dev->tf.file) != h->length))
+		return NULL;
+	if (lzf_decompress(dev->cbuf, h->length, slot->buf, size) != size) {
+		cdz_log("CDZ: hunk %u is corrupt\n", hunk);
+		return NULL;
+	}
+    }
+
+    slot->valid = 1;
+    slot->hunk = hunk;
+    slot->used = ++dev->stamp;
+
+    return slot->buf;
+}
+
+
+static int
+cdz_read(void *p, uint8_t *buffer, uint64_t seek, size_t count)
+{
+    cdz_t *dev = (cdz_t *) p;
+    uint32_t hunk, offset, len;
+    uint8_t *data;
+
+    if ((seek + count) > dev->hdr.length)
+	return 0;
+
+    while (count > 0) {
+	hunk = (uint32_t) (seek / dev->hdr.hunk_size);
+	offset = (uint32_t) (seek % dev->hdr.hunk_size);
+	len = dev->hdr.hunk_size - offset;
+	if (len > count)
+		len = (uint32_t) count;
+
+	data = cdz_get_hunk(dev, hunk);
+	if (data == NULL)
+		return 0;
+
+	memcpy(buffer, data + offset, len);
+	buffer += len;
+	seek += len;
+	count -= len;
+    }
+
+    return 1;
+}
+
+
+static uint64_t
+cdz_get_length(void *p)
+{
+    cdz_t *dev = (cdz_t *) p;
+
+    return dev->hdr.length;
+}
+
+
+static void
+cdz_close(void *p)
+{
+    cdz_t *dev = (cdz_t *) p;
+    int i;
+
+    if (dev == NULL)
+	return;
+
+    if (dev->tf.file != NULL)
+	fclose(dev->tf.file);
+
+    for (i = 0; i < CDZ_CACHE_HUNKS; i++) {
+	if (dev->cache[i].buf != NULL)
+		free(dev->cache[i].buf);
+    }
+
+    if (dev->cbuf != NULL)
+	free(dev->cbuf);
+    if (dev->table != NULL)
+	free(dev->table);
+
+    free(dev);
+}
+
+
+int
+cdz_detect(const wchar_t *filename)
+{
+    char magic[8];
+    FILE *f;
+    int ret;
+
+    f = plat_fopen64(filename, L"rb");
+    if (f == NULL)
+	return 0;
+
+    ret = (fread(magic, 1, 8, f) == 8) && !memcmp(magic, CDZ_MAGIC, 8);
+    fclose(f);
+
+    return ret;
+}
+
+
+track_file_t *
+cdz_init(const wchar_t *filename, int *error)
+{
+    cdz_t *dev = (cdz_t *) malloc(sizeof(cdz_t));
+    uint8_t hdr[CDZ_HEADER_SIZE];
+    uint8_t *raw = NULL;
+    uint64_t file_size;
+    uint32_t i;
+
+    *error = 1;
+
+    if (dev == NULL)
+	return NULL;
+    memset(dev, 0x00, sizeof(cdz_t));
+
+    if (wcslen(filename) <= 260)
+	wcscpy(dev->tf.fn, filename);
+    else
+	wcsncpy(dev->tf.fn, filename, 260);
+    dev->tf.file = plat_fopen64(dev->tf.fn, L"rb");
+    if (dev->tf.file == NULL)
+	goto fail;
+
+    if (fseeko64(dev->tf.file, 0, SEEK_END) == -1)
+	goto fail;
+    file_size = (uint64_t) ftello64(dev->tf.file);
+    if ((file_size < CDZ_HEADER_SIZE) || (file_size == (uint64_t) -1) ||
+	(fseeko64(dev->tf.file, 0, SEEK_SET) == -1))
+	goto fail;
+
+    if (fread(hdr, 1, CDZ_HEADER_SIZE, dev->tf.file) != CDZ_HEADER_SIZE)
+	goto fail;
+    cdz_header_unpack(&dev->hdr, hdr);
+
+    /* Everything below is sized from the header, so make sure it agrees
+       with itself and with the size of the file before trusting it. */
+    if (memcmp(dev->hdr.magic, CDZ_MAGIC, 8) || (dev->hdr.version != CDZ_VERSION) ||
+	(dev->hdr.hunk_size != CDZ_HUNK_SIZE) ||
+	((uint64_t) dev->hdr.hunks != ((dev->hdr.length + CDZ_HUNK_SIZE - 1) / CDZ_HUNK_SIZE)) ||
+	((uint64_t) dev->hdr.hunks > ((file_size - CDZ_HEADER_SIZE) / CDZ_ENTRY_SIZE)) ||
+	((uint64_t) dev->hdr.hunks > (SIZE_MAX / CDZ_ENTRY_SIZE))) {
+	cdz_log("CDZ: %ls is not a valid compressed image\n", filename);
+	goto fail;
+    }
+
+    dev->table = (cdz_hunk_t *) malloc((size_t) dev->hdr.hunks * sizeof(cdz_hunk_t));
+    dev->cbuf = (uint8_t *) malloc(CDZ_HUNK_SIZE);
+    raw = (uint8_t *) malloc((size_t) dev->hdr.hunks * CDZ_ENTRY_SIZE);
+    if ((dev->table == NULL) || (dev->cbuf == NULL) || (raw == NULL) ||
+	(fread(raw, CDZ_ENTRY_SIZE, dev->hdr.hunks, dev->tf.file) != dev->hdr.hunks))
+	goto fail;
+    cdz_table_unpack(dev->table, dev->hdr.hunks, raw);
+    free(raw);
+    raw = NULL;
+
+    for (i = 0; i < dev->hdr.hunks; i++) {
+	if ((dev->table[i].length > CDZ_HUNK_SIZE) || (dev->table[i].offset > file_size) ||
+	    (dev->table[i].length > (file_size - dev->table[i].offset))) {
+		cdz_log("CDZ: %ls: hunk %u lies outside the file\n", filename, i);
+		goto fail;
+	}
+    }
+
+    for (i = 0; i < CDZ_CACHE_HUNKS; i++) {
+	dev->cache[i].buf = (uint8_t *) malloc(CDZ_HUNK_SIZE);
+	if (dev->cache[i].buf == NULL)
+		goto fail;
+    }
+
+    cdz_log("CDZ: %ls: %" PRIu64 " bytes in %u hunks\n", filename,
+	    dev->hdr.length, dev->hdr.hunks);
+
+    dev->tf.read = cdz_read;
+    dev->tf.get_length = cdz_get_length;
+    dev->tf.close = cdz_close;
+
+    *error = 0;
+    return &dev->tf;
+
+fail:
+    free(raw);
+    cdz_close(dev);
+    return NULL;
+}
+
+
+/* Compress an ISO or BIN file; a CUE sheet can keep pointing at the
+   original file name once the compressed file replaces it. */
+int
+cdz_convert(const wchar_t *src, const wchar_t *dst)
+{
+    cdz_header_t hdr;
+    cdz_hunk_t *table = NULL;
+    uint8_t raw_hdr[CDZ_HEADER_SIZE];
+    uint8_t *raw = NULL, *in = NULL, *out = NULL;
+    FILE *fi, *fo = NULL;
+    uint32_t i, len, clen;
+    uint64_t stored = 0ULL;
+    int ret = 0;
+
+    fi = plat_fopen64(src, L"rb");
+    if (fi == NULL) {
+	pclog("CDZ: unable to open '%ls'\n", src);
+	return 0;
+    }
+
+    memset(&hdr, 0x00, sizeof(cdz_header_t));
+    memcpy(hdr.magic, CDZ_MAGIC, 8);
+    hdr.version = CDZ_VERSION;
+    hdr.hunk_size = CDZ_HUNK_SIZE;
+    fseeko64(fi, 0, SEEK_END);
+    hdr.length = ftello64(fi);
+    fseeko64(fi, 0, SEEK_SET);
+    hdr.hunks = (uint32_t) ((hdr.length + hdr.hunk_size - 1) / hdr.hunk_size);
+
+    table = (cdz_hunk_t *) calloc(hdr.hunks ? hdr.hunks : 1, sizeof(cdz_hunk_t));
+    raw = (uint8_t *) calloc(hdr.hunks ? hdr.hunks : 1, CDZ_ENTRY_SIZE);
+    in = (uint8_t *) malloc(hdr.hunk_size);
+    out = (uint8_t *) malloc(hdr.hunk_size);
+    if ((table == NULL) || (raw == NULL) || (in == NULL) || (out == NULL))
+	goto done;
+
+    fo = plat_fopen64(dst, L"wb");
+    if (fo == NULL) {
+	pclog("CDZ: unable to create '%ls'\n", dst);
+	goto done;
+    }
+
+    /* The table is written again once the offsets are known. */
+    cdz_header_pack(&hdr, raw_hdr);
+    if ((fwrite(raw_hdr, 1, CDZ_HEADER_SIZE, fo) != CDZ_HEADER_SIZE) ||
+	(fwrite(raw, CDZ_ENTRY_SIZE, hdr.hunks, fo) != hdr.hunks))
+	goto done;
+
+    for (i = 0; i < hdr.hunks; i++) {
+	len = hdr.hunk_size;
+	if (i == (hdr.hunks - 1))
+		len = (uint32_t) (hdr.length - ((uint64_t) i * hdr.hunk_size));
+
+	if (fread(in, 1, len, fi) != len)
+		goto done;
+
+	table[i].offset = ftello64(fo);
+
+	clen = lzf_compress(in, len, out, len - 1);
+	if (clen == 0) {
+		table[i].length = len;
+		table[i].flags = CDZ_HUNK_STORED;
+		if (fwrite(in, 1, len, fo) != len)
+			goto done;
+	} else {
+		table[i].length = clen;
+		if (fwrite(out, 1, clen, fo) != clen)
+			goto done;
+	}
+
+	stored += table[i].length;
+    }
+
+    cdz_table_pack(table, hdr.hunks, raw);
+    if ((fseeko64(fo, CDZ_HEADER_SIZE, SEEK_SET) == -1) ||
+	(fwrite(raw, CDZ_ENTRY_SIZE, hdr.hunks, fo) != hdr.hunks))
+	goto done;
+
+    pclog("CDZ: '%ls' compressed from %" PRIu64 " to %" PRIu64 " bytes\n",
+	  src, hdr.length, stored + CDZ_HEADER_SIZE + ((uint64_t) hdr.hunks * CDZ_ENTRY_SIZE));
+    ret = 1;
+
+done:
+    if (fo != NULL) {
+	/* A write error only shows up when the last data is flushed. */
+	if (fclose(fo) != 0)
+		ret = 0;
+
+	/* Do not leave a truncated image behind. */
+	if (!ret) {
+		pclog("CDZ: unable to compress '%ls'\n", src);
+		plat_remove((wchar_t *) dst);
+	}
+    }
+    fclose(fi);
+    free(out);
+    free(in);
+    free(raw);
+    free(table);
+
+    return ret;
+}
@@ -58,6 +58,10 @@ typedef struct codeblock_t
         /*First mem_block_t used by this block. Any subsequent mem_block_ts
           will be in the list starting at head_mem_block->next.*/
         struct mem_block_t *head_mem_block;
+
+        /*Set each time the block is executed, cleared as the eviction clock
+          hand passes over it.*/
+        uint8_t referenced;
 } codeblock_t;
 
 extern codeblock_t *codeblock;
@@ -334,9 +338,19 @@ void codegen_check_seg_read(codeblock_t *block, struct ir_data_t *ir, x86seg *se
 void codegen_check_seg_write(codeblock_t *block, struct ir_data_t *ir, x86seg *seg);
 
 int codegen_purge_purgable_list();
-/*Delete a random code block to free memory. This is obviously quite expensive, and
-  will only be called when the allocator is out of memory*/
-void codegen_delete_random_block(int required_mem_block);
+/*Delete a code block that has not been executed recently, to free memory. This is
+  obviously quite expensive, and will only be called when the allocator is out of
+  memory or there are no free code blocks*/
+void codegen_delete_cold_block(int required_mem_block);
+
+typedef struct codegen_stats_t
+{
+        uint64_t compiles;              /*Blocks generated*/
+        uint64_t evictions;             /*Blocks deleted to free memory or code blocks*/
+        uint64_t evicted_recompiles;    /*Blocks generated again soon after being evicted*/
+} codegen_stats_t;
+
+extern codegen_stats_t codegen_stats;
 
 extern int cpu_block_end;
 extern uint32_t codegen_endpc;
@@ -53,6 +53,22 @@ uint32_t instr_counts[256*256];
 
 static uint16_t block_free_list;
 static void delete_block(codeblock_t *block);
+
+codegen_stats_t codegen_stats;
+
+/*Eviction uses the CLOCK algorithm : the hand sweeps over the code blocks, giving
+  each block that has been executed since the last sweep a second chance.*/
+static int block_clock_hand = 1;
+
+/*Recently evicted blocks, to count how many are regenerated. Direct mapped, so
+  older entries are simply overwritten.*/
+#define EVICT_HISTORY_SIZE 4096
+#define EVICT_HISTORY_MASK (EVICT_HISTORY_SIZE-1)
+#define EVICT_HISTORY_HASH(pc) (((pc) ^ ((pc) >> 12)) & EVICT_HISTORY_MASK)
+static struct
+{
+        uint32_t pc, phys;
+} evict_history[EVICT_HISTORY_SIZE];
 static void delete_dirty_block(codeblock_t *block);
 
 /*Temporary list of code blocks that have recently been evicted. This allows for
@@ -200,7 +216,7 @@ static codeblock_t *block_free_list_get()
                 }
                 /*Free list is empty - free up a block*/
                 if (!codegen_purge_purgable_list())
-                        codegen_delete_random_block(0);
+                        codegen_delete_cold_block(0);
         }
 
         block = &codeblock[block_free_list];
@@ -222,6 +238,7 @@ void codegen_init()
                 block_free_list_add(&codeblock[c]);
         block_dirty_list_head = block_dirty_list_tail = 0;
         dirty_list_size = 0;
+        memset(evict_history, 0xff, sizeof(evict_history));
 #ifdef DEBUG_EXTRA
         memset(instr_counts, 0, sizeof(instr_counts));
 #endif
@@ -229,6 +246,11 @@ void codegen_init()
 
 void codegen_close()
 {
+#ifndef RELEASE_BUILD
+        pclog("Code blocks : %llu generated, %llu evicted, %llu regenerated after eviction\n",
+                (unsigned long long)codegen_stats.compiles, (unsigned long long)codegen_stats.evictions,
+                (unsigned long long)codegen_stats.evicted_recompiles);
+#endif
 #ifdef DEBUG_EXTRA
         pclog("Instruction counts :\n");
         while (1)
@@ -282,6 +304,9 @@ void codegen_reset()
                 codeblock[c].pc = BLOCK_PC_INVALID;
                 block_free_list_add(&codeblock[c]);
         }
+
+        memset(evict_history, 0xff, sizeof(evict_history));
+        block_clock_hand = 1;
 }
 
 void dump_block()
@@ -463,23 +488,34 @@ void codegen_delete_block(codeblock_t *block)
                 delete_block(block);
 }
 
-void codegen_delete_random_block(int required_mem_block)
+void codegen_delete_cold_block(int required_mem_block)
 {
-        int block_nr = rand() & BLOCK_MASK;
-        
         while (1)
         {
+                int block_nr = block_clock_hand;
+                
+                block_clock_hand = (block_clock_hand + 1) & BLOCK_MASK;
+
                 if (block_nr && block_nr != block_current)
                 {
                         codeblock_t *block = &codeblock[block_nr];
 
                         if (block->pc != BLOCK_PC_INVALID && (!required_mem_block || block->head_mem_block))
                         {
+                                if (block->referenced)
+                                {
+                                        /*Executed recently, give it a second chance*/
+                                        block->referenced = 0;
+                                        continue;
+                                }
+
+                                evict_history[EVICT_HISTORY_HASH(block->pc)].pc = block->pc;
+                                evict_history[EVICT_HISTORY_HASH(block->pc)].phys = block->phys;
+                                codegen_stats.evictions++;
                                 delete_block(block);
                                 return;
                         }
                 }
-                block_nr = (block_nr + 1) & BLOCK_MASK;
         }
 }
 
@@ -567,6 +603,7 @@ void codegen_block_init(uint32_t phys_addr)
         block->page_mask = block->page_mask2 = 0;
         block->flags = CODEBLOCK_STATIC_TOP;
         block->status = cpu_cur_status;
+        block->referenced = 1;
         
         recomp_page = block->phys & ~0xfff;
         codeblock_tree_add(block);
@@ -597,6 +634,14 @@ void codegen_block_start_recompile(codeblock_t *block)
         block->head_mem_block = codegen_allocator_allocate(NULL, block_current);
         block->data = codeblock_allocator_get_ptr(block->head_mem_block);
 
+        codegen_stats.compiles++;
+        if (evict_history[EVICT_HISTORY_HASH(block->pc)].pc == block->pc &&
+            evict_history[EVICT_HISTORY_HASH(block->pc)].phys == block->phys)
+        {
+                codegen_stats.evicted_recompiles++;
+                evict_history[EVICT_HISTORY_HASH(block->pc)].pc = BLOCK_PC_INVALID;
+        }
+
         block->status = cpu_cur_status;
         
         block->page_mask = block->page_mask2 = 0;
@@ -50,6 +50,7 @@
 #include <86box/fdc_ext.h>
 #include <86box/gameport.h>
 #include <86box/machine.h>
+#include <86box/mem.h>
 #include <86box/mouse.h>
 #include <86box/network.h>
 #include <86box/scsi.h>
@@ -673,6 +674,8 @@ load_machine(void)
 
     cpu_use_dynarec = !!config_get_int(cat, "cpu_use_dynarec", 0);
 
+    cachesize = config_get_int(cat, "mmu_cache_size", MMU_CACHE_SIZE);
+
     p = config_get_string(cat, "time_sync", NULL);
     if (p != NULL) {        
 	if (!strcmp(p, "disabled"))
@@ -723,6 +726,16 @@ load_video(void)
     }
 
     voodoo_enabled = !!config_get_int(cat, "voodoo", 0);
+
+    p = config_get_string(cat, "capture_format", "png");
+    if (!strcmp(p, "ppm"))
+	video_capture_format = VIDEO_CAPTURE_PPM;
+      else
+	video_capture_format = VIDEO_CAPTURE_PNG;
+    video_capture_level = config_get_int(cat, "capture_compression", -1);
+    if (video_capture_level > 9)
+	video_capture_level = 9;
+    video_capture_interval = config_get_int(cat, "capture_interval", 0);
 }
 
 
@@ -825,6 +838,19 @@ load_sound(void)
 	sound_is_float = 1;
       else
 	sound_is_float = 0;
+
+    p = config_get_string(cat, "sound_output", "openal");
+    if (!strcmp(p, "wav"))
+	sound_output = SOUND_OUTPUT_WAV;
+      else if (!strcmp(p, "null"))
+	sound_output = SOUND_OUTPUT_NULL;
+      else
+	sound_output = SOUND_OUTPUT_OPENAL;
+
+    memset(sound_wav_path, '\0', sizeof(sound_wav_path));
+    p = config_get_string(cat, "wav_output_file", NULL);
+    if (p != NULL)
+	strncpy(sound_wav_path, p, sizeof(sound_wav_path) - 1);
 }
 
 
@@ -1112,6 +1138,9 @@ load_hard_disks(void)
 		wcsncat(hdd[c].fn, wp, sizeof_w(hdd[c].fn)-wcslen(usr_path));
 	}
 
+	sprintf(temp, "hdd_%02i_mmap", c+1);
+	hdd[c].use_mmap = !!config_get_int(cat, temp, 0);
+
 	/* If disk is empty or invalid, mark it for deletion. */
 	if (! hdd_is_valid(c)) {
 		sprintf(temp, "hdd_%02i_parameters", c+1);
@@ -1128,6 +1157,9 @@ load_hard_disks(void)
 
 		sprintf(temp, "hdd_%02i_fn", c+1);
 		config_delete_var(cat, temp);
+
+		sprintf(temp, "hdd_%02i_mmap", c+1);
+		config_delete_var(cat, temp);
 	}
 
 	sprintf(temp, "hdd_%02i_mfm_channel", c+1);
@@ -1297,6 +1329,11 @@ load_floppy_and_cdrom_drives(void)
 	sprintf(temp, "cdrom_%02i_speed", c+1);
 	cdrom[c].speed = config_get_int(cat, temp, 8);
 
+	sprintf(temp, "cdrom_%02i_readahead", c+1);
+	cdrom[c].readahead = config_get_int(cat, temp, CDROM_READAHEAD);
+	if (cdrom[c].readahead < 0)
+		cdrom[c].readahead = 0;
+
 	/* Default values, needed for proper operation of the Settings dialog. */
 	cdrom[c].ide_channel = cdrom[c].scsi_device_id = c + 2;
 
@@ -1975,6 +2012,11 @@ save_machine(void)
 
     config_set_int(cat, "cpu_use_dynarec", cpu_use_dynarec);
 
+    if (cachesize == MMU_CACHE_SIZE)
+	config_delete_var(cat, "mmu_cache_size");
+      else
+	config_set_int(cat, "mmu_cache_size", cachesize);
+
     if (time_sync & TIME_SYNC_ENABLED)
 	if (time_sync & TIME_SYNC_UTC)
 		config_set_string(cat, "time_sync", "utc");
@@ -2001,6 +2043,21 @@ save_video(void)
       else
 	config_set_int(cat, "voodoo", voodoo_enabled);
 
+    if (video_capture_format == VIDEO_CAPTURE_PPM)
+	config_set_string(cat, "capture_format", "ppm");
+      else
+	config_delete_var(cat, "capture_format");
+
+    if (video_capture_level < 0)
+	config_delete_var(cat, "capture_compression");
+      else
+	config_set_int(cat, "capture_compression", video_capture_level);
+
+    if (video_capture_interval <= 0)
+	config_delete_var(cat, "capture_interval");
+      else
+	config_set_int(cat, "capture_interval", video_capture_interval);
+
     delete_section_if_empty(cat);
 }
 
@@ -2110,6 +2167,18 @@ save_sound(void)
       else
 	config_set_string(cat, "sound_type", (sound_is_float == 1) ? "float" : "int16");
 
+    if (sound_output == SOUND_OUTPUT_WAV)
+	config_set_string(cat, "sound_output", "wav");
+      else if (sound_output == SOUND_OUTPUT_NULL)
+	config_set_string(cat, "sound_output", "null");
+      else
+	config_delete_var(cat, "sound_output");
+
+    if (sound_wav_path[0] == '\0')
+	config_delete_var(cat, "wav_output_file");
+      else
+	config_set_string(cat, "wav_output_file", sound_wav_path);
+
     delete_section_if_empty(cat);
 }
 
@@ -2315,6 +2384,12 @@ save_hard_disks(void)
 			config_set_wstring(cat, temp, hdd[c].fn);
 	else
 		config_delete_var(cat, temp);
+
+	sprintf(temp, "hdd_%02i_mmap", c+1);
+	if (hdd_is_valid(c) && hdd[c].use_mmap)
+		config_set_int(cat, temp, hdd[c].use_mmap);
+	else
+		config_delete_var(cat, temp);
     }
 
     delete_section_if_empty(cat);
@@ -2383,6 +2458,13 @@ save_floppy_and_cdrom_drives(void)
 		config_set_int(cat, temp, cdrom[c].speed);
 	}
 
+	sprintf(temp, "cdrom_%02i_readahead", c+1);
+	if ((cdrom[c].bus_type == 0) || (cdrom[c].readahead == CDROM_READAHEAD)) {
+		config_delete_var(cat, temp);
+	} else {
+		config_set_int(cat, temp, cdrom[c].readahead);
+	}
+
 	sprintf(temp, "cdrom_%02i_parameters", c+1);
 	if (cdrom[c].bus_type == 0) {
 		config_delete_var(cat, temp);
@@ -511,7 +511,9 @@ exec386_dynarec_dyn(void)
     {
 	void (*code)() = (void *)&block->data[BLOCK_START];
 
-#ifndef USE_NEW_DYNAREC
+#ifdef USE_NEW_DYNAREC
+	block->referenced = 1;
+#else
 	codeblock_hash[hash] = block;
 #endif
 	inrecomp = 1;
@@ -60,6 +60,9 @@
 # include "codegen.h"
 #endif
 #include "x87_timings.h"
+#include "x86.h"
+#include <86box/timer.h>
+#include <86box/savestate.h>
 
 #define CCR1_USE_SMI  (1 << 1)
 #define CCR1_SMAC     (1 << 2)
@@ -87,6 +90,7 @@ enum {
 	CPUID_AMDSEP = (1 << 10),
 	CPUID_SEP = (1 << 11),
 	CPUID_MTRR = (1 << 12),
+	CPUID_PGE = (1 << 13),
         CPUID_CMOV = (1 << 15),
         CPUID_MMX = (1 << 23),
 	CPUID_FXSR = (1 << 24)
@@ -1690,7 +1694,7 @@ cpu_set(void)
                 timing_misaligned = 3;
                 cpu_features = CPU_FEATURE_RDTSC | CPU_FEATURE_MSR | CPU_FEATURE_CR4 | CPU_FEATURE_VME;
                 msr.fcr = (1 << 8) | (1 << 9) | (1 << 12) |  (1 << 16) | (1 << 19) | (1 << 21);
-                cpu_CR4_mask = CR4_VME | CR4_PVI | CR4_TSD | CR4_DE | CR4_PSE | CR4_PAE | CR4_MCE | CR4_PCE;
+                cpu_CR4_mask = CR4_VME | CR4_PVI | CR4_TSD | CR4_DE | CR4_PSE | CR4_PAE | CR4_MCE | CR4_PGE | CR4_PCE;
 #ifdef USE_DYNAREC
      	codegen_timing_set(&codegen_timing_p6);
 #endif
@@ -1745,7 +1749,7 @@ cpu_set(void)
                 timing_misaligned = 3;
                 cpu_features = CPU_FEATURE_RDTSC | CPU_FEATURE_MSR | CPU_FEATURE_CR4 | CPU_FEATURE_VME | CPU_FEATURE_MMX;
                 msr.fcr = (1 << 8) | (1 << 9) | (1 << 12) |  (1 << 16) | (1 << 19) | (1 << 21);
-                cpu_CR4_mask = CR4_VME | CR4_PVI | CR4_TSD | CR4_DE | CR4_PSE | CR4_PAE | CR4_MCE | CR4_PCE;
+                cpu_CR4_mask = CR4_VME | CR4_PVI | CR4_TSD | CR4_DE | CR4_PSE | CR4_PAE | CR4_MCE | CR4_PGE | CR4_PCE;
 #ifdef USE_DYNAREC
      	codegen_timing_set(&codegen_timing_p6);
 #endif
@@ -1800,7 +1804,7 @@ cpu_set(void)
                 timing_misaligned = 3;
                 cpu_features = CPU_FEATURE_RDTSC | CPU_FEATURE_MSR | CPU_FEATURE_CR4 | CPU_FEATURE_VME | CPU_FEATURE_MMX;
                 msr.fcr = (1 << 8) | (1 << 9) | (1 << 12) |  (1 << 16) | (1 << 19) | (1 << 21);
-                cpu_CR4_mask = CR4_VME | CR4_PVI | CR4_TSD | CR4_DE | CR4_PSE | CR4_MCE | CR4_PAE | CR4_PCE | CR4_OSFXSR;
+                cpu_CR4_mask = CR4_VME | CR4_PVI | CR4_TSD | CR4_DE | CR4_PSE | CR4_MCE | CR4_PAE | CR4_PGE | CR4_PCE | CR4_OSFXSR;
 #ifdef USE_DYNAREC
      	codegen_timing_set(&codegen_timing_p6);
 #endif
@@ -2489,7 +2493,7 @@ cpu_CPUID(void)
                 {
                         EAX = CPUID;
                         EBX = ECX = 0;
-                        EDX = CPUID_FPU | CPUID_VME | CPUID_PSE | CPUID_TSC | CPUID_MSR | CPUID_PAE | CPUID_CMPXCHG8B | CPUID_MTRR | CPUID_SEP | CPUID_CMOV;
+                        EDX = CPUID_FPU | CPUID_VME | CPUID_PSE | CPUID_TSC | CPUID_MSR | CPUID_PAE | CPUID_CMPXCHG8B | CPUID_MTRR | CPUID_PGE | CPUID_SEP | CPUID_CMOV;
                 }
 		else if (EAX == 2)
 		{
@@ -2513,7 +2517,7 @@ cpu_CPUID(void)
                 {
                         EAX = CPUID;
                         EBX = ECX = 0;
-                        EDX = CPUID_FPU | CPUID_VME | CPUID_PSE | CPUID_TSC | CPUID_MSR | CPUID_PAE | CPUID_CMPXCHG8B | CPUID_MMX | CPUID_MTRR | CPUID_SEP | CPUID_CMOV;
+                        EDX = CPUID_FPU | CPUID_VME | CPUID_PSE | CPUID_TSC | CPUID_MSR | CPUID_PAE | CPUID_CMPXCHG8B | CPUID_MMX | CPUID_MTRR | CPUID_PGE | CPUID_SEP | CPUID_CMOV;
                 }
 		else if (EAX == 2)
 		{
@@ -2537,7 +2541,7 @@ cpu_CPUID(void)
                 {
                         EAX = CPUID;
                         EBX = ECX = 0;
-                        EDX = CPUID_FPU | CPUID_VME | CPUID_PSE | CPUID_TSC | CPUID_MSR | CPUID_PAE | CPUID_CMPXCHG8B | CPUID_MMX | CPUID_MTRR | CPUID_SEP | CPUID_FXSR | CPUID_CMOV;
+                        EDX = CPUID_FPU | CPUID_VME | CPUID_PSE | CPUID_TSC | CPUID_MSR | CPUID_PAE | CPUID_CMPXCHG8B | CPUID_MMX | CPUID_MTRR | CPUID_PGE | CPUID_SEP | CPUID_FXSR | CPUID_CMOV;
                 }
 		else if (EAX == 2)
 		{
@@ -3951,3 +3955,74 @@ cpu_update_waitstates(void)
         if (cpu_s->rspeed <= 8000000)
                 cpu_rom_prefetch_cycles = cpu_mem_prefetch_cycles;
 }
+
+
+void
+cpu_save_state(savestate_t *st)
+{
+    savestate_var(st, cpu_state);
+    savestate_var(st, cr2);
+    savestate_var(st, cr3);
+    savestate_var(st, cr4);
+    savestate_var(st, dr);
+    savestate_var(st, gdt);
+    savestate_var(st, ldt);
+    savestate_var(st, idt);
+    savestate_var(st, tr);
+    savestate_var(st, use32);
+    savestate_var(st, stack32);
+    savestate_var(st, cpu_cur_status);
+    savestate_var(st, cpu_cache_int_enabled);
+    savestate_var(st, cpu_cache_ext_enabled);
+
+    savestate_var(st, in_smm);
+    savestate_var(st, smi_line);
+    savestate_var(st, smi_latched);
+    savestate_var(st, smm_in_hlt);
+    savestate_var(st, smbase);
+    savestate_var(st, nmi_enable);
+
+    savestate_var(st, msr);
+    savestate_var(st, pmc);
+    savestate_var(st, cs_msr);
+    savestate_var(st, esp_msr);
+    savestate_var(st, eip_msr);
+    savestate_var(st, mtrr_physbase_msr);
+    savestate_var(st, mtrr_physmask_msr);
+    savestate_var(st, mtrr_fix64k_8000_msr);
+    savestate_var(st, mtrr_fix16k_8000_msr);
+    savestate_var(st, mtrr_fix16k_a000_msr);
+    savestate_var(st, mtrr_fix4k_msr);
+    savestate_var(st, mtrr_deftype_msr);
+    savestate_var(st, apic_base_msr);
+    savestate_var(st, pat_msr);
+    savestate_var(st, msr_ia32_pmc);
+    savestate_var(st, star);
+    savestate_var(st, amd_efer);
+    savestate_var(st, amd_whcr);
+    savestate_var(st, amd_uwccr);
+    savestate_var(st, amd_epmr);
+    savestate_var(st, amd_psor);
+    savestate_var(st, amd_pfir);
+    savestate_var(st, amd_l2aar);
+
+    savestate_var(st, ccr0);
+    savestate_var(st, ccr1);
+    savestate_var(st, ccr2);
+    savestate_var(st, ccr3);
+    savestate_var(st, ccr4);
+    savestate_var(st, ccr5);
+    savestate_var(st, ccr6);
+    savestate_var(st, cyrix_addr);
+    savestate_var(st, cyrix);
+
+    x87_save_state(st);
+
+    if (st->loading) {
+	/* The saved pointer belongs to another process, it is set up
+	   again by every instruction that uses it. */
+	cpu_state.ea_seg = &cpu_state.seg_ds;
+
+	cpu_update_waitstates();
+    }
+}
@@ -197,6 +197,7 @@ typedef struct {
 #define CR4_PVI		(1 << 1)
 #define CR4_PSE		(1 << 4)
 #define CR4_PAE		(1 << 5)
+#define CR4_PGE		(1 << 7)
 
 #define CPL ((cpu_state.seg_cs.access>>5)&3)
 
@@ -610,4 +611,8 @@ typedef struct
 
 extern cyrix_t	cyrix;
 
+struct _savestate_;
+extern void	cpu_save_state(struct _savestate_ *st);
+extern void	x87_save_state(struct _savestate_ *st);
+
 #endif	/*EMU_CPU_H*/
@@ -616,7 +616,15 @@ static int opHLT(uint32_t fetchdat)
 		enter_smm_check(1);
         else if (!((cpu_state.flags & I_FLAG) && pic.int_pending))
         {
-                CLOCK_CYCLES_ALWAYS(100);
+                /*Nothing can wake the CPU before the next timer fires, so
+                  skip straight to it, but not past the end of the slice.*/
+                int idle = (int)(timer_target - (uint32_t)tsc);
+
+                if (idle > cycles)
+                        idle = cycles;
+                if (idle < 100)
+                        idle = 100;
+                CLOCK_CYCLES_ALWAYS(idle);
 		if (!((cpu_state.flags & I_FLAG) && pic.int_pending))
                 	cpu_state.pc--;
         }
@@ -905,7 +913,7 @@ static int opLOADALL386(uint32_t fetchdat)
 	loadall_load_segment(la_addr + 0xb4, &cpu_state.seg_cs);
 	loadall_load_segment(la_addr + 0xc0, &cpu_state.seg_es);
 
-	if (CPL==3 && oldcpl!=3) flushmmucache_cr3();
+	if (CPL==3 && oldcpl!=3) flushmmucache_cpl3();
 	oldcpl = CPL;
 
 	CLOCK_CYCLES(350);
@@ -1,3 +1,93 @@
+/*Fast path for REP MOVS/STOS/LODS. Returns how many of count elements,
+  starting at seg:addr and going in the direction given by D_FLAG, lie in
+  one page that already has a host pointer in the lookup tables and are
+  within the segment limits, with *p pointing at the first one. Pages in
+  the lookup tables are plain RAM with no code on them (those go through
+  page_lookup instead), so they can be accessed directly. Returns 0 when
+  the normal path has to be used.*/
+static __inline int rep_fast_count(x86seg *seg, uint32_t addr, int wide, int size, int count, int write, uint8_t **p)
+{
+        uint32_t lin = seg->base + addr;
+        uint32_t off = lin & 0xfff;
+        uintptr_t host;
+        int n;
+
+        if (seg->base == 0xffffffff)
+                return 0;
+        if ((msw & 1) && !(cpu_state.eflags & VM_FLAG) && !(seg->access & 0x80))
+                return 0;
+        if ((addr < seg->limit_low) || (((uint64_t)addr + size - 1) > seg->limit_high) || ((off + size) > 0x1000))
+                return 0;
+
+        host = write ? writelookup2[lin >> 12] : readlookup2[lin >> 12];
+        if (host == LOOKUP_INV)
+                return 0;
+
+        if (cpu_state.flags & D_FLAG)
+        {
+                n = (off / size) + 1;
+                if (n > (int)((addr - seg->limit_low) / size) + 1)
+                        n = (int)((addr - seg->limit_low) / size) + 1;
+                if (n > (int)(addr / size) + 1)
+                        n = (int)(addr / size) + 1;
+        }
+        else
+        {
+                n = (0x1000 - off) / size;
+                if (n > (int)(((uint64_t)seg->limit_high - addr + 1) / size))
+                        n = (int)(((uint64_t)seg->limit_high - addr + 1) / size);
+                if ((wide == 2) && (n > (int)((0x10000 - addr) / size)))
+                        n = (int)((0x10000 - addr) / size);
+        }
+
+        if (n > count)
+                n = count;
+        *p = (uint8_t *)(host + lin);
+        return n;
+}
+
+/*Copy n elements the way REP MOVS would, one element after the other, so
+  overlapping moves give the same result as on the real CPU.*/
+static __inline void rep_fast_move(uint8_t *dest, uint8_t *src, int n, int size)
+{
+        uint32_t temp;
+        int c, len = n * size;
+
+        if (cpu_state.flags & D_FLAG)
+        {
+                dest -= len - size;
+                src -= len - size;
+        }
+
+        if (((dest + len) <= src) || ((src + len) <= dest))
+        {
+                memcpy(dest, src, len);
+                return;
+        }
+
+        for (c = 0; c < n; c++)
+        {
+                int i = (cpu_state.flags & D_FLAG) ? (n - 1 - c) : c;
+
+                memcpy(&temp, src + i * size, size);
+                memcpy(dest + i * size, &temp, size);
+        }
+}
+
+static __inline void rep_fast_fill(uint8_t *dest, uint32_t val, int n, int size)
+{
+        int c;
+
+        if (cpu_state.flags & D_FLAG)
+                dest -= (n - 1) * size;
+
+        if (size == 1)
+                memset(dest, val, n);
+        else for (c = 0; c < n; c++)
+                memcpy(dest + c * size, &val, size);
+}
+
+
 #define REP_OPS(size, CNT_REG, SRC_REG, DEST_REG) \
 static int opREP_INSB_ ## size(uint32_t fetchdat)                               \
 {                                                                               \
@@ -191,6 +281,26 @@ static int opREP_MOVSB_ ## size(uint32_t fetchdat)
         while (CNT_REG > 0)                                                     \
         {                                                                       \
                 uint8_t temp;                                                   \
+                uint8_t *src, *dest;                                            \
+                int n = (cycles - cycles_end) / (is486 ? 3 : 4) + 1;            \
+                                                                                \
+                if ((uint32_t)n > CNT_REG)                                      \
+                        n = CNT_REG;                                            \
+                n = rep_fast_count(cpu_state.ea_seg, SRC_REG, sizeof(SRC_REG), 1, n, 0, &src); \
+                if (n)                                                          \
+                        n = rep_fast_count(&cpu_state.seg_es, DEST_REG, sizeof(DEST_REG), 1, n, 1, &dest); \
+                if (n)                                                          \
+                {                                                               \
+                        rep_fast_move(dest, src, n, 1);                         \
+                        if (cpu_state.flags & D_FLAG) { DEST_REG -= n * 1; SRC_REG -= n * 1; } \
+                        else                { DEST_REG += n * 1; SRC_REG += n * 1; } \
+                        CNT_REG -= n;                                           \
+                        cycles -= n * (is486 ? 3 : 4);                          \
+                        reads += n; writes += n; total_cycles += n * (is486 ? 3 : 4); \
+                        if (cycles < cycles_end)                                \
+                                break;                                          \
+                        continue;                                               \
+                }                                                               \
                                                                                 \
                 CHECK_READ_REP(cpu_state.ea_seg, SRC_REG, SRC_REG);             \
                 CHECK_WRITE_REP(&cpu_state.seg_es, DEST_REG, DEST_REG);         \
@@ -228,6 +338,26 @@ static int opREP_MOVSW_ ## size(uint32_t fetchdat)
         while (CNT_REG > 0)                                                     \
         {                                                                       \
                 uint16_t temp;                                                  \
+                uint8_t *src, *dest;                                            \
+                int n = (cycles - cycles_end) / (is486 ? 3 : 4) + 1;            \
+                                                                                \
+                if ((uint32_t)n > CNT_REG)                                      \
+                        n = CNT_REG;                                            \
+                n = rep_fast_count(cpu_state.ea_seg, SRC_REG, sizeof(SRC_REG), 2, n, 0, &src); \
+                if (n)                                                          \
+                        n = rep_fast_count(&cpu_state.seg_es, DEST_REG, sizeof(DEST_REG), 2, n, 1, &dest); \
+                if (n)                                                          \
+                {                                                               \
+                        rep_fast_move(dest, src, n, 2);                         \
+                        if (cpu_state.flags & D_FLAG) { DEST_REG -= n * 2; SRC_REG -= n * 2; } \
+                        else                { DEST_REG += n * 2; SRC_REG += n * 2; } \
+                        CNT_REG -= n;                                           \
+                        cycles -= n * (is486 ? 3 : 4);                          \
+                        reads += n; writes += n; total_cycles += n * (is486 ? 3 : 4); \
+                        if (cycles < cycles_end)                                \
+                                break;                                          \
+                        continue;                                               \
+                }                                                               \
                                                                                 \
                 CHECK_READ_REP(cpu_state.ea_seg, SRC_REG, SRC_REG + 1);         \
                 CHECK_WRITE_REP(&cpu_state.seg_es, DEST_REG, DEST_REG + 1);     \
@@ -265,6 +395,26 @@ static int opREP_MOVSL_ ## size(uint32_t fetchdat)
         while (CNT_REG > 0)                                                     \
         {                                                                       \
                 uint32_t temp;                                                  \
+                uint8_t *src, *dest;                                            \
+                int n = (cycles - cycles_end) / (is486 ? 3 : 4) + 1;            \
+                                                                                \
+                if ((uint32_t)n > CNT_REG)                                      \
+                        n = CNT_REG;                                            \
+                n = rep_fast_count(cpu_state.ea_seg, SRC_REG, sizeof(SRC_REG), 4, n, 0, &src); \
+                if (n)                                                          \
+                        n = rep_fast_count(&cpu_state.seg_es, DEST_REG, sizeof(DEST_REG), 4, n, 1, &dest); \
+                if (n)                                                          \
+                {                                                               \
+                        rep_fast_move(dest, src, n, 4);                         \
+                        if (cpu_state.flags & D_FLAG) { DEST_REG -= n * 4; SRC_REG -= n * 4; } \
+                        else                { DEST_REG += n * 4; SRC_REG += n * 4; } \
+                        CNT_REG -= n;                                           \
+                        cycles -= n * (is486 ? 3 : 4);                          \
+                        reads += n; writes += n; total_cycles += n * (is486 ? 3 : 4); \
+                        if (cycles < cycles_end)                                \
+                                break;                                          \
+                        continue;                                               \
+                }                                                               \
                                                                                 \
                 CHECK_READ_REP(cpu_state.ea_seg, SRC_REG, SRC_REG + 3);         \
                 CHECK_WRITE_REP(&cpu_state.seg_es, DEST_REG, DEST_REG + 3);     \
@@ -300,6 +450,25 @@ static int opREP_STOSB_ ## size(uint32_t fetchdat)
                 SEG_CHECK_WRITE(&cpu_state.seg_es);                             \
         while (CNT_REG > 0)                                                     \
         {                                                                       \
+                uint8_t *dest;                                                  \
+                int n = (cycles - cycles_end) / (is486 ? 4 : 5) + 1;            \
+                                                                                \
+                if ((uint32_t)n > CNT_REG)                                      \
+                        n = CNT_REG;                                            \
+                n = rep_fast_count(&cpu_state.seg_es, DEST_REG, sizeof(DEST_REG), 1, n, 1, &dest); \
+                if (n)                                                          \
+                {                                                               \
+                        rep_fast_fill(dest, AL, n, 1);                          \
+                        if (cpu_state.flags & D_FLAG) DEST_REG -= n * 1;        \
+                        else                DEST_REG += n * 1;                  \
+                        CNT_REG -= n;                                           \
+                        cycles -= n * (is486 ? 4 : 5);                          \
+                        writes += n; total_cycles += n * (is486 ? 4 : 5);       \
+                        if (cycles < cycles_end)                                \
+                                break;                                          \
+                        continue;                                               \
+                }                                                               \
+                                                                                \
                 CHECK_WRITE_REP(&cpu_state.seg_es, DEST_REG, DEST_REG);         \
                 writememb(es, DEST_REG, AL); if (cpu_state.abrt) return 1;      \
                 if (cpu_state.flags & D_FLAG) DEST_REG--;                       \
@@ -329,6 +498,25 @@ static int opREP_STOSW_ ## size(uint32_t fetchdat)
                 SEG_CHECK_WRITE(&cpu_state.seg_es);                             \
         while (CNT_REG > 0)                                                     \
         {                                                                       \
+                uint8_t *dest;                                                  \
+                int n = (cycles - cycles_end) / (is486 ? 4 : 5) + 1;            \
+                                                                                \
+                if ((uint32_t)n > CNT_REG)                                      \
+                        n = CNT_REG;                                            \
+                n = rep_fast_count(&cpu_state.seg_es, DEST_REG, sizeof(DEST_REG), 2, n, 1, &dest); \
+                if (n)                                                          \
+                {                                                               \
+                        rep_fast_fill(dest, AX, n, 2);                          \
+                        if (cpu_state.flags & D_FLAG) DEST_REG -= n * 2;        \
+                        else                DEST_REG += n * 2;                  \
+                        CNT_REG -= n;                                           \
+                        cycles -= n * (is486 ? 4 : 5);                          \
+                        writes += n; total_cycles += n * (is486 ? 4 : 5);       \
+                        if (cycles < cycles_end)                                \
+                                break;                                          \
+                        continue;                                               \
+                }                                                               \
+                                                                                \
                 CHECK_WRITE_REP(&cpu_state.seg_es, DEST_REG, DEST_REG + 1);     \
                 writememw(es, DEST_REG, AX); if (cpu_state.abrt) return 1;      \
                 if (cpu_state.flags & D_FLAG) DEST_REG -= 2;                    \
@@ -358,6 +546,25 @@ static int opREP_STOSL_ ## size(uint32_t fetchdat)
                 SEG_CHECK_WRITE(&cpu_state.seg_es);                             \
         while (CNT_REG > 0)                                                     \
         {                                                                       \
+                uint8_t *dest;                                                  \
+                int n = (cycles - cycles_end) / (is486 ? 4 : 5) + 1;            \
+                                                                                \
+                if ((uint32_t)n > CNT_REG)                                      \
+                        n = CNT_REG;                                            \
+                n = rep_fast_count(&cpu_state.seg_es, DEST_REG, sizeof(DEST_REG), 4, n, 1, &dest); \
+                if (n)                                                          \
+                {                                                               \
+                        rep_fast_fill(dest, EAX, n, 4);                         \
+                        if (cpu_state.flags & D_FLAG) DEST_REG -= n * 4;        \
+                        else                DEST_REG += n * 4;                  \
+                        CNT_REG -= n;                                           \
+                        cycles -= n * (is486 ? 4 : 5);                          \
+                        writes += n; total_cycles += n * (is486 ? 4 : 5);       \
+                        if (cycles < cycles_end)                                \
+                                break;                                          \
+                        continue;                                               \
+                }                                                               \
+                                                                                \
                 CHECK_WRITE_REP(&cpu_state.seg_es, DEST_REG, DEST_REG + 3);     \
                 writememl(es, DEST_REG, EAX); if (cpu_state.abrt) return 1;     \
                 if (cpu_state.flags & D_FLAG) DEST_REG -= 4;                    \
@@ -388,6 +595,28 @@ static int opREP_LODSB_ ## size(uint32_t fetchdat)
                 SEG_CHECK_READ(cpu_state.ea_seg);                               \
         while (CNT_REG > 0)                                                     \
         {                                                                       \
+                uint8_t *src;                                                   \
+                int n = (cycles - cycles_end) / (is486 ? 4 : 5) + 1;            \
+                                                                                \
+                if ((uint32_t)n > CNT_REG)                                      \
+                        n = CNT_REG;                                            \
+                n = rep_fast_count(cpu_state.ea_seg, SRC_REG, sizeof(SRC_REG), 1, n, 0, &src); \
+                if (n)                                                          \
+                {                                                               \
+                        /*Only the last element read is left in the register.*/ \
+                        if (cpu_state.flags & D_FLAG) src -= (n - 1) * 1;       \
+                        else                src += (n - 1) * 1;                 \
+                        AL = *(uint8_t *)src;                                   \
+                        if (cpu_state.flags & D_FLAG) SRC_REG -= n * 1;         \
+                        else                SRC_REG += n * 1;                   \
+                        CNT_REG -= n;                                           \
+                        cycles -= n * (is486 ? 4 : 5);                          \
+                        reads += n; total_cycles += n * (is486 ? 4 : 5);        \
+                        if (cycles < cycles_end)                                \
+                                break;                                          \
+                        continue;                                               \
+                }                                                               \
+                                                                                \
                 CHECK_READ_REP(cpu_state.ea_seg, SRC_REG, SRC_REG);             \
                 AL = readmemb(cpu_state.ea_seg->base, SRC_REG); if (cpu_state.abrt) return 1;      \
                 if (cpu_state.flags & D_FLAG) SRC_REG--;                       \
@@ -417,6 +646,28 @@ static int opREP_LODSW_ ## size(uint32_t fetchdat)
                 SEG_CHECK_READ(cpu_state.ea_seg);                               \
         while (CNT_REG > 0)                                                     \
         {                                                                       \
+                uint8_t *src;                                                   \
+                int n = (cycles - cycles_end) / (is486 ? 4 : 5) + 1;            \
+                                                                                \
+                if ((uint32_t)n > CNT_REG)                                      \
+                        n = CNT_REG;                                            \
+                n = rep_fast_count(cpu_state.ea_seg, SRC_REG, sizeof(SRC_REG), 2, n, 0, &src); \
+                if (n)                                                          \
+                {                                                               \
+                        /*Only the last element read is left in the register.*/ \
+                        if (cpu_state.flags & D_FLAG) src -= (n - 1) * 2;       \
+                        else                src += (n - 1) * 2;                 \
+                        AX = *(uint16_t *)src;                                  \
+                        if (cpu_state.flags & D_FLAG) SRC_REG -= n * 2;         \
+                        else                SRC_REG += n * 2;                   \
+                        CNT_REG -= n;                                           \
+                        cycles -= n * (is486 ? 4 : 5);                          \
+                        reads += n; total_cycles += n * (is486 ? 4 : 5);        \
+                        if (cycles < cycles_end)                                \
+                                break;                                          \
+                        continue;                                               \
+                }                                                               \
+                                                                                \
                 CHECK_READ_REP(cpu_state.ea_seg, SRC_REG, SRC_REG + 1);         \
                 AX = readmemw(cpu_state.ea_seg->base, SRC_REG); if (cpu_state.abrt) return 1;      \
                 if (cpu_state.flags & D_FLAG) SRC_REG -= 2;                     \
@@ -446,6 +697,28 @@ static int opREP_LODSL_ ## size(uint32_t fetchdat)
                 SEG_CHECK_READ(cpu_state.ea_seg);                               \
         while (CNT_REG > 0)                                                     \
         {                                                                       \
+                uint8_t *src;                                                   \
+                int n = (cycles - cycles_end) / (is486 ? 4 : 5) + 1;            \
+                                                                                \
+                if ((uint32_t)n > CNT_REG)                                      \
+                        n = CNT_REG;                                            \
+                n = rep_fast_count(cpu_state.ea_seg, SRC_REG, sizeof(SRC_REG), 4, n, 0, &src); \
+                if (n)                                                          \
+                {                                                               \
+                        /*Only the last element read is left in the register.*/ \
+                        if (cpu_state.flags & D_FLAG) src -= (n - 1) * 4;       \
+                        else                src += (n - 1) * 4;                 \
+                        EAX = *(uint32_t *)src;                                 \
+                        if (cpu_state.flags & D_FLAG) SRC_REG -= n * 4;         \
+                        else                SRC_REG += n * 4;                   \
+                        CNT_REG -= n;                                           \
+                        cycles -= n * (is486 ? 4 : 5);                          \
+                        reads += n; total_cycles += n * (is486 ? 4 : 5);        \
+                        if (cycles < cycles_end)                                \
+                                break;                                          \
+                        continue;                                               \
+                }                                                               \
+                                                                                \
                 CHECK_READ_REP(cpu_state.ea_seg, SRC_REG, SRC_REG + 3);         \
                 EAX = readmeml(cpu_state.ea_seg->base, SRC_REG); if (cpu_state.abrt) return 1;     \
                 if (cpu_state.flags & D_FLAG) SRC_REG -= 4;                     \
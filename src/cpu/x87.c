@@ -15,6 +15,8 @@
 #include "x86_ops.h"
 #include "x87.h"
 #include "386_common.h"
+#include <86box/timer.h>
+#include <86box/savestate.h>
 
 
 uint32_t x87_pc_off,x87_op_off;
@@ -130,3 +132,15 @@ void x87_dumpregs()
         fpu_log("Status = %04X  Control = %04X  Tag = %04X\n", cpu_state.npxs, cpu_state.npxc, x87_gettag());
 }
 #endif
+
+
+/* The register stack, tags and control/status words live in cpu_state and
+   are saved along with it; this covers the last instruction pointers. */
+void
+x87_save_state(savestate_t *st)
+{
+    savestate_var(st, x87_pc_off);
+    savestate_var(st, x87_op_off);
+    savestate_var(st, x87_pc_seg);
+    savestate_var(st, x87_op_seg);
+}
@@ -49,9 +49,8 @@
 #include <86box/device.h>
 #include <86box/machine.h>
 #include <86box/sound.h>
-
-
-#define DEVICE_MAX	256			/* max # of devices */
+#include <86box/timer.h>
+#include <86box/savestate.h>
 
 
 static device_t		*devices[DEVICE_MAX];
@@ -471,6 +470,50 @@ device_force_redraw(void)
 }
 
 
+int
+device_has_state(int c)
+{
+    return((devices[c] != NULL) && (devices[c]->save_state != NULL));
+}
+
+
+/* Returns the device in slot c if it is running and has state that can
+   not be saved, NULL otherwise. Devices without an init function have no
+   state of their own. */
+const device_t *
+device_get_unsaved(int c)
+{
+    if ((devices[c] == NULL) || (devices[c]->init == NULL) || (devices[c]->save_state != NULL))
+	return(NULL);
+
+    return(devices[c]);
+}
+
+
+/* The device name is stored ahead of the device's own data, so that a
+   state taken from a different configuration is refused. */
+void
+device_save_state(int c, savestate_t *st)
+{
+    char name[128];
+
+    memset(name, 0x00, sizeof(name));
+    strncpy(name, devices[c]->name, sizeof(name) - 1);
+
+    if (st->loading) {
+	savestate_data(st, name, sizeof(name));
+	if (!st->error && strncmp(name, devices[c]->name, sizeof(name) - 1)) {
+		savestate_fail(st, "device mismatch");
+		return;
+	}
+    } else
+	savestate_data(st, name, sizeof(name));
+
+    if (!st->error)
+	devices[c]->save_state(device_priv[c], st);
+}
+
+
 const char *
 device_get_config_string(const char *s)
 {
@@ -22,6 +22,7 @@
  */
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
@@ -45,6 +46,7 @@
 #include <86box/snd_speaker.h>
 #include <86box/video.h>
 #include <86box/keyboard.h>
+#include <86box/savestate.h>
 
 
 #define STAT_PARITY		0x80
@@ -2286,6 +2288,34 @@ kbd_close(void *priv)
 }
 
 
+static void
+kbd_save_state(void *priv, savestate_t *st)
+{
+    atkbd_t *dev = (atkbd_t *)priv;
+
+    savestate_data(st, &dev->command, offsetof(atkbd_t, flags) - offsetof(atkbd_t, command));
+    savestate_timer(st, &dev->refresh_time);
+    savestate_timer(st, &dev->pulse_cb);
+    savestate_timer(st, &dev->send_delay_timer);
+
+    savestate_var(st, kbc_queue_pos);
+    savestate_var(st, channel_queue_pos);
+    savestate_var(st, kbc_queue);
+    savestate_var(st, channel_queue);
+    savestate_var(st, kbd_last_scan_code);
+    savestate_var(st, sc_or);
+
+    savestate_var(st, keyboard_mode);
+    savestate_var(st, keyboard_scan);
+    savestate_var(st, keyboard_set3_flags);
+    savestate_var(st, keyboard_set3_all_repeat);
+    savestate_var(st, keyboard_set3_all_break);
+
+    if (st->loading)
+	set_scancode_map(dev);
+}
+
+
 static void *
 kbd_init(const device_t *info)
 {
@@ -2362,7 +2392,8 @@ const device_t keyboard_at_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_at_ami_device = {
@@ -2372,7 +2403,8 @@ const device_t keyboard_at_ami_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_at_samsung_device = {
@@ -2382,7 +2414,8 @@ const device_t keyboard_at_samsung_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_at_toshiba_device = {
@@ -2392,7 +2425,8 @@ const device_t keyboard_at_toshiba_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_at_olivetti_device = {
@@ -2402,7 +2436,8 @@ const device_t keyboard_at_olivetti_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_at_ncr_device = {
@@ -2412,7 +2447,8 @@ const device_t keyboard_at_ncr_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_device = {
@@ -2422,7 +2458,8 @@ const device_t keyboard_ps2_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_ps2_device = {
@@ -2432,7 +2469,8 @@ const device_t keyboard_ps2_ps2_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_ps1_device = {
@@ -2442,7 +2480,8 @@ const device_t keyboard_ps2_ps1_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_ps1_pci_device = {
@@ -2452,7 +2491,8 @@ const device_t keyboard_ps2_ps1_pci_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_xi8088_device = {
@@ -2462,7 +2502,8 @@ const device_t keyboard_ps2_xi8088_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_ami_device = {
@@ -2472,7 +2513,8 @@ const device_t keyboard_ps2_ami_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_olivetti_device = {
@@ -2482,7 +2524,8 @@ const device_t keyboard_ps2_olivetti_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_mca_device = {
@@ -2492,7 +2535,8 @@ const device_t keyboard_ps2_mca_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_mca_2_device = {
@@ -2502,7 +2546,8 @@ const device_t keyboard_ps2_mca_2_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_quadtel_device = {
@@ -2512,7 +2557,8 @@ const device_t keyboard_ps2_quadtel_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_pci_device = {
@@ -2522,7 +2568,8 @@ const device_t keyboard_ps2_pci_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_ami_pci_device = {
@@ -2532,7 +2579,8 @@ const device_t keyboard_ps2_ami_pci_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_intel_ami_pci_device = {
@@ -2542,7 +2590,8 @@ const device_t keyboard_ps2_intel_ami_pci_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 const device_t keyboard_ps2_acer_pci_device = {
@@ -2552,7 +2601,8 @@ const device_t keyboard_ps2_acer_pci_device = {
     kbd_init,
     kbd_close,
     kbd_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    kbd_save_state
 };
 
 
@@ -21,6 +21,7 @@
 #define _LARGEFILE_SOURCE
 #define _LARGEFILE64_SOURCE
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -44,6 +45,7 @@
 #include <86box/ui.h>
 #include <86box/hdc.h>
 #include <86box/hdc_ide.h>
+#include <86box/savestate.h>
 #include <86box/hdd.h>
 #include <86box/zip.h>
 #include <86box/version.h>
@@ -1584,6 +1586,11 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
 				} else
 					ide_set_callback(ide, 200.0 * IDE_TIME);
 				ide->do_initial_read = 1;
+
+				/* Start reading the sectors while the command is
+				   being timed. */
+				if ((ide->type == IDE_HDD) && (ide->lba || ide->cfg_spt))
+					hdd_image_prefetch(ide->hdd_num, ide_get_sector(ide), ide->secount ? ide->secount : 256);
 				return;
 
 			case WIN_WRITE_MULTIPLE:
@@ -2030,6 +2037,19 @@ ide_board_callback(void *priv)
 }
 
 
+/* Returns non-zero if the image is still reading the sectors of the current
+   command in the background, in which case the callback is re-armed. */
+static int
+ide_read_pending(ide_t *ide)
+{
+    if (hdd_image_prefetch_done(ide->hdd_num, ide_get_sector(ide), ide->secount ? ide->secount : 256))
+	return 0;
+
+    ide_set_callback(ide, 10.0 * IDE_TIME);
+    return 1;
+}
+
+
 static void
 ide_callback(void *priv)
 {
@@ -2108,6 +2128,8 @@ ide_callback(void *priv)
 			goto id_not_found;
 
 		if (ide->do_initial_read) {
+			if (ide_read_pending(ide))
+				return;
 			ide->do_initial_read = 0;
 			ide->sector_pos = 0;
 			if (ide->secount)
@@ -2139,6 +2161,9 @@ ide_callback(void *priv)
 			goto id_not_found;
 		}
 
+		if (ide_read_pending(ide))
+			return;
+
 		ide->sector_pos = 0;
 		if (ide->secount)
 			ide->sector_pos = ide->secount;
@@ -2190,6 +2215,8 @@ ide_callback(void *priv)
 			goto id_not_found;
 
 		if (ide->do_initial_read) {
+			if (ide_read_pending(ide))
+				return;
 			ide->do_initial_read = 0;
 			ide->sector_pos = 0;
 			if (ide->secount)
@@ -2691,6 +2718,56 @@ ide_board_init(int board, int irq, int base_main, int side_main, int type)
 }
 
 
+/* The state of the ATAPI devices themselves is not part of this, so a
+   packet command that is in progress when the state is taken is lost. */
+static void
+ide_board_save_state(int board, savestate_t *st)
+{
+    ide_board_t *dev = ide_boards[board];
+    ide_t *ide;
+    int d, present;
+
+    if (dev == NULL) {
+	savestate_fail(st, "IDE board missing");
+	return;
+    }
+
+    savestate_data(st, dev, offsetof(ide_board_t, base_main));
+    savestate_timer(st, &dev->timer);
+
+    for (d = (board << 1); d < ((board << 1) + 2); d++) {
+	ide = ide_drives[d];
+
+	present = (ide != NULL);
+	savestate_var(st, present);
+	if (st->error || (present != (ide != NULL))) {
+		savestate_fail(st, "IDE drive mismatch");
+		return;
+	}
+	if (!present)
+		continue;
+
+	savestate_data(st, ide, offsetof(ide_t, buffer));
+	if (ide->buffer != NULL)
+		savestate_data(st, ide->buffer, 65536 * sizeof(uint16_t));
+	if (ide->sector_buffer != NULL)
+		savestate_data(st, ide->sector_buffer, 256 * 512);
+	savestate_timer(st, &ide->timer);
+	savestate_var(st, ide->interrupt_drq);
+    }
+}
+
+
+static void
+ide_save_state(void *priv, savestate_t *st)
+{
+    ide_board_save_state(0, st);
+
+    if (ide_boards[1] != NULL)
+	ide_board_save_state(1, st);
+}
+
+
 static void *
 ide_ter_init(const device_t *info)
 {
@@ -2708,6 +2785,13 @@ ide_ter_close(void *priv)
 }
 
 
+static void
+ide_ter_save_state(void *priv, savestate_t *st)
+{
+    ide_board_save_state(2, st);
+}
+
+
 static void *
 ide_qua_init(const device_t *info)
 {
@@ -2725,6 +2809,13 @@ ide_qua_close(void *priv)
 }
 
 
+static void
+ide_qua_save_state(void *priv, savestate_t *st)
+{
+    ide_board_save_state(3, st);
+}
+
+
 void *
 ide_xtide_init(void)
 {
@@ -2849,7 +2940,8 @@ const device_t ide_isa_device = {
     DEVICE_ISA | DEVICE_AT,
     0,
     ide_init, ide_close, ide_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    ide_save_state
 };
 
 const device_t ide_isa_2ch_device = {
@@ -2857,7 +2949,8 @@ const device_t ide_isa_2ch_device = {
     DEVICE_ISA | DEVICE_AT,
     1,
     ide_init, ide_close, ide_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    ide_save_state
 };
 
 const device_t ide_vlb_device = {
@@ -2865,7 +2958,8 @@ const device_t ide_vlb_device = {
     DEVICE_VLB | DEVICE_AT,
     2,
     ide_init, ide_close, ide_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    ide_save_state
 };
 
 const device_t ide_vlb_2ch_device = {
@@ -2873,7 +2967,8 @@ const device_t ide_vlb_2ch_device = {
     DEVICE_VLB | DEVICE_AT,
     3,
     ide_init, ide_close, ide_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    ide_save_state
 };
 
 const device_t ide_pci_device = {
@@ -2881,7 +2976,8 @@ const device_t ide_pci_device = {
     DEVICE_PCI | DEVICE_AT,
     4,
     ide_init, ide_close, ide_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    ide_save_state
 };
 
 const device_t ide_pci_2ch_device = {
@@ -2889,7 +2985,8 @@ const device_t ide_pci_2ch_device = {
     DEVICE_PCI | DEVICE_AT,
     5,
     ide_init, ide_close, ide_reset,
-    { NULL }, NULL, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    ide_save_state
 };
 
 static const device_config_t ide_ter_config[] =
@@ -2982,7 +3079,8 @@ const device_t ide_ter_device = {
     0,
     ide_ter_init, ide_ter_close, NULL,
     { NULL }, NULL, NULL,
-    ide_ter_config
+    ide_ter_config,
+    ide_ter_save_state
 };
 
 const device_t ide_qua_device = {
@@ -2991,5 +3089,6 @@ const device_t ide_qua_device = {
     0,
     ide_qua_init, ide_qua_close, NULL,
     { NULL }, NULL, NULL,
-    ide_qua_config
+    ide_qua_config,
+    ide_qua_save_state
 };
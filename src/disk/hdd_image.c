@@ -35,11 +35,25 @@
 #include "minivhd/minivhd.h"
 #include "minivhd/minivhd_internal.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#if defined(__APPLE__) || defined(__FreeBSD__)
+#define pread64 pread
+#define pwrite64 pwrite
+#endif
+#endif
+
 #define HDD_IMAGE_RAW 0
 #define HDD_IMAGE_HDI 1
 #define HDD_IMAGE_HDX 2
 #define HDD_IMAGE_VHD 3
 
+#define HDD_IO_SECTORS 256	/* Size of the read-ahead buffer, in sectors. */
+
 typedef struct
 {
 	FILE *file; /* Used for HDD_IMAGE_RAW, HDD_IMAGE_HDI, and HDD_IMAGE_HDX. */ 
@@ -48,12 +62,32 @@ typedef struct
 	uint32_t pos, last_sector;
 	uint8_t type; /* HDD_IMAGE_RAW, HDD_IMAGE_HDI, HDD_IMAGE_HDX, or HDD_IMAGE_VHD */
 	uint8_t loaded;
+
+	/* Once loaded, HDD_IMAGE_RAW, HDD_IMAGE_HDI, and HDD_IMAGE_HDX are
+	   accessed with positioned reads and writes on the underlying file,
+	   or through a mapping of the whole image if one was requested. */
+#ifdef _WIN32
+	HANDLE handle, mapping;
+#else
+	int fd;
+#endif
+	uint8_t *map;
+	uint64_t map_size;
+
+	/* Background reads: prefetches requested by the controllers, and
+	   read-ahead of sequential accesses. */
+	thread_t *io_thread;
+	event_t *io_start, *io_done;
+	volatile int io_busy;
+	int io_quit, io_valid;
+	uint32_t io_sector, io_count, io_next;
+	uint8_t *io_buffer;
 } hdd_image_t;
 
 
 hdd_image_t hdd_images[HDD_NUM];
 
-static char empty_sector[512];
+static uint8_t empty_sectors[HDD_IO_SECTORS << 9];
 static char *empty_sector_1mb;
 
 #ifdef ENABLE_HDD_IMAGE_LOG
@@ -198,6 +232,254 @@ hdd_image_calc_chs(uint32_t *c, uint32_t *h, uint32_t *s, uint32_t size)
 }
 
 
+/* Read from the image at the given byte offset, with a single call where
+   possible; returns the number of bytes read. */
+static uint32_t
+hdd_image_pread(hdd_image_t *img, uint8_t *buffer, uint32_t len, uint64_t offset)
+{
+	uint32_t total = 0;
+#ifdef _WIN32
+	OVERLAPPED ov;
+	DWORD done;
+#else
+	ssize_t done;
+#endif
+
+	if ((img->map != NULL) && ((offset + len) <= img->map_size)) {
+		memcpy(buffer, img->map + offset, len);
+		return len;
+	}
+
+	while (total < len) {
+#ifdef _WIN32
+		memset(&ov, 0, sizeof(OVERLAPPED));
+		ov.Offset = (DWORD) (offset + total);
+		ov.OffsetHigh = (DWORD) ((offset + total) >> 32);
+		if (!ReadFile(img->handle, buffer + total, len - total, &done, &ov) || (done == 0))
+			break;
+#else
+		done = pread64(img->fd, buffer + total, len - total, offset + total);
+		if ((done < 0) && (errno == EINTR))
+			continue;
+		if (done <= 0)
+			break;
+#endif
+		total += done;
+	}
+
+	return total;
+}
+
+
+static uint32_t
+hdd_image_pwrite(hdd_image_t *img, uint8_t *buffer, uint32_t len, uint64_t offset)
+{
+	uint32_t total = 0;
+#ifdef _WIN32
+	OVERLAPPED ov;
+	DWORD done;
+#else
+	ssize_t done;
+#endif
+
+	if ((img->map != NULL) && ((offset + len) <= img->map_size)) {
+		memcpy(img->map + offset, buffer, len);
+		return len;
+	}
+
+	while (total < len) {
+#ifdef _WIN32
+		memset(&ov, 0, sizeof(OVERLAPPED));
+		ov.Offset = (DWORD) (offset + total);
+		ov.OffsetHigh = (DWORD) ((offset + total) >> 32);
+		if (!WriteFile(img->handle, buffer + total, len - total, &done, &ov) || (done == 0))
+			break;
+#else
+		done = pwrite64(img->fd, buffer + total, len - total, offset + total);
+		if ((done < 0) && (errno == EINTR))
+			continue;
+		if (done <= 0)
+			break;
+#endif
+		total += done;
+	}
+
+	return total;
+}
+
+
+static void
+hdd_image_io_thread(void *priv)
+{
+	hdd_image_t *img = (hdd_image_t *) priv;
+
+	while (1) {
+		thread_wait_event(img->io_start, -1);
+		thread_reset_event(img->io_start);
+
+		if (img->io_quit)
+			break;
+
+		hdd_image_pread(img, img->io_buffer, img->io_count << 9,
+				((uint64_t) img->io_sector << 9) + img->base);
+
+		img->io_busy = 0;
+		thread_set_event(img->io_done);
+	}
+}
+
+
+static void
+hdd_image_io_wait(hdd_image_t *img)
+{
+	while (img->io_busy)
+		thread_wait_event(img->io_done, -1);
+}
+
+
+static int
+hdd_image_io_covers(hdd_image_t *img, uint32_t sector, uint32_t count)
+{
+	return img->io_valid && (sector >= img->io_sector) &&
+	       (((uint64_t) sector + count) <= ((uint64_t) img->io_sector + img->io_count));
+}
+
+
+/* Start reading the given sectors in the background. */
+static void
+hdd_image_io_queue(hdd_image_t *img, uint32_t sector, uint32_t count)
+{
+#ifndef _WIN32
+	uint64_t addr, page;
+#endif
+
+	if (sector > img->last_sector)
+		return;
+	if (count > (img->last_sector - sector + 1))
+		count = img->last_sector - sector + 1;
+	if (count > HDD_IO_SECTORS)
+		count = HDD_IO_SECTORS;
+
+	if (img->map != NULL) {
+		/* Let the kernel page it in. */
+#ifndef _WIN32
+		page = sysconf(_SC_PAGESIZE);
+		addr = ((uint64_t) sector << 9) + img->base;
+		madvise(img->map + (addr & ~(page - 1)), (count << 9) + (addr & (page - 1)), MADV_WILLNEED);
+#endif
+		return;
+	}
+
+	if ((img->io_thread == NULL) || hdd_image_io_covers(img, sector, count))
+		return;
+
+	hdd_image_io_wait(img);
+
+	img->io_sector = sector;
+	img->io_count = count;
+	img->io_valid = 1;
+
+	thread_reset_event(img->io_done);
+	img->io_busy = 1;
+	thread_set_event(img->io_start);
+}
+
+
+/* Drop the read-ahead buffer if it overlaps sectors about to be written. */
+static void
+hdd_image_io_invalidate(hdd_image_t *img, uint32_t sector, uint32_t count)
+{
+	if (!img->io_valid || ((sector + count) <= img->io_sector) ||
+	    (sector >= (img->io_sector + img->io_count)))
+		return;
+
+	hdd_image_io_wait(img);
+	img->io_valid = 0;
+}
+
+
+/* Switch a loaded image over to direct I/O and start its I/O thread. */
+static void
+hdd_image_io_init(uint8_t id)
+{
+	hdd_image_t *img = &hdd_images[id];
+
+	fflush(img->file);
+
+	img->map = NULL;
+	img->map_size = ((uint64_t) (img->last_sector + 1) << 9) + img->base;
+#ifdef _WIN32
+	img->handle = (HANDLE) _get_osfhandle(_fileno(img->file));
+	img->mapping = NULL;
+	if (hdd[id].use_mmap && (img->map_size <= (size_t) -1)) {
+		img->mapping = CreateFileMapping(img->handle, NULL, PAGE_READWRITE,
+						 (DWORD) (img->map_size >> 32), (DWORD) img->map_size, NULL);
+		if (img->mapping != NULL) {
+			img->map = (uint8_t *) MapViewOfFile(img->mapping, FILE_MAP_WRITE, 0, 0, (size_t) img->map_size);
+			if (img->map == NULL) {
+				CloseHandle(img->mapping);
+				img->mapping = NULL;
+			}
+		}
+	}
+#else
+	img->fd = fileno(img->file);
+	if (hdd[id].use_mmap && (img->map_size <= (size_t) -1)) {
+		img->map = (uint8_t *) mmap(NULL, (size_t) img->map_size, PROT_READ | PROT_WRITE,
+					    MAP_SHARED, img->fd, 0);
+		if (img->map == (uint8_t *) MAP_FAILED)
+			img->map = NULL;
+	}
+#endif
+	if (hdd[id].use_mmap && (img->map == NULL))
+		hdd_image_log("Hard disk image %i: Unable to map the image, using file I/O\n", id);
+
+	img->io_valid = img->io_busy = img->io_quit = 0;
+	img->io_next = 0xffffffff;
+
+	if (img->map != NULL)
+		return;
+
+	img->io_buffer = (uint8_t *) malloc(HDD_IO_SECTORS << 9);
+	img->io_start = thread_create_event();
+	img->io_done = thread_create_event();
+	img->io_thread = thread_create(hdd_image_io_thread, img);
+}
+
+
+static void
+hdd_image_io_close(hdd_image_t *img)
+{
+	if (img->io_thread != NULL) {
+		hdd_image_io_wait(img);
+		img->io_quit = 1;
+		thread_set_event(img->io_start);
+		thread_wait(img->io_thread, -1);
+		img->io_thread = NULL;
+
+		thread_destroy_event(img->io_start);
+		thread_destroy_event(img->io_done);
+	}
+
+	if (img->io_buffer != NULL) {
+		free(img->io_buffer);
+		img->io_buffer = NULL;
+	}
+	img->io_valid = 0;
+
+	if (img->map != NULL) {
+#ifdef _WIN32
+		UnmapViewOfFile(img->map);
+		CloseHandle(img->mapping);
+		img->mapping = NULL;
+#else
+		munmap(img->map, (size_t) img->map_size);
+#endif
+		img->map = NULL;
+	}
+}
+
+
 static int
 prepare_new_hard_disk(uint8_t id, uint64_t full_size)
 {
@@ -240,6 +522,8 @@ prepare_new_hard_disk(uint8_t id, uint64_t full_size)
 
 	hdd_images[id].last_sector = (uint32_t) (full_size >> 9) - 1;
 
+	hdd_image_io_init(id);
+
 	hdd_images[id].loaded = 1;
 
 	return 1;
@@ -271,12 +555,11 @@ hdd_image_load(int id)
 	int is_vhd[2] = { 0, 0 };   
 	int vhd_error = 0; 
 
-	memset(empty_sector, 0, sizeof(empty_sector));
-
 	hdd_images[id].base = 0;
 
 	if (hdd_images[id].loaded) {
 		if (hdd_images[id].file) {
+			hdd_image_io_close(&hdd_images[id]);
 			fclose(hdd_images[id].file);
 			hdd_images[id].file = NULL;
 		}
@@ -489,6 +772,7 @@ hdd_image_load(int id)
 		ret = prepare_new_hard_disk(id, full_size);
 	else {
 		hdd_images[id].last_sector = (uint32_t) (full_size >> 9) - 1;
+		hdd_image_io_init(id);
 		hdd_images[id].loaded = 1;
 		ret = 1;
 	}   
@@ -518,24 +802,52 @@ hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 		int non_transferred_sectors = mvhd_read_sectors(hdd_images[id].vhd, sector, count, buffer);
 		hdd_images[id].pos = sector + count - non_transferred_sectors - 1;
 	} else {
-		int i;
+		hdd_image_t *img = &hdd_images[id];
+		uint32_t done;
 
-		if (fseeko64(hdd_images[id].file, ((uint64_t)(sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1) {
-			fatal("Hard disk image %i: Read error during seek\n", id);
+		if (count == 0)
 			return;
-		}
 
-		for (i = 0; i < count; i++) {
-			if (feof(hdd_images[id].file))
-				break;
+		if (hdd_image_io_covers(img, sector, count)) {
+			hdd_image_io_wait(img);
+			memcpy(buffer, img->io_buffer + ((sector - img->io_sector) << 9), count << 9);
+			done = count;
+		} else
+			done = hdd_image_pread(img, buffer, count << 9, ((uint64_t) sector << 9) + img->base) >> 9;
 
-			hdd_images[id].pos = sector + i;
-			fread(buffer + (i << 9), 1, 512, hdd_images[id].file);
-		}
+		img->pos = sector + ((done > 0) ? (done - 1) : 0);
+
+		/* On sequential access, fetch what follows in the background
+		   unless the next request of the same size is already there. */
+		if ((sector == img->io_next) && !hdd_image_io_covers(img, sector + count, count))
+			hdd_image_io_queue(img, sector + count, HDD_IO_SECTORS);
+		img->io_next = sector + count;
 	}
 }
 
 
+/* Start reading sectors that a controller is about to ask for. */
+void
+hdd_image_prefetch(uint8_t id, uint32_t sector, uint32_t count)
+{
+	if (!hdd_images[id].loaded || (hdd_images[id].type == HDD_IMAGE_VHD))
+		return;
+
+	hdd_image_io_queue(&hdd_images[id], sector, count);
+}
+
+
+/* Returns non-zero unless the given sectors are still being read in the
+   background, ie. a hdd_image_read() of them would have to wait. */
+int
+hdd_image_prefetch_done(uint8_t id, uint32_t sector, uint32_t count)
+{
+	hdd_image_t *img = &hdd_images[id];
+
+	return !img->io_busy || !hdd_image_io_covers(img, sector, count);
+}
+
+
 uint32_t
 hdd_image_get_last_sector(uint8_t id)
 {
@@ -574,20 +886,16 @@ hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 		int non_transferred_sectors = mvhd_write_sectors(hdd_images[id].vhd, sector, count, buffer);
 		hdd_images[id].pos = sector + count - non_transferred_sectors - 1;
 	} else {
-		int i;
+		hdd_image_t *img = &hdd_images[id];
+		uint32_t done;
 
-		if (fseeko64(hdd_images[id].file, ((uint64_t)(sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1) {
-			fatal("Hard disk image %i: Write error during seek\n", id);
+		if (count == 0)
 			return;
-		}
 
-		for (i = 0; i < count; i++) {
-			if (feof(hdd_images[id].file))
-				break;
+		hdd_image_io_invalidate(img, sector, count);
 
-			hdd_images[id].pos = sector + i;
-			fwrite(buffer + (i << 9), 512, 1, hdd_images[id].file);
-		}
+		done = hdd_image_pwrite(img, buffer, count << 9, ((uint64_t) sector << 9) + img->base) >> 9;
+		img->pos = sector + ((done > 0) ? (done - 1) : 0);
 	}
 }
 
@@ -616,21 +924,21 @@ hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
 		int non_transferred_sectors = mvhd_format_sectors(hdd_images[id].vhd, sector, count);
 		hdd_images[id].pos = sector + count - non_transferred_sectors - 1;
 	} else {
-		uint32_t i = 0;
+		hdd_image_t *img = &hdd_images[id];
+		uint32_t i, n, done;
 
-		memset(empty_sector, 0, 512);
+		hdd_image_io_invalidate(img, sector, count);
 
-		if (fseeko64(hdd_images[id].file, ((uint64_t)(sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1) {
-			fatal("Hard disk image %i: Zero error during seek\n", id);
-			return;
-		}
+		for (i = 0; i < count; i += n) {
+			n = count - i;
+			if (n > HDD_IO_SECTORS)
+				n = HDD_IO_SECTORS;
 
-		for (i = 0; i < count; i++) {
-			if (feof(hdd_images[id].file))
+			done = hdd_image_pwrite(img, empty_sectors, n << 9, ((uint64_t) (sector + i) << 9) + img->base) >> 9;
+			if (done > 0)
+				img->pos = sector + i + done - 1;
+			if (done < n)
 				break;
-
-			hdd_images[id].pos = sector + i;
-			fwrite(empty_sector, 512, 1, hdd_images[id].file);
 		}
 	}
 }
@@ -675,6 +983,7 @@ hdd_image_unload(uint8_t id, int fn_preserve)
 
 	if (hdd_images[id].loaded) {
 		if (hdd_images[id].file != NULL) {
+			hdd_image_io_close(&hdd_images[id]);
 			fclose(hdd_images[id].file);
 			hdd_images[id].file = NULL;
 		} else if (hdd_images[id].vhd != NULL) {
@@ -702,6 +1011,7 @@ hdd_image_close(uint8_t id)
 		return;
 
 	if (hdd_images[id].file != NULL) {
+		hdd_image_io_close(&hdd_images[id]);
 		fclose(hdd_images[id].file);
 		hdd_images[id].file = NULL;
 	} else if (hdd_images[id].vhd != NULL) {
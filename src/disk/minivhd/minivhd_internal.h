@@ -23,10 +23,18 @@
 #define MVHD_DIF_LOC_W2RU 0x57327275
 #define MVHD_DIF_LOC_W2KU 0x57326B75
 
+/* Number of sector bitmaps kept in memory for each image in a chain */
+#define MVHD_BITMAP_CACHE_SIZE 32
+
 typedef struct MVHDSectorBitmap {
     uint8_t* curr_bitmap;
     int sector_count;
     int curr_block;
+    /* Recently used bitmaps, replaced least recently used first */
+    uint8_t* cache;
+    int cache_block[MVHD_BITMAP_CACHE_SIZE];
+    uint32_t cache_stamp[MVHD_BITMAP_CACHE_SIZE];
+    uint32_t cache_clock;
 } MVHDSectorBitmap;
 
 typedef struct MVHDFooter {
@@ -19,6 +19,9 @@
 #define VHD_TESTBIT(A,k)    ( A[(k/8)] & (0x80 >> (k%8)) )
 
 static inline void mvhd_check_sectors(uint32_t offset, int num_sectors, uint32_t total_sectors, int* transfer_sect, int* trunc_sect);
+static uint8_t* mvhd_get_sect_bitmap(MVHDMeta* vhdm, int blk);
+static int mvhd_sect_run(uint8_t* bitmap, int sib, int max, bool* allocated);
+static int mvhd_diff_resolve(MVHDMeta* vhdm, uint32_t s, int max, MVHDMeta** owner);
 static void mvhd_read_sect_bitmap(MVHDMeta* vhdm, int blk);
 static void mvhd_write_bat_entry(MVHDMeta* vhdm, int blk);
 static void mvhd_create_block(MVHDMeta* vhdm, int blk);
@@ -51,27 +54,132 @@ void mvhd_write_empty_sectors(FILE* f, int sector_count) {
 }
 
 /**
- * \brief Read the sector bitmap for a block.
+ * \brief Get the sector bitmap for a block, from the bitmap cache if possible
  * 
- * If the block is sparse, the sector bitmap in memory will be 
- * zeroed. Otherwise, the sector bitmap is read from the VHD file.
+ * If the block is sparse, the bitmap will be zeroed. Otherwise, on a miss, the 
+ * bitmap is read from the VHD file into the least recently used cache entry.
  * 
  * \param [in] vhdm MiniVHD data structure
- * \param [in] blk The block for which to read the sector bitmap from
+ * \param [in] blk The block for which to get the sector bitmap
+ * 
+ * \return Pointer to the bitmap, valid until the next call for this image
  */
-static void mvhd_read_sect_bitmap(MVHDMeta* vhdm, int blk) {
+static uint8_t* mvhd_get_sect_bitmap(MVHDMeta* vhdm, int blk) {
+    MVHDSectorBitmap* bm = &vhdm->bitmap;
+    size_t bm_size = (size_t)bm->sector_count * MVHD_SECTOR_SIZE;
+    uint8_t* entry;
+    int i, lru = 0;
+    for (i = 0; i < MVHD_BITMAP_CACHE_SIZE; i++) {
+        if (bm->cache_block[i] == blk) {
+            bm->cache_stamp[i] = ++bm->cache_clock;
+            return bm->cache + i * bm_size;
+        }
+        if (bm->cache_stamp[i] < bm->cache_stamp[lru]) {
+            lru = i;
+        }
+    }
+    entry = bm->cache + lru * bm_size;
     if (vhdm->block_offset[blk] != MVHD_SPARSE_BLK) {
         mvhd_fseeko64(vhdm->f, (uint64_t)vhdm->block_offset[blk] * MVHD_SECTOR_SIZE, SEEK_SET);
-        fread(vhdm->bitmap.curr_bitmap, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE, 1, vhdm->f);
+        fread(entry, bm_size, 1, vhdm->f);
     } else {
-        memset(vhdm->bitmap.curr_bitmap, 0, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+        memset(entry, 0, bm_size);
+    }
+    bm->cache_block[lru] = blk;
+    bm->cache_stamp[lru] = ++bm->cache_clock;
+    return entry;
+}
+
+/**
+ * \brief Count the sectors from sib onwards that are in the same state as sib
+ * 
+ * \param [in] bitmap The sector bitmap of the block
+ * \param [in] sib The first sector in the block
+ * \param [in] max The maximum number of sectors to count
+ * \param [out] allocated Whether the bit for the sectors is set
+ * 
+ * \return The length of the run, between 1 and max
+ */
+static int mvhd_sect_run(uint8_t* bitmap, int sib, int max, bool* allocated) {
+    uint8_t fill;
+    int n = 1, k;
+    *allocated = VHD_TESTBIT(bitmap, sib) != 0;
+    fill = *allocated ? 0xff : 0x00;
+    while (n < max) {
+        k = sib + n;
+        /* Skip whole bytes where possible */
+        if ((k % 8) == 0 && (max - n) >= 8 && bitmap[k / 8] == fill) {
+            n += 8;
+            continue;
+        }
+        if ((VHD_TESTBIT(bitmap, k) != 0) != *allocated) {
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+/**
+ * \brief Find which image in a differencing chain holds a run of sectors
+ * 
+ * The chain is walked once for the whole run, rather than once per sector. Each 
+ * level the run falls through to limits the run to the sectors that it does not 
+ * contain either.
+ * 
+ * \param [in] vhdm MiniVHD data structure of the child image
+ * \param [in] s The first sector of the run
+ * \param [in] max The maximum length of the run
+ * \param [out] owner The image to read the sectors from
+ * 
+ * \return The length of the run, between 1 and max
+ */
+static int mvhd_diff_resolve(MVHDMeta* vhdm, uint32_t s, int max, MVHDMeta** owner) {
+    MVHDMeta* curr_vhdm = vhdm;
+    bool allocated = false;
+    int blk, sib, n;
+    while (curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF) {
+        blk = s / curr_vhdm->sect_per_block;
+        sib = s % curr_vhdm->sect_per_block;
+        n = curr_vhdm->sect_per_block - sib;
+        if (n > max) {
+            n = max;
+        }
+        if (curr_vhdm->block_offset[blk] != MVHD_SPARSE_BLK) {
+            n = mvhd_sect_run(mvhd_get_sect_bitmap(curr_vhdm, blk), sib, n, &allocated);
+        } else {
+            allocated = false;
+        }
+        max = n;
+        if (allocated) {
+            break;
+        }
+        curr_vhdm = curr_vhdm->parent;
     }
+    *owner = curr_vhdm;
+    return max;
+}
+
+/**
+ * \brief Read the sector bitmap for a block into the current bitmap.
+ * 
+ * If the block is sparse, the sector bitmap in memory will be 
+ * zeroed. Otherwise, the sector bitmap is read from the VHD file
+ * or the bitmap cache.
+ * 
+ * \param [in] vhdm MiniVHD data structure
+ * \param [in] blk The block for which to read the sector bitmap from
+ */
+static void mvhd_read_sect_bitmap(MVHDMeta* vhdm, int blk) {
+    memcpy(vhdm->bitmap.curr_bitmap, mvhd_get_sect_bitmap(vhdm, blk), (size_t)vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
     vhdm->bitmap.curr_block = blk;
 }
 
 /**
  * \brief Write the current sector bitmap in memory to file
  * 
+ * The cached copy of the bitmap, if any, is updated as well.
+ * 
  * \param [in] vhdm MiniVHD data structure
  */
 static void mvhd_write_curr_sect_bitmap(MVHDMeta* vhdm) {
@@ -79,6 +187,13 @@ static void mvhd_write_curr_sect_bitmap(MVHDMeta* vhdm) {
         int64_t abs_offset = (int64_t)vhdm->block_offset[vhdm->bitmap.curr_block] * MVHD_SECTOR_SIZE;
         mvhd_fseeko64(vhdm->f, abs_offset, SEEK_SET);
         fwrite(vhdm->bitmap.curr_bitmap, MVHD_SECTOR_SIZE, vhdm->bitmap.sector_count, vhdm->f);
+        for (int i = 0; i < MVHD_BITMAP_CACHE_SIZE; i++) {
+            if (vhdm->bitmap.cache_block[i] == vhdm->bitmap.curr_block) {
+                memcpy(vhdm->bitmap.cache + (size_t)i * vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE,
+                       vhdm->bitmap.curr_bitmap, (size_t)vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+                break;
+            }
+        }
     }
 }
 
@@ -161,29 +276,30 @@ int mvhd_sparse_read(MVHDMeta* vhdm, uint32_t offset, int num_sectors, void* out
     uint8_t* buff = (uint8_t*)out_buff;
     int64_t addr;
     uint32_t s, ls;
-    int blk, prev_blk, sib;
+    int blk, sib, n;
+    bool allocated;
     ls = offset + transfer_sectors;
-    prev_blk = -1;
-    for (s = offset; s < ls; s++) {
+    /* Read each run of sectors with the same bitmap state in one go */
+    for (s = offset; s < ls; s += n) {
         blk = s / vhdm->sect_per_block;
         sib = s % vhdm->sect_per_block;
-        if (blk != prev_blk) {
-            prev_blk = blk;
-            if (vhdm->bitmap.curr_block != blk) {
-                mvhd_read_sect_bitmap(vhdm, blk);
-                mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR);
-            } else {
-                addr = ((int64_t)vhdm->block_offset[blk] + vhdm->bitmap.sector_count + sib) * MVHD_SECTOR_SIZE;
-                mvhd_fseeko64(vhdm->f, addr, SEEK_SET);
-            }
-        }        
-        if (VHD_TESTBIT(vhdm->bitmap.curr_bitmap, sib)) {
-            fread(buff, MVHD_SECTOR_SIZE, 1, vhdm->f);
+        n = vhdm->sect_per_block - sib;
+        if ((uint32_t)n > ls - s) {
+            n = ls - s;
+        }
+        if (vhdm->block_offset[blk] != MVHD_SPARSE_BLK) {
+            n = mvhd_sect_run(mvhd_get_sect_bitmap(vhdm, blk), sib, n, &allocated);
         } else {
-            memset(buff, 0, MVHD_SECTOR_SIZE);
-            mvhd_fseeko64(vhdm->f, MVHD_SECTOR_SIZE, SEEK_CUR);
+            allocated = false;
         }
-        buff += MVHD_SECTOR_SIZE;
+        if (allocated) {
+            addr = ((int64_t)vhdm->block_offset[blk] + vhdm->bitmap.sector_count + sib) * MVHD_SECTOR_SIZE;
+            mvhd_fseeko64(vhdm->f, addr, SEEK_SET);
+            fread(buff, (size_t)n * MVHD_SECTOR_SIZE, 1, vhdm->f);
+        } else {
+            memset(buff, 0, (size_t)n * MVHD_SECTOR_SIZE);
+        }
+        buff += (size_t)n * MVHD_SECTOR_SIZE;
     }
     return truncated_sectors;
 }
@@ -193,30 +309,20 @@ int mvhd_diff_read(MVHDMeta* vhdm, uint32_t offset, int num_sectors, void* out_b
     uint32_t total_sectors = (uint32_t)(vhdm->footer.curr_sz / MVHD_SECTOR_SIZE);
     mvhd_check_sectors(offset, num_sectors, total_sectors, &transfer_sectors, &truncated_sectors);
     uint8_t* buff = (uint8_t*)out_buff;
-    MVHDMeta* curr_vhdm = vhdm;
+    MVHDMeta* owner;
     uint32_t s, ls;
-    int blk, sib;
+    int n;
     ls = offset + transfer_sectors;
-    for (s = offset; s < ls; s++) {
-        while (curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF) {
-            blk = s / curr_vhdm->sect_per_block;
-            sib = s % curr_vhdm->sect_per_block;
-            if (curr_vhdm->bitmap.curr_block != blk) {
-                mvhd_read_sect_bitmap(curr_vhdm, blk);
-            }
-            if (!VHD_TESTBIT(curr_vhdm->bitmap.curr_bitmap, sib)) {
-                curr_vhdm = curr_vhdm->parent;
-            } else { break; }
-        }
+    for (s = offset; s < ls; s += n) {
+        n = mvhd_diff_resolve(vhdm, s, ls - s, &owner);
         /* We handle actual sector reading using the fixed or sparse functions,
            as a differencing VHD is also a sparse VHD */
-        if (curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF || curr_vhdm->footer.disk_type == MVHD_TYPE_DYNAMIC) {
-            mvhd_sparse_read(curr_vhdm, s, 1, buff);
+        if (owner->footer.disk_type == MVHD_TYPE_DIFF || owner->footer.disk_type == MVHD_TYPE_DYNAMIC) {
+            mvhd_sparse_read(owner, s, n, buff);
         } else {
-            mvhd_fixed_read(curr_vhdm, s, 1, buff);
+            mvhd_fixed_read(owner, s, n, buff);
         }
-        curr_vhdm = vhdm;
-        buff += MVHD_SECTOR_SIZE;
+        buff += (size_t)n * MVHD_SECTOR_SIZE;
     }
     return truncated_sectors;
 }
@@ -258,11 +364,10 @@ int mvhd_sparse_diff_write(MVHDMeta* vhdm, uint32_t offset, int num_sectors, voi
         if (blk != prev_blk) {
             if (vhdm->bitmap.curr_block != blk) {                
                 mvhd_read_sect_bitmap(vhdm, blk);
-                mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR);
-            } else {
-                addr = ((int64_t)vhdm->block_offset[blk] + vhdm->bitmap.sector_count + sib) * MVHD_SECTOR_SIZE;
-                mvhd_fseeko64(vhdm->f, addr, SEEK_SET);
             }
+            /* The bitmap may have come from the cache, so always seek */
+            addr = ((int64_t)vhdm->block_offset[blk] + vhdm->bitmap.sector_count + sib) * MVHD_SECTOR_SIZE;
+            mvhd_fseeko64(vhdm->f, addr, SEEK_SET);
             prev_blk = blk;
         }
         fwrite(buff, MVHD_SECTOR_SIZE, 1, vhdm->f);
@@ -144,6 +144,18 @@ static int mvhd_init_sector_bitmap(MVHDMeta* vhdm, MVHDError* err) {
         return -1;
     }
     vhdm->bitmap.curr_block = -1;
+    vhdm->bitmap.cache = calloc((size_t)MVHD_BITMAP_CACHE_SIZE * vhdm->bitmap.sector_count, MVHD_SECTOR_SIZE);
+    if (vhdm->bitmap.cache == NULL) {
+        free(vhdm->bitmap.curr_bitmap);
+        vhdm->bitmap.curr_bitmap = NULL;
+        *err = MVHD_ERR_MEM;
+        return -1;
+    }
+    for (int i = 0; i < MVHD_BITMAP_CACHE_SIZE; i++) {
+        vhdm->bitmap.cache_block[i] = -1;
+        vhdm->bitmap.cache_stamp[i] = 0;
+    }
+    vhdm->bitmap.cache_clock = 0;
     return 0;
 }
 
@@ -451,6 +463,8 @@ cleanup_format_buff:
 cleanup_bitmap:
     free(vhdm->bitmap.curr_bitmap);
     vhdm->bitmap.curr_bitmap = NULL;
+    free(vhdm->bitmap.cache);
+    vhdm->bitmap.cache = NULL;
 cleanup_bat:
     free(vhdm->block_offset);
     vhdm->block_offset = NULL;
@@ -478,6 +492,10 @@ void mvhd_close(MVHDMeta* vhdm) {
             free(vhdm->bitmap.curr_bitmap);
             vhdm->bitmap.curr_bitmap = NULL;
         }
+        if (vhdm->bitmap.cache != NULL) {
+            free(vhdm->bitmap.cache);
+            vhdm->bitmap.cache = NULL;
+        }
         if (vhdm->format_buffer.zero_data != NULL) {
             free(vhdm->format_buffer.zero_data);
             vhdm->format_buffer.zero_data = NULL;
@@ -31,6 +31,8 @@
 #include <86box/io.h>
 #include <86box/pic.h>
 #include <86box/dma.h>
+#include <86box/timer.h>
+#include <86box/savestate.h>
 
 
 dma_t		dma[8];
@@ -1011,6 +1013,24 @@ dma_reset(void)
 }
 
 
+void
+dma_save_state(savestate_t *st)
+{
+    savestate_var(st, dma);
+    savestate_var(st, dma_e);
+    savestate_var(st, dmaregs);
+    savestate_var(st, dma_wp);
+    savestate_var(st, dma_m);
+    savestate_var(st, dma_stat);
+    savestate_var(st, dma_stat_rq);
+    savestate_var(st, dma_stat_rq_pc);
+    savestate_var(st, dma_command);
+    savestate_var(st, dma_req_is_soft);
+    savestate_var(st, dma_mask);
+    savestate_var(st, dma_ps2);
+}
+
+
 void
 dma_remove_sg(void)
 {
@@ -1620,45 +1640,12 @@ dma_mode(int channel)
 void
 dma_bm_read(uint32_t PhysAddress, uint8_t *DataRead, uint32_t TotalSize, int TransferSize)
 {
-    uint32_t i = 0, n, n2;
-    uint8_t bytes[4] = { 0, 0, 0, 0 };
-
-    n = TotalSize & ~(TransferSize - 1);
-    n2 = TotalSize - n;
-
-    /* Do the divisible block, if there is one. */
-    if (n) {
-	for (i = 0; i < n; i += TransferSize)
-		mem_read_phys((void *) &(DataRead[i]), PhysAddress + i, TransferSize);
-    }
-
-    /* Do the non-divisible block, if there is one. */
-    if (n2) {
-	mem_read_phys((void *) bytes, PhysAddress + n, TransferSize);
-	memcpy((void *) &(DataRead[n]), bytes, n2);
-    }
+    mem_read_phys_block((void *) DataRead, PhysAddress, TotalSize, TransferSize);
 }
 
 
 void
 dma_bm_write(uint32_t PhysAddress, const uint8_t *DataWrite, uint32_t TotalSize, int TransferSize)
 {
-    uint32_t i = 0, n, n2;
-    uint8_t bytes[4] = { 0, 0, 0, 0 };
-
-    n = TotalSize & ~(TransferSize - 1);
-    n2 = TotalSize - n;
-
-    /* Do the divisible block, if there is one. */
-    if (n) {
-	for (i = 0; i < n; i += TransferSize)
-		mem_write_phys((void *) &(DataWrite[i]), PhysAddress + i, TransferSize);
-    }
-
-    /* Do the non-divisible block, if there is one. */
-    if (n2) {
-	mem_read_phys((void *) bytes, PhysAddress + n, TransferSize);
-	memcpy(bytes, (void *) &(DataWrite[n]), n2);
-	mem_write_phys((void *) bytes, PhysAddress + n, TransferSize);
-    }
+    mem_write_phys_block((const void *) DataWrite, PhysAddress, TotalSize, TransferSize);
 }
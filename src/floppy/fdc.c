@@ -17,6 +17,7 @@
  *		Copyright 2008-2020 Sarah Walker.
  *		Copyright 2016-2020 Miran Grca.
  */
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -36,6 +37,7 @@
 #include <86box/fdd.h>
 #include <86box/fdc.h>
 #include <86box/fdc_ext.h>
+#include <86box/savestate.h>
 
 
 extern uint64_t motoron[FDD_NUM];
@@ -2346,6 +2348,19 @@ fdc_3f1_enable(fdc_t *fdc, int enable)
 }
 
 
+static void
+fdc_save_state(void *priv, savestate_t *st)
+{
+    fdc_t *fdc = (fdc_t *) priv;
+
+    savestate_data(st, fdc, offsetof(fdc_t, timer));
+    savestate_timer(st, &fdc->timer);
+    savestate_timer(st, &fdc->watchdog_timer);
+
+    fdd_save_state(st);
+}
+
+
 const device_t fdc_xt_device = {
     "PC/XT Floppy Drive Controller",
     0,
@@ -2353,7 +2368,8 @@ const device_t fdc_xt_device = {
     fdc_init,
     fdc_close,
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
 
 const device_t fdc_xt_t1x00_device = {
@@ -2363,7 +2379,8 @@ const device_t fdc_xt_t1x00_device = {
     fdc_init,
     fdc_close,
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
 
 const device_t fdc_xt_amstrad_device = {
@@ -2373,7 +2390,8 @@ const device_t fdc_xt_amstrad_device = {
     fdc_init,
     fdc_close,
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
 
 
@@ -2384,7 +2402,8 @@ const device_t fdc_pcjr_device = {
     fdc_init,
     fdc_close,
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
 
 const device_t fdc_at_device = {
@@ -2394,7 +2413,8 @@ const device_t fdc_at_device = {
     fdc_init,
     fdc_close,
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
 
 const device_t fdc_at_actlow_device = {
@@ -2404,7 +2424,8 @@ const device_t fdc_at_actlow_device = {
     fdc_init,
     fdc_close,
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
 
 const device_t fdc_at_ps1_device = {
@@ -2414,7 +2435,8 @@ const device_t fdc_at_ps1_device = {
     fdc_init,
     fdc_close,
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
 
 const device_t fdc_at_smc_device = {
@@ -2424,7 +2446,8 @@ const device_t fdc_at_smc_device = {
     fdc_init,
     fdc_close,
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
 
 const device_t fdc_at_winbond_device = {
@@ -2434,7 +2457,8 @@ const device_t fdc_at_winbond_device = {
     fdc_init,
     fdc_close,
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
 
 const device_t fdc_at_nsc_device = {
@@ -2444,7 +2468,8 @@ const device_t fdc_at_nsc_device = {
     fdc_init,
     fdc_close,
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
 
 const device_t fdc_dp8473_device = {
@@ -2454,7 +2479,8 @@ const device_t fdc_dp8473_device = {
     fdc_init,
     fdc_close, 
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
 
 const device_t fdc_um8398_device = {
@@ -2464,5 +2490,6 @@ const device_t fdc_um8398_device = {
     fdc_init,
     fdc_close, 
     fdc_reset,
-    { NULL }, NULL, NULL
+    { NULL }, NULL, NULL, NULL,
+    fdc_save_state
 };
@@ -37,6 +37,7 @@
 #include <86box/fdd_mfm.h>
 #include <86box/fdd_td0.h>
 #include <86box/fdc.h>
+#include <86box/savestate.h>
 
 
 /* Flags:
@@ -308,6 +309,24 @@ fdd_current_track(int drive)
 }
 
 
+/* Only the drive mechanics are saved, the image itself is expected to be
+   the same file, unchanged, when the state is restored. */
+void
+fdd_save_state(savestate_t *st)
+{
+    int i;
+
+    for (i = 0; i < FDD_NUM; i++) {
+	savestate_var(st, fdd[i].track);
+	savestate_var(st, fdd[i].densel);
+	savestate_var(st, fdd[i].head);
+	savestate_var(st, motoron[i]);
+	savestate_var(st, fdd_changed[i]);
+	savestate_timer(st, &fdd_poll_time[i]);
+    }
+}
+
+
 void
 fdd_set_densel(int densel)
 {
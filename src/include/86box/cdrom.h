@@ -45,6 +45,8 @@
 
 #define CDROM_IMAGE 200
 
+#define CDROM_READAHEAD	32		/* default image read-ahead, in sectors */
+
 /* This is so that if/when this is changed to something else,
    changing this one define will be enough. */
 #define CDROM_EMPTY !dev->host_drive
@@ -116,7 +118,8 @@ typedef struct cdrom {
 	     seek_diff, cd_end;
 
     int host_drive, prev_host_drive,
-	cd_buflen, noplay;
+	cd_buflen, noplay,
+	readahead;		/* image read-ahead, in sectors */
 
     const cdrom_ops_t	*ops;
 
@@ -67,12 +67,25 @@ typedef struct {
 typedef struct {
     int			tracks_num;
     track_t		*tracks;
+
+    int			last_track;	/* index of the last track looked up */
+
+    /* Sequential read-ahead cache, shared with the CD audio thread. */
+    void		*ra_lock;
+    track_file_t	*ra_file;
+    uint8_t		*ra_buf;
+    uint32_t		ra_size,	/* 0 = disabled */
+			ra_len;
+    uint64_t		ra_start,
+			ra_next,	/* where a sequential read continues */
+			ra_file_len;
 } cd_img_t;
 
 
 /* Binary file functions. */
 extern void	cdi_close(cd_img_t *cdi);
 extern int	cdi_set_device(cd_img_t *cdi, const wchar_t *path);
+extern void	cdi_set_readahead(cd_img_t *cdi, uint32_t sectors);
 extern int	cdi_get_audio_tracks(cd_img_t *cdi, int *st_track, int *end, TMSF *lead_out);
 extern int	cdi_get_audio_tracks_lba(cd_img_t *cdi, int *st_track, int *end, uint32_t *lead_out);
 extern int	cdi_get_audio_track_info(cd_img_t *cdi, int end, int track, int *track_num, TMSF *start, uint8_t *attr);
@@ -90,6 +103,11 @@ extern int	cdi_load_cue(cd_img_t *cdi, const wchar_t *cuefile);
 extern int	cdi_has_data_track(cd_img_t *cdi);
 extern int	cdi_has_audio_track(cd_img_t *cdi);
 
+/* Compressed track files. */
+extern int	cdz_detect(const wchar_t *filename);
+extern track_file_t	*cdz_init(const wchar_t *filename, int *error);
+extern int	cdz_convert(const wchar_t *src, const wchar_t *dst);
+
 
 
 #endif /* ! CDROM_IMAGE_BACKEND_H */
@@ -53,6 +53,9 @@
 #define CONFIG_MIDI_IN  10
 
 
+#define DEVICE_MAX	256			/* max # of devices */
+
+
 enum {
     DEVICE_NOT_WORKING = 1,	/* does not currently work correctly and will be disabled in a release build */
     DEVICE_LPT = 2,		/* requires a parallel port */
@@ -91,6 +94,8 @@ typedef struct {
     const device_config_selection_t selection[16];
 } device_config_t;
 
+struct _savestate_;
+
 typedef struct _device_ {
     const char	*name;
     uint32_t	flags;		/* system flags */
@@ -108,6 +113,9 @@ typedef struct _device_ {
     void	(*force_redraw)(void *priv);
 
     const device_config_t *config;
+
+    /* Save or restore the device state, depending on st->loading. */
+    void	(*save_state)(void *priv, struct _savestate_ *st);
 } device_t;
 
 typedef struct {
@@ -143,6 +151,9 @@ extern void		device_register_pci_slot(const device_t *d, int device, int type, i
 extern void		device_speed_changed(void);
 extern void		device_force_redraw(void);
 extern void		device_get_name(const device_t *d, int bus, char *name);
+extern int		device_has_state(int c);
+extern void		device_save_state(int c, struct _savestate_ *st);
+extern const device_t	*device_get_unsaved(int c);
 
 extern int		device_is_valid(const device_t *, int machine_flags);
 
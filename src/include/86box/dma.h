@@ -72,6 +72,9 @@ extern void	dma_init(void);
 extern void	dma16_init(void);
 extern void	ps2_dma_init(void);
 extern void	dma_reset(void);
+
+struct _savestate_;
+extern void	dma_save_state(struct _savestate_ *st);
 extern int	dma_mode(int channel);
 
 extern void	readdma0(void);
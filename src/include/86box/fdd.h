@@ -65,6 +65,9 @@ extern int	fdd_get_from_internal_name(char *s);
 
 extern int	fdd_current_track(int drive);
 
+struct _savestate_;
+extern void	fdd_save_state(struct _savestate_ *st);
+
 
 typedef struct {
     int		id;
@@ -88,7 +88,8 @@ typedef struct {
     uint8_t	bus,
 		res;			/* Reserved for bus mode */
     uint8_t	wp;			/* Disk has been mounted READ-ONLY */
-    uint8_t	pad, pad0;
+    uint8_t	use_mmap;		/* Map the image into memory */
+    uint8_t	pad0;
 
     void	*priv;
 
@@ -116,6 +117,8 @@ extern int	hdd_image_load(int id);
 extern void	hdd_image_seek(uint8_t id, uint32_t sector);
 extern void	hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern int	hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern void	hdd_image_prefetch(uint8_t id, uint32_t sector, uint32_t count);
+extern int	hdd_image_prefetch_done(uint8_t id, uint32_t sector, uint32_t count);
 extern void	hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern int	hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern void	hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count);
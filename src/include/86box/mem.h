@@ -94,6 +94,8 @@
 #define MEM_GRANULARITY_PAGE	(MEM_GRANULARITY_MASK & ~0xfff)
 #endif
 
+#define MMU_CACHE_SIZE		1024	/* default soft TLB slots per direction */
+
 #define mem_set_mem_state_common(smm, base, size, state) mem_set_state(!!smm, 0, base, size, state)
 #define mem_set_mem_state(base, size, state) mem_set_state(0, 0, base, size, state)
 #define mem_set_mem_state_smm(base, size, state) mem_set_state(1, 0, base, size, state)
@@ -189,14 +191,13 @@ extern uint32_t		rammask;
 extern uint8_t		*rom;
 extern uint32_t		biosmask, biosaddr;
 
-extern int		readlookup[256],
-			readlookupp[256];
+extern int		*readlookup,
+			*readlookupp;
 extern uintptr_t *	readlookup2;
-extern int		readlnext;
-extern int		writelookup[256],
-			writelookupp[256];
+extern int		*writelookup,
+			*writelookupp;
 extern uintptr_t *	writelookup2;
-extern int		writelnext;
+extern int		cachesize;
 extern uint32_t		ram_mapped_addr[64];
 
 extern mem_mapping_t	ram_low_mapping,
@@ -219,7 +220,8 @@ extern uint32_t		get_phys_virt, get_phys_phys;
 extern int		shadowbios,
 			shadowbios_write;
 extern int		readlnum,
-			writelnum;
+			writelnum,
+			mmu_walks;
 
 extern int		memspeed[11];
 
@@ -297,6 +299,8 @@ extern void	mem_writeb_phys(uint32_t addr, uint8_t val);
 extern void	mem_writew_phys(uint32_t addr, uint16_t val);
 extern void	mem_writel_phys(uint32_t addr, uint32_t val);
 extern void	mem_write_phys(void *src, uint32_t addr, int tranfer_size);
+extern void	mem_read_phys_block(void *dest, uint32_t addr, uint32_t len, int transfer_size);
+extern void	mem_write_phys_block(const void *src, uint32_t addr, uint32_t len, int transfer_size);
 
 extern uint8_t	mem_read_ram(uint32_t addr, void *priv);
 extern uint16_t	mem_read_ramw(uint32_t addr, void *priv);
@@ -329,8 +333,13 @@ extern void	mem_flush_write_page(uint32_t addr, uint32_t virt);
 
 extern void	mem_reset_page_blocks(void);
 
+struct _savestate_;
+extern void	mem_save_state(struct _savestate_ *st);
+
 extern void     flushmmucache(void);
 extern void     flushmmucache_cr3(void);
+extern void     flushmmucache_cpl3(void);
+extern void     flushmmucache_noglobal(void);
 extern void	flushmmucache_nopc(void);
 extern void     mmu_invalidate(uint32_t addr);
 
@@ -73,10 +73,14 @@ typedef struct netpkt {
     void		*priv;
     uint8_t		data[65536];	/* Maximum length + 1 to round up to the nearest power of 2. */
     int			len;
-
-    struct netpkt	*prev, *next;
 } netpkt_t;
 
+typedef struct {
+    uint32_t		drops,		/* frames dropped because the queue was full */
+			depth,		/* frames currently queued */
+			max_depth;	/* highest number of frames queued at once */
+} netqueue_stats_t;
+
 typedef struct {
     const char		*internal_name;
     const device_t	*device;
@@ -143,6 +147,7 @@ extern int	network_get_wait(void);
 extern void	network_timer_stop(void);
 
 extern void	network_queue_put(int tx, void *priv, uint8_t *data, int len);
+extern void	network_queue_stats(int tx, netqueue_stats_t *stats);
 
 #ifdef __cplusplus
 }
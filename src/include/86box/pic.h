@@ -44,6 +44,9 @@ extern void	pic_init_pcjr(void);
 extern void	pic2_init(void);
 extern void	pic_reset(void);
 
+struct _savestate_;
+extern void	pic_save_state(struct _savestate_ *st);
+
 extern int	picint_is_level(int irq);
 extern void	picint_common(uint16_t num, int level, int set);
 extern void	picint(uint16_t num);
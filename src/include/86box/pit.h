@@ -33,6 +33,8 @@ typedef struct {
 
     void	(*load_func)(uint8_t new_m, int new_count);
     void	(*out_func)(int new_out, int old_out);
+
+    struct PIT	*dev;		/* owning PIT */
 } ctr_t;
 
 
@@ -40,6 +42,8 @@ typedef struct PIT {
     int		flags, clock;
     pc_timer_t	callback_timer;
 
+    uint64_t	edge_ts;	/* time of the next CLOCK edge not yet applied */
+
     ctr_t	counters[3];
 
     uint8_t	ctrl;
@@ -0,0 +1,62 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Definitions for the machine save state module.
+ *
+ *		A save state file is a fixed header followed by a list of
+ *		sections, each with its own name, version and length, so
+ *		a component can change its layout without breaking the
+ *		sections of the others.
+ */
+#ifndef EMU_SAVESTATE_H
+# define EMU_SAVESTATE_H
+
+
+#define SAVESTATE_MAGIC		"86BoxSST"
+#define SAVESTATE_VERSION	1
+
+#define SAVESTATE_NAME_LEN	32
+
+
+typedef struct _savestate_ {
+    FILE	*f;
+
+    int		loading,		/* non-zero when restoring */
+		error;			/* set on any failure, sticky */
+
+    /* Current section. */
+    char	name[SAVESTATE_NAME_LEN];
+    uint32_t	version;		/* version of the section being loaded */
+
+    uint8_t	*buf;
+    uint32_t	pos, len, size;
+} savestate_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Transfer a block of data in the direction given by st->loading. */
+extern void	savestate_data(savestate_t *st, void *data, uint32_t len);
+#define savestate_var(st, v)	savestate_data((st), &(v), sizeof(v))
+
+extern void	savestate_timer(savestate_t *st, pc_timer_t *timer);
+
+/* Report a section that can not be restored by this build. */
+extern void	savestate_fail(savestate_t *st, const char *reason);
+
+extern int	savestate_save(wchar_t *fn);
+extern int	savestate_load(wchar_t *fn);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif	/*EMU_SAVESTATE_H*/
@@ -24,6 +24,14 @@ extern int sound_gain;
 
 #define SOUNDBUFLEN	(48000/50)
 
+/* The poll timer fires once per this many samples, devices catch up to
+   the exact sample through sound_update_pos(). */
+#define SOUND_POLL_SAMPLES	48
+
+#define SOUND_OUTPUT_OPENAL	0
+#define SOUND_OUTPUT_WAV	1
+#define SOUND_OUTPUT_NULL	2
+
 #define CD_FREQ		44100
 #define CD_BUFLEN	(CD_FREQ / 10)
 
@@ -40,6 +48,8 @@ extern int	gated,
 		speakon;
 
 extern int	sound_pos_global;
+extern int	sound_output;
+extern char	sound_wav_path[512];
 extern int	sound_card_current;
 
 
@@ -59,6 +69,9 @@ extern void	sound_card_init(void);
 extern void	sound_set_cd_volume(unsigned int vol_l, unsigned int vol_r);
 
 extern void	sound_speed_changed(void);
+extern void	sound_update_pos(void);
+extern void	sound_output_close(void);
+extern void	sound_wav_close(void);
 
 extern void	sound_init(void);
 extern void	sound_reset(void);
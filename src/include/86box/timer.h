@@ -53,7 +53,8 @@ typedef struct pc_timer_t
     void	(*callback)(void *p);
     void	*p;
 
-    struct	pc_timer_t *prev, *next;
+    uint32_t	seq;			/* Enable order, used to break timestamp ties. */
+    int		heap_idx;		/* Position in the timer heap, -1 if not queued. */
 } pc_timer_t;
 
 /*Timestamp of nearest enabled timer. CPU emulation must call timer_process()
@@ -72,6 +73,9 @@ extern void	timer_process(void);
 extern void	timer_close(void);
 extern void	timer_init(void);
 
+/*Set the TSC, moving all enabled timers along with it*/
+extern void	timer_set_tsc(uint64_t new_tsc);
+
 /*Add new timer. If start_timer is set, timer will be enabled with a zero
   timestamp - this is useful for permanently enabled timers*/
 extern void	timer_add(pc_timer_t *timer, void (*callback)(void *p), void *p, int start_timer);
@@ -190,43 +194,26 @@ extern void	timer_on_auto(pc_timer_t *timer, double period);
 extern void	timer_remove_head(void);
 
 
-extern pc_timer_t *	timer_head;
+extern pc_timer_t **	timer_heap;
+extern int		timer_heap_count;
 extern int		timer_inited;
 
 
-static __inline void
-timer_remove_head_inline(void)
-{
-    pc_timer_t *timer;
-
-    if (timer_inited && timer_head) {
-	timer = timer_head;
-	timer_head = timer->next;
-	if (timer_head) {
-		timer_head->prev = NULL;
-		timer->next->prev = NULL;
-	}
-	timer->next = timer->prev = NULL;
-	timer->flags &= ~TIMER_ENABLED;
-    }
-}
-
-
 static __inline void
 timer_process_inline(void)
 {
     pc_timer_t *timer;
 
-    if (!timer_inited || !timer_head)
+    if (!timer_inited || !timer_heap_count)
 	return;
 
-    while(1) {
-	timer = timer_head;
+    while(timer_heap_count) {
+	timer = timer_heap[0];
 
 	if (!TIMER_LESS_THAN_VAL(timer, (uint32_t)tsc))
 		break;
 
-	timer_remove_head_inline();
+	timer_remove_head();
 
 	if (timer->flags & TIMER_SPLIT)
 		timer_advance_ex(timer, 0);	/* We're splitting a > 1 s period into multiple <= 1 s periods. */
@@ -234,7 +221,8 @@ timer_process_inline(void)
 		timer->callback(timer->p);
     }
 
-    timer_target = timer_head->ts.ts32.integer;
+    if (timer_heap_count)
+	timer_target = timer_heap[0]->ts.ts32.integer;
 }
 
 #endif /*_TIMER_H_*/
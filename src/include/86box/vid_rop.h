@@ -0,0 +1,52 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Definitions for the shared 2D raster operation engine.
+ *
+ *		A raster operation is given as the four-entry truth table
+ *		of its result, indexed by (source << 1) | destination, so
+ *		the source is 0xc and the destination is 0xa. This is the
+ *		low nibble of the Windows ROP3 code, and the same encoding
+ *		as the MGA BOP field. Fills use the fill colour as their
+ *		source, so solid PATCOPY brushes are ROP_SRCCOPY fills.
+ */
+#ifndef EMU_VID_ROP_H
+# define EMU_VID_ROP_H
+
+#define ROP_BLACKNESS	0x0		/* 0 */
+#define ROP_NOTSRCERASE	0x1		/* ~(S | D) */
+#define ROP_NOTSRCAND	0x2		/* ~S & D */
+#define ROP_NOTSRCCOPY	0x3		/* ~S */
+#define ROP_SRCERASE	0x4		/* S & ~D */
+#define ROP_DSTINVERT	0x5		/* ~D */
+#define ROP_SRCINVERT	0x6		/* S ^ D */
+#define ROP_NOTSRCNAND	0x7		/* ~(S & D) */
+#define ROP_SRCAND	0x8		/* S & D */
+#define ROP_NOTSRCXOR	0x9		/* ~(S ^ D) */
+#define ROP_NOP		0xa		/* D */
+#define ROP_MERGEPAINT	0xb		/* ~S | D */
+#define ROP_SRCCOPY	0xc		/* S */
+#define ROP_SRCORNOTDST	0xd		/* S | ~D */
+#define ROP_SRCPAINT	0xe		/* S | D */
+#define ROP_WHITENESS	0xf		/* 1 */
+
+
+/* IBM 8514/A style mix codes, as used by S3 and ATI. */
+extern const uint8_t	vid_rop_from_mix[16];
+
+extern void	vid_rop_init(void);
+
+extern void	vid_rop_fill(svga_t *svga, uint32_t vram_mask, uint32_t dst,
+			     int32_t dst_pitch, int width, int height, int bpp,
+			     uint32_t col, uint32_t wrt_mask, int rop);
+extern void	vid_rop_copy(svga_t *svga, uint32_t vram_mask, uint32_t dst,
+			     int32_t dst_pitch, uint32_t src, int32_t src_pitch,
+			     int width, int height, int bpp, int x_dir,
+			     uint32_t wrt_mask, int rop);
+
+#endif	/*EMU_VID_ROP_H*/
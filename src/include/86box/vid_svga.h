@@ -158,6 +158,9 @@ extern int	svga_init(const device_t *info, svga_t *svga, void *p, int memsize,
 extern void	svga_recalctimings(svga_t *svga);
 extern void	svga_close(svga_t *svga);
 
+struct _savestate_;
+extern void	svga_save_state(svga_t *svga, struct _savestate_ *st);
+
 uint8_t		svga_read(uint32_t addr, void *p);
 uint16_t	svga_readw(uint32_t addr, void *p);
 uint32_t	svga_readl(uint32_t addr, void *p);
@@ -27,6 +27,8 @@ extern int scrollcache;
 
 extern uint8_t edatlookup[4][4];
 
+void svga_render_init(void);
+
 void svga_render_null(svga_t *svga);
 void svga_render_blank(svga_t *svga);
 void svga_render_overscan_left(svga_t *svga);
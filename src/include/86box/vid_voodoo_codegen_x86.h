@@ -21,15 +21,19 @@
 #include <xmmintrin.h>
 #endif
 
-#define BLOCK_NUM 8
-#define BLOCK_MASK (BLOCK_NUM-1)
+/*Limits of the number of compiled pipelines kept per render thread. The
+  number is set through the "recompiler_cache" option and rounded up to a
+  power of 2*/
+#define BLOCK_NUM_MIN 8
+#define BLOCK_NUM_MAX 256
 #define BLOCK_SIZE 8192
 
 #define LOD_MASK (LOD_TMIRROR_S | LOD_TMIRROR_T)
 
-typedef struct voodoo_x86_data_t
+/*Register state a compiled pipeline depends on. All members are 32 bits wide,
+  so there is no padding and keys can be hashed and compared as plain words*/
+typedef struct voodoo_x86_key_t
 {
-        uint8_t code_block[BLOCK_SIZE];
         int xdir;
         uint32_t alphaMode;
         uint32_t fbzMode;
@@ -39,10 +43,29 @@ typedef struct voodoo_x86_data_t
         uint32_t tLOD[2];
         uint32_t trexInit1;
 	int is_tiled;
+} voodoo_x86_key_t;
+
+typedef struct voodoo_x86_data_t
+{
+        uint8_t code_block[BLOCK_SIZE];
+        voodoo_x86_key_t key;
+        uint32_t hash;
+        int next;       /*Next block in the same hash chain, -1 if none*/
+        int valid;
+        int referenced; /*Used since the CLOCK hand last passed*/
 } voodoo_x86_data_t;
 
-static int last_block[4] = {0, 0};
-static int next_block_to_write[4] = {0, 0};
+/*Per render thread lookup state*/
+typedef struct voodoo_x86_cache_t
+{
+        voodoo_x86_data_t *data;        /*This thread's blocks*/
+        int *hash_table;                /*Twice as many chains as blocks*/
+        int block_mask, hash_mask;
+        int last_block;
+        int clock_hand;
+
+        uint64_t hits, misses, evictions;
+} voodoo_x86_cache_t;
 
 #define addbyte(val)                                            \
         do {                                                    \
@@ -3316,61 +3339,109 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
 }
 int voodoo_recomp = 0;
 
-static inline void *voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even)
+static inline uint32_t voodoo_block_hash(voodoo_x86_key_t *key)
 {
+        uint32_t *p = (uint32_t *)key;
+        uint32_t hash = 0x811c9dc5;
         int c;
-        int b = last_block[odd_even];
+
+        for (c = 0; c < sizeof(voodoo_x86_key_t) / 4; c++)
+                hash = (hash ^ p[c]) * 0x01000193;
+
+        return hash ^ (hash >> 16);
+}
+
+static inline void voodoo_block_unlink(voodoo_x86_cache_t *cache, int b)
+{
+        voodoo_x86_data_t *data = &cache->data[b];
+        int *prev = &cache->hash_table[data->hash & cache->hash_mask];
+
+        while (*prev != b)
+                prev = &cache->data[*prev].next;
+        *prev = data->next;
+}
+
+static inline void *voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even)
+{
+        voodoo_x86_cache_t *cache = &((voodoo_x86_cache_t *)voodoo->codegen_cache)[odd_even];
         voodoo_x86_data_t *data;
-        voodoo_x86_data_t *codegen_data = voodoo->codegen_data;
-        
-        for (c = 0; c < 8; c++)
+        voodoo_x86_key_t key;
+        uint32_t hash;
+        int b;
+
+        key.xdir = state->xdir;
+        key.alphaMode = params->alphaMode;
+        key.fbzMode = params->fbzMode;
+        key.fogMode = params->fogMode;
+        key.fbzColorPath = params->fbzColorPath;
+        key.textureMode[0] = params->textureMode[0];
+        key.textureMode[1] = params->textureMode[1];
+        key.tLOD[0] = params->tLOD[0] & LOD_MASK;
+        key.tLOD[1] = params->tLOD[1] & LOD_MASK;
+        key.trexInit1 = voodoo->trexInit1[0] & (1 << 18);
+	key.is_tiled = (params->col_tiled || params->aux_tiled) ? 1 : 0;
+        hash = voodoo_block_hash(&key);
+
+        /*Consecutive triangles usually share the same state*/
+        data = &cache->data[cache->last_block];
+        if (data->valid && data->hash == hash && !memcmp(&data->key, &key, sizeof(voodoo_x86_key_t)))
         {
-                data = &codegen_data[odd_even + b*4];
-                
-                if (state->xdir == data->xdir &&
-                    params->alphaMode == data->alphaMode &&
-                    params->fbzMode == data->fbzMode &&
-                    params->fogMode == data->fogMode &&
-                    params->fbzColorPath == data->fbzColorPath &&
-                    (voodoo->trexInit1[0] & (1 << 18)) == data->trexInit1 &&
-                    params->textureMode[0] == data->textureMode[0] &&
-                    params->textureMode[1] == data->textureMode[1] &&
-                    (params->tLOD[0] & LOD_MASK) == data->tLOD[0] &&
-                    (params->tLOD[1] & LOD_MASK) == data->tLOD[1] &&
-                    ((params->col_tiled || params->aux_tiled) ? 1 : 0) == data->is_tiled)
+                data->referenced = 1;
+                cache->hits++;
+                return data->code_block;
+        }
+
+        for (b = cache->hash_table[hash & cache->hash_mask]; b != -1; b = data->next)
+        {
+                data = &cache->data[b];
+
+                if (data->hash == hash && !memcmp(&data->key, &key, sizeof(voodoo_x86_key_t)))
                 {
-                        last_block[odd_even] = b;
+                        data->referenced = 1;
+                        cache->last_block = b;
+                        cache->hits++;
                         return data->code_block;
                 }
-                
-                b = (b + 1) & 7;
         }
-voodoo_recomp++;
-        data = &codegen_data[odd_even + next_block_to_write[odd_even]*4];
-//        code_block = data->code_block;
-        
+
+        /*Not cached - pick a victim with the CLOCK algorithm, giving blocks
+          used since the hand last passed a second chance*/
+        while (1)
+        {
+                b = cache->clock_hand;
+                cache->clock_hand = (b + 1) & cache->block_mask;
+                data = &cache->data[b];
+
+                if (!data->valid || !data->referenced)
+                        break;
+                data->referenced = 0;
+        }
+
+        if (data->valid)
+        {
+                voodoo_block_unlink(cache, b);
+                cache->evictions++;
+        }
+        cache->misses++;
+        voodoo_recomp++;
+
         voodoo_generate(data->code_block, voodoo, params, state, depth_op);
 
-        data->xdir = state->xdir;
-        data->alphaMode = params->alphaMode;
-        data->fbzMode = params->fbzMode;
-        data->fogMode = params->fogMode;
-        data->fbzColorPath = params->fbzColorPath;
-        data->trexInit1 = voodoo->trexInit1[0] & (1 << 18);
-        data->textureMode[0] = params->textureMode[0];
-        data->textureMode[1] = params->textureMode[1];
-        data->tLOD[0] = params->tLOD[0] & LOD_MASK;
-        data->tLOD[1] = params->tLOD[1] & LOD_MASK;
-	data->is_tiled = (params->col_tiled || params->aux_tiled) ? 1 : 0;
-
-        next_block_to_write[odd_even] = (next_block_to_write[odd_even] + 1) & 7;
-        
+        data->key = key;
+        data->hash = hash;
+        data->valid = 1;
+        data->referenced = 1;
+        data->next = cache->hash_table[hash & cache->hash_mask];
+        cache->hash_table[hash & cache->hash_mask] = b;
+        cache->last_block = b;
+
         return data->code_block;
 }
 
 void voodoo_codegen_init(voodoo_t *voodoo)
 {
         int c;
+        int blocks = BLOCK_NUM_MIN;
 #if defined(__linux__) || defined(__APPLE__)
 	void *start;
 	size_t len;
@@ -3378,12 +3449,33 @@ void voodoo_codegen_init(voodoo_t *voodoo)
 	long pagemask = ~(pagesize - 1);
 #endif
 
+        while ((blocks < voodoo->codegen_blocks) && (blocks < BLOCK_NUM_MAX))
+                blocks <<= 1;
+        voodoo->codegen_blocks = blocks;
+
 #if defined WIN32 || defined _WIN32 || defined _WIN32
-        voodoo->codegen_data = VirtualAlloc(NULL, sizeof(voodoo_x86_data_t) * BLOCK_NUM*4, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+        voodoo->codegen_data = VirtualAlloc(NULL, sizeof(voodoo_x86_data_t) * voodoo->codegen_blocks * voodoo->render_threads, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
 #else
-        voodoo->codegen_data = mmap(0, sizeof(voodoo_x86_data_t) * BLOCK_NUM*4, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_ANON|MAP_PRIVATE, 0, 0);
+        voodoo->codegen_data = mmap(0, sizeof(voodoo_x86_data_t) * voodoo->codegen_blocks * voodoo->render_threads, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_ANON|MAP_PRIVATE, 0, 0);
 #endif
 
+        voodoo->codegen_cache = malloc(sizeof(voodoo_x86_cache_t) * voodoo->render_threads);
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                voodoo_x86_cache_t *cache = &((voodoo_x86_cache_t *)voodoo->codegen_cache)[c];
+                int d;
+
+                cache->data = &((voodoo_x86_data_t *)voodoo->codegen_data)[c * blocks];
+                cache->hash_table = malloc(sizeof(int) * blocks * 2);
+                cache->block_mask = blocks - 1;
+                cache->hash_mask = (blocks * 2) - 1;
+                for (d = 0; d < blocks * 2; d++)
+                        cache->hash_table[d] = -1;
+                cache->last_block = 0;
+                cache->clock_hand = 0;
+                cache->hits = cache->misses = cache->evictions = 0;
+        }
+
         for (c = 0; c < 256; c++)
         {
                 int d[4];
@@ -3408,9 +3500,22 @@ void voodoo_codegen_init(voodoo_t *voodoo)
 
 void voodoo_codegen_close(voodoo_t *voodoo)
 {
+        int c;
+
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                voodoo_x86_cache_t *cache = &((voodoo_x86_cache_t *)voodoo->codegen_cache)[c];
+
+                if (cache->hits || cache->misses)
+                        voodoo_render_log("Voodoo recompiler thread %i: %llu hits, %llu misses (recompiles), %llu evictions\n",
+                                          c, cache->hits, cache->misses, cache->evictions);
+                free(cache->hash_table);
+        }
+        free(voodoo->codegen_cache);
+
 #if defined WIN32 || defined _WIN32 || defined _WIN32
         VirtualFree(voodoo->codegen_data, 0, MEM_RELEASE);
 #else
-        munmap(voodoo->codegen_data, sizeof(voodoo_x86_data_t) * BLOCK_NUM*4);
+        munmap(voodoo->codegen_data, sizeof(voodoo_x86_data_t) * voodoo->codegen_blocks * voodoo->render_threads);
 #endif
 }
@@ -26,9 +26,23 @@
 
 #define LOD_MAX 8
 
+#define VOODOO_MAX_RENDER_THREADS 32
+
+/*Screen lines are split into bands of (1 << VOODOO_TILE_SHIFT) lines, dealt
+  out to the render threads in turn*/
+#define VOODOO_TILE_SHIFT 3
+
 #define TEX_DIRTY_SHIFT 10
+#define TEX_DIRTY_PAGES 16384
+
+/*Upper limit of decoded textures per TMU, the number actually used is
+  set by the texture cache size option*/
+#define TEX_CACHE_MAX 256
+#define TEX_CACHE_WORDS (TEX_CACHE_MAX / 32)
+#define TEX_CACHE_ENTRY_SIZE ((256*256 + 256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2) * 4)
 
-#define TEX_CACHE_MAX 64
+#define TEX_HASH_BITS 9
+#define TEX_HASH_SIZE (1 << TEX_HASH_BITS)
 
 enum
 {
@@ -178,11 +192,13 @@ typedef struct texture_t
 {
         uint32_t base;
         uint32_t tLOD;
-        volatile int refcount, refcount_r[4];
+        volatile int refcount, refcount_r[VOODOO_MAX_RENDER_THREADS];
         int is16;
         uint32_t palette_checksum;
         uint32_t addr_start[4], addr_end[4];
         uint32_t *data;
+        int hash, hash_next;
+        int referenced;
 } texture_t;
 
 typedef struct vert_t
@@ -200,6 +216,12 @@ typedef struct clip_t
         int y_min, y_max;
 } clip_t;
 
+typedef struct voodoo_render_thread_data_t
+{
+        struct voodoo_t *voodoo;
+        int thread;
+} voodoo_render_thread_data_t;
+
 typedef struct voodoo_t
 {
         mem_mapping_t mapping;
@@ -273,21 +295,21 @@ typedef struct voodoo_t
         int ncc_dirty[2];
 
         thread_t *fifo_thread;
-        thread_t *render_thread[4];
+        thread_t *render_thread[VOODOO_MAX_RENDER_THREADS];
+        voodoo_render_thread_data_t render_thread_data[VOODOO_MAX_RENDER_THREADS];
         event_t *wake_fifo_thread;
         event_t *wake_main_thread;
         event_t *fifo_not_full_event;
-        event_t *render_not_full_event[4];
-        event_t *wake_render_thread[4];
+        event_t *render_not_full_event[VOODOO_MAX_RENDER_THREADS];
+        event_t *wake_render_thread[VOODOO_MAX_RENDER_THREADS];
 
         int voodoo_busy;
-        int render_voodoo_busy[4];
+        int render_voodoo_busy[VOODOO_MAX_RENDER_THREADS];
 
         int render_threads;
-        int odd_even_mask;
 
-        int pixel_count[4], texel_count[4], tri_count, frame_count;
-        int pixel_count_old[4], texel_count_old[4];
+        int pixel_count[VOODOO_MAX_RENDER_THREADS], texel_count[VOODOO_MAX_RENDER_THREADS], tri_count, frame_count;
+        int pixel_count_old[VOODOO_MAX_RENDER_THREADS], texel_count_old[VOODOO_MAX_RENDER_THREADS];
         int wr_count, rd_count, tex_count;
 
         int retrace_count;
@@ -311,7 +333,7 @@ typedef struct voodoo_t
         volatile int cmd_read, cmd_written, cmd_written_fifo;
 
         voodoo_params_t params_buffer[PARAM_SIZE];
-        volatile int params_read_idx[4], params_write_idx;
+        volatile int params_read_idx[VOODOO_MAX_RENDER_THREADS], params_write_idx;
 
         uint32_t cmdfifo_base, cmdfifo_end, cmdfifo_size;
         int cmdfifo_rp, cmdfifo_ret_addr;
@@ -480,21 +502,26 @@ typedef struct voodoo_t
         uint16_t purpleline[256][3];
 
         texture_t texture_cache[2][TEX_CACHE_MAX];
-        uint8_t texture_present[2][16384];
-        int texture_last_removed;
+        int texture_hash[2][TEX_HASH_SIZE];
+        uint32_t *texture_pages[2]; /*Bitmap of cache entries using each dirty page*/
+        uint8_t texture_present[2][TEX_DIRTY_PAGES];
+        int texture_last_removed[2];
+        int texture_cache_entries, texture_cache_used[2];
 
         uint32_t palette_checksum[2];
         int palette_dirty[2];
 
         uint64_t time;
-        int render_time[4];
+        int render_time[VOODOO_MAX_RENDER_THREADS];
 
         int force_blit_count;
         int can_blit;
         mutex_t* force_blit_mutex;
 
         int use_recompiler;
+        int codegen_blocks;     /*Compiled pipelines kept per render thread*/
         void *codegen_data;
+        void *codegen_cache;
 
         struct voodoo_set_t *set;
         
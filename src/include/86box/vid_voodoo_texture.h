@@ -34,3 +34,5 @@ void voodoo_recalc_tex(voodoo_t *voodoo, int tmu);
 void voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu);
 void voodoo_tex_writel(uint32_t addr, uint32_t val, void *p);
 void flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu);
+void voodoo_texture_cache_init(voodoo_t *voodoo, int size);
+void voodoo_texture_cache_close(voodoo_t *voodoo);
@@ -80,11 +80,18 @@ typedef struct {
 typedef rgb_t PALETTE[256];
 
 
+#define VIDEO_CAPTURE_PNG	0
+#define VIDEO_CAPTURE_PPM	1		/* raw, uncompressed */
+
+
 extern int	egareads,
 		egawrites;
 extern int	changeframecount;
 
 extern volatile int screenshots;
+extern int	video_capture_format,
+		video_capture_level,
+		video_capture_interval;
 extern bitmap_t	*buffer32, *render_buffer;
 extern PALETTE	cgapal,
 		cgapal_mono[6];
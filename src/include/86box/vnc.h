@@ -22,6 +22,9 @@
 extern "C" {
 #endif
 
+extern uint32_t	vnc_bytes_per_sec,
+		vnc_pixels_per_sec;
+
 extern int	vnc_init(void *);
 extern void	vnc_close(void);
 extern void	vnc_resize(int x, int y);
@@ -52,6 +52,20 @@ int initialized = 0;
 io_t *io[NPORTS], *io_last[NPORTS];
 
 
+/* Flattened view of the handler lists, rebuilt whenever they change:
+   io_single[] has the handler of every port that has exactly one, and
+   io_fast[] tells which word and dword accesses that handler can serve
+   on its own, because none of the following ports would add anything
+   to the result. */
+#define IO_FAST_INW	0x01
+#define IO_FAST_INL	0x02
+#define IO_FAST_OUTW	0x04
+#define IO_FAST_OUTL	0x08
+
+static io_t	*io_single[NPORTS];
+static uint8_t	io_fast[NPORTS];
+
+
 #ifdef ENABLE_IO_LOG
 int io_do_log = ENABLE_IO_LOG;
 
@@ -72,6 +86,77 @@ io_log(const char *fmt, ...)
 #endif
 
 
+/* Returns non-zero if no handler of the port takes part in a wider read
+   starting offset bytes below it. */
+static int
+io_in_quiet(uint16_t port, int width, int offset)
+{
+    io_t *p;
+
+    for (p = io[port]; p; p = p->next) {
+	if ((width == 4) && (offset == 2) && p->inw && !p->inl)
+		return 0;
+	if (p->inb && !p->inw && ((width == 2) || !p->inl))
+		return 0;
+    }
+
+    return 1;
+}
+
+
+static int
+io_out_quiet(uint16_t port, int width, int offset)
+{
+    io_t *p;
+
+    for (p = io[port]; p; p = p->next) {
+	if ((width == 4) && (offset == 2) && p->outw && !p->outl)
+		return 0;
+	if (p->outb && !p->outw && ((width == 2) || !p->outl))
+		return 0;
+    }
+
+    return 1;
+}
+
+
+static void
+io_update(uint16_t port)
+{
+    io_t *p = io[port];
+    uint8_t fast = 0;
+
+    if (p && !p->next) {
+	io_single[port] = p;
+
+	if (p->inw && io_in_quiet(port + 1, 2, 1))
+		fast |= IO_FAST_INW;
+	if (p->inl && io_in_quiet(port + 1, 4, 1) && io_in_quiet(port + 2, 4, 2) &&
+	    io_in_quiet(port + 3, 4, 3))
+		fast |= IO_FAST_INL;
+	if (p->outw && io_out_quiet(port + 1, 2, 1))
+		fast |= IO_FAST_OUTW;
+	if (p->outl && io_out_quiet(port + 1, 4, 1) && io_out_quiet(port + 2, 4, 2) &&
+	    io_out_quiet(port + 3, 4, 3))
+		fast |= IO_FAST_OUTL;
+    } else
+	io_single[port] = NULL;
+
+    io_fast[port] = fast;
+}
+
+
+/* A change to a port also affects wider accesses to the three ports below it. */
+static void
+io_update_range(uint16_t base, int size)
+{
+    int c;
+
+    for (c = -3; c < size; c++)
+	io_update((base + c) & 0xffff);
+}
+
+
 void
 io_init(void)
 {
@@ -100,6 +185,9 @@ io_init(void)
 	/* io[c] should be NULL. */
 	io[c] = io_last[c] = NULL;
     }
+
+    memset(io_single, 0x00, sizeof(io_single));
+    memset(io_fast, 0x00, sizeof(io_fast));
 }
 
 
@@ -141,6 +229,8 @@ io_sethandler(uint16_t base, int size,
 
 	io_last[base + c] = q;
     }
+
+    io_update_range(base, size);
 }
 
 
@@ -182,6 +272,8 @@ io_removehandler(uint16_t base, int size,
 		p = q;
 	}
     }
+
+    io_update_range(base, size);
 }
 
 
@@ -239,6 +331,8 @@ io_sethandler_interleaved(uint16_t base, int size,
 
 	q->priv = priv;
     }
+
+    io_update_range(base, size);
 }
 
 
@@ -276,6 +370,8 @@ io_removehandler_interleaved(uint16_t base, int size,
 		p = q;
 	}
     }
+
+    io_update_range(base, size);
 }
 #endif
 
@@ -288,15 +384,24 @@ inb(uint16_t port)
     int found = 0;
     int qfound = 0;
 
-    p = io[port];
-    while(p) {
-	q = p->next;
+    p = io_single[port];
+    if (p) {
 	if (p->inb) {
-		ret &= p->inb(port, p->priv);
-		found |= 1;
-		qfound++;
+		ret = p->inb(port, p->priv);
+		found = 1;
+		qfound = 1;
+	}
+    } else {
+	p = io[port];
+	while(p) {
+		q = p->next;
+		if (p->inb) {
+			ret &= p->inb(port, p->priv);
+			found |= 1;
+			qfound++;
+		}
+		p = q;
 	}
-	p = q;
     }
 
     if (port & 0x80)
@@ -322,15 +427,24 @@ outb(uint16_t port, uint8_t val)
     int found = 0;
     int qfound = 0;
 
-    p = io[port];
-    while(p) {
-	q = p->next;
+    p = io_single[port];
+    if (p) {
 	if (p->outb) {
 		p->outb(port, val, p->priv);
-		found |= 1;
-		qfound++;
+		found = 1;
+		qfound = 1;
+	}
+    } else {
+	p = io[port];
+	while(p) {
+		q = p->next;
+		if (p->outb) {
+			p->outb(port, val, p->priv);
+			found |= 1;
+			qfound++;
+		}
+		p = q;
 	}
-	p = q;
     }
 	
     if (!found) {
@@ -357,32 +471,39 @@ inw(uint16_t port)
     uint8_t ret8[2];
     int i = 0;
 
-    p = io[port];
-    while(p) {
-	q = p->next;
-	if (p->inw) {
-		ret &= p->inw(port, p->priv);
-		found |= 2;
-		qfound++;
-	}
-	p = q;
-    }
-
-    ret8[0] = ret & 0xff;
-    ret8[1] = (ret >> 8) & 0xff;
-    for (i = 0; i < 2; i++) {
-	p = io[(port + i) & 0xffff];
+    if (io_fast[port] & IO_FAST_INW) {
+	p = io_single[port];
+	ret = p->inw(port, p->priv);
+	found = 2;
+	qfound = 1;
+    } else {
+	p = io[port];
 	while(p) {
 		q = p->next;
-		if (p->inb && !p->inw) {
-			ret8[i] &= p->inb(port + i, p->priv);
-			found |= 1;
+		if (p->inw) {
+			ret &= p->inw(port, p->priv);
+			found |= 2;
 			qfound++;
 		}
 		p = q;
 	}
+
+	ret8[0] = ret & 0xff;
+	ret8[1] = (ret >> 8) & 0xff;
+	for (i = 0; i < 2; i++) {
+		p = io[(port + i) & 0xffff];
+		while(p) {
+			q = p->next;
+			if (p->inb && !p->inw) {
+				ret8[i] &= p->inb(port + i, p->priv);
+				found |= 1;
+				qfound++;
+			}
+			p = q;
+		}
+	}
+	ret = (ret8[1] << 8) | ret8[0];
     }
-    ret = (ret8[1] << 8) | ret8[0];
 
     if (port & 0x80)
 	amstrad_latch = AMSTRAD_NOLATCH;
@@ -408,28 +529,35 @@ outw(uint16_t port, uint16_t val)
     int qfound = 0;
     int i = 0;
 
-    p = io[port];
-    while(p) {
-	q = p->next;
-	if (p->outw) {
-		p->outw(port, val, p->priv);
-		found |= 2;
-		qfound++;
-	}
-	p = q;
-    }
-
-    for (i = 0; i < 2; i++) {
-	p = io[(port + i) & 0xffff];
+    if (io_fast[port] & IO_FAST_OUTW) {
+	p = io_single[port];
+	p->outw(port, val, p->priv);
+	found = 2;
+	qfound = 1;
+    } else {
+	p = io[port];
 	while(p) {
 		q = p->next;
-		if (p->outb && !p->outw) {
-			p->outb(port + i, val >> (i << 3), p->priv);
-			found |= 1;
+		if (p->outw) {
+			p->outw(port, val, p->priv);
+			found |= 2;
 			qfound++;
 		}
 		p = q;
 	}
+
+	for (i = 0; i < 2; i++) {
+		p = io[(port + i) & 0xffff];
+		while(p) {
+			q = p->next;
+			if (p->outb && !p->outw) {
+				p->outb(port + i, val >> (i << 3), p->priv);
+				found |= 1;
+				qfound++;
+			}
+			p = q;
+		}
+	}
     }
 
     if (!found) {
@@ -457,50 +585,57 @@ inl(uint16_t port)
     int qfound = 0;
     int i = 0;
 
-    p = io[port];
-    while(p) {
-	q = p->next;
-	if (p->inl) {
-		ret &= p->inl(port, p->priv);
-		found |= 4;
-		qfound++;
-	}
-	p = q;
-    }
-
-    ret16[0] = ret & 0xffff;
-    ret16[1] = (ret >> 16) & 0xffff;
-    for (i = 0; i < 4; i += 2) {
-	p = io[(port + i) & 0xffff];
+    if (io_fast[port] & IO_FAST_INL) {
+	p = io_single[port];
+	ret = p->inl(port, p->priv);
+	found = 4;
+	qfound = 1;
+    } else {
+	p = io[port];
 	while(p) {
 		q = p->next;
-		if (p->inw && !p->inl) {
-			ret16[i >> 1] &= p->inw(port + i, p->priv);
-			found |= 2;
+		if (p->inl) {
+			ret &= p->inl(port, p->priv);
+			found |= 4;
 			qfound++;
 		}
 		p = q;
 	}
-    }
-    ret = (ret16[1] << 16) | ret16[0];
-
-    ret8[0] = ret & 0xff;
-    ret8[1] = (ret >> 8) & 0xff;
-    ret8[2] = (ret >> 16) & 0xff;
-    ret8[3] = (ret >> 24) & 0xff;
-    for (i = 0; i < 4; i++) {
-	p = io[(port + i) & 0xffff];
-	while(p) {
-		q = p->next;
-		if (p->inb && !p->inw && !p->inl) {
-			ret8[i] &= p->inb(port + i, p->priv);
-			found |= 1;
-			qfound++;
+
+	ret16[0] = ret & 0xffff;
+	ret16[1] = (ret >> 16) & 0xffff;
+	for (i = 0; i < 4; i += 2) {
+		p = io[(port + i) & 0xffff];
+		while(p) {
+			q = p->next;
+			if (p->inw && !p->inl) {
+				ret16[i >> 1] &= p->inw(port + i, p->priv);
+				found |= 2;
+				qfound++;
+			}
+			p = q;
+		}
+	}
+	ret = (ret16[1] << 16) | ret16[0];
+
+	ret8[0] = ret & 0xff;
+	ret8[1] = (ret >> 8) & 0xff;
+	ret8[2] = (ret >> 16) & 0xff;
+	ret8[3] = (ret >> 24) & 0xff;
+	for (i = 0; i < 4; i++) {
+		p = io[(port + i) & 0xffff];
+		while(p) {
+			q = p->next;
+			if (p->inb && !p->inw && !p->inl) {
+				ret8[i] &= p->inb(port + i, p->priv);
+				found |= 1;
+				qfound++;
+			}
+			p = q;
 		}
-		p = q;
 	}
+	ret = (ret8[3] << 24) | (ret8[2] << 16) | (ret8[1] << 8) | ret8[0];
     }
-    ret = (ret8[3] << 24) | (ret8[2] << 16) | (ret8[1] << 8) | ret8[0];
 
     if (port & 0x80)
 	amstrad_latch = AMSTRAD_NOLATCH;
@@ -526,42 +661,49 @@ outl(uint16_t port, uint32_t val)
     int qfound = 0;
     int i = 0;
 
-    p = io[port];
-    if (p) {
-	while(p) {
-		q = p->next;
-		if (p->outl) {
-			p->outl(port, val, p->priv);
-			found |= 4;
-			qfound++;
+    if (io_fast[port] & IO_FAST_OUTL) {
+	p = io_single[port];
+	p->outl(port, val, p->priv);
+	found = 4;
+	qfound = 1;
+    } else {
+	p = io[port];
+	if (p) {
+		while(p) {
+			q = p->next;
+			if (p->outl) {
+				p->outl(port, val, p->priv);
+				found |= 4;
+				qfound++;
+			}
+			p = q;
 		}
-		p = q;
 	}
-    }
 
-    for (i = 0; i < 4; i += 2) {
-	p = io[(port + i) & 0xffff];
-	while(p) {
-		q = p->next;
-		if (p->outw && !p->outl) {
-			p->outw(port + i, val >> (i << 3), p->priv);
-			found |= 2;
-			qfound++;
+	for (i = 0; i < 4; i += 2) {
+		p = io[(port + i) & 0xffff];
+		while(p) {
+			q = p->next;
+			if (p->outw && !p->outl) {
+				p->outw(port + i, val >> (i << 3), p->priv);
+				found |= 2;
+				qfound++;
+			}
+			p = q;
 		}
-		p = q;
 	}
-    }
 
-    for (i = 0; i < 4; i++) {
-	p = io[(port + i) & 0xffff];
-	while(p) {
-		q = p->next;
-		if (p->outb && !p->outw && !p->outl) {
-			p->outb(port + i, val >> (i << 3), p->priv);
-			found |= 1;
-			qfound++;
+	for (i = 0; i < 4; i++) {
+		p = io[(port + i) & 0xffff];
+		while(p) {
+			q = p->next;
+			if (p->outb && !p->outw && !p->outl) {
+				p->outb(port + i, val >> (i << 3), p->priv);
+				found |= 1;
+				qfound++;
+			}
+			p = q;
 		}
-		p = q;
 	}
     }
 
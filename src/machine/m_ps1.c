@@ -189,6 +189,8 @@ snd_write(uint16_t port, uint8_t val, void *priv)
 static void
 snd_update(ps1snd_t *snd)
 {
+    sound_update_pos();
+
     for (; snd->pos < sound_pos_global; snd->pos++)        
 	snd->buffer[snd->pos] = (int8_t)(snd->dac_val ^ 0x80) * 0x20;
 }
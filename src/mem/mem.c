@@ -35,6 +35,8 @@
 #include <86box/io.h>
 #include <86box/mem.h>
 #include <86box/rom.h>
+#include <86box/timer.h>
+#include <86box/savestate.h>
 #ifdef USE_DYNAREC
 # include "codegen_public.h"
 #else
@@ -79,13 +81,11 @@ uint32_t		biosmask, biosaddr;
 uint32_t		pccache;
 uint8_t			*pccache2;
 
-int			readlnext;
-int			readlookup[256],
-			readlookupp[256];
+int			*readlookup,		/* slots of the soft TLB */
+			*readlookupp;
 uintptr_t		*readlookup2;
-int			writelnext;
-int			writelookup[256],
-			writelookupp[256];
+int			*writelookup,
+			*writelookupp;
 uintptr_t		*writelookup2;
 
 uint32_t		mem_logical_addr;
@@ -94,7 +94,7 @@ int			shadowbios = 0,
 			shadowbios_write;
 int			readlnum = 0,
 			writelnum = 0;
-int			cachesize = 256;
+int			cachesize = MMU_CACHE_SIZE;
 
 uint32_t		get_phys_virt,
 			get_phys_phys;
@@ -103,7 +103,8 @@ int			mem_a20_key = 0,
 			mem_a20_alt = 0,
 			mem_a20_state = 0;
 
-int			mmuflush = 0;
+int			mmuflush = 0,
+			mmu_walks = 0;
 int			mmu_perm = 4;
 
 uint64_t		*byte_dirty_mask;
@@ -154,26 +155,167 @@ mem_addr_is_ram(uint32_t addr)
 }
 
 
-void
-resetreadlookup(void)
+/* The soft TLB is kept as cachesize slots per direction, grouped
+   into sets of MMU_CACHE_WAYS indexed by the low bits of the virtual
+   page. The slots only remember which entries of the direct lookup
+   tables are in use, so that they can be invalidated again. */
+#define MMU_CACHE_WAYS	4
+
+#define MMU_PERM_WRITE	0x0002		/* writable from CPL 3 */
+#define MMU_PERM_USER	0x0004		/* readable from CPL 3 */
+#define MMU_PERM_LARGE	0x0080		/* part of a 4 MB or 2 MB page */
+#define MMU_PERM_GLOBAL	0x0100		/* global page, kept on CR3 loads */
+#define MMU_PERM_CHANCE	0x0200		/* global page not yet passed over */
+
+
+static int		mmu_cache_slots = 0,
+			mmu_cache_sets = 0;
+static uint8_t		*readlhand,
+			*writelhand;
+static uint32_t		mmu_perm_page = 0xffffffff;
+
+
+static void
+mmu_cache_alloc(void)
+{
+    int c;
+
+    /* Keep the size a power of two and at least one full set. */
+    for (c = MMU_CACHE_WAYS; (c << 1) <= cachesize; c <<= 1)
+	;
+    if (c > 65536)
+	c = 65536;
+    cachesize = c;
+
+    if (mmu_cache_slots == cachesize)
+	return;
+
+    if (readlookup != NULL) {
+	free(readlookup);
+	free(readlookupp);
+	free(writelookup);
+	free(writelookupp);
+	free(readlhand);
+	free(writelhand);
+    }
+
+    mmu_cache_slots = cachesize;
+    mmu_cache_sets = cachesize / MMU_CACHE_WAYS;
+
+    readlookup = (int *) malloc(mmu_cache_slots * sizeof(int));
+    readlookupp = (int *) malloc(mmu_cache_slots * sizeof(int));
+    writelookup = (int *) malloc(mmu_cache_slots * sizeof(int));
+    writelookupp = (int *) malloc(mmu_cache_slots * sizeof(int));
+    readlhand = (uint8_t *) malloc(mmu_cache_sets);
+    writelhand = (uint8_t *) malloc(mmu_cache_sets);
+
+    memset(readlookup, 0xff, mmu_cache_slots * sizeof(int));
+    memset(writelookup, 0xff, mmu_cache_slots * sizeof(int));
+    memset(readlookupp, 0x00, mmu_cache_slots * sizeof(int));
+    memset(writelookupp, 0x00, mmu_cache_slots * sizeof(int));
+    memset(readlhand, 0x00, mmu_cache_sets);
+    memset(writelhand, 0x00, mmu_cache_sets);
+}
+
+
+static __inline void
+mmu_cache_drop_read(int c)
+{
+    readlookup2[readlookup[c]] = LOOKUP_INV;
+    readlookup[c] = 0xffffffff;
+}
+
+
+static __inline void
+mmu_cache_drop_write(int c)
+{
+    page_lookup[writelookup[c]] = NULL;
+    writelookup2[writelookup[c]] = LOOKUP_INV;
+    writelookup[c] = 0xffffffff;
+}
+
+
+/* Drop the cached translations, except for those whose permissions
+   include all of the bits in rkeep (reads) or wkeep (writes). */
+static void
+mmu_cache_flush(int rkeep, int wkeep)
 {
     int c;
 
+    for (c = 0; c < mmu_cache_slots; c++) {
+	if ((readlookup[c] != (int) 0xffffffff) && (!rkeep || ((readlookupp[c] & rkeep) != rkeep)))
+		mmu_cache_drop_read(c);
+	if ((writelookup[c] != (int) 0xffffffff) && (!wkeep || ((writelookupp[c] & wkeep) != wkeep)))
+		mmu_cache_drop_write(c);
+    }
+
+    mmu_perm_page = 0xffffffff;
+}
+
+
+/* Pick the slot for a new entry in the set of the given page: a free
+   way if there is one, otherwise the next way round the set, with
+   global pages being passed over once before they are replaced. */
+static int
+mmu_cache_slot(int *lookup, int *perm, uint8_t *hand, uint32_t page)
+{
+    int set = page & (mmu_cache_sets - 1);
+    int base = set * MMU_CACHE_WAYS;
+    int c;
+
+    for (c = 0; c < MMU_CACHE_WAYS; c++) {
+	if (lookup[base + c] == (int) 0xffffffff)
+		return base + c;
+    }
+
+    for (;;) {
+	c = base + hand[set];
+	hand[set] = (hand[set] + 1) & (MMU_CACHE_WAYS - 1);
+
+	if (!(perm[c] & MMU_PERM_CHANCE))
+		return c;
+	perm[c] &= ~MMU_PERM_CHANCE;
+    }
+}
+
+
+/* Permissions for a new entry. They are only known for the page that
+   was last walked, anything else is treated as supervisor-only and
+   non-global, so it goes away on every flush as before. */
+static __inline int
+mmu_cache_perm(uint32_t virt)
+{
+    if (!(cr0 >> 31))
+	return MMU_PERM_USER | MMU_PERM_WRITE;
+
+    if ((virt >> 12) != mmu_perm_page)
+	return 0;
+
+    if (mmu_perm & MMU_PERM_GLOBAL)
+	return mmu_perm | MMU_PERM_CHANCE;
+
+    return mmu_perm;
+}
+
+
+void
+resetreadlookup(void)
+{
     /* Initialize the page lookup table. */
     memset(page_lookup, 0x00, (1<<20)*sizeof(page_t *));
 
-    /* Initialize the tables for lower (<= 1024K) RAM. */
-    for (c = 0; c < 256; c++) {
-	readlookup[c] = 0xffffffff;
-	writelookup[c] = 0xffffffff;
-    }
+    /* (Re)allocate the slots, the size may have been changed. */
+    mmu_cache_alloc();
+    memset(readlookup, 0xff, mmu_cache_slots * sizeof(int));
+    memset(writelookup, 0xff, mmu_cache_slots * sizeof(int));
+    memset(readlhand, 0x00, mmu_cache_sets);
+    memset(writelhand, 0x00, mmu_cache_sets);
 
     /* Initialize the tables for high (> 1024K) RAM. */
     memset(readlookup2, 0xff, (1<<20)*sizeof(uintptr_t));
     memset(writelookup2, 0xff, (1<<20)*sizeof(uintptr_t));
 
-    readlnext = 0;
-    writelnext = 0;
+    mmu_perm_page = 0xffffffff;
     pccache = 0xffffffff;
 }
 
@@ -181,19 +323,26 @@ resetreadlookup(void)
 void
 flushmmucache(void)
 {
-    int c;
+    mmu_cache_flush(0, 0);
+    mmuflush++;
 
-    for (c = 0; c < 256; c++) {
-	if (readlookup[c] != (int) 0xffffffff) {
-		readlookup2[readlookup[c]] = LOOKUP_INV;
-		readlookup[c] = 0xffffffff;
-	}
-	if (writelookup[c] != (int) 0xffffffff) {
-		page_lookup[writelookup[c]] = NULL;
-		writelookup2[writelookup[c]] = LOOKUP_INV;
-		writelookup[c] = 0xffffffff;
-	}
-    }
+    pccache = (uint32_t)0xffffffff;
+    pccache2 = (uint8_t *)0xffffffff;
+
+#ifdef USE_DYNAREC
+    codegen_flush();
+#endif
+}
+
+
+/* Flush on a CR3 load, global pages stay if CR4.PGE is set. */
+void
+flushmmucache_noglobal(void)
+{
+    if (cr4 & CR4_PGE)
+	mmu_cache_flush(MMU_PERM_GLOBAL, MMU_PERM_GLOBAL);
+    else
+	mmu_cache_flush(0, 0);
     mmuflush++;
 
     pccache = (uint32_t)0xffffffff;
@@ -208,38 +357,23 @@ flushmmucache(void)
 void
 flushmmucache_nopc(void)
 {
-    int c;
-
-    for (c = 0; c < 256; c++) {
-	if (readlookup[c] != (int) 0xffffffff) {
-		readlookup2[readlookup[c]] = LOOKUP_INV;
-		readlookup[c] = 0xffffffff;
-	}
-	if (writelookup[c] != (int) 0xffffffff) {
-		page_lookup[writelookup[c]] = NULL;
-		writelookup2[writelookup[c]] = LOOKUP_INV;
-		writelookup[c] = 0xffffffff;
-	}
-    }
+    mmu_cache_flush(0, 0);
 }
 
 
 void
 flushmmucache_cr3(void)
 {
-    int c;
+    mmu_cache_flush(0, 0);
+}
 
-    for (c = 0; c < 256; c++) {
-	if (readlookup[c] != (int) 0xffffffff) {
-		readlookup2[readlookup[c]] = LOOKUP_INV;
-		readlookup[c] = 0xffffffff;
-	}
-	if (writelookup[c] != (int) 0xffffffff) {
-		page_lookup[writelookup[c]] = NULL;
-		writelookup2[writelookup[c]] = LOOKUP_INV;
-		writelookup[c] = 0xffffffff;
-	}
-    }
+
+/* Called when dropping to CPL 3: the lookups do not check privilege,
+   so everything that CPL 3 may not access has to go. */
+void
+flushmmucache_cpl3(void)
+{
+    mmu_cache_flush(MMU_PERM_USER, MMU_PERM_USER | MMU_PERM_WRITE);
 }
 
 
@@ -250,7 +384,7 @@ mem_flush_write_page(uint32_t addr, uint32_t virt)
     int c;
     uint32_t a;
 
-    for (c = 0; c < 256; c++) {
+    for (c = 0; c < mmu_cache_slots; c++) {
 	if (writelookup[c] != (int) 0xffffffff) {
 		a = (uintptr_t)(addr & ~0xfff) - (virt & ~0xfff);
 		uintptr_t target;
@@ -260,11 +394,8 @@ mem_flush_write_page(uint32_t addr, uint32_t virt)
 		else
 			target = (uintptr_t)&ram[a];
 
-		if (writelookup2[writelookup[c]] == target || page_lookup[writelookup[c]] == page_target) {
-			writelookup2[writelookup[c]] = LOOKUP_INV;
-			page_lookup[writelookup[c]] = NULL;
-			writelookup[c] = 0xffffffff;
-		}
+		if (writelookup2[writelookup[c]] == target || page_lookup[writelookup[c]] == page_target)
+			mmu_cache_drop_write(c);
 	}
     }
 }
@@ -311,7 +442,10 @@ mmutranslatereal_normal(uint32_t addr, int rw)
 		return 0xffffffffffffffffULL;
 	}
 
-	mmu_perm = temp & 4;
+	mmu_perm = (temp & (MMU_PERM_USER | MMU_PERM_WRITE)) | MMU_PERM_LARGE;
+	if (cr4 & CR4_PGE)
+		mmu_perm |= (temp & MMU_PERM_GLOBAL);
+	mmu_perm_page = addr >> 12;
 	rammap(addr2) |= 0x20;
 
 	return (temp & ~0x3fffff) + (addr & 0x3fffff);
@@ -329,7 +463,10 @@ mmutranslatereal_normal(uint32_t addr, int rw)
 	return 0xffffffffffffffffULL;
     }
 
-    mmu_perm = temp & 4;
+    mmu_perm = temp3 & (MMU_PERM_USER | MMU_PERM_WRITE);
+    if (cr4 & CR4_PGE)
+	mmu_perm |= (temp & MMU_PERM_GLOBAL);
+    mmu_perm_page = addr >> 12;
     rammap(addr2) |= 0x20;
     rammap((temp2 & ~0xfff) + ((addr >> 10) & 0xffc)) |= (rw?0x60:0x20);
 
@@ -385,7 +522,10 @@ mmutranslatereal_pae(uint32_t addr, int rw)
 
 		return 0xffffffffffffffffULL;
 	}
-	mmu_perm = temp & 4;
+	mmu_perm = (temp & (MMU_PERM_USER | MMU_PERM_WRITE)) | MMU_PERM_LARGE;
+	if (cr4 & CR4_PGE)
+		mmu_perm |= (temp & MMU_PERM_GLOBAL);
+	mmu_perm_page = addr >> 12;
 	rammap64(addr3) |= 0x20;
 
 	return ((temp & ~0x1fffffULL) + (addr & 0x1fffffULL)) & 0x000000ffffffffffULL;
@@ -404,7 +544,10 @@ mmutranslatereal_pae(uint32_t addr, int rw)
 	return 0xffffffffffffffffULL;
     }
 
-    mmu_perm = temp & 4;
+    mmu_perm = temp3 & (MMU_PERM_USER | MMU_PERM_WRITE);
+    if (cr4 & CR4_PGE)
+	mmu_perm |= (temp & MMU_PERM_GLOBAL);
+    mmu_perm_page = addr >> 12;
     rammap64(addr3) |= 0x20;
     rammap64(addr4) |= (rw? 0x60 : 0x20);
 
@@ -415,6 +558,8 @@ mmutranslatereal_pae(uint32_t addr, int rw)
 uint64_t
 mmutranslatereal(uint32_t addr, int rw)
 {
+    mmu_walks++;
+
     if (cr4 & CR4_PAE)
 	return mmutranslatereal_pae(addr, rw);
     else
@@ -514,10 +659,31 @@ mmutranslate_noabrt(uint32_t addr, int rw)
 }
 
 
+/* INVLPG, drop just the one page, global or not. */
 void
 mmu_invalidate(uint32_t addr)
 {
-    flushmmucache_cr3();
+    int base = (int) ((addr >> 12) & (mmu_cache_sets - 1)) * MMU_CACHE_WAYS;
+    int c;
+
+    for (c = base; c < (base + MMU_CACHE_WAYS); c++) {
+	if (readlookup[c] == (int) (addr >> 12))
+		mmu_cache_drop_read(c);
+	if (writelookup[c] == (int) (addr >> 12))
+		mmu_cache_drop_write(c);
+    }
+
+    /* A large page is cached as separate 4K entries, which all go. */
+    for (c = 0; c < mmu_cache_slots; c++) {
+	if ((readlookupp[c] & MMU_PERM_LARGE) && (readlookup[c] != (int) 0xffffffff) &&
+	    ((readlookup[c] >> 10) == (int) (addr >> 22)))
+		mmu_cache_drop_read(c);
+	if ((writelookupp[c] & MMU_PERM_LARGE) && (writelookup[c] != (int) 0xffffffff) &&
+	    ((writelookup[c] >> 10) == (int) (addr >> 22)))
+		mmu_cache_drop_write(c);
+    }
+
+    mmu_perm_page = 0xffffffff;
 }
 
 
@@ -550,13 +716,15 @@ addreadlookup(uint32_t virt, uint32_t phys)
 #else
     uint32_t a;
 #endif
+    int c;
 
     if (virt == 0xffffffff) return;
 
     if (readlookup2[virt>>12] != (uintptr_t) LOOKUP_INV) return;
 
-    if (readlookup[readlnext] != (int) 0xffffffff)
-	readlookup2[readlookup[readlnext]] = LOOKUP_INV;
+    c = mmu_cache_slot(readlookup, readlookupp, readlhand, virt >> 12);
+    if (readlookup[c] != (int) 0xffffffff)
+	readlookup2[readlookup[c]] = LOOKUP_INV;
 
 #if (defined __amd64__ || defined _M_X64)
     a = ((uint64_t)(phys & ~0xfff) - (uint64_t)(virt & ~0xfff));
@@ -569,9 +737,9 @@ addreadlookup(uint32_t virt, uint32_t phys)
     else
 	readlookup2[virt>>12] = (uintptr_t)&ram[a];
 
-    readlookupp[readlnext] = mmu_perm;
-    readlookup[readlnext++] = virt >> 12;
-    readlnext &= (cachesize-1);
+    readlookupp[c] = mmu_cache_perm(virt);
+    readlookup[c] = virt >> 12;
+    readlnum++;
 
     cycles -= 9;
 }
@@ -585,14 +753,16 @@ addwritelookup(uint32_t virt, uint32_t phys)
 #else
     uint32_t a;
 #endif
+    int c;
 
     if (virt == 0xffffffff) return;
 
     if (page_lookup[virt >> 12]) return;
 
-    if (writelookup[writelnext] != -1) {
-	page_lookup[writelookup[writelnext]] = NULL;
-	writelookup2[writelookup[writelnext]] = LOOKUP_INV;
+    c = mmu_cache_slot(writelookup, writelookupp, writelhand, virt >> 12);
+    if (writelookup[c] != -1) {
+	page_lookup[writelookup[c]] = NULL;
+	writelookup2[writelookup[c]] = LOOKUP_INV;
     }
 
 #ifdef USE_NEW_DYNAREC
@@ -622,9 +792,9 @@ addwritelookup(uint32_t virt, uint32_t phys)
 		writelookup2[virt>>12] = (uintptr_t)&ram[a];
     }
 
-    writelookupp[writelnext] = mmu_perm;
-    writelookup[writelnext++] = virt >> 12;
-    writelnext &= (cachesize - 1);
+    writelookupp[c] = mmu_cache_perm(virt);
+    writelookup[c] = virt >> 12;
+    writelnum++;
 
     cycles -= 9;
 }
@@ -1654,6 +1824,140 @@ mem_write_phys(void *src, uint32_t addr, int transfer_size)
 }
 
 
+/* Returns a pointer to the memory behind a physical address if it is plain
+   RAM that can be read directly, the same memory the mapping handlers read. */
+static uint8_t *
+mem_phys_read_ptr(uint32_t addr)
+{
+    mem_mapping_t *map = read_mapping[addr >> MEM_GRANULARITY_BITS];
+
+    if (use_phys_exec && _mem_exec[addr >> MEM_GRANULARITY_BITS])
+	return &(_mem_exec[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK]);
+    else if (map == NULL)
+	return NULL;
+    else if (map->read_b == mem_read_ram)
+	return &(ram[addr]);
+    else if (map->read_b == mem_read_ram_2gb)
+	return &(ram2[addr - (1 << 30)]);
+
+    return NULL;
+}
+
+
+/* Same for writes; *inv is set if the recompiler has to be told about
+   the write. */
+static uint8_t *
+mem_phys_write_ptr(uint32_t addr, int *inv)
+{
+    mem_mapping_t *map = write_mapping[addr >> MEM_GRANULARITY_BITS];
+    page_t *p;
+
+    *inv = 0;
+
+    if (use_phys_exec && _mem_exec[addr >> MEM_GRANULARITY_BITS])
+	return &(_mem_exec[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK]);
+    else if ((map == NULL) || (map->write_b != mem_write_ram))
+	return NULL;
+    else if (!AT)
+	return &(ram[addr]);
+
+    if ((addr >> 12) >= pages_sz)
+	return NULL;
+
+    p = &pages[addr >> 12];
+    if ((p->mem == NULL) || (p->mem == page_ff))
+	return NULL;
+
+    *inv = 1;
+    return &(p->mem[addr & 0xfff]);
+}
+
+
+/* Bulk physical memory access for bus masters. Runs of plain RAM are
+   copied directly, anything else goes through the mapping handlers in
+   transfer_size units, a partial last unit being read (and written back)
+   in full. */
+void
+mem_read_phys_block(void *dest, uint32_t addr, uint32_t len, int transfer_size)
+{
+    uint8_t *d = (uint8_t *) dest, *p;
+    uint8_t bytes[4];
+    uint32_t run;
+
+    if (transfer_size < 1)
+	transfer_size = 1;
+
+    mem_logical_addr = 0xffffffff;
+
+    while (len > 0) {
+	p = mem_phys_read_ptr(addr);
+
+	if (p != NULL) {
+		run = MEM_GRANULARITY_SIZE - (addr & MEM_GRANULARITY_MASK);
+		if (run > len)
+			run = len;
+		memcpy(d, p, run);
+	} else if (len < (uint32_t) transfer_size) {
+		run = len;
+		mem_read_phys((void *) bytes, addr, transfer_size);
+		memcpy(d, bytes, run);
+	} else {
+		run = transfer_size;
+		mem_read_phys((void *) d, addr, transfer_size);
+	}
+
+	d += run;
+	addr += run;
+	len -= run;
+    }
+}
+
+
+void
+mem_write_phys_block(const void *src, uint32_t addr, uint32_t len, int transfer_size)
+{
+    const uint8_t *s = (const uint8_t *) src;
+    uint8_t *p;
+    uint8_t bytes[4];
+    uint32_t run;
+    int inv;
+
+    if (transfer_size < 1)
+	transfer_size = 1;
+
+    mem_logical_addr = 0xffffffff;
+
+    while (len > 0) {
+	p = mem_phys_write_ptr(addr, &inv);
+
+	if (p != NULL) {
+		run = 0x1000 - (addr & 0xfff);
+		if (run > len)
+			run = len;
+		/* Only what actually changes invalidates translated code. */
+		if (memcmp(p, s, run)) {
+			memcpy(p, s, run);
+			if (inv)
+				mem_invalidate_range(addr, addr + run - 1);
+		}
+	} else if (len < (uint32_t) transfer_size) {
+		run = len;
+		mem_read_phys((void *) bytes, addr, transfer_size);
+		memcpy(bytes, s, run);
+		mem_write_phys((void *) bytes, addr, transfer_size);
+	} else {
+		run = transfer_size;
+		memcpy(bytes, s, run);
+		mem_write_phys((void *) bytes, addr, transfer_size);
+	}
+
+	s += run;
+	addr += run;
+	len -= run;
+    }
+}
+
+
 uint8_t
 mem_read_ram(uint32_t addr, void *priv)
 {
@@ -2082,6 +2386,13 @@ mem_invalidate_range(uint32_t start_addr, uint32_t end_addr)
 	p->dirty_mask |= mask;
 	if ((p->code_present_mask & mask) && !page_in_evict_list(p))
 		page_add_to_evict_list(p);
+
+	/* Blocks that track their code bytes only look at the byte mask. */
+	if (p->byte_dirty_mask != NULL) {
+		p->byte_dirty_mask[(start_addr >> PAGE_BYTE_MASK_SHIFT) & PAGE_BYTE_MASK_OFFSET_MASK] = 0xffffffffffffffffULL;
+		if (p->byte_code_present_mask[(start_addr >> PAGE_BYTE_MASK_SHIFT) & PAGE_BYTE_MASK_OFFSET_MASK] && !page_in_evict_list(p))
+			page_add_to_evict_list(p);
+	}
     }
 #else
     uint32_t cur_addr;
@@ -2264,7 +2575,7 @@ mem_mapping_recalc(uint64_t base, uint64_t size)
 	map = map->next;
     }
 
-    flushmmucache_cr3();
+    flushmmucache_nopc();
 }
 
 
@@ -2772,6 +3083,9 @@ mem_init(void)
     page_lookup = (page_t **)malloc((1<<20)*sizeof(page_t *));
     readlookup2  = malloc((1<<20)*sizeof(uintptr_t));
     writelookup2 = malloc((1<<20)*sizeof(uintptr_t));
+
+    /* Allocate the soft TLB slots, empty. */
+    mmu_cache_alloc();
 }
 
 
@@ -2841,6 +3155,41 @@ mem_reset_page_blocks(void)
 }
 
 
+void
+mem_save_state(savestate_t *st)
+{
+    uint32_t m = 1024UL * mem_size;
+    uint32_t size = m;
+
+    savestate_var(st, size);
+    if (!st->error && (size != m)) {
+	savestate_fail(st, "RAM size mismatch");
+	return;
+    }
+
+#if (!(defined __amd64__ || defined _M_X64))
+    if (mem_size > 1048576) {
+	savestate_data(st, ram, 1 << 30);
+	savestate_data(st, ram2, m - (1 << 30));
+    } else
+#endif
+	savestate_data(st, ram, m);
+
+    savestate_var(st, _mem_state);
+    savestate_var(st, rammask);
+    savestate_var(st, shadowbios);
+    savestate_var(st, shadowbios_write);
+    savestate_var(st, mem_a20_key);
+    savestate_var(st, mem_a20_alt);
+    savestate_var(st, mem_a20_state);
+
+    if (st->loading && !st->error) {
+	mem_mapping_recalc(0ULL, 0x100000000ULL);
+	flushmmucache();
+    }
+}
+
+
 void
 mem_a20_recalc(void)
 {
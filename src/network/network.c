@@ -105,14 +105,44 @@ int		nic_do_log = ENABLE_NIC_LOG;
 #endif
 
 
+#define NET_QUEUE_LEN	32		/* packet slots per direction, power of 2 */
+#define NET_QUEUE_MASK	(NET_QUEUE_LEN - 1)
+#define NET_RX_BATCH	8		/* most frames handed to the card per tick */
+
+#ifdef __GNUC__
+# define network_barrier()	__sync_synchronize()
+#else
+# define network_barrier()	_ReadWriteBarrier()
+#endif
+
+
+/*
+ * Packet queue, one per direction.
+ *
+ * Each queue has exactly one producer and one consumer: received frames
+ * are put by the pcap/slirp poll thread and taken by the emulation
+ * thread, and the other way around for frames being transmitted. The
+ * slots are allocated once, and the two indexes are only ever written
+ * by their own side, so no lock is needed.
+ */
+typedef struct {
+    netpkt_t		*slots;
+
+    volatile uint32_t	head,		/* next slot to fill, producer only */
+			tail;		/* next slot to take, consumer only */
+
+    uint32_t		drops,
+			max_depth;
+} netqueue_t;
+
+
 /* Local variables. */
 static volatile int	net_wait = 0;
 static mutex_t		*network_mutex;
 static uint8_t		*network_mac;
 static uint8_t		network_timer_active = 0;
 static pc_timer_t	network_rx_queue_timer;
-static netpkt_t		*first_pkt[2] = { NULL, NULL },
-			*last_pkt[2] = { NULL, NULL };
+static netqueue_t	network_queues[2];
 
 
 static struct {
@@ -266,100 +296,146 @@ network_init(void)
 }
 
 
+static void
+network_queue_init(int tx)
+{
+    netqueue_t *queue = &network_queues[tx];
+
+    if (queue->slots == NULL)
+	queue->slots = (netpkt_t *) malloc(NET_QUEUE_LEN * sizeof(netpkt_t));
+
+    queue->head = queue->tail = 0;
+    queue->drops = queue->max_depth = 0;
+}
+
+
 void
 network_queue_put(int tx, void *priv, uint8_t *data, int len)
 {
-    netpkt_t *temp;
-
-    temp = (netpkt_t *) malloc(sizeof(netpkt_t));
-    memset(temp, 0, sizeof(netpkt_t));
-    temp->priv = priv;
-    memcpy(temp->data, data, len);
-    temp->len = len;
-    temp->prev = last_pkt[tx];
-    temp->next = NULL;
-
-    if (last_pkt[tx] != NULL)
-	last_pkt[tx]->next = temp;
-    last_pkt[tx] = temp;
-
-    if (first_pkt[tx] == NULL)
-	first_pkt[tx] = temp;
+    netqueue_t *queue = &network_queues[tx];
+    netpkt_t *pkt;
+    uint32_t head = queue->head;
+    uint32_t depth = head - queue->tail;
+
+    if (queue->slots == NULL)
+	return;
+
+    if (depth >= NET_QUEUE_LEN) {
+	queue->drops++;
+	network_log("NETWORK: %s queue full, frame dropped\n", tx ? "TX" : "RX");
+	return;
+    }
+
+    if (len > sizeof(pkt->data))
+	len = sizeof(pkt->data);
+
+    pkt = &queue->slots[head & NET_QUEUE_MASK];
+    pkt->priv = priv;
+    memcpy(pkt->data, data, len);
+    pkt->len = len;
+
+    /* Make the frame visible before the slot is handed over. */
+    network_barrier();
+    queue->head = head + 1;
+
+    if (++depth > queue->max_depth)
+	queue->max_depth = depth;
 }
 
 
-static void
-network_queue_get(int tx, netpkt_t **pkt)
+static netpkt_t *
+network_queue_get(int tx)
 {
-    if (first_pkt[tx] == NULL)
-	*pkt = NULL;
-    else
-	*pkt = first_pkt[tx];
+    netqueue_t *queue = &network_queues[tx];
+
+    if ((queue->slots == NULL) || (queue->tail == queue->head))
+	return NULL;
+
+    network_barrier();
+    return &queue->slots[queue->tail & NET_QUEUE_MASK];
 }
 
 
 static void
 network_queue_advance(int tx)
 {
-    netpkt_t *temp;
-
-    temp = first_pkt[tx];
+    netqueue_t *queue = &network_queues[tx];
 
-    if (temp == NULL)
+    if (queue->tail == queue->head)
 	return;
 
-    first_pkt[tx] = temp->next;
-    free(temp);
-
-    if (first_pkt[tx] == NULL)
-	last_pkt[tx] = NULL;
+    /* Done with the slot before the producer may reuse it. */
+    network_barrier();
+    queue->tail++;
 }
 
 
 static void
 network_queue_clear(int tx)
 {
-    netpkt_t *temp = first_pkt[tx], *temp2;
+    netqueue_t *queue = &network_queues[tx];
+
+    if (queue->slots != NULL)
+	network_log("NETWORK: %s queue: %u frame(s) dropped, at most %u queued\n",
+		    tx ? "TX" : "RX", queue->drops, queue->max_depth);
+
+    free(queue->slots);
+    queue->slots = NULL;
+    queue->head = queue->tail = 0;
+}
 
-    if (temp == NULL)
-	return;
 
-    do {
-	temp2 = temp->next;
-	free(temp);
-	temp = temp2;
-    } while (temp != NULL);
+void
+network_queue_stats(int tx, netqueue_stats_t *stats)
+{
+    netqueue_t *queue = &network_queues[tx];
 
-    first_pkt[tx] = last_pkt[tx] = NULL;
+    stats->drops = queue->drops;
+    stats->depth = queue->head - queue->tail;
+    stats->max_depth = queue->max_depth;
 }
 
 
 static void
 network_rx_queue(void *priv)
 {
-    int ret = 1;
+    netpkt_t *pkt;
+    double period = 0.0, time;
+    int frames = 0;
 
     if (network_rx_pause) {
 	timer_on_auto(&network_rx_queue_timer, 0.762939453125 * 2.0 * 128.0);
 	return;
     }
 
-    netpkt_t *pkt = NULL;
-
     network_busy(1);
 
-    network_queue_get(0, &pkt);
-    if ((pkt != NULL) && (pkt->len > 0)) {
-	network_dump_packet(pkt);
-	ret = net_cards[network_card].rx(pkt->priv, pkt->data, pkt->len);
-	if (pkt->len >= 128)
-		timer_on_auto(&network_rx_queue_timer, 0.762939453125 * 2.0 * ((double) pkt->len));
-	else
-		timer_on_auto(&network_rx_queue_timer, 0.762939453125 * 2.0 * 128.0);
-    } else
-	timer_on_auto(&network_rx_queue_timer, 0.762939453125 * 2.0 * 128.0);
-    if (ret)
+    /* Hand the card up to NET_RX_BATCH frames, and come back once they
+       would have taken their time on the wire. */
+    while ((frames < NET_RX_BATCH) && ((pkt = network_queue_get(0)) != NULL)) {
+	if (pkt->len > 0) {
+		if (pkt->len >= 128)
+			time = 0.762939453125 * 2.0 * ((double) pkt->len);
+		else
+			time = 0.762939453125 * 2.0 * 128.0;
+
+		network_dump_packet(pkt);
+		if (! net_cards[network_card].rx(pkt->priv, pkt->data, pkt->len)) {
+			/* The card is busy, retry this frame next time. */
+			if (frames == 0)
+				period = time;
+			break;
+		}
+		period += time;
+	}
+
 	network_queue_advance(0);
+	frames++;
+    }
+
+    if (period == 0.0)
+	period = 0.762939453125 * 2.0 * 128.0;
+    timer_on_auto(&network_rx_queue_timer, period);
 
     network_busy(0);
 }
@@ -386,6 +462,9 @@ network_attach(void *dev, uint8_t *mac, NETRXCB rx, NETWAITCB wait, NETSETLINKST
 
     network_set_wait(0);
 
+    network_queue_init(0);
+    network_queue_init(1);
+
     /* Create the network events. */
     poll_data.wake_poll_thread = thread_create_event();
     poll_data.poll_complete = thread_create_event();
@@ -401,8 +480,6 @@ network_attach(void *dev, uint8_t *mac, NETRXCB rx, NETWAITCB wait, NETSETLINKST
 		break;
     }
 
-    first_pkt[0] = first_pkt[1] = NULL;
-    last_pkt[0] = last_pkt[1] = NULL;
     memset(&network_rx_queue_timer, 0x00, sizeof(pc_timer_t));
     timer_add(&network_rx_queue_timer, network_rx_queue, NULL, 0);
     /* 10 mbps. */
@@ -540,51 +617,45 @@ network_reset(void)
 void
 network_tx(uint8_t *bufp, int len)
 {
-    network_busy(1);
-
     ui_sb_update_icon(SB_NETWORK, 1);
 
     network_queue_put(1, NULL, bufp, len);
 
     ui_sb_update_icon(SB_NETWORK, 0);
-
-    network_busy(0);
 }
 
 
-/* Actually transmit the packet. */
+/* Actually transmit the queued packets. */
 void
 network_do_tx(void)
 {
-    netpkt_t *pkt = NULL;
+    netpkt_t *pkt;
 
     if (network_tx_pause)
 	return;
 
-    network_queue_get(1, &pkt);
-    if ((pkt != NULL) && (pkt->len > 0)) {
-	network_dump_packet(pkt);
-	switch(network_type) {
-		case NET_TYPE_PCAP:
-			net_pcap_in(pkt->data, pkt->len);
-			break;
-
-		case NET_TYPE_SLIRP:
-			net_slirp_in(pkt->data, pkt->len);
-			break;
+    while ((pkt = network_queue_get(1)) != NULL) {
+	if (pkt->len > 0) {
+		network_dump_packet(pkt);
+		switch(network_type) {
+			case NET_TYPE_PCAP:
+				net_pcap_in(pkt->data, pkt->len);
+				break;
+
+			case NET_TYPE_SLIRP:
+				net_slirp_in(pkt->data, pkt->len);
+				break;
+		}
 	}
+	network_queue_advance(1);
     }
-    network_queue_advance(1);
 }
 
 
 int
 network_tx_queue_check(void)
 {
-    if ((first_pkt[1] == NULL) && (last_pkt[1] == NULL))
-	return 0;
-
-    return 1;
+    return (network_queue_get(1) != NULL);
 }
 
 
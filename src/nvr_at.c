@@ -237,6 +237,7 @@
 #include <86box/rom.h>
 #include <86box/device.h>
 #include <86box/nvr.h>
+#include <86box/savestate.h>
 
 
 /* RTC registers and bit definitions. */
@@ -900,6 +901,30 @@ nvr_lock_set(int base, int size, int lock, nvr_t *nvr)
 }
 
 
+static void
+nvr_at_save_state(void *priv, savestate_t *st)
+{
+    nvr_t *nvr = (nvr_t *) priv;
+    local_t *local = (local_t *) nvr->data;
+
+    savestate_var(st, nvr->regs);
+    savestate_var(st, nvr->onesec_cnt);
+    savestate_timer(st, &nvr->onesec_time);
+
+    savestate_var(st, local->stat);
+    savestate_var(st, local->addr);
+    savestate_var(st, local->wp);
+    savestate_var(st, local->bank);
+    savestate_data(st, local->lock, nvr->size);
+    savestate_var(st, local->count);
+    savestate_var(st, local->state);
+    savestate_var(st, local->ecount);
+    savestate_var(st, local->rtc_time);
+    savestate_timer(st, &local->update_timer);
+    savestate_timer(st, &local->rtc_timer);
+}
+
+
 static void *
 nvr_at_init(const device_t *info)
 {
@@ -1029,7 +1054,8 @@ const device_t at_nvr_old_device = {
     0,
     nvr_at_init, nvr_at_close, NULL,
     { NULL }, nvr_at_speed_changed,
-    NULL
+    NULL, NULL,
+    nvr_at_save_state
 };
 
 const device_t at_nvr_device = {
@@ -1038,7 +1064,8 @@ const device_t at_nvr_device = {
     1,
     nvr_at_init, nvr_at_close, NULL,
     { NULL }, nvr_at_speed_changed,
-    NULL
+    NULL, NULL,
+    nvr_at_save_state
 };
 
 const device_t ps_nvr_device = {
@@ -1047,7 +1074,8 @@ const device_t ps_nvr_device = {
     2,
     nvr_at_init, nvr_at_close, NULL,
     { NULL }, nvr_at_speed_changed,
-    NULL
+    NULL, NULL,
+    nvr_at_save_state
 };
 
 const device_t amstrad_nvr_device = {
@@ -1056,7 +1084,8 @@ const device_t amstrad_nvr_device = {
     3,
     nvr_at_init, nvr_at_close, NULL,
     { NULL }, nvr_at_speed_changed,
-    NULL
+    NULL, NULL,
+    nvr_at_save_state
 };
 
 const device_t ibmat_nvr_device = {
@@ -1065,7 +1094,8 @@ const device_t ibmat_nvr_device = {
     4,
     nvr_at_init, nvr_at_close, NULL,
     { NULL }, nvr_at_speed_changed,
-    NULL
+    NULL, NULL,
+    nvr_at_save_state
 };
 
 const device_t piix4_nvr_device = {
@@ -1074,7 +1104,8 @@ const device_t piix4_nvr_device = {
     9,
     nvr_at_init, nvr_at_close, NULL,
     { NULL }, nvr_at_speed_changed,
-    NULL
+    NULL, NULL,
+    nvr_at_save_state
 };
 
 const device_t ls486e_nvr_device = {
@@ -1083,7 +1114,8 @@ const device_t ls486e_nvr_device = {
     13,
     nvr_at_init, nvr_at_close, NULL,
     { NULL }, nvr_at_speed_changed,
-    NULL
+    NULL, NULL,
+    nvr_at_save_state
 };
 
 const device_t ami_apollo_nvr_device = {
@@ -1092,7 +1124,8 @@ const device_t ami_apollo_nvr_device = {
     14,
     nvr_at_init, nvr_at_close, NULL,
     { NULL }, nvr_at_speed_changed,
-    NULL
+    NULL, NULL,
+    nvr_at_save_state
 };
 
 const device_t via_nvr_device = {
@@ -1101,5 +1134,6 @@ const device_t via_nvr_device = {
     15,
     nvr_at_init, nvr_at_close, NULL,
     { NULL }, nvr_at_speed_changed,
-    NULL
+    NULL, NULL,
+    nvr_at_save_state
 };
@@ -70,6 +70,7 @@
 #include <86box/mo.h>
 #include <86box/scsi_disk.h>
 #include <86box/cdrom_image.h>
+#include <86box/cdrom_image_backend.h>
 #include <86box/network.h>
 #include <86box/sound.h>
 #include <86box/midi.h>
@@ -78,6 +79,7 @@
 #include <86box/ui.h>
 #include <86box/plat.h>
 #include <86box/plat_midi.h>
+#include <86box/savestate.h>
 #include <86box/version.h>
 
 
@@ -110,6 +112,8 @@ uint64_t	unique_id = 0;
 uint64_t	source_hwnd = 0;
 #endif
 wchar_t log_path[1024] = { L'\0'};		/* (O) full path of logfile */
+wchar_t savestate_load_path[1024] = { L'\0'};	/* (O) state to restore at startup */
+wchar_t savestate_save_path[1024] = { L'\0'};	/* (O) state to save on exit */
 
 /* Configuration values. */
 int	window_w, window_h,			/* (C) window size and */
@@ -154,6 +158,7 @@ int	enable_crashdump = 0;			/* (C) enable crash dump */
 /* Statistics. */
 extern int
 	mmuflush,
+	mmu_walks,
 	readlnum,
 	writelnum;
 
@@ -376,6 +381,9 @@ usage:
 		printf("-H or --hwnd id,hwnd - sends back the main dialog's hwnd\n");
 #endif
 		printf("-R or --crashdump    - enables crashdump on exception\n");
+		printf("-V or --loadstate path - restore machine state from 'path'\n");
+		printf("-W or --savestate path - save machine state to 'path' on exit\n");
+		printf("-Z or --compresscd src dst - compress CD-ROM image 'src' to 'dst' and exit\n");
 		printf("\nA config file can be specified. If none is, the default file will be used.\n");
 		return(0);
 	} else if (!wcscasecmp(argv[c], L"--dumpcfg") ||
@@ -408,6 +416,23 @@ usage:
 	} else if (!wcscasecmp(argv[c], L"--crashdump") ||
 		   !wcscasecmp(argv[c], L"-R")) {
 		enable_crashdump = 1;
+	} else if (!wcscasecmp(argv[c], L"--loadstate") ||
+		   !wcscasecmp(argv[c], L"-V")) {
+		if ((c+1) == argc) goto usage;
+
+		wcscpy(savestate_load_path, argv[++c]);
+	} else if (!wcscasecmp(argv[c], L"--savestate") ||
+		   !wcscasecmp(argv[c], L"-W")) {
+		if ((c+1) == argc) goto usage;
+
+		wcscpy(savestate_save_path, argv[++c]);
+	} else if (!wcscasecmp(argv[c], L"--compresscd") ||
+		   !wcscasecmp(argv[c], L"-Z")) {
+		if ((c+2) >= argc) goto usage;
+
+		/* Leave with the status of the conversion itself, as
+		   returning 0 from here always ends with the same one. */
+		exit(cdz_convert(argv[c+1], argv[c+2]) ? 0 : 1);
 #ifdef _WIN32
 	} else if (!wcscasecmp(argv[c], L"--hwnd") ||
 		   !wcscasecmp(argv[c], L"-H")) {
@@ -714,7 +739,7 @@ pc_reset_hard_close(void)
 
     scsi_disk_close();
 
-    closeal();
+    sound_output_close();
 
     video_reset_close();
 }
@@ -907,6 +932,8 @@ pc_close(thread_t *ptr)
     mo_close();
 
     scsi_disk_close();
+
+    sound_wav_close();
 }
 
 
@@ -935,6 +962,10 @@ pc_thread(void *param)
     title_update = 1;
     old_time = plat_get_ticks();
     done = drawits = frames = 0;
+
+    if (savestate_load_path[0] != L'\0')
+	savestate_load(savestate_load_path);
+
     while (! *quitp) {
 	/* See if it is time to run a frame of code. */
 	new_time = plat_get_ticks();
@@ -977,7 +1008,7 @@ pc_thread(void *param)
 
 			readlnum = writelnum = 0;
 			egareads = egawrites = 0;
-			mmuflush = 0;
+			mmuflush = mmu_walks = 0;
 			frames = 0;
 		}
 
@@ -1014,8 +1045,9 @@ pc_thread(void *param)
 		end_time = plat_timer_read();
 		main_time += (end_time - start_time);
 	} else {
-		/* Just so we dont overload the host OS. */
-		plat_delay_ms(1);
+		/* Sleep until the next frame is due, an idle guest
+		   gets its frames done early and then waits here. */
+		plat_delay_ms((dopause || (drawits > 0)) ? 1 : MIN(1 - drawits, 10));
 	}
 
 	/* If needed, handle a screen resize. */
@@ -1026,6 +1058,13 @@ pc_thread(void *param)
 	}
     }
 
+    /* We are between frames here, so the machine state is consistent. */
+    if (savestate_save_path[0] != L'\0') {
+	startblit();
+	savestate_save(savestate_save_path);
+	endblit();
+    }
+
     pc_log("PC: main thread done.\n");
 }
 
@@ -16,6 +16,7 @@
  *		Copyright 2016-2020 Miran Grca.
  */
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,6 +36,7 @@
 #include <86box/apm.h>
 #include <86box/nvr.h>
 #include <86box/acpi.h>
+#include <86box/savestate.h>
 
 
 enum
@@ -249,6 +251,19 @@ pic_reset()
 }
 
 
+void
+pic_save_state(savestate_t *st)
+{
+    /* The slave pointers are set up by pic_reset() and not saved. */
+    savestate_data(st, &pic, offsetof(pic_t, slaves));
+    savestate_data(st, &pic2, offsetof(pic_t, slaves));
+    savestate_var(st, shadow);
+    savestate_var(st, latched);
+    savestate_var(st, pic_pending);
+    savestate_timer(st, &pic_timer);
+}
+
+
 void
 pic_set_shadow(int sh)
 {
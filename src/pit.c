@@ -17,6 +17,7 @@
 #include <inttypes.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -38,6 +39,7 @@
 #include <86box/sound.h>
 #include <86box/snd_speaker.h>
 #include <86box/video.h>
+#include <86box/savestate.h>
 
 
 pit_t		*pit, *pit2;
@@ -396,6 +398,282 @@ ctr_latch_count(ctr_t *ctr)
 }
 
 
+/* Counters clocked by the PIT's own timer are not stepped on every CLOCK
+   edge; they are brought up to date when they are accessed, and the timer
+   only fires on the edges where something other than the count changes.
+
+   A tick that only changes the count is a "plain" tick, and any number of
+   them can be applied at once. Every other tick (reloads, OUT changes,
+   the latch and state 1 handshakes) is still applied one edge at a time
+   through pit_ctr_set_clock_common(), so there is only one definition of
+   what the counter does on an edge. */
+#define PIT_EDGES_INF		0xffffffffffffffffULL
+#define PIT_EDGES_MAX		0x40000ULL	/* upper bound for one timer period */
+
+
+static int
+ctr_bcd_valid(ctr_t *ctr)
+{
+    int i;
+
+    for (i = 0; i < 20; i += 4) {
+	if (((ctr->count >> i) & 0x0f) > 9)
+		return 0;
+    }
+
+    return 1;
+}
+
+
+/* Returns the count as a number of ticks to go. */
+static uint32_t
+ctr_count_value(ctr_t *ctr)
+{
+    if (ctr->ctrl & 0x01)
+	return ((ctr->count >> 16) & 0x0f) * 10000 + ((ctr->count >> 12) & 0x0f) * 1000 +
+	       ((ctr->count >> 8) & 0x0f) * 100 + ((ctr->count >> 4) & 0x0f) * 10 + (ctr->count & 0x0f);
+
+    return ctr->count;
+}
+
+
+/* Same as calling ctr_decrease_count() ticks times. */
+static void
+ctr_decrease_count_by(ctr_t *ctr, uint64_t ticks)
+{
+    uint32_t v;
+
+    if (ctr->ctrl & 0x01) {
+	v = ctr_count_value(ctr);
+	v = (v + 100000 - (uint32_t) (ticks % 100000ULL)) % 100000;
+	ctr->count = ((v / 10000) << 16) | (((v / 1000) % 10) << 12) |
+		     (((v / 100) % 10) << 8) | (((v / 10) % 10) << 4) | (v % 10);
+    } else
+	ctr->count = (int) (((uint64_t) ctr->count - ticks) & 0xffff);
+}
+
+
+/* Returns how many plain ticks come before the next one that is not. */
+static uint64_t
+ctr_plain_ticks(ctr_t *ctr)
+{
+    if ((ctr->ctrl & 0x01) && !ctr_bcd_valid(ctr))
+	return 0ULL;
+
+    switch(ctr->m & 0x07) {
+	case 0:
+		if (ctr->state == 1)
+			return 0ULL;
+		if ((ctr->state == 2) && ctr->gate && (ctr->count >= 1))
+			return ctr_count_value(ctr) - 1;
+		break;
+	case 1:
+		if (ctr->state == 1)
+			return 0ULL;
+		if ((ctr->state == 2) && (ctr->count >= 1))
+			return ctr_count_value(ctr) - 1;
+		break;
+	case 2: case 6:
+		if ((ctr->state == 1) || (ctr->state == 3))
+			return 0ULL;
+		if ((ctr->state == 2) && ctr->gate && (ctr->count >= 2))
+			return ctr_count_value(ctr) - 2;
+		break;
+	case 3: case 7:
+		if (ctr->state == 1)
+			return 0ULL;
+		if (((ctr->state == 2) || (ctr->state == 3)) && ctr->gate && (ctr->count >= 0))
+			return ctr->newcount ? 0ULL : (uint64_t) (ctr->count >> 1);
+		break;
+	case 4: case 5:
+		if ((ctr->gate == 0) && (ctr->m == 4))
+			break;
+		if ((ctr->state == 1) || (ctr->state == 3))
+			return 0ULL;
+		if ((ctr->state == 2) && (ctr->count >= 1))
+			return ctr_count_value(ctr) - 1;
+		break;
+    }
+
+    /* The counter is either stopped or counts without ever changing OUT. */
+    return PIT_EDGES_INF;
+}
+
+
+/* Applies ticks plain ticks, which must not exceed ctr_plain_ticks(). */
+static void
+ctr_plain_tick(ctr_t *ctr, uint64_t ticks)
+{
+    switch(ctr->m & 0x07) {
+	case 0:
+		if (((ctr->state == 2) && ctr->gate && (ctr->count >= 1)) || (ctr->state == 3))
+			ctr_decrease_count_by(ctr, ticks);
+		break;
+	case 1:
+		if (((ctr->state == 2) && (ctr->count >= 1)) || (ctr->state == 3))
+			ctr_decrease_count_by(ctr, ticks);
+		break;
+	case 2: case 6:
+		if ((ctr->state == 2) && ctr->gate && (ctr->count >= 2))
+			ctr_decrease_count_by(ctr, ticks);
+		break;
+	case 3: case 7:
+		if (((ctr->state == 2) || (ctr->state == 3)) && ctr->gate && (ctr->count >= 0))
+			ctr->count -= (int) (ticks << 1);
+		break;
+	case 4: case 5:
+		if ((ctr->gate == 0) && (ctr->m == 4))
+			break;
+		if ((ctr->state == 0) || ((ctr->state == 2) && (ctr->count >= 1)))
+			ctr_decrease_count_by(ctr, ticks);
+		break;
+    }
+}
+
+
+/* Returns how many of the coming CLOCK edges the counter can skip, the
+   counter ticks on the falling ones. */
+static uint64_t
+ctr_plain_edges(ctr_t *ctr, int clock)
+{
+    uint64_t ticks;
+
+    if (!ctr->using_timer)
+	return PIT_EDGES_INF;
+
+    if (ctr->latch || (ctr->state == 1))
+	return 0ULL;
+
+    ticks = ctr_plain_ticks(ctr);
+    if (ticks == PIT_EDGES_INF)
+	return PIT_EDGES_INF;
+
+    return (ticks << 1) + (clock ? 0 : 1);
+}
+
+
+static __inline void
+pit_ctr_set_clock_common(ctr_t *ctr, int clock)
+{
+    int old = ctr->clock;
+
+    ctr->clock = clock;
+
+    if (ctr->using_timer && ctr->latch) {
+	if (old && !ctr->clock) {
+		ctr_set_state_1(ctr);
+		ctr->latch = 0;
+	}
+    } else if (ctr->using_timer && !ctr->latch) {
+	if (ctr->state == 1) {
+		if (!old && ctr->clock)
+			ctr->s1_det = 1;	/* Rising edge. */
+		else if (old && !ctr->clock) {
+			ctr->s1_det++;		/* Falling edge. */
+			if (ctr->s1_det != 2)
+				ctr->s1_det = 0;
+		}
+
+		if (ctr->s1_det == 2) {
+			ctr->s1_det = 0;
+			ctr_tick(ctr);
+		}
+	} else if (old && !ctr->clock)
+		ctr_tick(ctr);
+    }
+}
+
+
+static uint64_t
+pit_plain_edges(pit_t *dev)
+{
+    uint64_t edges, min = PIT_EDGES_INF;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+	edges = ctr_plain_edges(&dev->counters[i], dev->clock);
+	if (edges < min)
+		min = edges;
+    }
+
+    return min;
+}
+
+
+/* Applies every CLOCK edge up to the current time. */
+static void
+pit_sync(pit_t *dev)
+{
+    uint64_t half = PITCONST >> 1ULL;
+    uint64_t edges, skip, ticks;
+    int64_t elapsed;
+    int i;
+
+    if (half == 0ULL)
+	return;
+
+    /* An edge is due once the integer part of its time is reached, the
+       same as a timer. */
+    elapsed = (int64_t) ((tsc << 32) + 0xffffffffULL - dev->edge_ts);
+    if (elapsed < 0)
+	return;
+
+    edges = ((uint64_t) elapsed / half) + 1;
+
+    while (edges > 0ULL) {
+	skip = pit_plain_edges(dev);
+	if (skip > edges)
+		skip = edges;
+
+	if (skip > 0ULL) {
+		ticks = dev->clock ? ((skip + 1) >> 1) : (skip >> 1);
+		if (skip & 1)
+			dev->clock ^= 1;
+
+		for (i = 0; i < 3; i++) {
+			if (dev->counters[i].using_timer && ticks)
+				ctr_plain_tick(&dev->counters[i], ticks);
+			dev->counters[i].clock = dev->clock;
+		}
+
+		dev->edge_ts += skip * half;
+		edges -= skip;
+	}
+
+	if (edges > 0ULL) {
+		dev->clock ^= 1;
+
+		for (i = 0; i < 3; i++)
+			pit_ctr_set_clock_common(&dev->counters[i], dev->clock);
+
+		dev->edge_ts += half;
+		edges--;
+	}
+    }
+}
+
+
+/* Arms the timer for the next edge that can not be skipped. */
+static void
+pit_schedule(pit_t *dev)
+{
+    uint64_t skip, ts;
+
+    skip = pit_plain_edges(dev);
+    if (skip > PIT_EDGES_MAX)
+	skip = PIT_EDGES_MAX;
+
+    ts = dev->edge_ts + skip * (PITCONST >> 1ULL);
+
+    if (timer_is_enabled(&dev->callback_timer) && (dev->callback_timer.ts.ts64 == ts))
+	return;
+
+    timer_disable(&dev->callback_timer);
+    dev->callback_timer.ts.ts64 = ts;
+    timer_enable(&dev->callback_timer);
+}
+
+
 uint16_t
 pit_ctr_get_count(ctr_t *ctr)
 {
@@ -428,6 +706,8 @@ pit_ctr_set_gate(ctr_t *ctr, int gate)
 {
     int old = ctr->gate;
 
+    pit_sync(ctr->dev);
+
     ctr->gate = gate;
 
     switch (ctr->m & 0x07) {
@@ -456,54 +736,28 @@ pit_ctr_set_gate(ctr_t *ctr, int gate)
 		}
 		break;
    }
-}
-
-
-static __inline void
-pit_ctr_set_clock_common(ctr_t *ctr, int clock)
-{
-    int old = ctr->clock;
 
-    ctr->clock = clock;
-
-    if (ctr->using_timer && ctr->latch) {
-	if (old && !ctr->clock) {
-		ctr_set_state_1(ctr);
-		ctr->latch = 0;
-	}
-    } else if (ctr->using_timer && !ctr->latch) {
-	if (ctr->state == 1) {
-		if (!old && ctr->clock)
-			ctr->s1_det = 1;	/* Rising edge. */
-		else if (old && !ctr->clock) {
-			ctr->s1_det++;		/* Falling edge. */
-			if (ctr->s1_det != 2)
-				ctr->s1_det = 0;
-		}
-
-		if (ctr->s1_det == 2) {
-			ctr->s1_det = 0;
-			ctr_tick(ctr);
-		}
-	} else if (old && !ctr->clock)
-		ctr_tick(ctr);
-    }
+    pit_schedule(ctr->dev);
 }
 
 
 void
 pit_ctr_set_clock(ctr_t *ctr, int clock)
 {
+    pit_sync(ctr->dev);
     pit_ctr_set_clock_common(ctr, clock);
+    pit_schedule(ctr->dev);
 }
 
 
 void
 pit_ctr_set_using_timer(ctr_t *ctr, int using_timer)
 {
-    timer_process();
+    pit_sync(ctr->dev);
 
     ctr->using_timer = using_timer;
+
+    pit_schedule(ctr->dev);
 }
 
 
@@ -511,14 +765,9 @@ static void
 pit_timer_over(void *p)
 {
     pit_t *dev = (pit_t *) p;
-    int i;
-
-    dev->clock ^= 1;
-
-    for (i = 0; i < 3; i++)
-	pit_ctr_set_clock_common(&dev->counters[i], dev->clock);
 
-    timer_advance_u64(&dev->callback_timer, PITCONST >> 1ULL);
+    pit_sync(dev);
+    pit_schedule(dev);
 }
 
 
@@ -531,6 +780,8 @@ pit_write(uint16_t addr, uint8_t val, void *priv)
 
     pit_log("[%04X:%08X] pit_write(%04X, %02X, %08X)\n", CS, cpu_state.pc, addr, val, priv);
 
+    pit_sync(dev);
+
     switch (addr & 3) {
 	case 3:		/* control */
 		t = val >> 6;
@@ -627,6 +878,8 @@ pit_write(uint16_t addr, uint8_t val, void *priv)
 		}
 		break;
     }
+
+    pit_schedule(dev);
 }
 
 
@@ -638,6 +891,8 @@ pit_read(uint16_t addr, void *priv)
     int count, t = (addr & 3);
     ctr_t *ctr;
 
+    pit_sync(dev);
+
     switch (addr & 3) {
 	case 3:		/* Control. */
 		/* This is 8254-only, 8253 returns 0x00. */
@@ -813,8 +1068,10 @@ pit_reset(pit_t *dev)
 
     dev->clock = 0;
 
-    for (i = 0; i < 3; i++)
+    for (i = 0; i < 3; i++) {
 	ctr_reset(&dev->counters[i]);
+	dev->counters[i].dev = dev;
+    }
 
     /* Disable speaker gate. */
     dev->counters[2].gate = 0;
@@ -844,6 +1101,38 @@ pit_close(void *priv)
 }
 
 
+static void
+pit_save_state(void *priv, savestate_t *st)
+{
+    pit_t *dev = (pit_t *) priv;
+    int64_t edge = 0;
+    int i;
+
+    if (!st->loading) {
+	pit_sync(dev);
+	edge = (int64_t) (dev->edge_ts - (tsc << 32));
+    }
+
+    savestate_var(st, dev->clock);
+    savestate_var(st, dev->ctrl);
+    savestate_var(st, edge);
+
+    /* The load and out callbacks are machine-specific and not saved. */
+    for (i = 0; i < 3; i++)
+	savestate_data(st, &dev->counters[i], offsetof(ctr_t, load_func));
+
+    if (st->loading && !st->error) {
+	dev->edge_ts = (tsc << 32) + (uint64_t) edge;
+	pit_schedule(dev);
+    }
+
+    if (dev == pit) {
+	savestate_var(st, speakon);
+	savestate_var(st, ppispeakon);
+    }
+}
+
+
 static void *
 pit_init(const device_t *info)
 {
@@ -852,7 +1141,8 @@ pit_init(const device_t *info)
 
     if (!(dev->flags & PIT_PS2) && !(dev->flags & PIT_CUSTOM_CLOCK)) {
 	timer_add(&dev->callback_timer, pit_timer_over, (void *) dev, 0);
-	timer_set_delay_u64(&dev->callback_timer, PITCONST >> 1ULL);
+	dev->edge_ts = (tsc << 32) + (PITCONST >> 1ULL);
+	pit_schedule(dev);
     }
 
     dev->flags = info->local;
@@ -871,7 +1161,8 @@ const device_t i8253_device =
 	PIT_8253,
         pit_init, pit_close, NULL,
         { NULL }, NULL, NULL,
-	NULL
+	NULL,
+	pit_save_state
 };
 
 
@@ -882,7 +1173,8 @@ const device_t i8254_device =
 	PIT_8254,
         pit_init, pit_close, NULL,
         { NULL }, NULL, NULL,
-	NULL
+	NULL,
+	pit_save_state
 };
 
 
@@ -893,7 +1185,8 @@ const device_t i8254_ext_io_device =
 	PIT_8254 | PIT_EXT_IO,
         pit_init, pit_close, NULL,
         { NULL }, NULL, NULL,
-	NULL
+	NULL,
+	pit_save_state
 };
 
 
@@ -904,7 +1197,8 @@ const device_t i8254_ps2_device =
 	PIT_8254 | PIT_PS2 | PIT_EXT_IO,
         pit_init, pit_close, NULL,
         { NULL }, NULL, NULL,
-	NULL
+	NULL,
+	pit_save_state
 };
 
 
@@ -959,6 +1253,12 @@ pit_ps2_init(void)
 void
 pit_set_clock(int clock)
 {
+    /* Bring the counters up to date with the old PIT clock first. */
+    if (pit != NULL)
+	pit_sync(pit);
+    if (pit2 != NULL)
+	pit_sync(pit2);
+
     /* Set default CPU/crystal clock and xt_cpu_multi. */
     if (cpu_s->cpu_type >= CPU_286) {
 	if (clock == 66666666)
@@ -1054,6 +1354,11 @@ pit_set_clock(int clock)
     else
 	SYSCLK = bus_timing * 3.0;
 
+    if (pit != NULL)
+	pit_schedule(pit);
+    if (pit2 != NULL)
+	pit_schedule(pit2);
+
     video_update_timing();
 
     device_speed_changed();
@@ -135,6 +135,14 @@ static dllimp_t ft_imports[] = {
 #define FONT_SCRIPT		4
 #define FONT_OCRA		5
 #define FONT_OCRB		6
+#define FONT_MAX		7
+
+/* Rendered glyphs kept per printer, in a direct-mapped table. */
+#define GLYPH_CACHE_BITS	10
+#define GLYPH_CACHE_SIZE	(1 << GLYPH_CACHE_BITS)
+
+/* Finished pages that may wait for the PNG writer at any time. */
+#define PAGE_QUEUE_MAX		4
 
 /* Font styles. */
 #define STYLE_PROP		0x0001
@@ -197,6 +205,35 @@ typedef struct {
 } psurface_t;
 
 
+/* A rendered glyph, keyed by face, size, slant and code point. */
+typedef struct {
+    uint8_t	valid,
+		font,
+		italic;
+    uint16_t	code,
+		hsize,		/* character size, 26.6 points */
+		vsize;
+
+    int		left,		/* bitmap position relative to the pen */
+		top;
+    long	advance;	/* 26.6 pixels */
+    unsigned	width,
+		rows;
+    uint8_t	*buffer;	/* width * rows grayscale pixels */
+} glyph_t;
+
+
+/* A finished page waiting to be written out as PNG. */
+typedef struct page_job {
+    wchar_t	path[1024];
+    uint8_t	*pixels;
+    uint16_t	w, h, pitch;
+    PALETTE	palcol;
+
+    struct page_job *next;
+} page_job_t;
+
+
 typedef struct {
     const char	*name;
 
@@ -263,6 +300,9 @@ typedef struct {
     double	curr_x, curr_y;		/* print head position (inch) */
     uint16_t	current_font;
     FT_Face	fontface;
+    uint16_t	font_hsize,		/* size and slant of fontface */
+		font_vsize;
+    int8_t	font_italic;
     int8_t	lq_typeface;
     uint16_t	font_style;
     uint8_t	print_quality;
@@ -293,13 +333,38 @@ typedef struct {
     uint8_t	ctrl;
     
     PALETTE	palcol;
+
+    /* Faces stay loaded once used, with the size and slant last set. */
+    FT_Face	faces[FONT_MAX];
+    int8_t	face_failed[FONT_MAX];
+    uint16_t	face_hsize[FONT_MAX],
+		face_vsize[FONT_MAX];
+    int8_t	face_italic[FONT_MAX];
+
+    glyph_t	*glyphs;
+
+    /* Background PNG writer. */
+    thread_t	*page_thread;
+    event_t	*page_event,
+		*page_done_event;
+    mutex_t	*page_mutex;
+    page_job_t	*page_queue;
+    int		page_queued,		/* queued or being written */
+		page_stop;
 } escp_t;
 
 
+static const wchar_t *font_files[FONT_MAX] = {
+    FONT_FILE_DOTMATRIX, FONT_FILE_ROMAN, FONT_FILE_SANSSERIF,
+    FONT_FILE_COURIER, FONT_FILE_SCRIPT, FONT_FILE_OCRA,
+    FONT_FILE_OCRB
+};
+
+
 static void
 update_font(escp_t *dev);
 static void
-blit_glyph(escp_t *dev, unsigned destx, unsigned desty, int8_t add);
+blit_glyph(escp_t *dev, glyph_t *glyph, unsigned destx, unsigned desty, int8_t add);
 static void
 draw_hline(escp_t *dev, unsigned from_x, unsigned to_x, unsigned y, int8_t broken);
 static void
@@ -394,15 +459,90 @@ escp_log(const char *fmt, ...)
 #endif
 
 
+/* Write out finished pages, so the emulated printer never waits for
+   the PNG encoder. */
+static void
+page_thread(void *priv)
+{
+    escp_t *dev = (escp_t *) priv;
+    page_job_t *job;
+    int stop;
+
+    for (;;) {
+	thread_wait_mutex(dev->page_mutex);
+	job = dev->page_queue;
+	if (job != NULL)
+		dev->page_queue = job->next;
+	else
+		thread_reset_event(dev->page_event);
+	stop = dev->page_stop;
+	thread_release_mutex(dev->page_mutex);
+
+	if (job == NULL) {
+		if (stop)
+			break;
+		thread_wait_event(dev->page_event, -1);
+		continue;
+	}
+
+	png_write_rgb(job->path, job->pixels, job->w, job->h, job->pitch, job->palcol);
+	free(job->pixels);
+	free(job);
+
+	thread_wait_mutex(dev->page_mutex);
+	dev->page_queued--;
+	thread_set_event(dev->page_done_event);
+	thread_release_mutex(dev->page_mutex);
+    }
+}
+
+
 /* Dump the current page into a formatted file. */
 static void 
 dump_page(escp_t *dev)
 {
     wchar_t path[1024];
+    page_job_t *job, **tail;
+    uint8_t *pixels = NULL;
 
     wcscpy(path, dev->pagepath);
     wcscat(path, dev->page_fn);
-    png_write_rgb(path, dev->page->pixels, dev->page->w, dev->page->h, dev->page->pitch, dev->palcol);
+
+    /* Hand the page buffer over to the writer, the page gets a new one. */
+    job = (page_job_t *) malloc(sizeof(page_job_t));
+    if ((dev->page_thread != NULL) && (job != NULL))
+	pixels = (uint8_t *) malloc(dev->page->pitch * dev->page->h);
+    if (pixels == NULL) {
+	free(job);
+	png_write_rgb(path, dev->page->pixels, dev->page->w, dev->page->h, dev->page->pitch, dev->palcol);
+	return;
+    }
+
+    memset(job, 0x00, sizeof(page_job_t));
+    wcscpy(job->path, path);
+    job->pixels = dev->page->pixels;
+    job->w = dev->page->w;
+    job->h = dev->page->h;
+    job->pitch = dev->page->pitch;
+    memcpy(job->palcol, dev->palcol, sizeof(PALETTE));
+
+    /* new_page() clears it. */
+    dev->page->pixels = pixels;
+
+    thread_wait_mutex(dev->page_mutex);
+    while (dev->page_queued >= PAGE_QUEUE_MAX) {
+	thread_reset_event(dev->page_done_event);
+	thread_release_mutex(dev->page_mutex);
+	thread_wait_event(dev->page_done_event, -1);
+	thread_wait_mutex(dev->page_mutex);
+    }
+
+    for (tail = &dev->page_queue; *tail != NULL; tail = &(*tail)->next)
+	;
+    *tail = job;
+    dev->page_queued++;
+    thread_set_event(dev->page_event);
+    thread_release_mutex(dev->page_mutex);
 }
 
 
@@ -550,64 +690,81 @@ init_codepage(escp_t *dev, uint16_t num)
 }
 
 
-static void
-update_font(escp_t *dev)
+/* Return the face for a font, loading it on first use. */
+static FT_Face
+get_face(escp_t *dev, int font)
 {
     wchar_t path[1024];
-    wchar_t *fn;
     char temp[1024];
+
+    if ((dev->faces[font] != NULL) || dev->face_failed[font])
+	return(dev->faces[font]);
+
+    /* Create a full pathname for the ROM file. */
+    wcscpy(path, dev->fontpath);
+    plat_path_slash(path);
+    wcscat(path, font_files[font]);
+
+    /* Convert (back) to ANSI for the FreeType API. */
+    wcstombs(temp, path, sizeof(temp));
+
+    escp_log("Temp file=%s\n", temp);
+
+    /* Load the new font. */
+    if (ft_New_Face(ft_lib, temp, 0, &dev->faces[font])) {
+	escp_log("ESC/P: unable to load font '%s'\n", temp);
+	dev->faces[font] = NULL;
+	dev->face_failed[font] = 1;
+    }
+
+    dev->face_hsize[font] = dev->face_vsize[font] = 0;
+    dev->face_italic[font] = 0;
+
+    return(dev->faces[font]);
+}
+
+
+static void
+update_font(escp_t *dev)
+{
     FT_Matrix matrix;
     double hpoints = 10.5;
     double vpoints = 10.5;
+    uint16_t hsize, vsize;
+    int8_t italic;
+    int font;
 
     /* We need the FreeType library. */
     if (ft_lib == NULL)
 	return;
 
-    /* Release current font if we have one. */
-    if (dev->fontface)
-	ft_Done_Face(dev->fontface);
-
     if (dev->print_quality == QUALITY_DRAFT)
-	fn = FONT_FILE_DOTMATRIX;
+	font = FONT_DEFAULT;
     else switch (dev->lq_typeface) {
 	case TYPEFACE_ROMAN:
-		fn = FONT_FILE_ROMAN;
+		font = FONT_ROMAN;
 		break;
 	case TYPEFACE_SANSSERIF:
-		fn = FONT_FILE_SANSSERIF;
+		font = FONT_SANSSERIF;
 		break;
 	case TYPEFACE_COURIER:
-		fn = FONT_FILE_COURIER;
+		font = FONT_COURIER;
 		break;
 	case TYPEFACE_SCRIPT:
-		fn = FONT_FILE_SCRIPT;
+		font = FONT_SCRIPT;
 		break;
 	case TYPEFACE_OCRA:
-		fn = FONT_FILE_OCRA;
+		font = FONT_OCRA;
 		break;
 	case TYPEFACE_OCRB:
-		fn = FONT_FILE_OCRB;
+		font = FONT_OCRB;
 		break;
 	default:
-		fn = FONT_FILE_DOTMATRIX;
+		font = FONT_DEFAULT;
     }
 
-    /* Create a full pathname for the ROM file. */
-    wcscpy(path, dev->fontpath);
-    plat_path_slash(path);
-    wcscat(path, fn);
-
-    /* Convert (back) to ANSI for the FreeType API. */
-    wcstombs(temp, path, sizeof(temp));
-
-    escp_log("Temp file=%s\n", temp);
-
-    /* Load the new font. */
-    if (ft_New_Face(ft_lib, temp, 0, &dev->fontface)) {
-	escp_log("ESC/P: unable to load font '%s'\n", temp);
-	dev->fontface = NULL;
-    }
+    dev->current_font = font;
+    dev->fontface = get_face(dev, font);
 
     if (!dev->multipoint_mode) {
 	dev->actual_cpi = dev->cpi;
@@ -652,19 +809,86 @@ update_font(escp_t *dev)
 	dev->actual_cpi /= 2.0 / 3.0;
     }
 
-    ft_Set_Char_Size(dev->fontface,
-		     (uint16_t)(hpoints * 64), (uint16_t)(vpoints * 64),
-		     dev->dpi, dev->dpi);
-
-    if ((dev->font_style & STYLE_ITALICS) ||
-	(dev->char_tables[dev->curr_char_table] == 0)) {
-	/* Italics transformation. */
-	matrix.xx = 0x10000L;
-	matrix.xy = (FT_Fixed)(0.20 * 0x10000L);
-	matrix.yx = 0;
-	matrix.yy = 0x10000L;
-	ft_Set_Transform(dev->fontface, &matrix, 0);
+    if (dev->fontface == NULL)
+	return;
+
+    hsize = (uint16_t)(hpoints * 64);
+    vsize = (uint16_t)(vpoints * 64);
+    italic = (dev->font_style & STYLE_ITALICS) ||
+	     (dev->char_tables[dev->curr_char_table] == 0);
+
+    /* Only touch the face when the size or slant actually changes. */
+    if ((hsize != dev->face_hsize[font]) || (vsize != dev->face_vsize[font])) {
+	ft_Set_Char_Size(dev->fontface, hsize, vsize, dev->dpi, dev->dpi);
+	dev->face_hsize[font] = hsize;
+	dev->face_vsize[font] = vsize;
+    }
+
+    if (italic != dev->face_italic[font]) {
+	if (italic) {
+		/* Italics transformation. */
+		matrix.xx = 0x10000L;
+		matrix.xy = (FT_Fixed)(0.20 * 0x10000L);
+		matrix.yx = 0;
+		matrix.yy = 0x10000L;
+		ft_Set_Transform(dev->fontface, &matrix, 0);
+	} else
+		ft_Set_Transform(dev->fontface, NULL, NULL);
+	dev->face_italic[font] = italic;
+    }
+
+    dev->font_hsize = hsize;
+    dev->font_vsize = vsize;
+    dev->font_italic = italic;
+}
+
+
+/* Return the rendered glyph for a code point in the current font. */
+static glyph_t *
+get_glyph(escp_t *dev, uint16_t code)
+{
+    FT_GlyphSlot slot = dev->fontface->glyph;
+    glyph_t *glyph;
+    uint32_t hash;
+    unsigned y;
+
+    hash = code ^ (dev->current_font << 16) ^ (dev->font_italic << 19);
+    hash = (hash * 0x9e3779b1) ^ ((dev->font_hsize << 16) | dev->font_vsize);
+    hash = (hash * 0x9e3779b1) >> (32 - GLYPH_CACHE_BITS);
+    glyph = &dev->glyphs[hash];
+
+    if (glyph->valid && (glyph->code == code) && (glyph->font == dev->current_font) &&
+	(glyph->italic == dev->font_italic) && (glyph->hsize == dev->font_hsize) &&
+	(glyph->vsize == dev->font_vsize))
+	return(glyph);
+
+    ft_Load_Glyph(dev->fontface, ft_Get_Char_Index(dev->fontface, code), FT_LOAD_DEFAULT);
+    ft_Render_Glyph(slot, FT_RENDER_MODE_NORMAL);
+
+    if (glyph->buffer != NULL)
+	free(glyph->buffer);
+
+    glyph->valid = 1;
+    glyph->code = code;
+    glyph->font = dev->current_font;
+    glyph->italic = dev->font_italic;
+    glyph->hsize = dev->font_hsize;
+    glyph->vsize = dev->font_vsize;
+    glyph->left = slot->bitmap_left;
+    glyph->top = slot->bitmap_top;
+    glyph->advance = slot->advance.x;
+    glyph->width = slot->bitmap.width;
+    glyph->rows = slot->bitmap.rows;
+    glyph->buffer = NULL;
+
+    if (glyph->width && glyph->rows) {
+	glyph->buffer = (uint8_t *) malloc(glyph->width * glyph->rows);
+	for (y = 0; y < glyph->rows; y++)
+		memcpy(glyph->buffer + y * glyph->width,
+		       slot->bitmap.buffer + y * slot->bitmap.pitch, glyph->width);
     }
+
+    return(glyph);
 }
 
 
@@ -1601,7 +1825,7 @@ process_char(escp_t *dev, uint8_t ch)
 static void
 handle_char(escp_t *dev, uint8_t ch)
 {
-    FT_UInt char_index;
+    glyph_t *glyph;
     uint16_t pen_x, pen_y;
     uint16_t line_start, line_y;
     double x_advance;
@@ -1640,43 +1864,39 @@ handle_char(escp_t *dev, uint8_t ch)
 	ch = 0x20;
 
     /* ok, so we need to print the character now */
-    if (ft_lib) {
-	char_index = ft_Get_Char_Index(dev->fontface, dev->curr_cpmap[ch]);
-	ft_Load_Glyph(dev->fontface, char_index, FT_LOAD_DEFAULT);
-	ft_Render_Glyph(dev->fontface->glyph, FT_RENDER_MODE_NORMAL);
-    }
+    glyph = get_glyph(dev, dev->curr_cpmap[ch]);
 
-    pen_x = PIXX + dev->fontface->glyph->bitmap_left;
-    pen_y = (uint16_t)(PIXY - dev->fontface->glyph->bitmap_top + dev->fontface->size->metrics.ascender / 64);
+    pen_x = PIXX + glyph->left;
+    pen_y = (uint16_t)(PIXY - glyph->top + dev->fontface->size->metrics.ascender / 64);
 
     if (dev->font_style & STYLE_SUBSCRIPT)
-	pen_y += dev->fontface->glyph->bitmap.rows / 2;
+	pen_y += glyph->rows / 2;
 
     /* mark the page as dirty if anything is drawn */
     if ((ch != 0x20) || (dev->font_score != SCORE_NONE))
 	dev->page->dirty = 1;
  
     /* draw the glyph */
-    blit_glyph(dev, pen_x, pen_y, 0);
-    blit_glyph(dev, pen_x + 1, pen_y, 1);
+    blit_glyph(dev, glyph, pen_x, pen_y, 0);
+    blit_glyph(dev, glyph, pen_x + 1, pen_y, 1);
 
     /* doublestrike -> draw glyph a second time, 1px below */
     if (dev->font_style & STYLE_DOUBLESTRIKE) {
-	blit_glyph(dev, pen_x, pen_y + 1, 1);
-	blit_glyph(dev, pen_x + 1, pen_y + 1, 1);
+	blit_glyph(dev, glyph, pen_x, pen_y + 1, 1);
+	blit_glyph(dev, glyph, pen_x + 1, pen_y + 1, 1);
     }
 
     /* bold -> draw glyph a second time, 1px to the right */
     if (dev->font_style & STYLE_BOLD) {
-	blit_glyph(dev, pen_x + 1, pen_y, 1);
-	blit_glyph(dev, pen_x + 2, pen_y, 1);
-	blit_glyph(dev, pen_x + 3, pen_y, 1);
+	blit_glyph(dev, glyph, pen_x + 1, pen_y, 1);
+	blit_glyph(dev, glyph, pen_x + 2, pen_y, 1);
+	blit_glyph(dev, glyph, pen_x + 3, pen_y, 1);
     }
 
     line_start = PIXX;
 
     if (dev->font_style & STYLE_PROP)
-	x_advance = dev->fontface->glyph->advance.x / (dev->dpi * 64.0);
+	x_advance = glyph->advance / (dev->dpi * 64.0);
     else {
 	if (dev->hmi < 0)
 		x_advance = 1.0 / dev->actual_cpi;
@@ -1716,9 +1936,8 @@ handle_char(escp_t *dev, uint8_t ch)
 
 /* TODO: This can be optimized quite a bit... I'm just too lazy right now ;-) */
 static void
-blit_glyph(escp_t *dev, unsigned destx, unsigned desty, int8_t add)
+blit_glyph(escp_t *dev, glyph_t *glyph, unsigned destx, unsigned desty, int8_t add)
 {
-    FT_Bitmap *bitmap = &dev->fontface->glyph->bitmap;
     unsigned x, y;
     uint8_t src, *dst;
 
@@ -1726,9 +1945,9 @@ blit_glyph(escp_t *dev, unsigned destx, unsigned desty, int8_t add)
     if (ft_lib == NULL)
 	return;
 
-    for (y = 0; y < bitmap->rows; y++) {
-	for (x = 0; x < bitmap->width; x++) {
-		src = *(bitmap->buffer + x + y * bitmap->pitch);
+    for (y = 0; y < glyph->rows; y++) {
+	for (x = 0; x < glyph->width; x++) {
+		src = *(glyph->buffer + x + y * glyph->width);
 		/* ignore background, and respect page size */
 		if (src > 0 && (destx + x < (unsigned)dev->page->w) && (desty + y < (unsigned)dev->page->h)) {
 			dst = (uint8_t *)dev->page->pixels + (x + destx) + (y + desty) * dev->page->pitch;
@@ -2113,6 +2332,14 @@ escp_init(void *lpt)
     dev->fontface = 0;
     dev->autofeed = 0;
 
+    dev->glyphs = (glyph_t *)malloc(GLYPH_CACHE_SIZE * sizeof(glyph_t));
+    memset(dev->glyphs, 0x00, GLYPH_CACHE_SIZE * sizeof(glyph_t));
+
+    dev->page_mutex = thread_create_mutex();
+    dev->page_event = thread_create_event();
+    dev->page_done_event = thread_create_event();
+    dev->page_thread = thread_create(page_thread, dev);
+
     reset_printer(dev);
 
     escp_log("ESC/P: created a virtual page of dimensions %d x %d pixels.\n",
@@ -2129,6 +2356,7 @@ static void
 escp_close(void *priv)
 {
     escp_t *dev = (escp_t *)priv;
+    int i;
 
     if (dev == NULL) return;
 
@@ -2142,6 +2370,29 @@ escp_close(void *priv)
 	free(dev->page);
     }
 
+    /* Let the writer finish the queued pages. */
+    if (dev->page_thread != NULL) {
+	thread_wait_mutex(dev->page_mutex);
+	dev->page_stop = 1;
+	thread_set_event(dev->page_event);
+	thread_release_mutex(dev->page_mutex);
+	thread_wait(dev->page_thread, -1);
+    }
+    thread_destroy_event(dev->page_event);
+    thread_destroy_event(dev->page_done_event);
+    thread_close_mutex(dev->page_mutex);
+
+    for (i = 0; i < GLYPH_CACHE_SIZE; i++) {
+	if (dev->glyphs[i].buffer != NULL)
+		free(dev->glyphs[i].buffer);
+    }
+    free(dev->glyphs);
+
+    for (i = 0; i < FONT_MAX; i++) {
+	if (dev->faces[i] != NULL)
+		ft_Done_Face(dev->faces[i]);
+    }
+
     free(dev);
 }
 
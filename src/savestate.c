@@ -0,0 +1,421 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Machine save state module.
+ *
+ *		The file starts with a header identifying the machine it
+ *		was taken from, followed by one section per component:
+ *
+ *		  timer	 TSC and the timer time base
+ *		  cpu	 CPU and FPU registers, MSR's
+ *		  mem	 RAM contents and memory state
+ *		  pic	 both interrupt controllers
+ *		  dma	 both DMA controllers and the page registers
+ *		  devNNN device slot NNN, for devices that have a
+ *			 save_state hook
+ *
+ *		A state can only be restored into a machine with the same
+ *		configuration, so that the same devices end up in the same
+ *		slots; the header and the device names are checked for this.
+ *		Devices without a hook are listed in the log when a state is
+ *		written and keep their current state on load; no state is
+ *		written while the video card or disk controller lacks one.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/timer.h>
+#include <86box/device.h>
+#include <86box/machine.h>
+#include <86box/mem.h>
+#include <86box/pic.h>
+#include <86box/dma.h>
+#include <86box/hdc.h>
+#include <86box/video.h>
+#include <86box/plat.h>
+#include <86box/savestate.h>
+
+
+typedef struct {
+    char	magic[8];
+    uint32_t	version,
+		mem_size;
+    char	machine[64],
+		cpu[64];
+} savestate_header_t;
+
+
+#ifdef ENABLE_SAVESTATE_LOG
+int savestate_do_log = ENABLE_SAVESTATE_LOG;
+
+
+static void
+savestate_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (savestate_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define savestate_log(fmt, ...)
+#endif
+
+
+void
+savestate_data(savestate_t *st, void *data, uint32_t len)
+{
+    uint64_t new_size;
+
+    if (st->error)
+	return;
+
+    if (((uint64_t) st->pos + len) > 0xffffffffULL) {
+	savestate_fail(st, "section too large");
+	return;
+    }
+
+    if (st->loading) {
+	if ((st->pos + len) > st->len) {
+		savestate_fail(st, "section too short");
+		return;
+	}
+	memcpy(data, st->buf + st->pos, len);
+    } else {
+	if ((st->pos + len) > st->size) {
+		new_size = ((uint64_t) st->pos + len) << 1;
+		if (new_size < 65536)
+			new_size = 65536;
+		if (new_size > 0xffffffffULL)
+			new_size = 0xffffffffULL;
+		st->size = (uint32_t) new_size;
+		st->buf = (uint8_t *) realloc(st->buf, st->size);
+		if (st->buf == NULL) {
+			savestate_fail(st, "out of memory");
+			return;
+		}
+	}
+	memcpy(st->buf + st->pos, data, len);
+	st->len = st->pos + len;
+    }
+
+    st->pos += len;
+}
+
+
+/* Timers are stored relative to the TSC, so the "timer" section must be
+   restored before any section that contains timers. */
+void
+savestate_timer(savestate_t *st, pc_timer_t *timer)
+{
+    int64_t remaining = 0;
+    int enabled = 0, split = 0;
+
+    if (!st->loading) {
+	enabled = timer_is_enabled(timer);
+	split = !!(timer->flags & TIMER_SPLIT);
+	remaining = (int64_t) (timer->ts.ts64 - (tsc << 32));
+    }
+
+    savestate_var(st, enabled);
+    savestate_var(st, split);
+    savestate_var(st, remaining);
+    savestate_var(st, timer->period);
+
+    if (st->loading && !st->error) {
+	timer_disable(timer);
+	timer->ts.ts64 = (tsc << 32) + (uint64_t) remaining;
+	if (split)
+		timer->flags |= TIMER_SPLIT;
+	else
+		timer->flags &= ~TIMER_SPLIT;
+	if (enabled)
+		timer_enable(timer);
+    }
+}
+
+
+void
+savestate_fail(savestate_t *st, const char *reason)
+{
+    if (!st->error)
+	pclog("SAVESTATE: section \"%s\": %s\n", st->name, reason);
+
+    st->error = 1;
+}
+
+
+static void
+timer_save_state(savestate_t *st)
+{
+    uint64_t new_tsc = tsc;
+
+    savestate_var(st, new_tsc);
+
+    /* Move every timer that is not part of the state along with the
+       TSC, so that they keep their remaining time. */
+    if (st->loading && !st->error)
+	timer_set_tsc(new_tsc);
+}
+
+
+static void
+savestate_begin(savestate_t *st, const char *name, uint32_t version)
+{
+    memset(st->name, 0x00, sizeof(st->name));
+    strncpy(st->name, name, sizeof(st->name) - 1);
+    st->version = version;
+    st->pos = st->len = 0;
+}
+
+
+static void
+savestate_end(savestate_t *st)
+{
+    if (st->error)
+	return;
+
+    if ((fwrite(st->name, 1, SAVESTATE_NAME_LEN, st->f) != SAVESTATE_NAME_LEN) ||
+	(fwrite(&st->version, 1, 4, st->f) != 4) ||
+	(fwrite(&st->len, 1, 4, st->f) != 4) ||
+	(fwrite(st->buf, 1, st->len, st->f) != st->len))
+	savestate_fail(st, "write error");
+
+    savestate_log("SAVESTATE: wrote section \"%s\" (%i bytes)\n", st->name, st->len);
+}
+
+
+static void
+savestate_section(savestate_t *st, const char *name, void (*func)(savestate_t *st))
+{
+    if (st->error)
+	return;
+
+    savestate_begin(st, name, SAVESTATE_VERSION);
+    func(st);
+    savestate_end(st);
+}
+
+
+static void
+savestate_devices(savestate_t *st)
+{
+    char name[SAVESTATE_NAME_LEN];
+    const device_t *dev;
+    int c;
+
+    /* A device that is not saved comes back in whatever state it is in
+       at load time. That is harmless for most of them, as the memory
+       mappings a chipset sets up are part of the memory state, but the
+       video card and the disk controller would lose guest data, so no
+       state is written while either of them lacks a hook. */
+    for (c = 0; c < DEVICE_MAX; c++) {
+	dev = device_get_unsaved(c);
+	if (dev == NULL)
+		continue;
+
+	if ((dev == video_card_getdevice(gfxcard)) || (dev == hdc_get_device(hdc_current))) {
+		pclog("SAVESTATE: device \"%s\" does not support save states\n", dev->name);
+		st->error = 1;
+	} else
+		pclog("SAVESTATE: device \"%s\" is not saved\n", dev->name);
+    }
+
+    for (c = 0; (c < DEVICE_MAX) && !st->error; c++) {
+	if (!device_has_state(c))
+		continue;
+
+	sprintf(name, "dev%03i", c);
+	savestate_begin(st, name, SAVESTATE_VERSION);
+	device_save_state(c, st);
+	savestate_end(st);
+    }
+}
+
+
+static void
+savestate_header_fill(savestate_header_t *hdr)
+{
+    memset(hdr, 0x00, sizeof(savestate_header_t));
+    memcpy(hdr->magic, SAVESTATE_MAGIC, 8);
+    hdr->version = SAVESTATE_VERSION;
+    hdr->mem_size = mem_size;
+    strncpy(hdr->machine, machine_get_internal_name(), sizeof(hdr->machine) - 1);
+    strncpy(hdr->cpu, cpu_s->name, sizeof(hdr->cpu) - 1);
+}
+
+
+int
+savestate_save(wchar_t *fn)
+{
+    savestate_header_t hdr;
+    savestate_t st;
+
+    memset(&st, 0x00, sizeof(savestate_t));
+
+    st.f = plat_fopen(fn, L"wb");
+    if (st.f == NULL) {
+	pclog("SAVESTATE: unable to create '%ls'\n", fn);
+	return(0);
+    }
+
+    savestate_header_fill(&hdr);
+    if (fwrite(&hdr, 1, sizeof(hdr), st.f) != sizeof(hdr))
+	st.error = 1;
+
+    savestate_section(&st, "timer", timer_save_state);
+    savestate_section(&st, "cpu", cpu_save_state);
+    savestate_section(&st, "mem", mem_save_state);
+    savestate_section(&st, "pic", pic_save_state);
+    savestate_section(&st, "dma", dma_save_state);
+    savestate_devices(&st);
+
+    fclose(st.f);
+    free(st.buf);
+
+    if (st.error)
+	pclog("SAVESTATE: failed to save state to '%ls'\n", fn);
+    else
+	pclog("SAVESTATE: state saved to '%ls'\n", fn);
+
+    return(!st.error);
+}
+
+
+static void
+savestate_load_section(savestate_t *st, uint8_t *restored)
+{
+    int c;
+
+    if (!strcmp(st->name, "timer"))
+	timer_save_state(st);
+    else if (!strcmp(st->name, "cpu"))
+	cpu_save_state(st);
+    else if (!strcmp(st->name, "mem"))
+	mem_save_state(st);
+    else if (!strcmp(st->name, "pic"))
+	pic_save_state(st);
+    else if (!strcmp(st->name, "dma"))
+	dma_save_state(st);
+    else if ((sscanf(st->name, "dev%03i", &c) == 1) && (c >= 0) && (c < DEVICE_MAX) && device_has_state(c)) {
+	device_save_state(c, st);
+	restored[c] = 1;
+    } else
+	savestate_fail(st, "unknown section");
+
+    if (!st->error && (st->pos != st->len))
+	savestate_fail(st, "section size mismatch");
+}
+
+
+int
+savestate_load(wchar_t *fn)
+{
+    savestate_header_t hdr, cur;
+    savestate_t st;
+    uint8_t restored[DEVICE_MAX];
+    int c;
+
+    memset(&st, 0x00, sizeof(savestate_t));
+    memset(restored, 0x00, sizeof(restored));
+    st.loading = 1;
+
+    st.f = plat_fopen(fn, L"rb");
+    if (st.f == NULL) {
+	pclog("SAVESTATE: unable to open '%ls'\n", fn);
+	return(0);
+    }
+
+    savestate_header_fill(&cur);
+    if ((fread(&hdr, 1, sizeof(hdr), st.f) != sizeof(hdr)) ||
+	memcmp(hdr.magic, cur.magic, 8) || (hdr.version > SAVESTATE_VERSION)) {
+	pclog("SAVESTATE: '%ls' is not a valid state file\n", fn);
+	fclose(st.f);
+	return(0);
+    }
+
+    if ((hdr.mem_size != cur.mem_size) || strncmp(hdr.machine, cur.machine, sizeof(hdr.machine)) ||
+	strncmp(hdr.cpu, cur.cpu, sizeof(hdr.cpu))) {
+	pclog("SAVESTATE: '%ls' was taken from a different machine configuration\n", fn);
+	fclose(st.f);
+	return(0);
+    }
+
+    while (!st.error) {
+	memset(st.name, 0x00, sizeof(st.name));
+	if (fread(st.name, 1, SAVESTATE_NAME_LEN, st.f) != SAVESTATE_NAME_LEN)
+		break;
+	st.name[SAVESTATE_NAME_LEN - 1] = '\0';
+
+	if ((fread(&st.version, 1, 4, st.f) != 4) || (fread(&st.len, 1, 4, st.f) != 4)) {
+		savestate_fail(&st, "truncated header");
+		break;
+	}
+
+	if (st.len > st.size) {
+		st.size = st.len;
+		st.buf = (uint8_t *) realloc(st.buf, st.size);
+		if (st.buf == NULL) {
+			savestate_fail(&st, "out of memory");
+			break;
+		}
+	}
+
+	if (fread(st.buf, 1, st.len, st.f) != st.len) {
+		savestate_fail(&st, "truncated data");
+		break;
+	}
+
+	if (st.version > SAVESTATE_VERSION) {
+		savestate_fail(&st, "unsupported version");
+		break;
+	}
+
+	st.pos = 0;
+	savestate_load_section(&st, restored);
+
+	savestate_log("SAVESTATE: read section \"%s\" (%i bytes)\n", st.name, st.len);
+    }
+
+    /* Every device that can be saved must have been restored. */
+    for (c = 0; (c < DEVICE_MAX) && !st.error; c++) {
+	if (device_has_state(c) && !restored[c]) {
+		sprintf(st.name, "dev%03i", c);
+		savestate_fail(&st, "missing from the state");
+	}
+    }
+
+    fclose(st.f);
+    free(st.buf);
+
+    if (st.error) {
+	/* The machine is now in an undefined state, start it over. */
+	pclog("SAVESTATE: failed to restore state from '%ls', resetting\n", fn);
+	pc_reset_hard();
+	return(0);
+    }
+
+    /* Translated code and lookups are rebuilt on demand. */
+    flushmmucache();
+#ifdef USE_DYNAREC
+    codegen_reset();
+#endif
+
+    pclog("SAVESTATE: state restored from '%ls'\n", fn);
+
+    return(1);
+}
@@ -514,6 +514,8 @@ uint8_t adgold_read(uint16_t addr, void *p)
 
 void adgold_update(adgold_t *adgold)
 {
+        sound_update_pos();
+
         for (; adgold->pos < sound_pos_global; adgold->pos++)
         {
                 adgold->mma_buffer[0][adgold->pos] = adgold->mma_buffer[1][adgold->pos] = 0;
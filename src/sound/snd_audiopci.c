@@ -8,6 +8,7 @@
 #define HAVE_STDARG_H
 #include <86box/86box.h>
 #include <86box/device.h>
+#include <86box/dma.h>
 #include <86box/io.h>
 #include <86box/nmi.h>
 #include <86box/mem.h>
@@ -1020,85 +1021,57 @@ static void es1371_fetch(es1371_t *es1371, int dac_nr)
 {
 	int format = dac_nr ? ((es1371->si_cr >> 2) & 3) : (es1371->si_cr & 3);
 	int pos = es1371->dac[dac_nr].buffer_pos & 63;
-	int c;
+	uint8_t data[32];
+	int c, n;
+
+	/* Fetch up to 32 bytes, stopping at the end of the buffer, with a
+	   single bus master read. */
+	n = (format == FORMAT_STEREO_16) ? 4 : 8;
+	if (es1371->dac[dac_nr].count <= es1371->dac[dac_nr].size)
+		n = MIN(n, es1371->dac[dac_nr].size - es1371->dac[dac_nr].count + 1);
+	else
+		n = 1;
 
 //audiopci_log("Fetch format=%i %08x %08x  %08x %08x  %08x\n", format, es1371->dac[dac_nr].count, es1371->dac[dac_nr].size,  es1371->dac[dac_nr].curr_samp_ct,es1371->dac[dac_nr].samp_ct, es1371->dac[dac_nr].addr);
+	dma_bm_read(es1371->dac[dac_nr].addr, data, n << 2, 4);
+
 	switch (format)
 	{
 		case FORMAT_MONO_8:
-		for (c = 0; c < 32; c += 4)
-		{
-			es1371->dac[dac_nr].buffer_l[(pos+c)   & 63] = es1371->dac[dac_nr].buffer_r[(pos+c)   & 63] = (mem_readb_phys(es1371->dac[dac_nr].addr) ^ 0x80) << 8;
-			es1371->dac[dac_nr].buffer_l[(pos+c+1) & 63] = es1371->dac[dac_nr].buffer_r[(pos+c+1) & 63] = (mem_readb_phys(es1371->dac[dac_nr].addr+1) ^ 0x80) << 8;
-			es1371->dac[dac_nr].buffer_l[(pos+c+2) & 63] = es1371->dac[dac_nr].buffer_r[(pos+c+2) & 63] = (mem_readb_phys(es1371->dac[dac_nr].addr+2) ^ 0x80) << 8;
-			es1371->dac[dac_nr].buffer_l[(pos+c+3) & 63] = es1371->dac[dac_nr].buffer_r[(pos+c+3) & 63] = (mem_readb_phys(es1371->dac[dac_nr].addr+3) ^ 0x80) << 8;
-			es1371->dac[dac_nr].addr += 4;
-	
-			es1371->dac[dac_nr].buffer_pos_end += 4;
-			es1371->dac[dac_nr].count++;
-			if (es1371->dac[dac_nr].count > es1371->dac[dac_nr].size)
-			{
-				es1371->dac[dac_nr].count = 0;
-				es1371->dac[dac_nr].addr = es1371->dac[dac_nr].addr_latch;
-				break;
-			}
-		}
+		for (c = 0; c < (n << 2); c++)
+			es1371->dac[dac_nr].buffer_l[(pos+c) & 63] = es1371->dac[dac_nr].buffer_r[(pos+c) & 63] = (data[c] ^ 0x80) << 8;
+		es1371->dac[dac_nr].buffer_pos_end += (n << 2);
 		break;
 		case FORMAT_STEREO_8:
-		for (c = 0; c < 16; c += 2)
+		for (c = 0; c < (n << 1); c++)
 		{
-			es1371->dac[dac_nr].buffer_l[(pos+c)   & 63] = (mem_readb_phys(es1371->dac[dac_nr].addr) ^ 0x80) << 8;
-			es1371->dac[dac_nr].buffer_r[(pos+c)   & 63] = (mem_readb_phys(es1371->dac[dac_nr].addr + 1) ^ 0x80) << 8;
-			es1371->dac[dac_nr].buffer_l[(pos+c+1) & 63] = (mem_readb_phys(es1371->dac[dac_nr].addr + 2) ^ 0x80) << 8;
-			es1371->dac[dac_nr].buffer_r[(pos+c+1) & 63] = (mem_readb_phys(es1371->dac[dac_nr].addr + 3) ^ 0x80) << 8;
-			es1371->dac[dac_nr].addr += 4;
-	
-			es1371->dac[dac_nr].buffer_pos_end += 2;
-			es1371->dac[dac_nr].count++;
-			if (es1371->dac[dac_nr].count > es1371->dac[dac_nr].size)
-			{
-				es1371->dac[dac_nr].count = 0;
-				es1371->dac[dac_nr].addr = es1371->dac[dac_nr].addr_latch;
-				break;
-			}
+			es1371->dac[dac_nr].buffer_l[(pos+c) & 63] = (data[c << 1] ^ 0x80) << 8;
+			es1371->dac[dac_nr].buffer_r[(pos+c) & 63] = (data[(c << 1) + 1] ^ 0x80) << 8;
 		}
+		es1371->dac[dac_nr].buffer_pos_end += (n << 1);
 		break;
 		case FORMAT_MONO_16:
-		for (c = 0; c < 16; c += 2)
-		{
-			es1371->dac[dac_nr].buffer_l[(pos+c)   & 63] = es1371->dac[dac_nr].buffer_r[(pos+c)   & 63] = mem_readw_phys(es1371->dac[dac_nr].addr);
-			es1371->dac[dac_nr].buffer_l[(pos+c+1) & 63] = es1371->dac[dac_nr].buffer_r[(pos+c+1) & 63] = mem_readw_phys(es1371->dac[dac_nr].addr + 2);
-			es1371->dac[dac_nr].addr += 4;
-
-			es1371->dac[dac_nr].buffer_pos_end += 2;
-			es1371->dac[dac_nr].count++;
-			if (es1371->dac[dac_nr].count > es1371->dac[dac_nr].size)
-			{
-				es1371->dac[dac_nr].count = 0;
-				es1371->dac[dac_nr].addr = es1371->dac[dac_nr].addr_latch;
-				break;
-			}
-		}
+		for (c = 0; c < (n << 1); c++)
+			es1371->dac[dac_nr].buffer_l[(pos+c) & 63] = es1371->dac[dac_nr].buffer_r[(pos+c) & 63] = data[c << 1] | (data[(c << 1) + 1] << 8);
+		es1371->dac[dac_nr].buffer_pos_end += (n << 1);
 		break;
 		case FORMAT_STEREO_16:
-		for (c = 0; c < 4; c++)
+		for (c = 0; c < n; c++)
 		{
-			es1371->dac[dac_nr].buffer_l[(pos+c) & 63] = mem_readw_phys(es1371->dac[dac_nr].addr);
-			es1371->dac[dac_nr].buffer_r[(pos+c) & 63] = mem_readw_phys(es1371->dac[dac_nr].addr + 2);
-//			audiopci_log("Fetch %02x %08x  %04x %04x\n", (pos+c) & 63, es1371->dac[dac_nr].addr, es1371->dac[dac_nr].buffer_l[(pos+c) & 63], es1371->dac[dac_nr].buffer_r[(pos+c) & 63]);
-			es1371->dac[dac_nr].addr += 4;
-	
-			es1371->dac[dac_nr].buffer_pos_end++;
-			es1371->dac[dac_nr].count++;
-			if (es1371->dac[dac_nr].count > es1371->dac[dac_nr].size)
-			{
-				es1371->dac[dac_nr].count = 0;
-				es1371->dac[dac_nr].addr = es1371->dac[dac_nr].addr_latch;
-				break;
-			}
+			es1371->dac[dac_nr].buffer_l[(pos+c) & 63] = data[c << 2] | (data[(c << 2) + 1] << 8);
+			es1371->dac[dac_nr].buffer_r[(pos+c) & 63] = data[(c << 2) + 2] | (data[(c << 2) + 3] << 8);
 		}
+		es1371->dac[dac_nr].buffer_pos_end += n;
 		break;
 	}
+
+	es1371->dac[dac_nr].addr += (n << 2);
+	es1371->dac[dac_nr].count += n;
+	if (es1371->dac[dac_nr].count > es1371->dac[dac_nr].size)
+	{
+		es1371->dac[dac_nr].count = 0;
+		es1371->dac[dac_nr].addr = es1371->dac[dac_nr].addr_latch;
+	}
 }
 
 static inline float low_fir_es1371(int dac_nr, int i, float NewSample)
@@ -1187,6 +1160,8 @@ static void es1371_update(es1371_t *es1371)
         else if (r > 32767)
                 r = 32767;
 
+        sound_update_pos();
+
         for (; es1371->pos < sound_pos_global; es1371->pos++)
         {                                        
                 es1371->buffer[es1371->pos*2]     = l;
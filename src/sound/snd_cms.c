@@ -37,6 +37,8 @@ typedef struct cms_t
 
 void cms_update(cms_t *cms)
 {
+        sound_update_pos();
+
         for (; cms->pos < sound_pos_global; cms->pos++)
         {
                 int c, d;
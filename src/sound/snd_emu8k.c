@@ -1726,7 +1726,10 @@ int32_t emu8k_vol_slide(emu8k_slide_t* slide, int32_t target)
 //int32_t old_vol[32]={0};
 void emu8k_update(emu8k_t *emu8k)
 {
-        int new_pos = (sound_pos_global * 44100) / 48000;
+        int new_pos;
+
+        sound_update_pos();
+        new_pos = (sound_pos_global * 44100) / 48000;
         if (emu8k->pos >= new_pos)
                 return;
 
@@ -894,6 +894,8 @@ void gus_poll_timer_2(void *p)
 
 static void gus_update(gus_t *gus)
 {
+        sound_update_pos();
+
         for (; gus->pos < sound_pos_global; gus->pos++)
         {
                 if (gus->out_l < -32768)
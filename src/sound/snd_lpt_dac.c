@@ -26,6 +26,8 @@ typedef struct lpt_dac_t
 
 static void dac_update(lpt_dac_t *lpt_dac)
 {
+        sound_update_pos();
+
         for (; lpt_dac->pos < sound_pos_global; lpt_dac->pos++)
         {
                 lpt_dac->buffer[0][lpt_dac->pos] = (int8_t)(lpt_dac->dac_val_l ^ 0x80) * 0x40;
@@ -257,6 +257,8 @@ opl2_init(opl_t *dev)
 void
 opl2_update(opl_t *dev)
 {
+    sound_update_pos();
+
     if (dev->pos >= sound_pos_global)
 	return;
 
@@ -307,6 +309,8 @@ opl3_init(opl_t *dev)
 void
 opl3_update(opl_t *dev)
 {
+    sound_update_pos();
+
     if (dev->pos >= sound_pos_global)
 	return;
 
@@ -692,6 +692,8 @@ static void pas16_out_base(uint16_t port, uint8_t val, void *p)
 
 static void pas16_update(pas16_t *pas16)
 {
+        sound_update_pos();
+
         if (!(pas16->audiofilt & PAS16_FILT_MUTE))
         {
                 for (; pas16->pos < sound_pos_global; pas16->pos++)
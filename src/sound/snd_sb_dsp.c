@@ -1436,6 +1436,8 @@ sb_poll_i(void *p)
 
 void sb_dsp_update(sb_dsp_t *dsp)
 {
+    sound_update_pos();
+
     if (dsp->muted) {
 	dsp->sbdatl = 0;
 	dsp->sbdatr = 0;
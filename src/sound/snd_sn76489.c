@@ -24,6 +24,8 @@ static float volslog[16]=
 
 void sn76489_update(sn76489_t *sn76489)
 {
+        sound_update_pos();
+
         for (; sn76489->pos < sound_pos_global; sn76489->pos++)
         {
                 int c;
@@ -54,6 +54,8 @@ speaker_update(void)
     int32_t val;
     double amplitude;
 
+    sound_update_pos();
+
     amplitude = ((speaker_count / 64.0) * 10240.0) - 5120.0;
 
     if (amplitude > 5120.0)
@@ -21,6 +21,8 @@ typedef struct ssi2001_t
 
 static void ssi2001_update(ssi2001_t *ssi2001)
 {
+        sound_update_pos();
+
         if (ssi2001->pos >= sound_pos_global)
                 return;
         
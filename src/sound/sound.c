@@ -54,6 +54,8 @@ typedef struct {
 int sound_card_current = 0;
 int sound_pos_global = 0;
 int sound_gain = 0;
+int sound_output = SOUND_OUTPUT_OPENAL;
+char sound_wav_path[512] = { '\0' };
 
 
 static sound_handler_t sound_handlers[8];
@@ -67,6 +69,11 @@ static int16_t *outbuffer_ex_int16;
 static int sound_handlers_num;
 static pc_timer_t sound_poll_timer;
 static uint64_t sound_poll_latch;
+static int sound_pos_base = 0;
+static FILE *sound_wav_f = NULL;
+static uint32_t sound_wav_len = 0;
+static char sound_wav_open_path[512];
+static int sound_wav_float;
 
 static int16_t cd_buffer[CDROM_NUM][CD_BUFLEN * 2];
 static float cd_out_buffer[CD_BUFLEN * 2];
@@ -384,16 +391,154 @@ sound_set_cd_audio_filter(void (*filter)(int channel, double *buffer, void *p),
 }
 
 
+/* Bring sound_pos_global up to the current emulated time. The poll timer
+   only fires once every SOUND_POLL_SAMPLES samples, so devices call this
+   before rendering up to sound_pos_global, which gives them the exact
+   sample the guest is at when it writes to a register. */
+void
+sound_update_pos(void)
+{
+    uint64_t elapsed, period;
+    int pos;
+
+    if (!timer_is_enabled(&sound_poll_timer) || !sound_poll_latch)
+	return;
+
+    period = sound_poll_latch * SOUND_POLL_SAMPLES;
+    elapsed = period - timer_get_remaining_u64(&sound_poll_timer);
+    if (elapsed > period)
+	elapsed = period;
+
+    pos = (int) (elapsed / sound_poll_latch);
+    if (pos > SOUND_POLL_SAMPLES)
+	pos = SOUND_POLL_SAMPLES;
+
+    if ((sound_pos_base + pos) > sound_pos_global)
+	sound_pos_global = sound_pos_base + pos;
+}
+
+
+static void
+sound_wav_write_header(void)
+{
+    uint8_t hdr[44];
+    uint16_t fmt = sound_wav_float ? 3 : 1;
+    uint16_t bits = sound_wav_float ? 32 : 16;
+    uint32_t rate = 48000, bps = rate * 2 * (bits >> 3);
+    uint16_t align = 2 * (bits >> 3), chans = 2;
+    uint32_t riff = sound_wav_len + 36, fmt_len = 16;
+
+    memcpy(&hdr[0], "RIFF", 4);
+    memcpy(&hdr[4], &riff, 4);
+    memcpy(&hdr[8], "WAVEfmt ", 8);
+    memcpy(&hdr[16], &fmt_len, 4);
+    memcpy(&hdr[20], &fmt, 2);
+    memcpy(&hdr[22], &chans, 2);
+    memcpy(&hdr[24], &rate, 4);
+    memcpy(&hdr[28], &bps, 4);
+    memcpy(&hdr[32], &align, 2);
+    memcpy(&hdr[34], &bits, 2);
+    memcpy(&hdr[36], "data", 4);
+    memcpy(&hdr[40], &sound_wav_len, 4);
+
+    fseek(sound_wav_f, 0, SEEK_SET);
+    fwrite(hdr, 1, sizeof(hdr), sound_wav_f);
+    fseek(sound_wav_f, 0, SEEK_END);
+}
+
+
+void
+sound_wav_close(void)
+{
+    if (sound_wav_f != NULL) {
+	sound_wav_write_header();
+	fclose(sound_wav_f);
+	sound_wav_f = NULL;
+    }
+}
+
+
+/* The capture is kept open across hard resets, so that it covers the
+   whole session; it is only started over when its file or its sample
+   format changes. */
+static void
+sound_wav_open(void)
+{
+    if (sound_wav_f != NULL) {
+	if (!strcmp(sound_wav_open_path, sound_wav_path) && (sound_wav_float == sound_is_float))
+		return;
+	sound_wav_close();
+    }
+
+    if (sound_wav_path[0] == '\0')
+	return;
+
+    sound_wav_f = fopen(sound_wav_path, "wb");
+    if (sound_wav_f == NULL) {
+	sound_log("SOUND: unable to create '%s'\n", sound_wav_path);
+	return;
+    }
+    strcpy(sound_wav_open_path, sound_wav_path);
+    sound_wav_float = sound_is_float;
+
+    /* The sizes are patched in whenever the output is closed. */
+    sound_wav_len = 0;
+    sound_wav_write_header();
+}
+
+
+void
+sound_output_close(void)
+{
+    /* Only bring the WAV header up to date, see sound_wav_open(). */
+    if (sound_wav_f != NULL) {
+	sound_wav_write_header();
+	fflush(sound_wav_f);
+    }
+
+    closeal();
+}
+
+
+static void
+sound_give_buffer(void *buf)
+{
+    uint32_t len;
+
+    switch (sound_output) {
+	case SOUND_OUTPUT_OPENAL:
+		givealbuffer(buf);
+		break;
+
+	case SOUND_OUTPUT_WAV:
+		if (sound_wav_f == NULL)
+			break;
+		len = SOUNDBUFLEN * 2 * (sound_wav_float ? sizeof(float) : sizeof(int16_t));
+		if (fwrite(buf, 1, len, sound_wav_f) == len)
+			sound_wav_len += len;
+		break;
+
+	default:
+		break;
+    }
+}
+
+
 void
 sound_poll(void *priv)
 {
-    timer_advance_u64(&sound_poll_timer, sound_poll_latch);
+    int c;
 
-    midi_poll();
+    timer_advance_u64(&sound_poll_timer, sound_poll_latch * SOUND_POLL_SAMPLES);
 
-    sound_pos_global++;
-    if (sound_pos_global == SOUNDBUFLEN) {
-	int c;
+    /* MIDI devices count their render period in samples. */
+    for (c = 0; c < SOUND_POLL_SAMPLES; c++)
+	midi_poll();
+
+    sound_pos_base += SOUND_POLL_SAMPLES;
+    sound_pos_global = sound_pos_base;
+    if (sound_pos_base >= SOUNDBUFLEN) {
+	sound_pos_global = SOUNDBUFLEN;
 
 	memset(outbuffer, 0, SOUNDBUFLEN * 2 * sizeof(int32_t));
 
@@ -414,9 +559,9 @@ sound_poll(void *priv)
 	}
 
 	if (sound_is_float)
-		givealbuffer(outbuffer_ex);
+		sound_give_buffer(outbuffer_ex);
 	else
-		givealbuffer(outbuffer_ex_int16);
+		sound_give_buffer(outbuffer_ex_int16);
 
 	if (cd_thread_enable) {
                 cd_buf_update--;
@@ -426,6 +571,7 @@ sound_poll(void *priv)
                 }
 	}
 
+	sound_pos_base = 0;
 	sound_pos_global = 0;
     }
 }
@@ -445,8 +591,14 @@ sound_reset(void)
 
     midi_device_init();
     midi_in_device_init();
-    inital();
+    if (sound_output == SOUND_OUTPUT_OPENAL)
+	inital();
+    if (sound_output == SOUND_OUTPUT_WAV)
+	sound_wav_open();
+    else
+	sound_wav_close();
 
+    sound_pos_base = sound_pos_global = 0;
     timer_add(&sound_poll_timer, sound_poll, NULL, 1);
 
     sound_handlers_num = 0;
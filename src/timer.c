@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 #include <86box/86box.h>
@@ -9,64 +10,128 @@
 uint64_t TIMER_USEC;
 uint32_t timer_target;
 
-/*Enabled timers are stored in a linked list, with the first timer to expire at
-  the head.*/
-pc_timer_t *timer_head = NULL;
+/*Enabled timers are stored in a binary min-heap, with the first timer to
+  expire at index 0. Each timer keeps its own heap index so it can be removed
+  in O(log n) without searching. Timers with equal timestamps are ordered by
+  insertion sequence, newest first, which matches the behaviour of the old
+  sorted linked list.*/
+pc_timer_t **timer_heap = NULL;
+int timer_heap_count = 0;
+static int timer_heap_size = 0;
+static uint32_t timer_seq = 0;
 
 /* Are we initialized? */
 int timer_inited = 0;
 
 
+/*True if timer a must be processed before timer b*/
+static __inline int
+timer_heap_before(pc_timer_t *a, pc_timer_t *b)
+{
+    int64_t diff = (int64_t)(a->ts.ts64 - b->ts.ts64);
+
+    if (diff)
+	return (diff < 0);
+
+    /* Same timestamp - the most recently enabled timer goes first. */
+    return ((int32_t)(a->seq - b->seq) > 0);
+}
+
+
+static __inline void
+timer_heap_set(int idx, pc_timer_t *timer)
+{
+    timer_heap[idx] = timer;
+    timer->heap_idx = idx;
+}
+
+
+static void
+timer_heap_sift_up(int idx)
+{
+    pc_timer_t *timer = timer_heap[idx];
+    int parent;
+
+    while (idx > 0) {
+	parent = (idx - 1) >> 1;
+	if (!timer_heap_before(timer, timer_heap[parent]))
+		break;
+	timer_heap_set(idx, timer_heap[parent]);
+	idx = parent;
+    }
+
+    timer_heap_set(idx, timer);
+}
+
+
+static void
+timer_heap_sift_down(int idx)
+{
+    pc_timer_t *timer = timer_heap[idx];
+    int child;
+
+    while (1) {
+	child = (idx << 1) + 1;
+	if (child >= timer_heap_count)
+		break;
+	if (((child + 1) < timer_heap_count) && timer_heap_before(timer_heap[child + 1], timer_heap[child]))
+		child++;
+	if (!timer_heap_before(timer_heap[child], timer))
+		break;
+	timer_heap_set(idx, timer_heap[child]);
+	idx = child;
+    }
+
+    timer_heap_set(idx, timer);
+}
+
+
+/*Remove the timer at the given heap index, filling the hole with the last
+  element of the heap*/
+static void
+timer_heap_remove(int idx)
+{
+    pc_timer_t *last;
+
+    timer_heap[idx]->heap_idx = -1;
+    timer_heap_count--;
+
+    if (idx == timer_heap_count)
+	return;
+
+    last = timer_heap[timer_heap_count];
+    timer_heap_set(idx, last);
+
+    if ((idx > 0) && timer_heap_before(last, timer_heap[(idx - 1) >> 1]))
+	timer_heap_sift_up(idx);
+    else
+	timer_heap_sift_down(idx);
+}
+
+
 void
 timer_enable(pc_timer_t *timer)
 {
-    pc_timer_t *timer_node = timer_head;
-
     if (!timer_inited || (timer == NULL))
 	return;
 
     if (timer->flags & TIMER_ENABLED)
 	timer_disable(timer);
 
-    if (timer->next || timer->prev)
-	fatal("timer_enable - timer->next\n");
+    if (timer_heap_count == timer_heap_size) {
+	timer_heap_size = timer_heap_size ? (timer_heap_size << 1) : 64;
+	timer_heap = (pc_timer_t **) realloc(timer_heap, timer_heap_size * sizeof(pc_timer_t *));
+	if (timer_heap == NULL)
+		fatal("timer_enable - out of memory\n");
+    }
 
     timer->flags |= TIMER_ENABLED;
+    timer->seq = timer_seq++;
 
-    /*List currently empty - add to head*/
-    if (!timer_head) {
-	timer_head = timer;
-	timer->next = timer->prev = NULL;
-	timer_target = timer_head->ts.ts32.integer;
-	return;
-    }
+    timer_heap_set(timer_heap_count++, timer);
+    timer_heap_sift_up(timer->heap_idx);
 
-    timer_node = timer_head;
-
-    while(1) {
-	/*Timer expires before timer_node. Add to list in front of timer_node*/
-	if (TIMER_LESS_THAN(timer, timer_node)) {
-		timer->next = timer_node;
-		timer->prev = timer_node->prev;
-		timer_node->prev = timer;
-		if (timer->prev)
-			timer->prev->next = timer;
-		else {
-			timer_head = timer;
-			timer_target = timer_head->ts.ts32.integer;
-		}
-		return;
-	}
-
-	/*timer_node is last in the list. Add timer to end of list*/
-	if (!timer_node->next) {
-		timer_node->next = timer;
-		timer->prev = timer_node;
-		return;
-	}
-
-	timer_node = timer_node->next;
-    }
+    timer_target = timer_heap[0]->ts.ts32.integer;
 }
 
 
@@ -76,38 +141,27 @@ timer_disable(pc_timer_t *timer)
     if (!timer_inited || (timer == NULL) || !(timer->flags & TIMER_ENABLED))
 	return;
 
-    if (!timer->next && !timer->prev && timer != timer_head)
-	fatal("timer_disable - !timer->next\n");
+    if ((timer->heap_idx < 0) || (timer->heap_idx >= timer_heap_count) || (timer_heap[timer->heap_idx] != timer))
+	fatal("timer_disable - timer not in queue\n");
 
     timer->flags &= ~TIMER_ENABLED;
 
-    if (timer->prev)
-	timer->prev->next = timer->next;
-    else
-	timer_head = timer->next;
-    if (timer->next)
-	timer->next->prev = timer->prev;
-    timer->prev = timer->next = NULL;
+    timer_heap_remove(timer->heap_idx);
+
+    if (timer_heap_count)
+	timer_target = timer_heap[0]->ts.ts32.integer;
 }
 
 
 void
 timer_remove_head(void)
 {
-    pc_timer_t *timer;
-
     if (!timer_inited)
 	return;
 
-    if (timer_head) {
-	timer = timer_head;
-	timer_head = timer->next;
-	if (timer_head) {
-		timer_head->prev = NULL;
-		timer->next->prev = NULL;
-	}
-	timer->next = timer->prev = NULL;
-	timer->flags &= ~TIMER_ENABLED;
+    if (timer_heap_count) {
+	timer_heap[0]->flags &= ~TIMER_ENABLED;
+	timer_heap_remove(0);
     }
 }
 
@@ -115,44 +169,23 @@ timer_remove_head(void)
 void
 timer_process(void)
 {
-    pc_timer_t *timer;
-
-    if (!timer_inited || !timer_head)
-	return;
-
-    while(1) {
-	timer = timer_head;
-
-	if (!TIMER_LESS_THAN_VAL(timer, (uint32_t)tsc))
-		break;
-
-	timer_remove_head();
-
-	if (timer->flags & TIMER_SPLIT)
-		timer_advance_ex(timer, 0);	/* We're splitting a > 1 s period into multiple <= 1 s periods. */
-	else if (timer->callback != NULL)	/* Make sure it's no NULL, so that we can have a NULL callback when no operation is needed. */
-		timer->callback(timer->p);
-    }
-
-    timer_target = timer_head->ts.ts32.integer;
+    timer_process_inline();
 }
 
 
 void
 timer_close(void)
 {
-    pc_timer_t *t = timer_head, *r;
+    int i;
 
-    /* Set all timers' prev and next to NULL so it is assured that
-       timers that are not in malloc'd structs don't keep pointing
-       to timers that may be in malloc'd structs. */
-    while (t != NULL) {
-	r = t;
-	r->prev = r->next = NULL;
-	t = r->next;
+    /* Detach all timers so that timers that are not in malloc'd structs
+       don't keep pointing into the queue. */
+    for (i = 0; i < timer_heap_count; i++) {
+	timer_heap[i]->flags &= ~TIMER_ENABLED;
+	timer_heap[i]->heap_idx = -1;
     }
 
-    timer_head = NULL;
+    timer_heap_count = 0;
 
     timer_inited = 0;
 }
@@ -164,10 +197,31 @@ timer_init(void)
     timer_target = 0ULL;
     tsc = 0;
 
+    timer_heap_count = 0;
+    timer_seq = 0;
+
     timer_inited = 1;
 }
 
 
+/*Move the TSC to a new value, shifting every queued timer by the same amount
+  so they all keep their remaining time. Used when restoring a saved state*/
+void
+timer_set_tsc(uint64_t new_tsc)
+{
+    uint64_t delta = (new_tsc - tsc) << 32;
+    int i;
+
+    for (i = 0; i < timer_heap_count; i++)
+	timer_heap[i]->ts.ts64 += delta;
+
+    tsc = new_tsc;
+
+    if (timer_heap_count)
+	timer_target = timer_heap[0]->ts.ts32.integer;
+}
+
+
 void
 timer_add(pc_timer_t *timer, void (*callback)(void *p), void *p, int start_timer)
 {
@@ -176,7 +230,7 @@ timer_add(pc_timer_t *timer, void (*callback)(void *p), void *p, int start_timer
     timer->callback = callback;
     timer->p = p;
     timer->flags = 0;
-    timer->prev = timer->next = NULL;
+    timer->heap_idx = -1;
     if (start_timer)
 	timer_set_delay_u64(timer, 0);
 }
@@ -36,6 +36,7 @@
 #include <86box/vid_ddc.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/vid_rop.h>
 #include <86box/vid_ati_eeprom.h>
 
 #ifdef CLAMP
@@ -1237,6 +1238,186 @@ void mach64_start_line(mach64_t *mach64)
                                         svga->changedvram[(((addr) >> 3) & mach64->vram_mask) >> 12] = changeframecount;        \
                                 }
 
+static uint32_t mach64_rot24(uint32_t col, int n)
+{
+        /*Only the first rotation looks at the top byte, after that the
+          colour repeats every three pixels*/
+        if (n >= 3)
+                n = 3 + (n % 3);
+        while (n--)
+                col = ((col >> 8) & 0xffff) | (col << 16);
+        return col;
+}
+
+/*Solid fills and screen to screen copies that need no per pixel decisions
+  are handed to the shared raster operation engine. The blitter is left in
+  the state the pixel loop would have left it in*/
+static int mach64_rect_fast(mach64_t *mach64)
+{
+        svga_t *svga = &mach64->svga;
+        int w = mach64->accel.dst_width, h = mach64->accel.dst_height;
+        int xinc = mach64->accel.xinc, yinc = mach64->accel.yinc;
+        int size = mach64->accel.dst_size;
+        int source = mach64->accel.source_fg;
+        int rot24 = mach64->dst_cntl & DST_24_ROT_EN, rot_fill;
+        int dx_lo, dx_hi, dy_lo, dy_hi, x0, x1, y0, y1;
+        int cmp_clr = 0, rop, j;
+        uint32_t col = 0;
+
+        if ((mach64->accel.source_mix != MONO_SRC_1) || (size == WIDTH_1BIT) ||
+            (mach64->dst_cntl & DST_POLYGON_EN))
+                return 0;
+
+        switch (source)
+        {
+                case SRC_HOST:
+                return 0;
+                case SRC_BLITSRC:
+                if ((mach64->src_cntl & (SRC_LINEAR_EN | SRC_PATT_EN)) ||
+                    (mach64->accel.src_size != size) || (mach64->accel.src_width1 < w))
+                        return 0;
+                break;
+                case SRC_FG:
+                col = mach64->accel.dp_frgd_clr;
+                break;
+                case SRC_BG:
+                col = mach64->accel.dp_bkgd_clr;
+                break;
+        }
+        /*Rotating the colour only has a meaning for the colour registers*/
+        rot_fill = rot24 && ((source == SRC_FG) || (source == SRC_BG));
+        if (rot_fill && size)
+                return 0;
+
+        switch (mach64->accel.clr_cmp_fn)
+        {
+                case 1: /*TRUE*/
+                cmp_clr = 1;
+                break;
+                case 4: /*DST_CLR != CLR_CMP_CLR*/
+                case 5: /*DST_CLR == CLR_CMP_CLR*/
+                if (!mach64->accel.clr_cmp_src || (source == SRC_BLITSRC) || rot_fill)
+                        return 0;
+                cmp_clr = ((col & mach64->accel.clr_cmp_mask) == mach64->accel.clr_cmp_clr) ^ (mach64->accel.clr_cmp_fn == 4);
+                break;
+        }
+
+        /*The coordinates wrap at 4096, so only take runs that do not*/
+        dx_lo = (xinc > 0) ? mach64->accel.dst_x_start : (mach64->accel.dst_x_start - w + 1);
+        dx_hi = dx_lo + w - 1;
+        dy_lo = (yinc > 0) ? mach64->accel.dst_y_start : (mach64->accel.dst_y_start - h + 1);
+        dy_hi = dy_lo + h - 1;
+        if ((dx_lo < 0) || (dx_hi > 0xfff) || (dy_lo < 0) || (dy_hi > 0xfff))
+                return 0;
+        if ((source == SRC_BLITSRC) &&
+            ((mach64->accel.src_x_start + ((xinc > 0) ? (w - 1) : (1 - w)) < 0) ||
+             (mach64->accel.src_x_start + ((xinc > 0) ? (w - 1) : (1 - w)) > 0xfff) ||
+             (mach64->accel.src_y_start + ((yinc > 0) ? (h - 1) : (1 - h)) < 0) ||
+             (mach64->accel.src_y_start + ((yinc > 0) ? (h - 1) : (1 - h)) > 0xfff)))
+                return 0;
+
+        if (cmp_clr)
+                rop = ROP_NOP;
+        else if (mach64->accel.mix_fg < 16)
+                rop = vid_rop_from_mix[mach64->accel.mix_fg];
+        else
+                rop = ROP_NOP;
+
+        x0 = MAX(dx_lo, mach64->accel.sc_left);
+        x1 = MIN(dx_hi, mach64->accel.sc_right);
+        y0 = MAX(dy_lo, mach64->accel.sc_top);
+        y1 = MIN(dy_hi, mach64->accel.sc_bottom);
+
+        if ((x1 >= x0) && (y1 >= y0))
+        {
+                int32_t pitch = mach64->accel.dst_pitch << size;
+
+                if (source == SRC_BLITSRC)
+                {
+                        /*Rows go in blit order, as they may overlap*/
+                        int y = (yinc > 0) ? y0 : y1;
+                        int sx = mach64->accel.src_x_start + (x0 - mach64->accel.dst_x_start);
+                        int sy = mach64->accel.src_y_start + (y - mach64->accel.dst_y_start);
+
+                        vid_rop_copy(svga, mach64->vram_mask,
+                                     (mach64->accel.dst_offset + (y * mach64->accel.dst_pitch) + x0) << size, pitch * yinc,
+                                     (mach64->accel.src_offset + (sy * mach64->accel.src_pitch) + sx) << size,
+                                     (int32_t) (mach64->accel.src_pitch << size) * yinc,
+                                     x1 - x0 + 1, y1 - y0 + 1, 1 << size, xinc, 0xffffffff, rop);
+                }
+                else if (rot_fill)
+                {
+                        /*Each 8-bit pixel takes the next byte of the colour, and
+                          the rotation carries on from row to row*/
+                        int len = x1 - x0 + 1;
+
+                        for (j = y0; j <= y1; j++)
+                        {
+                                int n = ((j - mach64->accel.dst_y_start) * yinc * w) + ((x0 - mach64->accel.dst_x_start) * xinc);
+                                uint32_t addr = mach64->accel.dst_offset + (j * mach64->accel.dst_pitch) + x0;
+                                uint32_t c = mach64_rot24(col, n), pat;
+                                int i;
+
+                                pat = (c & 0xff) | ((mach64_rot24(c, (xinc > 0) ? 1 : 2) & 0xff) << 8) |
+                                      ((mach64_rot24(c, (xinc > 0) ? 2 : 1) & 0xff) << 16);
+                                vid_rop_fill(svga, mach64->vram_mask, addr, pitch, len / 3, 1, 3, pat, 0xffffffff, rop);
+                                for (i = len - (len % 3); i < len; i++)
+                                        vid_rop_fill(svga, mach64->vram_mask, addr + i, pitch, 1, 1, 1,
+                                                     pat >> ((i % 3) << 3), 0xffffffff, rop);
+                        }
+                }
+                else
+                        vid_rop_fill(svga, mach64->vram_mask,
+                                     (mach64->accel.dst_offset + (y0 * mach64->accel.dst_pitch) + x0) << size, pitch,
+                                     x1 - x0 + 1, y1 - y0 + 1, 1 << size, col, 0xffffffff, rop);
+        }
+
+        if (rot24)
+        {
+                mach64->accel.dp_frgd_clr = mach64_rot24(mach64->accel.dp_frgd_clr, w * h);
+                mach64->accel.dp_bkgd_clr = mach64_rot24(mach64->accel.dp_bkgd_clr, w * h);
+        }
+
+        for (j = 0; j < h; j++)
+        {
+                if (mach64->src_cntl & SRC_LINEAR_EN)
+                        mach64->accel.src_x += w * xinc;
+
+                mach64->accel.x_count = w;
+                mach64->accel.dst_x = 0;
+                mach64->accel.dst_y += yinc;
+                mach64->accel.src_x_start = (mach64->src_y_x >> 16) & 0xfff;
+                mach64->accel.src_x_count = mach64->accel.src_width1;
+
+                if (!(mach64->src_cntl & SRC_LINEAR_EN))
+                {
+                        mach64->accel.src_x = 0;
+                        mach64->accel.src_y += yinc;
+                        mach64->accel.src_y_count--;
+                        if (mach64->accel.src_y_count <= 0)
+                        {
+                                mach64->accel.src_y = 0;
+                                if ((mach64->src_cntl & (SRC_PATT_ROT_EN | SRC_PATT_EN)) == (SRC_PATT_ROT_EN | SRC_PATT_EN))
+                                {
+                                        mach64->accel.src_y_start = mach64->src_y_x_start & 0xfff;
+                                        mach64->accel.src_y_count = mach64->accel.src_height2;
+                                }
+                                else
+                                        mach64->accel.src_y_count = mach64->accel.src_height1;
+                        }
+                }
+        }
+
+        mach64->accel.poly_draw = 0;
+        mach64->accel.dst_height = 0;
+        mach64->accel.busy = 0;
+        if (mach64->dst_cntl & DST_X_TILE)
+                mach64->dst_y_x = (mach64->dst_y_x & 0xfff) | ((mach64->dst_y_x + (mach64->accel.dst_width << 16)) & 0xfff0000);
+        if (mach64->dst_cntl & DST_Y_TILE)
+                mach64->dst_y_x = (mach64->dst_y_x & 0xfff0000) | ((mach64->dst_y_x + (mach64->dst_height_width & 0x1fff)) & 0xfff);
+        return 1;
+}
+
 void mach64_blit(uint32_t cpu_dat, int count, mach64_t *mach64)
 {
         svga_t *svga = &mach64->svga;
@@ -1250,6 +1431,8 @@ void mach64_blit(uint32_t cpu_dat, int count, mach64_t *mach64)
         switch (mach64->accel.op)
         {
                 case OP_RECT:
+                if ((count == -1) && mach64_rect_fast(mach64))
+                        return;
                 while (count)
                 {
                         uint32_t src_dat, dest_dat;
@@ -27,6 +27,7 @@
 #include <86box/timer.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/savestate.h>
 
 
 typedef struct
@@ -151,12 +152,22 @@ att49x_ramdac_close(void *priv)
 }
 
 
+static void
+att49x_ramdac_save_state(void *priv, savestate_t *st)
+{
+    att49x_ramdac_t *ramdac = (att49x_ramdac_t *) priv;
+
+    savestate_data(st, ramdac, sizeof(att49x_ramdac_t));
+}
+
+
 const device_t att490_ramdac_device =
 {
         "AT&T 20c490/20c491 RAMDAC",
         0, ATT_490_1,
         att49x_ramdac_init, att49x_ramdac_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	att49x_ramdac_save_state
 };
 
 const device_t att492_ramdac_device =
@@ -164,5 +175,6 @@ const device_t att492_ramdac_device =
         "AT&T 20c492/20c493 RAMDAC",
         0, ATT_492_3,
         att49x_ramdac_init, att49x_ramdac_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	att49x_ramdac_save_state
 };
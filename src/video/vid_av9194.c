@@ -27,6 +27,7 @@
 #include <86box/timer.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/savestate.h>
 
 
 float
@@ -95,11 +96,19 @@ av9194_init(const device_t *info)
 }
 
 
+/* The frequency table is fixed, there is nothing to save. */
+static void
+av9194_save_state(void *priv, savestate_t *st)
+{
+}
+
+
 const device_t av9194_device =
 {
         "AV9194 Clock Generator",
         0, 0,
         av9194_init, NULL,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	av9194_save_state
 };
 
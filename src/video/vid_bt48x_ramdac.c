@@ -28,6 +28,7 @@
 #include <86box/timer.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/savestate.h>
 
 
 typedef struct
@@ -500,12 +501,22 @@ bt48x_ramdac_close(void *priv)
 }
 
 
+static void
+bt48x_ramdac_save_state(void *priv, savestate_t *st)
+{
+    bt48x_ramdac_t *ramdac = (bt48x_ramdac_t *) priv;
+
+    savestate_data(st, ramdac, sizeof(bt48x_ramdac_t));
+}
+
+
 const device_t bt484_ramdac_device =
 {
         "Brooktree Bt484 RAMDAC",
         0, BT484,
         bt48x_ramdac_init, bt48x_ramdac_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	bt48x_ramdac_save_state
 };
 
 const device_t att20c504_ramdac_device =
@@ -513,7 +524,8 @@ const device_t att20c504_ramdac_device =
         "AT&T 20c504 RAMDAC",
         0, ATT20C504,
         bt48x_ramdac_init, bt48x_ramdac_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	bt48x_ramdac_save_state
 };
 
 const device_t bt485_ramdac_device =
@@ -521,7 +533,8 @@ const device_t bt485_ramdac_device =
         "Brooktree Bt485 RAMDAC",
         0, BT485,
         bt48x_ramdac_init, bt48x_ramdac_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	bt48x_ramdac_save_state
 };
 
 const device_t att20c505_ramdac_device =
@@ -529,7 +542,8 @@ const device_t att20c505_ramdac_device =
         "AT&T 20c505 RAMDAC",
         0, ATT20C505,
         bt48x_ramdac_init, bt48x_ramdac_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	bt48x_ramdac_save_state
 };
 
 const device_t bt485a_ramdac_device =
@@ -537,5 +551,6 @@ const device_t bt485a_ramdac_device =
         "Brooktree Bt485A RAMDAC",
         0, BT485A,
         bt48x_ramdac_init, bt48x_ramdac_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	bt48x_ramdac_save_state
 };
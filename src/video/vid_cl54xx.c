@@ -39,6 +39,8 @@
 #include <86box/vid_ddc.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/vid_rop.h>
+#include <86box/savestate.h>
 
 #define BIOS_GD5401_PATH		L"roms/video/cirruslogic/avga1.rom"
 #define BIOS_GD5402_PATH		L"roms/video/cirruslogic/avga2.rom"
@@ -1840,6 +1842,33 @@ gd54xx_rop(gd54xx_t *gd54xx, uint8_t *res, uint8_t *dst, const uint8_t *src) {
 }
 
 
+/* The same operations for the shared raster operation engine; codes the
+   blitter does not know leave the destination alone. */
+static int
+gd54xx_rop2(gd54xx_t *gd54xx)
+{
+    switch (gd54xx->blt.rop) {
+	case 0x00: return ROP_BLACKNESS;
+	case 0x05: return ROP_SRCAND;
+	case 0x09: return ROP_SRCERASE;
+	case 0x0b: return ROP_DSTINVERT;
+	case 0x0d: return ROP_SRCCOPY;
+	case 0x0e: return ROP_WHITENESS;
+	case 0x50: return ROP_NOTSRCAND;
+	case 0x59: return ROP_SRCINVERT;
+	case 0x6d: return ROP_SRCPAINT;
+	case 0x90: return ROP_NOTSRCERASE;
+	case 0x95: return ROP_NOTSRCXOR;
+	case 0xad: return ROP_SRCORNOTDST;
+	case 0xd0: return ROP_NOTSRCCOPY;
+	case 0xd6: return ROP_MERGEPAINT;
+	case 0xda: return ROP_NOTSRCNAND;
+    }
+
+    return ROP_NOP;
+}
+
+
 static uint8_t
 gd54xx_mem_sys_dest_read(gd54xx_t *gd54xx)
 {
@@ -3172,6 +3201,40 @@ gd54xx_transparent_comp(gd54xx_t *gd54xx, uint32_t xx, uint8_t src)
 }
 
 
+/* A solid fill expands every pixel to the foreground colour, so only the
+   left skip and the transparency mode decide what gets written. */
+static void
+gd54xx_solid_fill(gd54xx_t *gd54xx)
+{
+    svga_t *svga = &gd54xx->svga;
+    int pw = gd54xx->blt.pixel_width;
+    int len = ((gd54xx->blt.width / pw) + 1) * pw;
+    int skip = gd54xx->blt.pattern_x;
+    uint32_t dsta = gd54xx->blt.dst_addr & svga->vram_mask;
+    int rop = gd54xx_rop2(gd54xx);
+    int x;
+
+    if (gd54xx->blt.mode & CIRRUS_BLTMODE_TRANSPARENTCOMP) {
+	if (gd54xx->blt.modeext & CIRRUS_BLTMODEEXT_COLOREXPINV)
+		return;
+    } else if (gd54xx->blt.modeext & CIRRUS_BLTMODEEXT_BACKGROUNDONLY)
+	skip = 0;
+
+    /* The skip is in bytes. Only in 24-bpp mode may it split a pixel,
+       otherwise any pixel starting before it is left alone. */
+    if (pw == 3) {
+	for (x = skip; (x % pw) && (x < len); x++)
+		vid_rop_fill(svga, svga->vram_mask, dsta + x, gd54xx->blt.dst_pitch, 1, gd54xx->blt.height + 1, 1,
+			     gd54xx->blt.fg_col >> ((x % pw) << 3), 0xffffffff, rop);
+    } else
+	x = ((skip + pw - 1) / pw) * pw;
+
+    if (x < len)
+	vid_rop_fill(svga, svga->vram_mask, dsta + x, gd54xx->blt.dst_pitch, (len - x) / pw, gd54xx->blt.height + 1, pw,
+		     gd54xx->blt.fg_col, 0xffffffff, rop);
+}
+
+
 static void
 gd54xx_pattern_copy(gd54xx_t *gd54xx)
 {
@@ -3181,6 +3244,11 @@ gd54xx_pattern_copy(gd54xx_t *gd54xx)
     uint32_t srca, srca2, dsta;
     svga_t *svga = &gd54xx->svga;
 
+    if ((gd54xx->blt.mode & CIRRUS_BLTMODE_COLOREXPAND) && (gd54xx->blt.modeext & CIRRUS_BLTMODEEXT_SOLIDFILL)) {
+	gd54xx_solid_fill(gd54xx);
+	return;
+    }
+
     pattern_pitch = gd54xx->blt.pixel_width << 3;
 
     if (gd54xx->blt.pixel_width == 3)
@@ -3355,6 +3423,36 @@ gd54xx_normal_blit(uint32_t count, gd54xx_t *gd54xx, svga_t *svga)
     gd54xx->blt.x_count = 0;
     gd54xx->blt.y_count = 0;
 
+    /* Plain screen to screen copies need no decisions per byte. */
+    if (!(gd54xx->blt.mode & (CIRRUS_BLTMODE_COLOREXPAND | CIRRUS_BLTMODE_TRANSPARENTCOMP)) &&
+	(count >= ((uint32_t) (width + 1) * (gd54xx->blt.height + 1)))) {
+	int32_t dst_pitch = gd54xx->blt.dst_pitch * gd54xx->blt.dir;
+	int32_t src_pitch = gd54xx->blt.src_pitch * gd54xx->blt.dir;
+	int rows = gd54xx->blt.height + 1;
+	int skip = gd54xx->blt.pattern_x;
+
+	/* The engine wants the lowest address of each row; the left skip
+	   is the first bytes in blit order, so it only moves the start of
+	   rows that go up. */
+	if (gd54xx->blt.dir < 0) {
+		dst_addr -= width;
+		src_addr -= width;
+	} else {
+		dst_addr += skip;
+		src_addr += skip;
+	}
+	if (skip <= width)
+		vid_rop_copy(svga, svga->vram_mask, dst_addr, dst_pitch, src_addr, src_pitch,
+			     width + 1 - skip, rows, 1, gd54xx->blt.dir, 0xffffffff, gd54xx_rop2(gd54xx));
+
+	gd54xx->blt.dst_addr_backup = (gd54xx->blt.dst_addr + (rows * dst_pitch)) & svga->vram_mask;
+	gd54xx->blt.src_addr_backup = (gd54xx->blt.src_addr + (rows * src_pitch)) & svga->vram_mask;
+	gd54xx->blt.y_count = (rows * gd54xx->blt.dir) & 7;
+	gd54xx->blt.height_internal = 0xffff;
+	gd54xx_reset_blit(gd54xx);
+	return;
+    }
+
     while (count) {
 	src = 0;
 	mask = 0;
@@ -4093,6 +4191,44 @@ gd54xx_force_redraw(void *p)
     gd54xx->svga.fullchange = changeframecount;
 }
 
+
+static void
+gd54xx_save_state(void *p, savestate_t *st)
+{
+    gd54xx_t *gd54xx = (gd54xx_t *)p;
+
+    savestate_var(st, gd54xx->vclk_n);
+    savestate_var(st, gd54xx->vclk_d);
+    savestate_var(st, gd54xx->ramdac);
+    savestate_var(st, gd54xx->blt);
+    savestate_var(st, gd54xx->overlay);
+    savestate_var(st, gd54xx->countminusone);
+    savestate_var(st, gd54xx->vblank_irq);
+    savestate_var(st, gd54xx->vportsync);
+    savestate_var(st, gd54xx->pci_regs);
+    savestate_var(st, gd54xx->int_line);
+    savestate_var(st, gd54xx->unlocked);
+    savestate_var(st, gd54xx->status);
+    savestate_var(st, gd54xx->extensions);
+    savestate_var(st, gd54xx->crtcreg_mask);
+    savestate_var(st, gd54xx->fc);
+    savestate_var(st, gd54xx->pos_regs);
+    savestate_var(st, gd54xx->lfb_base);
+    savestate_var(st, gd54xx->vgablt_base);
+    savestate_var(st, gd54xx->extpallook);
+    savestate_var(st, gd54xx->extpal);
+
+    svga_save_state(&gd54xx->svga, st);
+
+    if (st->loading && !st->error) {
+	gd54xx_recalc_banking(gd54xx);
+	if (gd54xx->pci)
+		cl_pci_write(0, PCI_REG_COMMAND, gd54xx->pci_regs[PCI_REG_COMMAND], gd54xx);
+	else
+		gd543x_recalc_mapping(gd54xx);
+    }
+}
+
 static const device_config_t gd5422_config[] =
 {
         {
@@ -4233,6 +4369,7 @@ const device_t gd5401_isa_device =
     gd54xx_speed_changed,
     gd54xx_force_redraw,
     NULL,
+    gd54xx_save_state
 };
 
 const device_t gd5402_isa_device =
@@ -4246,6 +4383,7 @@ const device_t gd5402_isa_device =
     gd54xx_speed_changed,
     gd54xx_force_redraw,
     NULL,
+    gd54xx_save_state
 };
 
 const device_t gd5402_onboard_device =
@@ -4259,6 +4397,7 @@ const device_t gd5402_onboard_device =
     gd54xx_speed_changed,
     gd54xx_force_redraw,
     NULL,
+    gd54xx_save_state
 };
 
 const device_t gd5420_isa_device =
@@ -4272,6 +4411,7 @@ const device_t gd5420_isa_device =
     gd54xx_speed_changed,
     gd54xx_force_redraw,
     gd5422_config,
+    gd54xx_save_state
 };
 
 const device_t gd5422_isa_device = {
@@ -4284,6 +4424,7 @@ const device_t gd5422_isa_device = {
     gd54xx_speed_changed,
     gd54xx_force_redraw,
     gd5422_config,
+    gd54xx_save_state
 };
 
 const device_t gd5424_vlb_device = {
@@ -4296,6 +4437,7 @@ const device_t gd5424_vlb_device = {
     gd54xx_speed_changed,
     gd54xx_force_redraw,
     gd5422_config,
+    gd54xx_save_state
 };
 
 const device_t gd5426_vlb_device =
@@ -4309,7 +4451,8 @@ const device_t gd5426_vlb_device =
     { gd5426_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5428_config
+    gd5428_config,
+    gd54xx_save_state
 };
 
 const device_t gd5426_onboard_device =
@@ -4323,7 +4466,8 @@ const device_t gd5426_onboard_device =
     { NULL },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    NULL
+    NULL,
+    gd54xx_save_state
 };
 
 const device_t gd5428_isa_device =
@@ -4337,7 +4481,8 @@ const device_t gd5428_isa_device =
     { gd5428_isa_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5428_config
+    gd5428_config,
+    gd54xx_save_state
 };
 
 const device_t gd5428_vlb_device =
@@ -4351,7 +4496,8 @@ const device_t gd5428_vlb_device =
     { gd5428_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5428_config
+    gd5428_config,
+    gd54xx_save_state
 };
 
 const device_t gd5428_mca_device =
@@ -4365,7 +4511,8 @@ const device_t gd5428_mca_device =
     { gd5428_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    NULL
+    NULL,
+    gd54xx_save_state
 };
 
 const device_t gd5428_onboard_device =
@@ -4379,7 +4526,8 @@ const device_t gd5428_onboard_device =
     { gd5428_isa_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5428_onboard_config
+    gd5428_onboard_config,
+    gd54xx_save_state
 };
 
 const device_t gd5429_isa_device =
@@ -4393,7 +4541,8 @@ const device_t gd5429_isa_device =
     { gd5429_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5428_config
+    gd5428_config,
+    gd54xx_save_state
 };
 
 const device_t gd5429_vlb_device =
@@ -4407,7 +4556,8 @@ const device_t gd5429_vlb_device =
     { gd5429_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5428_config
+    gd5428_config,
+    gd54xx_save_state
 };
 
 const device_t gd5430_vlb_device =
@@ -4421,7 +4571,8 @@ const device_t gd5430_vlb_device =
     { gd5430_vlb_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5428_config
+    gd5428_config,
+    gd54xx_save_state
 };
 
 const device_t gd5430_pci_device =
@@ -4435,7 +4586,8 @@ const device_t gd5430_pci_device =
     { gd5430_pci_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5428_config
+    gd5428_config,
+    gd54xx_save_state
 };
 
 const device_t gd5434_isa_device =
@@ -4449,7 +4601,8 @@ const device_t gd5434_isa_device =
     { gd5434_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5434_config
+    gd5434_config,
+    gd54xx_save_state
 };
 
 const device_t gd5434_onboard_pci_device =
@@ -4463,7 +4616,8 @@ const device_t gd5434_onboard_pci_device =
     { NULL },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5434_config
+    gd5434_config,
+    gd54xx_save_state
 };
 
 const device_t gd5434_vlb_device =
@@ -4477,7 +4631,8 @@ const device_t gd5434_vlb_device =
     { gd5434_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5434_config
+    gd5434_config,
+    gd54xx_save_state
 };
 
 const device_t gd5434_pci_device =
@@ -4491,7 +4646,8 @@ const device_t gd5434_pci_device =
     { gd5434_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5434_config
+    gd5434_config,
+    gd54xx_save_state
 };
 
 const device_t gd5436_pci_device =
@@ -4505,7 +4661,8 @@ const device_t gd5436_pci_device =
     { gd5436_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5434_config
+    gd5434_config,
+    gd54xx_save_state
 };
 
 const device_t gd5440_onboard_pci_device =
@@ -4519,7 +4676,8 @@ const device_t gd5440_onboard_pci_device =
     { NULL },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5440_onboard_config
+    gd5440_onboard_config,
+    gd54xx_save_state
 };
 
 const device_t gd5440_pci_device =
@@ -4533,7 +4691,8 @@ const device_t gd5440_pci_device =
     { gd5440_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5428_config
+    gd5428_config,
+    gd54xx_save_state
 };
 
 const device_t gd5446_pci_device =
@@ -4547,7 +4706,8 @@ const device_t gd5446_pci_device =
     { gd5446_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5434_config
+    gd5434_config,
+    gd54xx_save_state
 };
 
 const device_t gd5446_stb_pci_device =
@@ -4561,7 +4721,8 @@ const device_t gd5446_stb_pci_device =
     { gd5446_stb_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5434_config
+    gd5434_config,
+    gd54xx_save_state
 };
 
 const device_t gd5480_pci_device =
@@ -4575,5 +4736,6 @@ const device_t gd5480_pci_device =
     { gd5480_available },
     gd54xx_speed_changed,
     gd54xx_force_redraw,
-    gd5434_config
+    gd5434_config,
+    gd54xx_save_state
 };
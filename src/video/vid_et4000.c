@@ -52,6 +52,7 @@
 #include <86box/video.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/savestate.h>
 
 
 #define BIOS_ROM_PATH		L"roms/video/et4000/et4000.bin"
@@ -775,6 +776,38 @@ et4000_force_redraw(void *priv)
 }
 
 
+static void
+et4000_save_state(void *priv, savestate_t *st)
+{
+    et4000_t *dev = (et4000_t *)priv;
+    uint16_t kasan_access_addr = dev->kasan_access_addr;
+
+    savestate_var(st, dev->pos_regs);
+    savestate_var(st, dev->banking);
+    savestate_var(st, dev->port_22cb_val);
+    savestate_var(st, dev->port_32cb_val);
+    savestate_var(st, dev->get_korean_font_enabled);
+    savestate_var(st, dev->get_korean_font_index);
+    savestate_var(st, dev->get_korean_font_base);
+    savestate_var(st, dev->kasan_cfg_index);
+    savestate_var(st, dev->kasan_cfg_regs);
+    savestate_var(st, dev->kasan_access_addr);
+    savestate_var(st, dev->kasan_font_data);
+
+    if (st->loading && !st->error && (dev->type == 4)) {
+	dev->svga.ksc5601_swap_mode = (dev->kasan_cfg_regs[4] & 4) >> 2;
+
+	/* The Kasan access ports can be moved. */
+	io_removehandler(kasan_access_addr, 0x0008,
+			 et4000_kasan_in, NULL, NULL, et4000_kasan_out, NULL, NULL, dev);
+	io_sethandler(dev->kasan_access_addr, 0x0008,
+		      et4000_kasan_in, NULL, NULL, et4000_kasan_out, NULL, NULL, dev);
+    }
+
+    svga_save_state(&dev->svga, st);
+}
+
+
 static int
 et4000_available(void)
 {
@@ -828,7 +861,8 @@ const device_t et4000_isa_device = {
     { et4000_available },
     et4000_speed_changed,
     et4000_force_redraw,
-    et4000_config
+    et4000_config,
+    et4000_save_state
 };
 
 const device_t et4000_mca_device = {
@@ -839,7 +873,8 @@ const device_t et4000_mca_device = {
     { et4000_available },
     et4000_speed_changed,
     et4000_force_redraw,
-    et4000_config
+    et4000_config,
+    et4000_save_state
 };
 
 const device_t et4000k_isa_device = {
@@ -850,7 +885,8 @@ const device_t et4000k_isa_device = {
     { et4000k_available },
     et4000_speed_changed,
     et4000_force_redraw,
-    et4000_config
+    et4000_config,
+    et4000_save_state
 };
 
 const device_t et4000k_tg286_isa_device = {
@@ -861,7 +897,8 @@ const device_t et4000k_tg286_isa_device = {
     { et4000k_available },
     et4000_speed_changed,
     et4000_force_redraw,
-    et4000_config
+    et4000_config,
+    et4000_save_state
 };
 
 const device_t et4000_kasan_isa_device = {
@@ -872,5 +909,6 @@ const device_t et4000_kasan_isa_device = {
     { et4000_kasan_available },
     et4000_speed_changed,
     et4000_force_redraw,
-    et4000_config
+    et4000_config,
+    et4000_save_state
 };
@@ -25,6 +25,7 @@
 #include <86box/timer.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/savestate.h>
 
 
 typedef union {
@@ -945,10 +946,20 @@ ibm_rgb528_ramdac_close(void *priv)
 }
 
 
+static void
+ibm_rgb528_ramdac_save_state(void *priv, savestate_t *st)
+{
+    ibm_rgb528_ramdac_t *ramdac = (ibm_rgb528_ramdac_t *) priv;
+
+    savestate_data(st, ramdac, sizeof(ibm_rgb528_ramdac_t));
+}
+
+
 const device_t ibm_rgb528_ramdac_device =
 {
         "IBM RGB528 RAMDAC",
         0, 0,
         ibm_rgb528_ramdac_init, ibm_rgb528_ramdac_close,
-	NULL, { NULL }, NULL, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	ibm_rgb528_ramdac_save_state
 };
@@ -27,6 +27,8 @@
 #include <wchar.h>
 #include <86box/86box.h>
 #include <86box/device.h>
+#include <86box/timer.h>
+#include <86box/savestate.h>
 
 
 typedef struct icd2061_t
@@ -166,12 +168,22 @@ icd2061_close(void *priv)
 }
 
 
+static void
+icd2061_save_state(void *priv, savestate_t *st)
+{
+    icd2061_t *icd2061 = (icd2061_t *) priv;
+
+    savestate_data(st, icd2061, sizeof(icd2061_t));
+}
+
+
 const device_t icd2061_device =
 {
         "ICD2061 Clock Generator",
         0, 0,
         icd2061_init, icd2061_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	icd2061_save_state
 };
 
 
@@ -180,5 +192,6 @@ const device_t ics9161_device =
         "ICS9161 Clock Generator",
         0, 0,
         icd2061_init, icd2061_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	icd2061_save_state
 };
@@ -23,6 +23,8 @@
 #include <wchar.h>
 #include <86box/86box.h>
 #include <86box/device.h>
+#include <86box/timer.h>
+#include <86box/savestate.h>
 
 
 typedef struct ics2494_t
@@ -105,10 +107,20 @@ ics2494_close(void *priv)
 }
 
 
+static void
+ics2494_save_state(void *priv, savestate_t *st)
+{
+    ics2494_t *ics2494 = (ics2494_t *) priv;
+
+    savestate_data(st, ics2494, sizeof(ics2494_t));
+}
+
+
 const device_t ics2494an_305_device =
 {
         "ICS2494AN-305 Clock Generator",
         0, 305,
         ics2494_init, ics2494_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	ics2494_save_state
 };
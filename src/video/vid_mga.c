@@ -32,6 +32,7 @@
 #include <86box/vid_ddc.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/vid_rop.h>
 
 
 #define ROM_MYSTIQUE			L"roms/video/matrox/MYSTIQUE.VBI"
@@ -3594,6 +3595,64 @@ blit_autoline(mystique_t *mystique, int closed)
 }
 
 
+/* Draws one BLK/RPL/RSTR trapezoid span through the shared raster op
+   engine when it reduces to a solid fill, ie. no transparency and a
+   pattern row that is all foreground or all background. Returns 0 to
+   leave the span to the pixel loop. */
+static int
+blit_trap_span_fast(mystique_t *mystique, int16_t x_l, int16_t x_r, int yoff, int rop)
+{
+    svga_t *svga = &mystique->svga;
+    int bpp, pattern, x, lo, hi;
+    uint32_t addr;
+
+    if ((mystique->dwgreg.dwgctrl_running & DWGCTRL_TRANS_MASK) || (x_l >= x_r))
+	return 0;
+
+    pattern = !!mystique->dwgreg.pattern[yoff][0];
+    for (x = 1; x < 8; x++) {
+	if (!!mystique->dwgreg.pattern[yoff][x] != pattern)
+		return 0;
+    }
+
+    switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
+	case MACCESS_PWIDTH_8:
+		bpp = 1;
+		break;
+	case MACCESS_PWIDTH_16:
+		bpp = 2;
+		break;
+	case MACCESS_PWIDTH_24:
+		bpp = 3;
+		break;
+	case MACCESS_PWIDTH_32:
+		bpp = 4;
+		break;
+	default:
+		return 0;
+    }
+
+    lo = (x_l > mystique->dwgreg.cxleft) ? x_l : mystique->dwgreg.cxleft;
+    hi = ((x_r - 1) < mystique->dwgreg.cxright) ? (x_r - 1) : mystique->dwgreg.cxright;
+
+    if ((lo <= hi) && (mystique->dwgreg.ydst_lin >= mystique->dwgreg.ytop) && (mystique->dwgreg.ydst_lin <= mystique->dwgreg.ybot)) {
+	addr = (mystique->dwgreg.ydst_lin + lo) * bpp;
+
+	/* 24 bpp pixels are stored as 32-bit read-modify-writes, which
+	   do not wrap the same way as the byte engine at the end of VRAM. */
+	if ((bpp == 3) && (((addr & mystique->vram_mask) + ((hi - lo + 1) * 3)) > mystique->vram_mask))
+		return 0;
+
+	vid_rop_fill(svga, mystique->vram_mask, addr, 0, hi - lo + 1, 1, bpp,
+		     pattern ? mystique->dwgreg.fcol : mystique->dwgreg.bcol, 0xffffffff, rop);
+    }
+
+    mystique->pixel_count += x_r - x_l;
+
+    return 1;
+}
+
+
 static void
 blit_trap(mystique_t *mystique)
 {
@@ -3614,6 +3673,9 @@ blit_trap(mystique_t *mystique)
 			int16_t x_r = mystique->dwgreg.fxright & 0xffff;
 			int yoff = (mystique->dwgreg.yoff + mystique->dwgreg.ydst) & 7;
 
+			if (blit_trap_span_fast(mystique, x_l, x_r, yoff, ROP_SRCCOPY))
+				x_l = x_r;
+
 			while (x_l != x_r) {
 				if (x_l >= mystique->dwgreg.cxleft && x_l <= mystique->dwgreg.cxright &&
 				    mystique->dwgreg.ydst_lin >= mystique->dwgreg.ytop && mystique->dwgreg.ydst_lin <= mystique->dwgreg.ybot &&
@@ -3687,6 +3749,9 @@ blit_trap(mystique_t *mystique)
 			int16_t x_r = mystique->dwgreg.fxright & 0xffff;
 			int yoff = (mystique->dwgreg.yoff + mystique->dwgreg.ydst) & 7;
 
+			if (blit_trap_span_fast(mystique, x_l, x_r, yoff, (mystique->dwgreg.dwgctrl_running & DWGCTRL_BOP_MASK) >> 16))
+				x_l = x_r;
+
 			while (x_l != x_r) {
 				if (x_l >= mystique->dwgreg.cxleft && x_l <= mystique->dwgreg.cxright &&
 				    mystique->dwgreg.ydst_lin >= mystique->dwgreg.ytop && mystique->dwgreg.ydst_lin <= mystique->dwgreg.ybot &&
@@ -0,0 +1,358 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Shared 2D raster operation engine.
+ *
+ *		The accelerators hand over rectangles that need no per
+ *		pixel decisions (no colour compare, no monochrome source)
+ *		and the work is done a row at a time on bytes, with SSE2
+ *		or AVX2 kernels picked at startup. Rows that wrap around
+ *		the end of video memory, or that overlap their source in
+ *		the direction of the blit, are done a byte at a time in
+ *		the order the hardware would do them.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/mem.h>
+#include <86box/timer.h>
+#include <86box/video.h>
+#include <86box/vid_svga.h>
+#include <86box/vid_rop.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+# define USE_ROP_SSE2
+# include <emmintrin.h>
+# if defined(__GNUC__) || defined(_MSC_VER)
+#  define USE_ROP_AVX2
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#   include <intrin.h>
+#   define ROP_AVX2
+#  else
+#   define ROP_AVX2	__attribute__((target("avx2")))
+#  endif
+# endif
+#endif
+
+
+/* A multiple of every pixel size, and of the widest vector. */
+#define ROP_CHUNK	768
+
+
+typedef void (*rop_span_t)(uint8_t *d, const uint8_t *s, const uint8_t *m, int len, int rop);
+
+
+const uint8_t vid_rop_from_mix[16] = {
+    ROP_DSTINVERT,	ROP_BLACKNESS,	ROP_WHITENESS,	ROP_NOP,
+    ROP_NOTSRCCOPY,	ROP_SRCINVERT,	ROP_NOTSRCXOR,	ROP_SRCCOPY,
+    ROP_NOTSRCNAND,	ROP_MERGEPAINT,	ROP_SRCORNOTDST, ROP_SRCPAINT,
+    ROP_SRCAND,		ROP_SRCERASE,	ROP_NOTSRCAND,	ROP_NOTSRCERASE
+};
+
+
+/* Each result is selected by the destination between t0 and t1, which
+   are themselves selected by the source from the truth table:
+
+	t0 = c0 ^ (S & (c0 ^ c2))
+	t1 = c1 ^ (S & (c1 ^ c3))
+	R  = t0 ^ (D & (t0 ^ t1))
+
+   and a write mask keeps the destination where it is clear. */
+#define ROP_TERM(rop, n)	((((rop) >> (n)) & 1) ? 0xffffffff : 0x00000000)
+
+
+static uint8_t
+rop_byte(uint8_t s, uint8_t d, int rop)
+{
+    uint8_t t0 = ROP_TERM(rop, 0) ^ (s & (ROP_TERM(rop, 0) ^ ROP_TERM(rop, 2)));
+    uint8_t t1 = ROP_TERM(rop, 1) ^ (s & (ROP_TERM(rop, 1) ^ ROP_TERM(rop, 3)));
+
+    return t0 ^ (d & (t0 ^ t1));
+}
+
+
+static void
+rop_span_c(uint8_t *d, const uint8_t *s, const uint8_t *m, int len, int rop)
+{
+    uint32_t c0 = ROP_TERM(rop, 0), c02 = c0 ^ ROP_TERM(rop, 2);
+    uint32_t c1 = ROP_TERM(rop, 1), c13 = c1 ^ ROP_TERM(rop, 3);
+    uint32_t sv, dv, mv, t0, t1, r;
+    int i = 0;
+
+    if ((rop == ROP_SRCCOPY) && (m == NULL)) {
+	memmove(d, s, len);
+	return;
+    }
+
+    for (; i <= (len - 4); i += 4) {
+	memcpy(&sv, s + i, 4);
+	memcpy(&dv, d + i, 4);
+	t0 = c0 ^ (sv & c02);
+	t1 = c1 ^ (sv & c13);
+	r = t0 ^ (dv & (t0 ^ t1));
+	if (m != NULL) {
+		memcpy(&mv, m + i, 4);
+		r = dv ^ ((r ^ dv) & mv);
+	}
+	memcpy(d + i, &r, 4);
+    }
+
+    for (; i < len; i++) {
+	r = rop_byte(s[i], d[i], rop);
+	if (m != NULL)
+		r = d[i] ^ ((r ^ d[i]) & m[i]);
+	d[i] = r;
+    }
+}
+
+
+#ifdef USE_ROP_SSE2
+static void
+rop_span_sse2(uint8_t *d, const uint8_t *s, const uint8_t *m, int len, int rop)
+{
+    __m128i c0 = _mm_set1_epi32(ROP_TERM(rop, 0)), c02 = _mm_xor_si128(c0, _mm_set1_epi32(ROP_TERM(rop, 2)));
+    __m128i c1 = _mm_set1_epi32(ROP_TERM(rop, 1)), c13 = _mm_xor_si128(c1, _mm_set1_epi32(ROP_TERM(rop, 3)));
+    __m128i sv, dv, t0, t1, r;
+    int i = 0;
+
+    if ((rop == ROP_SRCCOPY) && (m == NULL)) {
+	memmove(d, s, len);
+	return;
+    }
+
+    for (; i <= (len - 16); i += 16) {
+	sv = _mm_loadu_si128((const __m128i *) (s + i));
+	dv = _mm_loadu_si128((const __m128i *) (d + i));
+	t0 = _mm_xor_si128(c0, _mm_and_si128(sv, c02));
+	t1 = _mm_xor_si128(c1, _mm_and_si128(sv, c13));
+	r = _mm_xor_si128(t0, _mm_and_si128(dv, _mm_xor_si128(t0, t1)));
+	if (m != NULL)
+		r = _mm_xor_si128(dv, _mm_and_si128(_mm_xor_si128(r, dv), _mm_loadu_si128((const __m128i *) (m + i))));
+	_mm_storeu_si128((__m128i *) (d + i), r);
+    }
+
+    if (i < len)
+	rop_span_c(d + i, s + i, m ? (m + i) : NULL, len - i, rop);
+}
+#endif
+
+
+#ifdef USE_ROP_AVX2
+ROP_AVX2 static void
+rop_span_avx2(uint8_t *d, const uint8_t *s, const uint8_t *m, int len, int rop)
+{
+    __m256i c0 = _mm256_set1_epi32(ROP_TERM(rop, 0)), c02 = _mm256_xor_si256(c0, _mm256_set1_epi32(ROP_TERM(rop, 2)));
+    __m256i c1 = _mm256_set1_epi32(ROP_TERM(rop, 1)), c13 = _mm256_xor_si256(c1, _mm256_set1_epi32(ROP_TERM(rop, 3)));
+    __m256i sv, dv, t0, t1, r;
+    int i = 0;
+
+    if ((rop == ROP_SRCCOPY) && (m == NULL)) {
+	memmove(d, s, len);
+	return;
+    }
+
+    for (; i <= (len - 32); i += 32) {
+	sv = _mm256_loadu_si256((const __m256i *) (s + i));
+	dv = _mm256_loadu_si256((const __m256i *) (d + i));
+	t0 = _mm256_xor_si256(c0, _mm256_and_si256(sv, c02));
+	t1 = _mm256_xor_si256(c1, _mm256_and_si256(sv, c13));
+	r = _mm256_xor_si256(t0, _mm256_and_si256(dv, _mm256_xor_si256(t0, t1)));
+	if (m != NULL)
+		r = _mm256_xor_si256(dv, _mm256_and_si256(_mm256_xor_si256(r, dv), _mm256_loadu_si256((const __m256i *) (m + i))));
+	_mm256_storeu_si256((__m256i *) (d + i), r);
+    }
+
+    if (i < len)
+	rop_span_sse2(d + i, s + i, m ? (m + i) : NULL, len - i, rop);
+}
+
+
+static int
+rop_has_avx2(void)
+{
+# ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+	return 0;
+
+    /* OSXSAVE and AVX, with the YMM state enabled by the OS. */
+    __cpuid(info, 1);
+    if ((info[2] & 0x18000000) != 0x18000000)
+	return 0;
+    if ((_xgetbv(0) & 6) != 6)
+	return 0;
+
+    __cpuidex(info, 7, 0);
+    return !!(info[1] & 0x20);
+# else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+# endif
+}
+#endif
+
+
+static rop_span_t	rop_span = rop_span_c;
+
+
+void
+vid_rop_init(void)
+{
+    rop_span = rop_span_c;
+#ifdef USE_ROP_SSE2
+    rop_span = rop_span_sse2;
+#endif
+#ifdef USE_ROP_AVX2
+    if (rop_has_avx2())
+	rop_span = rop_span_avx2;
+#endif
+}
+
+
+/* Repeat a pixel value over a chunk; returns NULL for an all ones write
+   mask, which the kernels skip. */
+static uint8_t *
+rop_pattern(uint8_t *buf, uint32_t val, int bpp, int is_mask)
+{
+    uint32_t pix_mask = (bpp == 4) ? 0xffffffff : ((1 << (bpp << 3)) - 1);
+    int i;
+
+    if (is_mask && ((val & pix_mask) == pix_mask))
+	return NULL;
+
+    for (i = 0; i < ROP_CHUNK; i++)
+	buf[i] = val >> ((i % bpp) << 3);
+
+    return buf;
+}
+
+
+static void
+rop_mark(svga_t *svga, uint32_t addr, int len)
+{
+    uint32_t page;
+
+    for (page = addr >> 12; page <= ((addr + len - 1) >> 12); page++)
+	svga->changedvram[page] = changeframecount;
+}
+
+
+/* One byte at a time in blit order, for rows that wrap around video
+   memory or run into their own source; fills pass their source chunk. */
+static void
+rop_row_slow(svga_t *svga, uint32_t vram_mask, uint32_t dst, uint32_t src, const uint8_t *sbuf,
+	     const uint8_t *mbuf, int len, int x_dir, int rop)
+{
+    uint8_t *vram = svga->vram;
+    uint8_t s, d, r;
+    int i, x;
+
+    for (i = 0; i < len; i++) {
+	x = (x_dir < 0) ? (len - 1 - i) : i;
+	s = sbuf ? sbuf[x % ROP_CHUNK] : vram[(src + x) & vram_mask];
+	d = vram[(dst + x) & vram_mask];
+	r = rop_byte(s, d, rop);
+	if (mbuf != NULL)
+		r = d ^ ((r ^ d) & mbuf[x % ROP_CHUNK]);
+	vram[(dst + x) & vram_mask] = r;
+	svga->changedvram[((dst + x) & vram_mask) >> 12] = changeframecount;
+    }
+}
+
+
+void
+vid_rop_fill(svga_t *svga, uint32_t vram_mask, uint32_t dst, int32_t dst_pitch, int width, int height, int bpp,
+	     uint32_t col, uint32_t wrt_mask, int rop)
+{
+    uint8_t sbuf[ROP_CHUNK], mbuf[ROP_CHUNK];
+    uint8_t *m;
+    int len = width * bpp;
+    int x, n, y;
+
+    if ((width <= 0) || (height <= 0))
+	return;
+
+    rop_pattern(sbuf, col, bpp, 0);
+    m = rop_pattern(mbuf, wrt_mask, bpp, 1);
+
+    /* With the source fixed, anything that ignores the destination is
+       a plain store of a precomputed chunk. */
+    if (((rop >> 1) & 5) == (rop & 5)) {
+	for (x = 0; x < ROP_CHUNK; x++)
+		sbuf[x] = rop_byte(sbuf[x], 0x00, rop);
+	rop = ROP_SRCCOPY;
+    }
+
+    for (y = 0; y < height; y++, dst += dst_pitch) {
+	dst &= vram_mask;
+
+	if ((dst + len) > (vram_mask + 1)) {
+		rop_row_slow(svga, vram_mask, dst, 0, sbuf, m, len, 1, rop);
+		continue;
+	}
+
+	for (x = 0; x < len; x += n) {
+		n = MIN(len - x, ROP_CHUNK);
+		rop_span(&svga->vram[dst + x], sbuf, m, n, rop);
+	}
+	rop_mark(svga, dst, len);
+    }
+}
+
+
+void
+vid_rop_copy(svga_t *svga, uint32_t vram_mask, uint32_t dst, int32_t dst_pitch, uint32_t src, int32_t src_pitch,
+	     int width, int height, int bpp, int x_dir, uint32_t wrt_mask, int rop)
+{
+    uint8_t tmp[ROP_CHUNK], mbuf[ROP_CHUNK];
+    uint8_t *m;
+    int len = width * bpp;
+    int x, n, y, overlap;
+
+    if ((width <= 0) || (height <= 0))
+	return;
+
+    m = rop_pattern(mbuf, wrt_mask, bpp, 1);
+
+    for (y = 0; y < height; y++, dst += dst_pitch, src += src_pitch) {
+	dst &= vram_mask;
+	src &= vram_mask;
+
+	overlap = (src != dst) && (src < (dst + len)) && (dst < (src + len));
+
+	if (((dst + len) > (vram_mask + 1)) || ((src + len) > (vram_mask + 1)) ||
+	    (overlap && ((x_dir < 0) ? (dst < src) : (dst > src)))) {
+		rop_row_slow(svga, vram_mask, dst, src, NULL, m, len, x_dir, rop);
+		continue;
+	}
+
+	if (overlap && (x_dir < 0)) {
+		/* The destination is above the source; walk down through it
+		   so no chunk is read after it has been written. */
+		for (x = len; x > 0; x -= n) {
+			n = MIN(x, ROP_CHUNK);
+			memcpy(tmp, &svga->vram[src + x - n], n);
+			rop_span(&svga->vram[dst + x - n], tmp, m, n, rop);
+		}
+	} else {
+		/* The kernels read each vector before writing it, so going
+		   up is safe when the destination is below the source. */
+		for (x = 0; x < len; x += n) {
+			n = MIN(len - x, ROP_CHUNK);
+			rop_span(&svga->vram[dst + x], &svga->vram[src + x], m, n, rop);
+		}
+	}
+	rop_mark(svga, dst, len);
+    }
+}
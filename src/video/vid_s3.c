@@ -35,6 +35,8 @@
 #include <86box/vid_ddc.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/vid_rop.h>
+#include <86box/savestate.h>
 #include "cpu.h"
 
 #define ROM_ORCHID_86C911		L"roms/video/s3/BIOS.BIN"
@@ -4326,6 +4328,107 @@ s3_visionx68_video_engine_op(uint32_t cpu_dat, s3_t *s3)
 	}
 }
 
+/*Visible part of a run of len coordinates from start, going down if dir is
+  clear; returns 0 if the run wraps around the 12-bit clipping space*/
+static int
+s3_accel_clip_run(int start, int len, int dir, int clip_lo, int clip_hi, int *first, int *count)
+{
+	int lo = dir ? start : (start - len + 1);
+	int hi = lo + len - 1;
+	int base = lo & ~0xfff;
+
+	if ((hi & ~0xfff) != base)
+		return 0;
+
+	lo = MAX(lo, base + clip_lo);
+	hi = MIN(hi, base + clip_hi);
+
+	*first = lo;
+	*count = (hi >= lo) ? (hi - lo + 1) : 0;
+	return 1;
+}
+
+/*Whole rectangle fills and screen to screen blits with a constant mix,
+  handed to the shared raster operation engine. The engine state is left
+  as the pixel loop would leave it*/
+static int
+s3_accel_fill_fast(s3_t *s3, uint32_t dstbase, int clip_l, int clip_r, int clip_t, int clip_b, int compare_mode, uint32_t compare)
+{
+	svga_t *svga = &s3->svga;
+	int frgd_mix = (s3->accel.frgd_mix >> 5) & 3;
+	int rows = s3->accel.sy + 1, cols = s3->accel.sx + 1;
+	int shift = (s3->bpp == 3) ? 2 : s3->bpp;
+	int x, y, w, h;
+	uint32_t src_dat;
+
+	if (!s3_accel_clip_run(s3->accel.cx, cols, s3->accel.cmd & 0x20, clip_l, clip_r, &x, &w) ||
+	    !s3_accel_clip_run(s3->accel.cy, rows, s3->accel.cmd & 0x80, clip_t, clip_b, &y, &h))
+		return 0;
+
+	switch (frgd_mix)
+	{
+		case 0: src_dat = s3->accel.bkgd_color; break;
+		case 1: src_dat = s3->accel.frgd_color; break;
+		default: src_dat = 0; break;
+	}
+
+	if (w && h && ((compare_mode < 2) || ((compare_mode == 2) && (src_dat != compare)) ||
+		       ((compare_mode == 3) && (src_dat == compare))))
+		vid_rop_fill(svga, s3->vram_mask, (dstbase + y * s3->width + x) << shift,
+			     s3->width << shift, w, h, 1 << shift,
+			     src_dat, s3->accel.wrt_mask, vid_rop_from_mix[s3->accel.frgd_mix & 0xf]);
+
+	if (s3->accel.cmd & 0x80) s3->accel.cy += rows;
+	else			  s3->accel.cy -= rows;
+	s3->accel.sx   = s3->accel.maj_axis_pcnt & 0xfff;
+	s3->accel.sy   = -1;
+	s3->accel.dest = dstbase + s3->accel.cy * s3->width;
+	s3->accel.cur_x = s3->accel.cx;
+	s3->accel.cur_y = s3->accel.cy;
+	return 1;
+}
+
+static int
+s3_accel_blit_fast(s3_t *s3, uint32_t srcbase, uint32_t dstbase, int clip_l, int clip_r, int clip_t, int clip_b)
+{
+	svga_t *svga = &s3->svga;
+	int rows = s3->accel.sy + 1, cols = s3->accel.sx + 1;
+	int shift = (s3->bpp == 3) ? 2 : s3->bpp;
+	int x_dir = s3->accel.cmd & 0x20, y_dir = s3->accel.cmd & 0x80;
+	int x, y, w, h, sx, sy;
+	int32_t pitch = s3->width << shift;
+
+	if (!s3_accel_clip_run(s3->accel.dx, cols, x_dir, clip_l, clip_r, &x, &w) ||
+	    !s3_accel_clip_run(s3->accel.dy, rows, y_dir, clip_t, clip_b, &y, &h))
+		return 0;
+
+	if (w && h) {
+		if (!y_dir) {
+			y += h - 1;
+			pitch = -pitch;
+		}
+		sx = s3->accel.cx + (x - s3->accel.dx);
+		sy = s3->accel.cy + (y - s3->accel.dy);
+
+		vid_rop_copy(svga, s3->vram_mask, (dstbase + y * s3->width + x) << shift, pitch,
+			     (srcbase + sy * s3->width + sx) << shift, pitch, w, h, 1 << shift,
+			     x_dir ? 1 : -1, s3->accel.wrt_mask, vid_rop_from_mix[s3->accel.frgd_mix & 0xf]);
+	}
+
+	if (y_dir) {
+		s3->accel.cy += rows;
+		s3->accel.dy += rows;
+	} else {
+		s3->accel.cy -= rows;
+		s3->accel.dy -= rows;
+	}
+	s3->accel.sx   = s3->accel.maj_axis_pcnt & 0xfff;
+	s3->accel.sy   = -1;
+	s3->accel.src  = srcbase + s3->accel.cy * s3->width;
+	s3->accel.dest = dstbase + s3->accel.dy * s3->width;
+	return 1;
+}
+
 void
 s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat, s3_t *s3)
 {
@@ -4612,6 +4715,10 @@ s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat, s3_
 		s3->accel.pix_trans[2] = 0xff;
 		s3->accel.pix_trans[3] = 0xff;
 
+		if (!cpu_input && !(s3->accel.cmd & 0x100) &&
+		    s3_accel_fill_fast(s3, dstbase, clip_l, clip_r, clip_t, clip_b, compare_mode, compare))
+			break;
+
 		if (s3->accel.b2e8_pix && count == 16) { /*Stupid undocumented 0xB2E8 on 911/924*/
 			count <<= 8;
 			s3->accel.temp_cnt = 16;
@@ -4833,6 +4940,10 @@ s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat, s3_
 
 		frgd_mix = (s3->accel.frgd_mix >> 5) & 3;
 		bkgd_mix = (s3->accel.bkgd_mix >> 5) & 3;
+
+		if (!cpu_input && frgd_mix == 3 && !vram_mask && compare_mode < 2 &&
+		    s3_accel_blit_fast(s3, srcbase, dstbase, clip_l, clip_r, clip_t, clip_b))
+			break;
 		
 		if (!cpu_input && frgd_mix == 3 && !vram_mask && !compare_mode &&
 		    (s3->accel.cmd & 0xa0) == 0xa0 && (s3->accel.frgd_mix & 0xf) == 7 &&
@@ -6158,6 +6269,46 @@ static void s3_force_redraw(void *p)
 	s3->svga.fullchange = changeframecount;
 }
 
+static void s3_save_state(void *p, savestate_t *st)
+{
+	s3_t *s3 = (s3_t *)p;
+
+	/*Let the FIFO thread finish any queued accelerator writes, so that
+	  it does not touch the state while it is being transferred*/
+	s3_wait_fifo_idle(s3);
+
+	savestate_var(st, s3->bank);
+	savestate_var(st, s3->ma_ext);
+	savestate_var(st, s3->width);
+	savestate_var(st, s3->bpp);
+	savestate_var(st, s3->int_line);
+	savestate_var(st, s3->packed_mmio);
+	savestate_var(st, s3->linear_base);
+	savestate_var(st, s3->linear_size);
+	savestate_var(st, s3->pci_regs);
+	savestate_var(st, s3->data_available);
+	savestate_var(st, s3->accel);
+	savestate_data(st, (void *) &s3->videoengine, sizeof(s3->videoengine));
+	savestate_var(st, s3->streams);
+	savestate_var(st, s3->subsys_cntl);
+	savestate_var(st, s3->subsys_stat);
+	savestate_var(st, s3->hwc_fg_col);
+	savestate_var(st, s3->hwc_bg_col);
+	savestate_var(st, s3->hwc_col_stack_pos);
+	savestate_var(st, s3->serialport);
+
+	svga_save_state(&s3->svga, st);
+
+	if (st->loading && !st->error) {
+		if (s3->pci && !(s3->pci_regs[PCI_REG_COMMAND] & PCI_COMMAND_IO))
+			s3_io_remove(s3);
+		else
+			s3_io_set(s3);
+		s3_updatemapping(s3);
+		s3_update_irqs(s3);
+	}
+}
+
 static const device_config_t s3_orchid_86c911_config[] =
 {
 	{
@@ -6287,7 +6438,8 @@ const device_t s3_orchid_86c911_isa_device =
 	{ s3_orchid_86c911_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_orchid_86c911_config
+	s3_orchid_86c911_config,
+	s3_save_state
 };
 
 const device_t s3_diamond_stealth_vram_isa_device =
@@ -6301,7 +6453,8 @@ const device_t s3_diamond_stealth_vram_isa_device =
 	{ s3_diamond_stealth_vram_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_orchid_86c911_config
+	s3_orchid_86c911_config,
+	s3_save_state
 };
 
 const device_t s3_ami_86c924_isa_device =
@@ -6315,7 +6468,8 @@ const device_t s3_ami_86c924_isa_device =
 	{ s3_ami_86c924_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_orchid_86c911_config
+	s3_orchid_86c911_config,
+	s3_save_state
 };
 
 const device_t s3_v7mirage_86c801_isa_device =
@@ -6329,7 +6483,8 @@ const device_t s3_v7mirage_86c801_isa_device =
 	{ s3_v7mirage_86c801_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_9fx_config
+	s3_9fx_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_86c805_vlb_device =
@@ -6343,7 +6498,8 @@ const device_t s3_phoenix_86c805_vlb_device =
 	{ s3_phoenix_86c805_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_9fx_config
+	s3_9fx_config,
+	s3_save_state
 };
 
 const device_t s3_metheus_86c928_isa_device =
@@ -6357,7 +6513,8 @@ const device_t s3_metheus_86c928_isa_device =
 	{ s3_metheus_86c928_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_metheus_86c928_vlb_device =
@@ -6371,7 +6528,8 @@ const device_t s3_metheus_86c928_vlb_device =
 	{ s3_metheus_86c928_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_metheus_86c928_pci_device =
@@ -6385,7 +6543,8 @@ const device_t s3_metheus_86c928_pci_device =
 	{ s3_metheus_86c928_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_bahamas64_vlb_device =
@@ -6399,7 +6558,8 @@ const device_t s3_bahamas64_vlb_device =
 	{ s3_bahamas64_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_9fx_config
+	s3_9fx_config,
+	s3_save_state
 };
 
 const device_t s3_bahamas64_pci_device =
@@ -6413,7 +6573,8 @@ const device_t s3_bahamas64_pci_device =
 	{ s3_bahamas64_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_9fx_config
+	s3_9fx_config,
+	s3_save_state
 };
 
 const device_t s3_diamond_stealth64_964_vlb_device =
@@ -6427,7 +6588,8 @@ const device_t s3_diamond_stealth64_964_vlb_device =
 	{ s3_diamond_stealth64_964_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_diamond_stealth64_964_pci_device =
@@ -6441,7 +6603,8 @@ const device_t s3_diamond_stealth64_964_pci_device =
 	{ s3_diamond_stealth64_964_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_9fx_vlb_device =
@@ -6455,7 +6618,8 @@ const device_t s3_9fx_vlb_device =
 	{ s3_9fx_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_9fx_config
+	s3_9fx_config,
+	s3_save_state
 };
 
 const device_t s3_9fx_pci_device =
@@ -6469,7 +6633,8 @@ const device_t s3_9fx_pci_device =
 	{ s3_9fx_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_9fx_config
+	s3_9fx_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_trio32_vlb_device =
@@ -6483,7 +6648,8 @@ const device_t s3_phoenix_trio32_vlb_device =
 	{ s3_phoenix_trio32_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_phoenix_trio32_config
+	s3_phoenix_trio32_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_trio32_pci_device =
@@ -6497,7 +6663,8 @@ const device_t s3_phoenix_trio32_pci_device =
 	{ s3_phoenix_trio32_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_phoenix_trio32_config
+	s3_phoenix_trio32_config,
+	s3_save_state
 };
 
 const device_t s3_diamond_stealth_se_vlb_device =
@@ -6511,7 +6678,8 @@ const device_t s3_diamond_stealth_se_vlb_device =
 	{ s3_diamond_stealth_se_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_phoenix_trio32_config
+	s3_phoenix_trio32_config,
+	s3_save_state
 };
 
 const device_t s3_diamond_stealth_se_pci_device =
@@ -6525,7 +6693,8 @@ const device_t s3_diamond_stealth_se_pci_device =
 	{ s3_diamond_stealth_se_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_phoenix_trio32_config
+	s3_phoenix_trio32_config,
+	s3_save_state
 };
 
 
@@ -6540,7 +6709,8 @@ const device_t s3_phoenix_trio64_vlb_device =
 	{ s3_phoenix_trio64_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_trio64_onboard_pci_device =
@@ -6554,7 +6724,8 @@ const device_t s3_phoenix_trio64_onboard_pci_device =
 	{ NULL },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_trio64_pci_device =
@@ -6568,7 +6739,8 @@ const device_t s3_phoenix_trio64_pci_device =
 	{ s3_phoenix_trio64_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_trio64vplus_vlb_device =
@@ -6582,7 +6754,8 @@ const device_t s3_phoenix_trio64vplus_vlb_device =
 	{ s3_phoenix_trio64vplus_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_trio64vplus_onboard_pci_device =
@@ -6596,7 +6769,8 @@ const device_t s3_phoenix_trio64vplus_onboard_pci_device =
 	{ NULL },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_trio64vplus_pci_device =
@@ -6610,7 +6784,8 @@ const device_t s3_phoenix_trio64vplus_pci_device =
 	{ s3_phoenix_trio64vplus_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_vision864_vlb_device =
@@ -6624,7 +6799,8 @@ const device_t s3_phoenix_vision864_vlb_device =
 	{ s3_phoenix_vision864_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_vision864_pci_device =
@@ -6638,7 +6814,8 @@ const device_t s3_phoenix_vision864_pci_device =
 	{ s3_phoenix_vision864_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_vision868_vlb_device =
@@ -6652,7 +6829,8 @@ const device_t s3_phoenix_vision868_vlb_device =
 	{ s3_phoenix_vision868_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_phoenix_vision868_pci_device =
@@ -6666,7 +6844,8 @@ const device_t s3_phoenix_vision868_pci_device =
 	{ s3_phoenix_vision868_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_standard_config
+	s3_standard_config,
+	s3_save_state
 };
 
 const device_t s3_diamond_stealth64_vlb_device =
@@ -6680,7 +6859,8 @@ const device_t s3_diamond_stealth64_vlb_device =
 	{ s3_diamond_stealth64_764_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_9fx_config
+	s3_9fx_config,
+	s3_save_state
 };
 
 const device_t s3_diamond_stealth64_pci_device =
@@ -6694,7 +6874,8 @@ const device_t s3_diamond_stealth64_pci_device =
 	{ s3_diamond_stealth64_764_available },
 	s3_speed_changed,
 	s3_force_redraw,
-	s3_9fx_config
+	s3_9fx_config,
+	s3_save_state
 };
 
 const device_t s3_elsa_winner2000_pro_x_964_pci_device =
@@ -6708,7 +6889,8 @@ const device_t s3_elsa_winner2000_pro_x_964_pci_device =
         { s3_elsa_winner2000_pro_x_964_available },
         s3_speed_changed,
         s3_force_redraw,
-        s3_968_config
+        s3_968_config,
+        s3_save_state
 };
 
 const device_t s3_elsa_winner2000_pro_x_964_vlb_device =
@@ -6722,7 +6904,8 @@ const device_t s3_elsa_winner2000_pro_x_964_vlb_device =
         { s3_elsa_winner2000_pro_x_964_available },
         s3_speed_changed,
         s3_force_redraw,
-        s3_968_config
+        s3_968_config,
+        s3_save_state
 };
 
 const device_t s3_elsa_winner2000_pro_x_pci_device =
@@ -6736,7 +6919,8 @@ const device_t s3_elsa_winner2000_pro_x_pci_device =
         { s3_elsa_winner2000_pro_x_available },
         s3_speed_changed,
         s3_force_redraw,
-        s3_968_config
+        s3_968_config,
+        s3_save_state
 };
 
 const device_t s3_elsa_winner2000_pro_x_vlb_device =
@@ -6750,7 +6934,8 @@ const device_t s3_elsa_winner2000_pro_x_vlb_device =
         { s3_elsa_winner2000_pro_x_available },
         s3_speed_changed,
         s3_force_redraw,
-        s3_968_config
+        s3_968_config,
+        s3_save_state
 };
 
 
@@ -6765,6 +6950,7 @@ const device_t s3_trio64v2_dx_pci_device =
         { s3_trio64v2_dx_available },
         s3_speed_changed,
         s3_force_redraw,
-        s3_standard_config
+        s3_standard_config,
+        s3_save_state
 };
 
@@ -51,9 +51,14 @@ static int dither[4][4] =
 #define RB_SIZE 256
 #define RB_MASK (RB_SIZE - 1)
 
-#define RB_ENTRIES (virge->s3d_write_idx - virge->s3d_read_idx)
-#define RB_FULL (RB_ENTRIES == RB_SIZE)
-#define RB_EMPTY (!RB_ENTRIES)
+#define RB_ENTRIES(x) (virge->s3d_write_idx - virge->s3d_read_idx[x])
+#define RB_FULL(x) (RB_ENTRIES(x) == RB_SIZE)
+#define RB_EMPTY(x) (!RB_ENTRIES(x))
+
+#define S3D_MAX_RENDER_THREADS 8
+/*Screen lines are split into bands of (1 << S3D_BAND_SHIFT) lines, dealt
+  out to the render threads in turn*/
+#define S3D_BAND_SHIFT 3
 
 #define FIFO_SIZE 65536
 #define FIFO_MASK (FIFO_SIZE - 1)
@@ -150,7 +155,15 @@ typedef struct s3d_t
         uint32_t txs;
         uint32_t tys;
         int ty01, ty12, tlr;
+
+        int sync, serial; /*Set by queue_triangle()*/
 } s3d_t;
+
+typedef struct
+{
+        struct virge_t *virge;
+        int thread;
+} s3d_render_thread_data_t;
         
 typedef struct virge_t
 {
@@ -182,12 +195,18 @@ typedef struct virge_t
         int dithering_enabled;
         int memory_size;
         
-        int pixel_count, tri_count;
-        
-        thread_t *render_thread;
-        event_t *wake_render_thread;
+        int pixel_count[S3D_MAX_RENDER_THREADS], tri_count;
+        uint64_t render_time[S3D_MAX_RENDER_THREADS];
+
+        int render_threads;
+        thread_t *render_thread[S3D_MAX_RENDER_THREADS];
+        s3d_render_thread_data_t render_thread_data[S3D_MAX_RENDER_THREADS];
+        event_t *wake_render_thread[S3D_MAX_RENDER_THREADS];
         event_t *wake_main_thread;
-        event_t *not_full_event;
+        event_t *not_full_event[S3D_MAX_RENDER_THREADS];
+        event_t *render_sync_event[S3D_MAX_RENDER_THREADS];
+        volatile int render_sync_wait[S3D_MAX_RENDER_THREADS];
+        mutex_t *render_mutex;
         
         uint32_t hwc_fg_col, hwc_bg_col;
         int hwc_col_stack_pos;
@@ -240,8 +259,8 @@ typedef struct virge_t
         s3d_t s3d_tri;
 
         s3d_t s3d_buffer[RB_SIZE];
-        int s3d_read_idx, s3d_write_idx;
-        int s3d_busy;
+        volatile int s3d_read_idx[S3D_MAX_RENDER_THREADS], s3d_write_idx;
+        volatile int s3d_busy[S3D_MAX_RENDER_THREADS];
                 
         struct
         {
@@ -303,6 +322,19 @@ static __inline void wake_fifo_thread(virge_t *virge)
         thread_set_event(virge->wake_fifo_thread); /*Wake up FIFO thread if moving from idle*/
 }
 
+static __inline int s3_virge_render_busy(virge_t *virge)
+{
+        int c;
+
+        for (c = 0; c < virge->render_threads; c++)
+        {
+                if (!RB_EMPTY(c) || virge->s3d_busy[c])
+                        return 1;
+        }
+
+        return 0;
+}
+
 static void queue_triangle(virge_t *virge);
 
 static void s3_virge_recalctimings(svga_t *svga);
@@ -895,7 +927,7 @@ s3_virge_mmio_read(uint32_t addr, void *p)
         switch (addr & 0xffff)
         {
                 case 0x8505:
-                if (virge->s3d_busy || virge->virge_busy || !FIFO_EMPTY)
+                if (s3_virge_render_busy(virge) || virge->virge_busy || !FIFO_EMPTY)
                         ret = 0x10;
                 else
                         ret = 0x10 | (1 << 5);
@@ -1016,7 +1048,7 @@ s3_virge_mmio_read_l(uint32_t addr, void *p)
 		break;	
 		
 		case 0x8504:
-		if (virge->s3d_busy || virge->virge_busy || !FIFO_EMPTY)
+		if (s3_virge_render_busy(virge) || virge->virge_busy || !FIFO_EMPTY)
 			ret = (0x10 << 8);
 		else
 			ret = (0x10 << 8) | (1 << 13);
@@ -2175,10 +2207,10 @@ skip_line:
                                   g = (val & 0xff00) >> 8;    \
                                   r = (val & 0xff0000) >> 16
 
-#define RGB15(r, g, b, dest) \
+#define RGB15(r, g, b, x, y, dest) \
         if (virge->dithering_enabled)                           \
         {                                                       \
-                int add = dither[_y & 3][_x & 3];               \
+                int add = dither[(y) & 3][(x) & 3];             \
                 int _r = (r > 248) ? 248 : r+add;               \
                 int _g = (g > 248) ? 248 : g+add;               \
                 int _b = (b > 248) ? 248 : b+add;               \
@@ -2199,21 +2231,24 @@ typedef struct s3d_state_t
         int32_t r, g, b, a, u, v, d, w;
 
         int32_t base_r, base_g, base_b, base_a, base_u, base_v, base_d, base_w;
-        
+
         uint32_t base_z;
 
         uint32_t tbu, tbv;
 
         uint32_t cmd_set;
         int max_d;
-        
+
         uint16_t *texture[10];
-        
+
         uint32_t tex_bdr_clr;
-        
+
         int32_t x1, x2;
         int y;
-        
+
+        int mipmap, persp, persp_shift;
+        int wrap;
+
         rgba_t dest_rgba;
 } s3d_state_t;
 
@@ -2221,472 +2256,148 @@ typedef struct s3d_texture_state_t
 {
         int level;
         int texture_shift;
-        
+
         int32_t u, v;
 } s3d_texture_state_t;
 
-static void (*tex_read)(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out);
-static void (*tex_sample)(s3d_state_t *state);
-static void (*dest_pixel)(s3d_state_t *state);
-
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
-static int _x, _y;
-
-static void tex_ARGB1555(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out)
-{
-        int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
-                     (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
-        uint16_t val = state->texture[texture_state->level][offset];
-
-        out->r = ((val & 0x7c00) >> 7) | ((val & 0x7000) >> 12);
-        out->g = ((val & 0x03e0) >> 2) | ((val & 0x0380) >> 7);
-        out->b = ((val & 0x001f) << 3) | ((val & 0x001c) >> 2);
-        out->a = (val & 0x8000) ? 0xff : 0;
-}
-
-static void tex_ARGB1555_nowrap(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out)
-{
-        int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
-                     (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
-        uint16_t val = state->texture[texture_state->level][offset];
-
-        if (((texture_state->u | texture_state->v) & 0xf8000000) == 0xf8000000)
-                val = state->tex_bdr_clr;
-
-        out->r = ((val & 0x7c00) >> 7) | ((val & 0x7000) >> 12);
-        out->g = ((val & 0x03e0) >> 2) | ((val & 0x0380) >> 7);
-        out->b = ((val & 0x001f) << 3) | ((val & 0x001c) >> 2);
-        out->a = (val & 0x8000) ? 0xff : 0;
-}
+/*The span kernels below are instances of tri_span() for a constant texture
+  format, filter and blend mode, and rely on the per pixel helpers being
+  inlined into them so that those arguments fold away*/
+#if defined(_MSC_VER)
+#define S3D_INLINE __forceinline
+#elif defined(__GNUC__)
+#define S3D_INLINE __inline __attribute__((always_inline))
+#else
+#define S3D_INLINE __inline
+#endif
 
-static void tex_ARGB4444(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out)
+enum
 {
-        int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
-                     (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
-        uint16_t val = state->texture[texture_state->level][offset];
-
-        out->r = ((val & 0x0f00) >> 4) | ((val & 0x0f00) >> 8);
-        out->g = (val & 0x00f0) | ((val & 0x00f0) >> 4);
-        out->b = ((val & 0x000f) << 4) | (val & 0x000f);
-        out->a = ((val & 0xf000) >> 8) | ((val & 0xf000) >> 12);
-}
+        TEX_ARGB8888 = 0,
+        TEX_ARGB4444,
+        TEX_ARGB1555
+};
 
-static void tex_ARGB4444_nowrap(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out)
+enum
 {
-        int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
-                     (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
-        uint16_t val = state->texture[texture_state->level][offset];
-
-        if (((texture_state->u | texture_state->v) & 0xf8000000) == 0xf8000000)
-                val = state->tex_bdr_clr;
-
-        out->r = ((val & 0x0f00) >> 4) | ((val & 0x0f00) >> 8);
-        out->g = (val & 0x00f0) | ((val & 0x00f0) >> 4);
-        out->b = ((val & 0x000f) << 4) | (val & 0x000f);
-        out->a = ((val & 0xf000) >> 8) | ((val & 0xf000) >> 12);
-}
+        BLEND_GOURAUD = 0,
+        BLEND_DECAL, /*Also unlit textures*/
+        BLEND_REFLECTION,
+        BLEND_MODULATE
+};
 
-static void tex_ARGB8888(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out)
+static S3D_INLINE void tex_read(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out, const int format)
 {
         int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
                      (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
-        uint32_t val = ((uint32_t *)state->texture[texture_state->level])[offset];
+        uint32_t val;
 
-        out->r = (val >> 16) & 0xff;
-        out->g = (val >> 8)  & 0xff;
-        out->b =  val        & 0xff;
-        out->a = (val >> 24) & 0xff;
-}
-static void tex_ARGB8888_nowrap(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out)
-{
-        int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
-                     (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
-        uint32_t val = ((uint32_t *)state->texture[texture_state->level])[offset];
+        if (format == TEX_ARGB8888)
+                val = ((uint32_t *)state->texture[texture_state->level])[offset];
+        else
+                val = state->texture[texture_state->level][offset];
 
-        if (((texture_state->u | texture_state->v) & 0xf8000000) == 0xf8000000)
+        if (!state->wrap && (((texture_state->u | texture_state->v) & 0xf8000000) == 0xf8000000))
                 val = state->tex_bdr_clr;
 
-        out->r = (val >> 16) & 0xff;
-        out->g = (val >> 8)  & 0xff;
-        out->b =  val        & 0xff;
-        out->a = (val >> 24) & 0xff;
-}
-
-static void tex_sample_normal(s3d_state_t *state)
-{
-        s3d_texture_state_t texture_state;
-        
-        texture_state.level = state->max_d;
-        texture_state.texture_shift = 18 + (9 - texture_state.level);
-        texture_state.u = state->u + state->tbu;
-        texture_state.v = state->v + state->tbv;
-
-        tex_read(state, &texture_state, &state->dest_rgba);
-}
-
-static void tex_sample_normal_filter(s3d_state_t *state)
-{
-        s3d_texture_state_t texture_state;
-        int tex_offset;
-        rgba_t tex_samples[4];
-        int du, dv;
-        int d[4];
-
-        texture_state.level = state->max_d;
-        texture_state.texture_shift = 18 + (9 - texture_state.level);
-        tex_offset = 1 << texture_state.texture_shift;
-
-        texture_state.u = state->u + state->tbu;
-        texture_state.v = state->v + state->tbv;
-        tex_read(state, &texture_state, &tex_samples[0]);
-        du = (texture_state.u >> (texture_state.texture_shift - 8)) & 0xff;
-        dv = (texture_state.v >> (texture_state.texture_shift - 8)) & 0xff;
-
-        texture_state.u = state->u + state->tbu + tex_offset;
-        texture_state.v = state->v + state->tbv;
-        tex_read(state, &texture_state, &tex_samples[1]);
-
-        texture_state.u = state->u + state->tbu;
-        texture_state.v = state->v + state->tbv + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[2]);
-
-        texture_state.u = state->u + state->tbu + tex_offset;
-        texture_state.v = state->v + state->tbv + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[3]);
-        
-        d[0] = (256 - du) * (256 - dv);
-        d[1] =  du * (256 - dv);
-        d[2] = (256 - du) * dv;
-        d[3] = du * dv;
-        
-        state->dest_rgba.r = (tex_samples[0].r * d[0] + tex_samples[1].r * d[1] + tex_samples[2].r * d[2] + tex_samples[3].r * d[3]) >> 16;
-        state->dest_rgba.g = (tex_samples[0].g * d[0] + tex_samples[1].g * d[1] + tex_samples[2].g * d[2] + tex_samples[3].g * d[3]) >> 16;
-        state->dest_rgba.b = (tex_samples[0].b * d[0] + tex_samples[1].b * d[1] + tex_samples[2].b * d[2] + tex_samples[3].b * d[3]) >> 16;
-        state->dest_rgba.a = (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
-}
-
-static void tex_sample_mipmap(s3d_state_t *state)
-{
-        s3d_texture_state_t texture_state;
-
-        texture_state.level = (state->d < 0) ? state->max_d : state->max_d - ((state->d >> 27) & 0xf);
-        if (texture_state.level < 0)
-                texture_state.level = 0;
-        texture_state.texture_shift = 18 + (9 - texture_state.level);
-        texture_state.u = state->u + state->tbu;
-        texture_state.v = state->v + state->tbv;
-
-        tex_read(state, &texture_state, &state->dest_rgba);
-}
-
-static void tex_sample_mipmap_filter(s3d_state_t *state)
-{
-        s3d_texture_state_t texture_state;
-        int tex_offset;
-        rgba_t tex_samples[4];
-        int du, dv;
-        int d[4];
-
-        texture_state.level = (state->d < 0) ? state->max_d : state->max_d - ((state->d >> 27) & 0xf);
-        if (texture_state.level < 0)
-                texture_state.level = 0;
-        texture_state.texture_shift = 18 + (9 - texture_state.level);
-        tex_offset = 1 << texture_state.texture_shift;
-        
-        texture_state.u = state->u + state->tbu;
-        texture_state.v = state->v + state->tbv;
-        tex_read(state, &texture_state, &tex_samples[0]);
-        du = (texture_state.u >> (texture_state.texture_shift - 8)) & 0xff;
-        dv = (texture_state.v >> (texture_state.texture_shift - 8)) & 0xff;
-
-        texture_state.u = state->u + state->tbu + tex_offset;
-        texture_state.v = state->v + state->tbv;
-        tex_read(state, &texture_state, &tex_samples[1]);
-
-        texture_state.u = state->u + state->tbu;
-        texture_state.v = state->v + state->tbv + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[2]);
-
-        texture_state.u = state->u + state->tbu + tex_offset;
-        texture_state.v = state->v + state->tbv + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[3]);
-
-        d[0] = (256 - du) * (256 - dv);
-        d[1] =  du * (256 - dv);
-        d[2] = (256 - du) * dv;
-        d[3] = du * dv;
-        
-        state->dest_rgba.r = (tex_samples[0].r * d[0] + tex_samples[1].r * d[1] + tex_samples[2].r * d[2] + tex_samples[3].r * d[3]) >> 16;
-        state->dest_rgba.g = (tex_samples[0].g * d[0] + tex_samples[1].g * d[1] + tex_samples[2].g * d[2] + tex_samples[3].g * d[3]) >> 16;
-        state->dest_rgba.b = (tex_samples[0].b * d[0] + tex_samples[1].b * d[1] + tex_samples[2].b * d[2] + tex_samples[3].b * d[3]) >> 16;
-        state->dest_rgba.a = (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
-}
-
-static void tex_sample_persp_normal(s3d_state_t *state)
-{
-        s3d_texture_state_t texture_state;
-        int32_t w = 0;
-
-        if (state->w)
-                w = (int32_t)(((1ULL << 27) << 19) / (int64_t)state->w);
-        
-        texture_state.level = state->max_d;
-        texture_state.texture_shift = 18 + (9 - texture_state.level);      
-        texture_state.u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (12 + state->max_d)) + state->tbu;
-        texture_state.v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (12 + state->max_d)) + state->tbv;
-
-        tex_read(state, &texture_state, &state->dest_rgba);
-}
-
-static void tex_sample_persp_normal_filter(s3d_state_t *state)
-{
-        s3d_texture_state_t texture_state;
-        int32_t w = 0, u, v;
-        int tex_offset;
-        rgba_t tex_samples[4];
-        int du, dv;
-        int d[4];
-
-        if (state->w)
-                w = (int32_t)(((1ULL << 27) << 19) / (int64_t)state->w);
-
-        u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (12 + state->max_d)) + state->tbu;
-        v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (12 + state->max_d)) + state->tbv;
-
-        texture_state.level = state->max_d;
-        texture_state.texture_shift = 18 + (9 - texture_state.level);
-        tex_offset = 1 << texture_state.texture_shift;
-        
-        texture_state.u = u;
-        texture_state.v = v;
-        tex_read(state, &texture_state, &tex_samples[0]);
-        du = (u >> (texture_state.texture_shift - 8)) & 0xff;
-        dv = (v >> (texture_state.texture_shift - 8)) & 0xff;
-
-        texture_state.u = u + tex_offset;
-        texture_state.v = v;
-        tex_read(state, &texture_state, &tex_samples[1]);
-
-        texture_state.u = u;
-        texture_state.v = v + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[2]);
-
-        texture_state.u = u + tex_offset;
-        texture_state.v = v + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[3]);
-
-        d[0] = (256 - du) * (256 - dv);
-        d[1] =  du * (256 - dv);
-        d[2] = (256 - du) * dv;
-        d[3] = du * dv;
-        
-        state->dest_rgba.r = (tex_samples[0].r * d[0] + tex_samples[1].r * d[1] + tex_samples[2].r * d[2] + tex_samples[3].r * d[3]) >> 16;
-        state->dest_rgba.g = (tex_samples[0].g * d[0] + tex_samples[1].g * d[1] + tex_samples[2].g * d[2] + tex_samples[3].g * d[3]) >> 16;
-        state->dest_rgba.b = (tex_samples[0].b * d[0] + tex_samples[1].b * d[1] + tex_samples[2].b * d[2] + tex_samples[3].b * d[3]) >> 16;
-        state->dest_rgba.a = (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
-}
-
-static void tex_sample_persp_normal_375(s3d_state_t *state)
-{
-        s3d_texture_state_t texture_state;
-        int32_t w = 0;
-
-        if (state->w)
-                w = (int32_t)(((1ULL << 27) << 19) / (int64_t)state->w);
-        
-        texture_state.level = state->max_d;
-        texture_state.texture_shift = 18 + (9 - texture_state.level);      
-        texture_state.u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (8 + state->max_d)) + state->tbu;
-        texture_state.v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (8 + state->max_d)) + state->tbv;
-
-        tex_read(state, &texture_state, &state->dest_rgba);
-}
-
-static void tex_sample_persp_normal_filter_375(s3d_state_t *state)
-{
-        s3d_texture_state_t texture_state;
-        int32_t w = 0, u, v;
-        int tex_offset;
-        rgba_t tex_samples[4];
-        int du, dv;
-        int d[4];
-
-        if (state->w)
-                w = (int32_t)(((1ULL << 27) << 19) / (int64_t)state->w);
-
-        u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (8 + state->max_d)) + state->tbu;
-        v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (8 + state->max_d)) + state->tbv;
-        
-        texture_state.level = state->max_d;
-        texture_state.texture_shift = 18 + (9 - texture_state.level);
-        tex_offset = 1 << texture_state.texture_shift;
-
-        texture_state.u = u;
-        texture_state.v = v;
-        tex_read(state, &texture_state, &tex_samples[0]);
-        du = (u >> (texture_state.texture_shift - 8)) & 0xff;
-        dv = (v >> (texture_state.texture_shift - 8)) & 0xff;
-
-        texture_state.u = u + tex_offset;
-        texture_state.v = v;
-        tex_read(state, &texture_state, &tex_samples[1]);
-
-        texture_state.u = u;
-        texture_state.v = v + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[2]);
-
-        texture_state.u = u + tex_offset;
-        texture_state.v = v + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[3]);
-
-        d[0] = (256 - du) * (256 - dv);
-        d[1] =  du * (256 - dv);
-        d[2] = (256 - du) * dv;
-        d[3] = du * dv;
-        
-        state->dest_rgba.r = (tex_samples[0].r * d[0] + tex_samples[1].r * d[1] + tex_samples[2].r * d[2] + tex_samples[3].r * d[3]) >> 16;
-        state->dest_rgba.g = (tex_samples[0].g * d[0] + tex_samples[1].g * d[1] + tex_samples[2].g * d[2] + tex_samples[3].g * d[3]) >> 16;
-        state->dest_rgba.b = (tex_samples[0].b * d[0] + tex_samples[1].b * d[1] + tex_samples[2].b * d[2] + tex_samples[3].b * d[3]) >> 16;
-        state->dest_rgba.a = (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
-}
-
-
-static void tex_sample_persp_mipmap(s3d_state_t *state)
-{
-        s3d_texture_state_t texture_state;
-        int32_t w = 0;
-
-        if (state->w)
-                w = (int32_t)(((1ULL << 27) << 19) / (int64_t)state->w);
-        
-        texture_state.level = (state->d < 0) ? state->max_d : state->max_d - ((state->d >> 27) & 0xf);
-        if (texture_state.level < 0)
-                texture_state.level = 0;
-        texture_state.texture_shift = 18 + (9 - texture_state.level);
-        texture_state.u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (12 + state->max_d)) + state->tbu;
-        texture_state.v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (12 + state->max_d)) + state->tbv;
-
-        tex_read(state, &texture_state, &state->dest_rgba);
-}
-
-static void tex_sample_persp_mipmap_filter(s3d_state_t *state)
-{
-        s3d_texture_state_t texture_state;
-        int32_t w = 0, u, v;
-        int tex_offset;
-        rgba_t tex_samples[4];
-        int du, dv;
-        int d[4];
-
-        if (state->w)
-                w = (int32_t)(((1ULL << 27) << 19) / (int64_t)state->w);
-
-        u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (12 + state->max_d)) + state->tbu;
-        v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (12 + state->max_d)) + state->tbv;
-        
-        texture_state.level = (state->d < 0) ? state->max_d : state->max_d - ((state->d >> 27) & 0xf);
-        if (texture_state.level < 0)
-                texture_state.level = 0;
-        texture_state.texture_shift = 18 + (9 - texture_state.level);
-        tex_offset = 1 << texture_state.texture_shift;
-
-        texture_state.u = u;
-        texture_state.v = v;
-        tex_read(state, &texture_state, &tex_samples[0]);
-        du = (u >> (texture_state.texture_shift - 8)) & 0xff;
-        dv = (v >> (texture_state.texture_shift - 8)) & 0xff;
-
-        texture_state.u = u + tex_offset;
-        texture_state.v = v;
-        tex_read(state, &texture_state, &tex_samples[1]);
-
-        texture_state.u = u;
-        texture_state.v = v + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[2]);
-
-        texture_state.u = u + tex_offset;
-        texture_state.v = v + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[3]);
-
-        d[0] = (256 - du) * (256 - dv);
-        d[1] =  du * (256 - dv);
-        d[2] = (256 - du) * dv;
-        d[3] = du * dv;
-        
-        state->dest_rgba.r = (tex_samples[0].r * d[0] + tex_samples[1].r * d[1] + tex_samples[2].r * d[2] + tex_samples[3].r * d[3]) >> 16;
-        state->dest_rgba.g = (tex_samples[0].g * d[0] + tex_samples[1].g * d[1] + tex_samples[2].g * d[2] + tex_samples[3].g * d[3]) >> 16;
-        state->dest_rgba.b = (tex_samples[0].b * d[0] + tex_samples[1].b * d[1] + tex_samples[2].b * d[2] + tex_samples[3].b * d[3]) >> 16;
-        state->dest_rgba.a = (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
+        switch (format)
+        {
+                case TEX_ARGB8888:
+                out->r = (val >> 16) & 0xff;
+                out->g = (val >> 8)  & 0xff;
+                out->b =  val        & 0xff;
+                out->a = (val >> 24) & 0xff;
+                break;
+                case TEX_ARGB4444:
+                out->r = ((val & 0x0f00) >> 4) | ((val & 0x0f00) >> 8);
+                out->g = (val & 0x00f0) | ((val & 0x00f0) >> 4);
+                out->b = ((val & 0x000f) << 4) | (val & 0x000f);
+                out->a = ((val & 0xf000) >> 8) | ((val & 0xf000) >> 12);
+                break;
+                default:
+                out->r = ((val & 0x7c00) >> 7) | ((val & 0x7000) >> 12);
+                out->g = ((val & 0x03e0) >> 2) | ((val & 0x0380) >> 7);
+                out->b = ((val & 0x001f) << 3) | ((val & 0x001c) >> 2);
+                out->a = (val & 0x8000) ? 0xff : 0;
+                break;
+        }
 }
 
-static void tex_sample_persp_mipmap_375(s3d_state_t *state)
+static S3D_INLINE void tex_sample(s3d_state_t *state, const int format, const int filter)
 {
         s3d_texture_state_t texture_state;
-        int32_t w = 0;
+        int32_t u, v;
 
-        if (state->w)
-                w = (int32_t)(((1ULL << 27) << 19) / (int64_t)state->w);
-        
-        texture_state.level = (state->d < 0) ? state->max_d : state->max_d - ((state->d >> 27) & 0xf);
-        if (texture_state.level < 0)
-                texture_state.level = 0;
+        if (state->mipmap)
+        {
+                texture_state.level = (state->d < 0) ? state->max_d : state->max_d - ((state->d >> 27) & 0xf);
+                if (texture_state.level < 0)
+                        texture_state.level = 0;
+        }
+        else
+                texture_state.level = state->max_d;
         texture_state.texture_shift = 18 + (9 - texture_state.level);
-        texture_state.u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (8 + state->max_d)) + state->tbu;
-        texture_state.v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (8 + state->max_d)) + state->tbv;
 
-        tex_read(state, &texture_state, &state->dest_rgba);
-}
+        if (state->persp)
+        {
+                int32_t w = 0;
 
-static void tex_sample_persp_mipmap_filter_375(s3d_state_t *state)
-{
-        s3d_texture_state_t texture_state;
-        int32_t w = 0, u, v;
-        int tex_offset;
-        rgba_t tex_samples[4];
-        int du, dv;
-        int d[4];
+                if (state->w)
+                        w = (int32_t)(((1ULL << 27) << 19) / (int64_t)state->w);
 
-        if (state->w)
-                w = (int32_t)(((1ULL << 27) << 19) / (int64_t)state->w);
+                u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (state->persp_shift + state->max_d)) + state->tbu;
+                v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (state->persp_shift + state->max_d)) + state->tbv;
+        }
+        else
+        {
+                u = state->u + state->tbu;
+                v = state->v + state->tbv;
+        }
 
-        u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (8 + state->max_d)) + state->tbu;
-        v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (8 + state->max_d)) + state->tbv;
-        
-        texture_state.level = (state->d < 0) ? state->max_d : state->max_d - ((state->d >> 27) & 0xf);
-        if (texture_state.level < 0)
-                texture_state.level = 0;
-        texture_state.texture_shift = 18 + (9 - texture_state.level);
-        tex_offset = 1 << texture_state.texture_shift;
-        
-        texture_state.u = u;
-        texture_state.v = v;
-        tex_read(state, &texture_state, &tex_samples[0]);
-        du = (u >> (texture_state.texture_shift - 8)) & 0xff;
-        dv = (v >> (texture_state.texture_shift - 8)) & 0xff;
-
-        texture_state.u = u + tex_offset;
-        texture_state.v = v;
-        tex_read(state, &texture_state, &tex_samples[1]);
-
-        texture_state.u = u;
-        texture_state.v = v + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[2]);
-
-        texture_state.u = u + tex_offset;
-        texture_state.v = v + tex_offset;
-        tex_read(state, &texture_state, &tex_samples[3]);
-
-        d[0] = (256 - du) * (256 - dv);
-        d[1] =  du * (256 - dv);
-        d[2] = (256 - du) * dv;
-        d[3] = du * dv;
-        
-        state->dest_rgba.r = (tex_samples[0].r * d[0] + tex_samples[1].r * d[1] + tex_samples[2].r * d[2] + tex_samples[3].r * d[3]) >> 16;
-        state->dest_rgba.g = (tex_samples[0].g * d[0] + tex_samples[1].g * d[1] + tex_samples[2].g * d[2] + tex_samples[3].g * d[3]) >> 16;
-        state->dest_rgba.b = (tex_samples[0].b * d[0] + tex_samples[1].b * d[1] + tex_samples[2].b * d[2] + tex_samples[3].b * d[3]) >> 16;
-        state->dest_rgba.a = (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
+        if (filter)
+        {
+                int tex_offset = 1 << texture_state.texture_shift;
+                rgba_t tex_samples[4];
+                int du, dv;
+                int d[4];
+
+                texture_state.u = u;
+                texture_state.v = v;
+                tex_read(state, &texture_state, &tex_samples[0], format);
+                du = (u >> (texture_state.texture_shift - 8)) & 0xff;
+                dv = (v >> (texture_state.texture_shift - 8)) & 0xff;
+
+                texture_state.u = u + tex_offset;
+                texture_state.v = v;
+                tex_read(state, &texture_state, &tex_samples[1], format);
+
+                texture_state.u = u;
+                texture_state.v = v + tex_offset;
+                tex_read(state, &texture_state, &tex_samples[2], format);
+
+                texture_state.u = u + tex_offset;
+                texture_state.v = v + tex_offset;
+                tex_read(state, &texture_state, &tex_samples[3], format);
+
+                d[0] = (256 - du) * (256 - dv);
+                d[1] =  du * (256 - dv);
+                d[2] = (256 - du) * dv;
+                d[3] = du * dv;
+
+                state->dest_rgba.r = (tex_samples[0].r * d[0] + tex_samples[1].r * d[1] + tex_samples[2].r * d[2] + tex_samples[3].r * d[3]) >> 16;
+                state->dest_rgba.g = (tex_samples[0].g * d[0] + tex_samples[1].g * d[1] + tex_samples[2].g * d[2] + tex_samples[3].g * d[3]) >> 16;
+                state->dest_rgba.b = (tex_samples[0].b * d[0] + tex_samples[1].b * d[1] + tex_samples[2].b * d[2] + tex_samples[3].b * d[3]) >> 16;
+                state->dest_rgba.a = (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
+        }
+        else
+        {
+                texture_state.u = u;
+                texture_state.v = v;
+                tex_read(state, &texture_state, &state->dest_rgba, format);
+        }
 }
 
 
@@ -2706,7 +2417,7 @@ static void tex_sample_persp_mipmap_filter_375(s3d_state_t *state)
                         b = ((b) < 0) ? 0 : 0xff;       \
                 if ((a) & ~0xff)                        \
                         a = ((a) < 0) ? 0 : 0xff;
-        
+
 #define CLAMP_RGB(r, g, b) do           \
         {                               \
                 if ((r) < 0)            \
@@ -2724,95 +2435,225 @@ static void tex_sample_persp_mipmap_filter_375(s3d_state_t *state)
         }                               \
         while (0)
 
-static void dest_pixel_gouraud_shaded_triangle(s3d_state_t *state)
+static S3D_INLINE void dest_pixel(s3d_state_t *state, const int blend, const int format, const int filter)
 {
-        state->dest_rgba.r = state->r >> 7;
-        CLAMP(state->dest_rgba.r);
-
-        state->dest_rgba.g = state->g >> 7;
-        CLAMP(state->dest_rgba.g);
+        int r, g, b, a;
 
-        state->dest_rgba.b = state->b >> 7;
-        CLAMP(state->dest_rgba.b);
+        switch (blend)
+        {
+                case BLEND_GOURAUD:
+                state->dest_rgba.r = state->r >> 7;
+                CLAMP(state->dest_rgba.r);
 
-        state->dest_rgba.a = state->a >> 7;
-        CLAMP(state->dest_rgba.a);
-}
+                state->dest_rgba.g = state->g >> 7;
+                CLAMP(state->dest_rgba.g);
 
-static void dest_pixel_unlit_texture_triangle(s3d_state_t *state)
-{
-        tex_sample(state);
+                state->dest_rgba.b = state->b >> 7;
+                CLAMP(state->dest_rgba.b);
 
-        if (state->cmd_set & CMD_SET_ABC_SRC)
                 state->dest_rgba.a = state->a >> 7;
-}
+                CLAMP(state->dest_rgba.a);
+                break;
 
-static void dest_pixel_lit_texture_decal(s3d_state_t *state)
-{
-        tex_sample(state);
+                case BLEND_DECAL:
+                tex_sample(state, format, filter);
 
-        if (state->cmd_set & CMD_SET_ABC_SRC)
-                state->dest_rgba.a = state->a >> 7;
+                if (state->cmd_set & CMD_SET_ABC_SRC)
+                        state->dest_rgba.a = state->a >> 7;
+                break;
+
+                case BLEND_REFLECTION:
+                tex_sample(state, format, filter);
+
+                state->dest_rgba.r += (state->r >> 7);
+                state->dest_rgba.g += (state->g >> 7);
+                state->dest_rgba.b += (state->b >> 7);
+                if (state->cmd_set & CMD_SET_ABC_SRC)
+                        state->dest_rgba.a += (state->a >> 7);
+
+                CLAMP_RGBA(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b, state->dest_rgba.a);
+                break;
+
+                case BLEND_MODULATE:
+                r = state->r >> 7;
+                g = state->g >> 7;
+                b = state->b >> 7;
+                a = state->a >> 7;
+
+                tex_sample(state, format, filter);
+
+                CLAMP_RGBA(r, g, b, a);
+
+                state->dest_rgba.r = ((state->dest_rgba.r) * r) >> 8;
+                state->dest_rgba.g = ((state->dest_rgba.g) * g) >> 8;
+                state->dest_rgba.b = ((state->dest_rgba.b) * b) >> 8;
+
+                if (state->cmd_set & CMD_SET_ABC_SRC)
+                        state->dest_rgba.a = a;
+                break;
+        }
 }
 
-static void dest_pixel_lit_texture_reflection(s3d_state_t *state)
+static S3D_INLINE void tri_span(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int x, int xe, uint32_t dest_addr, uint32_t z_addr, uint32_t z,
+                                const int blend, const int format, const int filter)
 {
-        tex_sample(state);
+	svga_t *svga = &virge->svga;
+        uint8_t *vram = svga->vram;
+
+        int x_dir = s3d_tri->tlr ? 1 : -1;
+
+        int use_z = !(s3d_tri->cmd_set & CMD_SET_ZB_MODE);
+
+        int bpp = (s3d_tri->cmd_set >> 2) & 7;
+
+        int x_offset = x_dir * (bpp + 1);
+        int xz_offset = x_dir << 1;
+
+	uint32_t src_col;
+	int src_r = 0, src_g = 0, src_b = 0;
+
+	int update;
+	uint16_t src_z = 0;
+
+        for (; x != xe; x = (x + x_dir) & 0xfff)
+        {
+                update = 1;
+
+                if (use_z)
+                {
+                        src_z = Z_READ(z_addr);
+                        Z_CLIP(src_z, z >> 16);
+                }
+
+                if (update)
+                {
+                        uint32_t dest_col;
+
+                        dest_pixel(state, blend, format, filter);
+
+                        if (s3d_tri->cmd_set & CMD_SET_ABC_ENABLE)
+                        {
+                                switch (bpp)
+                                {
+                                        case 0: /*8 bpp*/
+                                        /*Not implemented yet*/
+                                        break;
+                                        case 1: /*16 bpp*/
+                                        src_col = *(uint16_t *)&vram[dest_addr & svga->vram_mask];
+                                        RGB15_TO_24(src_col, src_r, src_g, src_b);
+                                        break;
+                                        case 2: /*24 bpp*/
+                                        src_col = (*(uint32_t *)&vram[dest_addr & svga->vram_mask]) & 0xffffff;
+                                        RGB24_TO_24(src_col, src_r, src_g, src_b);
+                                        break;
+                                }
+
+                                state->dest_rgba.r = ((state->dest_rgba.r * state->dest_rgba.a) + (src_r * (255 - state->dest_rgba.a))) / 255;
+                                state->dest_rgba.g = ((state->dest_rgba.g * state->dest_rgba.a) + (src_g * (255 - state->dest_rgba.a))) / 255;
+                                state->dest_rgba.b = ((state->dest_rgba.b * state->dest_rgba.a) + (src_b * (255 - state->dest_rgba.a))) / 255;
+                        }
 
-        state->dest_rgba.r += (state->r >> 7);
-        state->dest_rgba.g += (state->g >> 7);
-        state->dest_rgba.b += (state->b >> 7);
-        if (state->cmd_set & CMD_SET_ABC_SRC)
-                state->dest_rgba.a += (state->a >> 7);
+                        switch (bpp)
+                        {
+                                case 0: /*8 bpp*/
+                                /*Not implemented yet*/
+                                break;
+                                case 1: /*16 bpp*/
+                                RGB15(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b, x, state->y, dest_col);
+                                *(uint16_t *)&vram[dest_addr] = dest_col;
+                                break;
+                                case 2: /*24 bpp*/
+                                dest_col = RGB24(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b);
+                                *(uint8_t *)&vram[dest_addr] = dest_col & 0xff;
+                                *(uint8_t *)&vram[dest_addr + 1] = (dest_col >> 8) & 0xff;
+                                *(uint8_t *)&vram[dest_addr + 2] = (dest_col >> 16) & 0xff;
+                                break;
+                        }
 
-        CLAMP_RGBA(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b, state->dest_rgba.a);
+                        if (use_z && (s3d_tri->cmd_set & CMD_SET_ZUP))
+                                Z_WRITE(z_addr, src_z);
+                }
+
+                z += s3d_tri->TdZdX;
+                state->u += s3d_tri->TdUdX;
+                state->v += s3d_tri->TdVdX;
+                state->r += s3d_tri->TdRdX;
+                state->g += s3d_tri->TdGdX;
+                state->b += s3d_tri->TdBdX;
+                state->a += s3d_tri->TdAdX;
+                state->d += s3d_tri->TdDdX;
+                state->w += s3d_tri->TdWdX;
+                dest_addr += x_offset;
+                z_addr += xz_offset;
+        }
 }
 
-static void dest_pixel_lit_texture_modulate(s3d_state_t *state)
+typedef void (*tri_span_t)(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int x, int xe, uint32_t dest_addr, uint32_t z_addr, uint32_t z);
+
+#define TRI_SPAN(name, blend, format, filter)                                                                                    \
+        static void name(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int x, int xe, uint32_t dest_addr, uint32_t z_addr, uint32_t z) \
+        {                                                                                                                       \
+                tri_span(virge, s3d_tri, state, x, xe, dest_addr, z_addr, z, blend, format, filter);                            \
+        }
+
+#define TRI_SPAN_BLEND(name, blend)                                             \
+        TRI_SPAN(name ## _argb8888,        blend, TEX_ARGB8888, 0)              \
+        TRI_SPAN(name ## _argb8888_filter, blend, TEX_ARGB8888, 1)              \
+        TRI_SPAN(name ## _argb4444,        blend, TEX_ARGB4444, 0)              \
+        TRI_SPAN(name ## _argb4444_filter, blend, TEX_ARGB4444, 1)              \
+        TRI_SPAN(name ## _argb1555,        blend, TEX_ARGB1555, 0)              \
+        TRI_SPAN(name ## _argb1555_filter, blend, TEX_ARGB1555, 1)
+
+TRI_SPAN(tri_span_gouraud, BLEND_GOURAUD, TEX_ARGB8888, 0)
+TRI_SPAN_BLEND(tri_span_decal, BLEND_DECAL)
+TRI_SPAN_BLEND(tri_span_reflection, BLEND_REFLECTION)
+TRI_SPAN_BLEND(tri_span_modulate, BLEND_MODULATE)
+
+/*Indexed by blend mode - 1, texture format and filter*/
+static const tri_span_t tri_span_textured[3][3][2] =
 {
-        int r = state->r >> 7, g = state->g >> 7, b = state->b >> 7, a = state->a >> 7;
-        
-        tex_sample(state);
-        
-        CLAMP_RGBA(r, g, b, a);
-        
-        state->dest_rgba.r = ((state->dest_rgba.r) * r) >> 8;
-        state->dest_rgba.g = ((state->dest_rgba.g) * g) >> 8;
-        state->dest_rgba.b = ((state->dest_rgba.b) * b) >> 8;
+        {
+                {tri_span_decal_argb8888, tri_span_decal_argb8888_filter},
+                {tri_span_decal_argb4444, tri_span_decal_argb4444_filter},
+                {tri_span_decal_argb1555, tri_span_decal_argb1555_filter}
+        },
+        {
+                {tri_span_reflection_argb8888, tri_span_reflection_argb8888_filter},
+                {tri_span_reflection_argb4444, tri_span_reflection_argb4444_filter},
+                {tri_span_reflection_argb1555, tri_span_reflection_argb1555_filter}
+        },
+        {
+                {tri_span_modulate_argb8888, tri_span_modulate_argb8888_filter},
+                {tri_span_modulate_argb4444, tri_span_modulate_argb4444_filter},
+                {tri_span_modulate_argb1555, tri_span_modulate_argb1555_filter}
+        }
+};
 
-        if (state->cmd_set & CMD_SET_ABC_SRC)
-                state->dest_rgba.a = a;
+/*Render thread that draws the given screen line*/
+static __inline int s3_virge_line_thread(virge_t *virge, int y)
+{
+        return ((uint32_t)y >> S3D_BAND_SHIFT) % virge->render_threads;
 }
 
-static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int32_t dx1, int32_t dx2)
+static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, tri_span_t span, int thread, int yc, int32_t dx1, int32_t dx2)
 {
 	svga_t *svga = &virge->svga;
-        uint8_t *vram = svga->vram;
 
         int x_dir = s3d_tri->tlr ? 1 : -1;
-        
-        int use_z = !(s3d_tri->cmd_set & CMD_SET_ZB_MODE);
 
         int y_count = yc;
-        
+
         int bpp = (s3d_tri->cmd_set >> 2) & 7;
-        
-        uint32_t dest_offset = 0, z_offset = 0;
 
-	uint32_t src_col;
-	int src_r = 0, src_g = 0, src_b = 0;
+        int banded = (virge->render_threads > 1) && !s3d_tri->serial;
+
+        uint32_t dest_offset = 0, z_offset = 0;
 
 	int x;
 	int xe;
 	uint32_t z;
 
-	uint32_t dest_addr, z_addr;
 	int dx;
-	int x_offset;
-	int xz_offset;
-
-	int update;
-	uint16_t src_z = 0;
 
         if (s3d_tri->cmd_set & CMD_SET_HC)
         {
@@ -2821,10 +2662,10 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
                 if (state->y > s3d_tri->clip_b)
                 {
                         int diff_y = state->y - s3d_tri->clip_b;
-                        
+
                         if (diff_y > y_count)
                                 diff_y = y_count;
-                        
+
                         state->base_u += (s3d_tri->TdUdY * diff_y);
                         state->base_v += (s3d_tri->TdVdY * diff_y);
                         state->base_z += (s3d_tri->TdZdY * diff_y);
@@ -2847,9 +2688,14 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
 
         dest_offset = s3d_tri->dest_base + (state->y * s3d_tri->dest_str);
         z_offset = s3d_tri->z_base + (state->y * s3d_tri->z_str);
-        
+
         for (; y_count > 0; y_count--)
         {
+                /*Lines of other bands are left to their own render threads,
+                  but still step the edges so every thread sees the same state*/
+                if (banded && (s3_virge_line_thread(virge, state->y) != thread))
+                        goto tri_skip_line;
+
                 x  = (state->x1 + ((1 << 20) - 1)) >> 20;
                 xe = (state->x2 + ((1 << 20) - 1)) >> 20;
                 z = (state->base_z > 0) ? (state->base_z << 1) : 0;
@@ -2862,8 +2708,6 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
                 if (((x != xe) && ((x_dir > 0) && (x < xe))) || ((x_dir < 0) && (x > xe)))
                 {
                         dx = (x_dir > 0) ? ((31 - ((state->x1-1) >> 15)) & 0x1f) : (((state->x1-1) >> 15) & 0x1f);
-                        x_offset = x_dir * (bpp + 1);
-                        xz_offset = x_dir << 1;
                         if (x_dir > 0)
                                 dx += 1;
                         state->r = state->base_r + ((s3d_tri->TdRdX * dx) >> 5);
@@ -2889,7 +2733,7 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
                                         if (x < s3d_tri->clip_l)
                                         {
                                                 int diff_x = s3d_tri->clip_l - x;
-                                                
+
                                                 z += (s3d_tri->TdZdX * diff_x);
                                                 state->u += (s3d_tri->TdUdX * diff_x);
                                                 state->v += (s3d_tri->TdVdX * diff_x);
@@ -2899,7 +2743,7 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
                                                 state->a += (s3d_tri->TdAdX * diff_x);
                                                 state->d += (s3d_tri->TdDdX * diff_x);
                                                 state->w += (s3d_tri->TdWdX * diff_x);
-                                                
+
                                                 x = s3d_tri->clip_l;
                                         }
                                 }
@@ -2914,7 +2758,7 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
                                         if (x > s3d_tri->clip_r)
                                         {
                                                 int diff_x = x - s3d_tri->clip_r;
-                                                
+
                                                 z += (s3d_tri->TdZdX * diff_x);
                                                 state->u += (s3d_tri->TdUdX * diff_x);
                                                 state->v += (s3d_tri->TdVdX * diff_x);
@@ -2924,7 +2768,7 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
                                                 state->a += (s3d_tri->TdAdX * diff_x);
                                                 state->d += (s3d_tri->TdDdX * diff_x);
                                                 state->w += (s3d_tri->TdWdX * diff_x);
-                                                
+
                                                 x = s3d_tri->clip_r;
                                         }
                                 }
@@ -2932,85 +2776,8 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
 
                         virge->svga.changedvram[(dest_offset & svga->vram_mask) >> 12] = changeframecount;
 
-                        dest_addr = dest_offset + (x * (bpp + 1));
-                        z_addr = z_offset + (x << 1);
-
-                        x &= 0xfff;
-                        xe &= 0xfff;			
-			
-                        for (; x != xe; x = (x + x_dir) & 0xfff)
-                        {
-                                update = 1;
-                                _x = x; _y = state->y;
-
-                                if (use_z)
-                                {
-                                        src_z = Z_READ(z_addr);
-                                        Z_CLIP(src_z, z >> 16);
-                                }
-
-                                if (update)
-                                {
-                                        uint32_t dest_col;
-
-                                        dest_pixel(state);
-
-                                        if (s3d_tri->cmd_set & CMD_SET_ABC_ENABLE)
-                                        {
-                                                switch (bpp)
-                                                {
-                                                        case 0: /*8 bpp*/
-                                                        /*Not implemented yet*/
-                                                        break;
-                                                        case 1: /*16 bpp*/
-                                                        src_col = *(uint16_t *)&vram[dest_addr & svga->vram_mask];
-                                                        RGB15_TO_24(src_col, src_r, src_g, src_b);
-                                                        break;
-                                                        case 2: /*24 bpp*/
-                                                        src_col = (*(uint32_t *)&vram[dest_addr & svga->vram_mask]) & 0xffffff;
-                                                        RGB24_TO_24(src_col, src_r, src_g, src_b);
-                                                        break;
-                                                }
-
-                                                state->dest_rgba.r = ((state->dest_rgba.r * state->dest_rgba.a) + (src_r * (255 - state->dest_rgba.a))) / 255;
-                                                state->dest_rgba.g = ((state->dest_rgba.g * state->dest_rgba.a) + (src_g * (255 - state->dest_rgba.a))) / 255;
-                                                state->dest_rgba.b = ((state->dest_rgba.b * state->dest_rgba.a) + (src_b * (255 - state->dest_rgba.a))) / 255;
-                                        }
-
-                                        switch (bpp)
-                                        {
-                                                case 0: /*8 bpp*/ 
-                                                /*Not implemented yet*/
-                                                break;
-                                                case 1: /*16 bpp*/
-                                                RGB15(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b, dest_col);
-                                                *(uint16_t *)&vram[dest_addr] = dest_col;
-                                                break;
-                                                case 2: /*24 bpp*/
-                                                dest_col = RGB24(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b);
-                                                *(uint8_t *)&vram[dest_addr] = dest_col & 0xff;
-                                                *(uint8_t *)&vram[dest_addr + 1] = (dest_col >> 8) & 0xff;
-                                                *(uint8_t *)&vram[dest_addr + 2] = (dest_col >> 16) & 0xff;
-                                                break;
-                                        }
-
-                                        if (use_z && (s3d_tri->cmd_set & CMD_SET_ZUP))
-                                                Z_WRITE(z_addr, src_z);
-                                }
-
-                                z += s3d_tri->TdZdX;
-                                state->u += s3d_tri->TdUdX;
-                                state->v += s3d_tri->TdVdX;
-                                state->r += s3d_tri->TdRdX;
-                                state->g += s3d_tri->TdGdX;
-                                state->b += s3d_tri->TdBdX;
-                                state->a += s3d_tri->TdAdX;
-                                state->d += s3d_tri->TdDdX;
-                                state->w += s3d_tri->TdWdX;
-                                dest_addr += x_offset;
-                                z_addr += xz_offset;
-                                virge->pixel_count++;
-                        }
+                        span(virge, s3d_tri, state, x & 0xfff, xe & 0xfff, dest_offset + (x * (bpp + 1)), z_offset + (x << 1), z);
+                        virge->pixel_count[thread] += ((xe - x) * x_dir) & 0xfff;
                 }
 tri_skip_line:
                 state->x1 += dx1;
@@ -3042,23 +2809,30 @@ static int tex_size[8] =
         1*2
 };
 
-static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri)
+static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri, int thread)
 {
         s3d_state_t state;
+        tri_span_t span;
 
         uint32_t tex_base;
         int c;
+        int blend, format, filter;
 
         uint64_t start_time = plat_timer_read();
         uint64_t end_time;
 
+        /*Triangles that may overlap themselves between lines are drawn by
+          the first render thread alone*/
+        if (s3d_tri->serial && thread)
+                return;
+
         state.tbu = s3d_tri->tbu << 11;
         state.tbv = s3d_tri->tbv << 11;
-        
+
         state.max_d = (s3d_tri->cmd_set >> 8) & 15;
-        
+
         state.tex_bdr_clr = s3d_tri->tex_bdr_clr;
-        
+
         state.cmd_set = s3d_tri->cmd_set;
 
         state.base_u = s3d_tri->tus;
@@ -3070,7 +2844,7 @@ static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri)
         state.base_a = (int32_t)s3d_tri->tas;
         state.base_d = s3d_tri->tds;
         state.base_w = s3d_tri->tws;
-        
+
         tex_base = s3d_tri->tex_base;
         for (c = 9; c >= 0; c--)
         {
@@ -3082,20 +2856,20 @@ static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri)
         switch ((s3d_tri->cmd_set >> 27) & 0xf)
         {
                 case 0:
-                dest_pixel = dest_pixel_gouraud_shaded_triangle;
+                blend = BLEND_GOURAUD;
                 break;
                 case 1:
                 case 5:
                 switch ((s3d_tri->cmd_set >> 15) & 0x3)
                 {
                         case 0:
-                        dest_pixel = dest_pixel_lit_texture_reflection;
+                        blend = BLEND_REFLECTION;
                         break;
                         case 1:
-                        dest_pixel = dest_pixel_lit_texture_modulate;
+                        blend = BLEND_MODULATE;
                         break;
                         case 2:
-                        dest_pixel = dest_pixel_lit_texture_decal;
+                        blend = BLEND_DECAL;
                         break;
                         default:
                         s3_virge_log("bad triangle type %x\n", (s3d_tri->cmd_set >> 27) & 0xf);
@@ -3104,135 +2878,218 @@ static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri)
                 break;
                 case 2:
                 case 6:
-                dest_pixel = dest_pixel_unlit_texture_triangle;
+                blend = BLEND_DECAL;
                 break;
                 default:
                 s3_virge_log("bad triangle type %x\n", (s3d_tri->cmd_set >> 27) & 0xf);
                 return;
-        }        
-        
-        switch (((s3d_tri->cmd_set >> 12) & 7) | ((s3d_tri->cmd_set & (1 << 29)) ? 8 : 0))
-        {
-                case 0: case 1:
-                tex_sample = tex_sample_mipmap;
-                break;
-                case 2: case 3:
-                tex_sample = virge->bilinear_enabled ? tex_sample_mipmap_filter : tex_sample_mipmap;
-                break;
-                case 4: case 5:
-                tex_sample = tex_sample_normal;
-                break;
-                case 6: case 7:
-                tex_sample = virge->bilinear_enabled ? tex_sample_normal_filter : tex_sample_normal;
-                break;
-                case (0 | 8): case (1 | 8):
-#if defined(DEV_BRANCH) && defined(USE_S3TRIO3D2X)
-		if (virge->chip == S3_VIRGEDX || virge->chip == S3_TRIO3D2X)
-#else
-		if (virge->chip == S3_VIRGEDX)
-#endif
-                        tex_sample = tex_sample_persp_mipmap_375;
-                else
-                        tex_sample = tex_sample_persp_mipmap;
-                break;
-                case (2 | 8): case (3 | 8):
-#if defined(DEV_BRANCH) && defined(USE_S3TRIO3D2X)
-		if (virge->chip == S3_VIRGEDX || virge->chip == S3_TRIO3D2X)
-#else
-		if (virge->chip == S3_VIRGEDX)
-#endif
-                        tex_sample = virge->bilinear_enabled ? tex_sample_persp_mipmap_filter_375 : tex_sample_persp_mipmap_375;
-                else
-                        tex_sample = virge->bilinear_enabled ? tex_sample_persp_mipmap_filter : tex_sample_persp_mipmap;
-                break;
-                case (4 | 8): case (5 | 8):
-#if defined(DEV_BRANCH) && defined(USE_S3TRIO3D2X)
-		if (virge->chip == S3_VIRGEDX || virge->chip == S3_TRIO3D2X)
-#else
-		if (virge->chip == S3_VIRGEDX)
-#endif
-                        tex_sample = tex_sample_persp_normal_375;
-                else
-                        tex_sample = tex_sample_persp_normal;
-                break;
-                case (6 | 8): case (7 | 8):
+        }
+
+        /*Bits 12-14 select mipmapping and filtering, bit 29 perspective
+          correction*/
+        state.mipmap = !(s3d_tri->cmd_set & (4 << 12));
+        filter = virge->bilinear_enabled && (s3d_tri->cmd_set & (2 << 12));
+        state.persp = !!(s3d_tri->cmd_set & (1 << 29));
 #if defined(DEV_BRANCH) && defined(USE_S3TRIO3D2X)
-		if (virge->chip == S3_VIRGEDX || virge->chip == S3_TRIO3D2X)
+	if (virge->chip == S3_VIRGEDX || virge->chip == S3_TRIO3D2X)
 #else
-		if (virge->chip == S3_VIRGEDX)
+	if (virge->chip == S3_VIRGEDX)
 #endif
-                        tex_sample = virge->bilinear_enabled ? tex_sample_persp_normal_filter_375 : tex_sample_persp_normal_375;
-                else
-                        tex_sample = virge->bilinear_enabled ? tex_sample_persp_normal_filter : tex_sample_persp_normal;
-                break;
-        }
-        
+                state.persp_shift = 8;
+        else
+                state.persp_shift = 12;
+
+        state.wrap = !!(s3d_tri->cmd_set & CMD_SET_TWE);
         switch ((s3d_tri->cmd_set >> 5) & 7)
         {
                 case 0:
-                tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB8888 : tex_ARGB8888_nowrap;
+                format = TEX_ARGB8888;
                 break;
                 case 1:
-                tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB4444 : tex_ARGB4444_nowrap;
+                format = TEX_ARGB4444;
                 break;
                 case 2:
-                tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB1555 : tex_ARGB1555_nowrap;
+                format = TEX_ARGB1555;
                 break;
                 default:
                 s3_virge_log("bad texture type %i\n", (s3d_tri->cmd_set >> 5) & 7);
-                tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB1555 : tex_ARGB1555_nowrap;
+                format = TEX_ARGB1555;
                 break;
         }
 
+        if (blend == BLEND_GOURAUD)
+                span = tri_span_gouraud;
+        else
+                span = tri_span_textured[blend - 1][format][filter];
+
         state.y  = s3d_tri->tys;
         state.x1 = s3d_tri->txs;
         state.x2 = s3d_tri->txend01;
-        tri(virge, s3d_tri, &state, s3d_tri->ty01, s3d_tri->TdXdY02, s3d_tri->TdXdY01);
+        tri(virge, s3d_tri, &state, span, thread, s3d_tri->ty01, s3d_tri->TdXdY02, s3d_tri->TdXdY01);
         state.x2 = s3d_tri->txend12;
-        tri(virge, s3d_tri, &state, s3d_tri->ty12, s3d_tri->TdXdY02, s3d_tri->TdXdY12);
+        tri(virge, s3d_tri, &state, span, thread, s3d_tri->ty12, s3d_tri->TdXdY02, s3d_tri->TdXdY12);
 
-        virge->tri_count++;
+        if (!thread)
+                virge->tri_count++;
 
         end_time = plat_timer_read();
-        
-        virge_time += end_time - start_time;
+
+        virge->render_time[thread] += end_time - start_time;
+}
+
+/*Wait until the other render threads have drawn every triangle queued before
+  the one this thread is about to draw*/
+static void s3_virge_render_sync(virge_t *virge, int thread)
+{
+        int idx = virge->s3d_read_idx[thread];
+        int c;
+
+        for (c = 0; c < virge->render_threads; c++)
+        {
+                while ((c != thread) && ((idx - virge->s3d_read_idx[c]) > 0))
+                {
+                        thread_reset_event(virge->render_sync_event[thread]);
+                        virge->render_sync_wait[thread] = 1;
+                        if ((idx - virge->s3d_read_idx[c]) > 0)
+                                thread_wait_event(virge->render_sync_event[thread], 1);
+                }
+        }
+
+        virge->render_sync_wait[thread] = 0;
 }
 
 static void render_thread(void *param)
 {
-        virge_t *virge = (virge_t *)param;
-        
+        s3d_render_thread_data_t *data = (s3d_render_thread_data_t *)param;
+        virge_t *virge = data->virge;
+        int thread = data->thread;
+        int c, done;
+
         while (1)
         {
-                thread_wait_event(virge->wake_render_thread, -1);
-                thread_reset_event(virge->wake_render_thread);
-                virge->s3d_busy = 1;
-                while (!RB_EMPTY)
+                thread_wait_event(virge->wake_render_thread[thread], -1);
+                thread_reset_event(virge->wake_render_thread[thread]);
+                done = 0;
+
+                while (virge->s3d_busy[thread])
                 {
-                        s3_virge_triangle(virge, &virge->s3d_buffer[virge->s3d_read_idx & RB_MASK]);
-                        virge->s3d_read_idx++;
-                        
-                        if (RB_ENTRIES == RB_SIZE - 1)
-                                thread_set_event(virge->not_full_event);
+                        while (!RB_EMPTY(thread))
+                        {
+                                s3d_t *s3d_tri = &virge->s3d_buffer[virge->s3d_read_idx[thread] & RB_MASK];
+
+                                if (s3d_tri->sync && (virge->render_threads > 1))
+                                        s3_virge_render_sync(virge, thread);
+
+                                s3_virge_triangle(virge, s3d_tri, thread);
+                                virge->s3d_read_idx[thread]++;
+
+                                if (RB_ENTRIES(thread) == RB_SIZE - 1)
+                                        thread_set_event(virge->not_full_event[thread]);
+
+                                for (c = 0; c < virge->render_threads; c++)
+                                {
+                                        if (virge->render_sync_wait[c])
+                                                thread_set_event(virge->render_sync_event[c]);
+                                }
+                        }
+
+                        /*Going idle is serialised with queue_triangle(), so
+                          that exactly one thread sees the whole engine finish*/
+                        thread_wait_mutex(virge->render_mutex);
+                        if (RB_EMPTY(thread))
+                        {
+                                virge->s3d_busy[thread] = 0;
+                                done = !s3_virge_render_busy(virge);
+                        }
+                        thread_release_mutex(virge->render_mutex);
+                }
+
+                if (done)
+                {
+                        virge->subsys_stat |= INT_S3D_DONE;
+                        s3_virge_update_irqs(virge);
                 }
-                virge->s3d_busy = 0;
-                virge->subsys_stat |= INT_S3D_DONE;
-                s3_virge_update_irqs(virge);
         }
 }
 
+/*Whether a triangle can write the same memory from two different lines, in
+  which case it can not be split between render threads. The edges are
+  straight, so their end points bound every span*/
+static int s3_virge_tri_serial(s3d_t *s3d_tri)
+{
+        int bpp = ((s3d_tri->cmd_set >> 2) & 7) + 1;
+        int64_t x[6];
+        int64_t x_min, x_max;
+        int c;
+
+        x[0] = (int32_t)s3d_tri->txs;
+        x[1] = x[0] + (int64_t)(int32_t)s3d_tri->TdXdY02 * (s3d_tri->ty01 + s3d_tri->ty12);
+        x[2] = (int32_t)s3d_tri->txend01;
+        x[3] = x[2] + (int64_t)(int32_t)s3d_tri->TdXdY01 * s3d_tri->ty01;
+        x[4] = (int32_t)s3d_tri->txend12;
+        x[5] = x[4] + (int64_t)(int32_t)s3d_tri->TdXdY12 * s3d_tri->ty12;
+
+        x_min = x_max = x[0];
+        for (c = 1; c < 6; c++)
+        {
+                x_min = MIN(x_min, x[c]);
+                x_max = MAX(x_max, x[c]);
+        }
+        x_min = (x_min >> 20) - 1;
+        x_max = (x_max >> 20) + 1;
+        if (s3d_tri->cmd_set & CMD_SET_HC)
+        {
+                x_min = MAX(x_min, s3d_tri->clip_l);
+                x_max = MIN(x_max, s3d_tri->clip_r);
+        }
+
+        if ((x_min < 0) || (((x_max + 1) * bpp) > s3d_tri->dest_str))
+                return 1;
+        if (!(s3d_tri->cmd_set & CMD_SET_ZB_MODE) && (((x_max + 1) * 2) > s3d_tri->z_str))
+                return 1;
+
+        return 0;
+}
+
 static void queue_triangle(virge_t *virge)
 {
-        if (RB_FULL)
+        s3d_t *s3d_tri = &virge->s3d_buffer[virge->s3d_write_idx & RB_MASK];
+        s3d_t *prev = &virge->s3d_buffer[(virge->s3d_write_idx - 1) & RB_MASK];
+        int c;
+
+        for (c = 0; c < virge->render_threads; c++)
         {
-                thread_reset_event(virge->not_full_event);
-                if (RB_FULL)
-                        thread_wait_event(virge->not_full_event, -1); /*Wait for room in ringbuffer*/
+                if (RB_FULL(c))
+                {
+                        thread_reset_event(virge->not_full_event[c]);
+                        if (RB_FULL(c))
+                                thread_wait_event(virge->not_full_event[c], -1); /*Wait for room in ringbuffer*/
+                }
         }
-        virge->s3d_buffer[virge->s3d_write_idx & RB_MASK] = virge->s3d_tri;
+
+        *s3d_tri = virge->s3d_tri;
+
+        /*Render threads only draw their own bands of lines, which is safe as
+          long as triangles keep to the same buffers. Anything that changes
+          the buffers, such as a new frame or rendering to a texture, waits
+          for all earlier triangles to be drawn first*/
+        s3d_tri->serial = s3_virge_tri_serial(s3d_tri);
+        s3d_tri->sync = s3d_tri->serial || prev->serial ||
+                        (s3d_tri->dest_base != prev->dest_base) || (s3d_tri->dest_str != prev->dest_str) ||
+                        (s3d_tri->z_base != prev->z_base) || (s3d_tri->z_str != prev->z_str) ||
+                        (s3d_tri->tex_base != prev->tex_base);
+
+        thread_wait_mutex(virge->render_mutex);
         virge->s3d_write_idx++;
-        if (!virge->s3d_busy)
-                thread_set_event(virge->wake_render_thread); /*Wake up render thread if moving from idle*/
+        for (c = 0; c < virge->render_threads; c++)
+        {
+                if (!virge->s3d_busy[c])
+                {
+                        virge->s3d_busy[c] = 1;
+                        thread_set_event(virge->wake_render_thread[c]); /*Wake up render thread if moving from idle*/
+                }
+        }
+        thread_release_mutex(virge->render_mutex);
 }
 
 static void s3_virge_hwcursor_draw(svga_t *svga, int displine)
@@ -3686,12 +3543,18 @@ static void *s3_virge_init(const device_t *info)
 {
 	const wchar_t *bios_fn;
         virge_t *virge = malloc(sizeof(virge_t));
+        int c;
 
         memset(virge, 0, sizeof(virge_t));
 
         virge->bilinear_enabled = device_get_config_int("bilinear");
         virge->dithering_enabled = device_get_config_int("dithering");
         virge->memory_size = device_get_config_int("memory");
+        virge->render_threads = device_get_config_int("render_threads");
+        if (virge->render_threads < 1)
+                virge->render_threads = 1;
+        if (virge->render_threads > S3D_MAX_RENDER_THREADS)
+                virge->render_threads = S3D_MAX_RENDER_THREADS;
         
 	switch(info->local) {
 		case S3_VIRGE_325:
@@ -3861,10 +3724,20 @@ static void *s3_virge_init(const device_t *info)
         if (info->flags & DEVICE_PCI)
 	        virge->card = pci_add_card(PCI_ADD_VIDEO, s3_virge_pci_read, s3_virge_pci_write, virge);
 
-        virge->wake_render_thread = thread_create_event();
+        virge->render_mutex = thread_create_mutex();
         virge->wake_main_thread = thread_create_event();
-        virge->not_full_event = thread_create_event();
-        virge->render_thread = thread_create(render_thread, virge);
+        for (c = 0; c < virge->render_threads; c++)
+        {
+                virge->wake_render_thread[c] = thread_create_event();
+                virge->not_full_event[c] = thread_create_event();
+                virge->render_sync_event[c] = thread_create_event();
+        }
+        for (c = 0; c < virge->render_threads; c++)
+        {
+                virge->render_thread_data[c].virge = virge;
+                virge->render_thread_data[c].thread = c;
+                virge->render_thread[c] = thread_create(render_thread, &virge->render_thread_data[c]);
+        }
 
         virge->wake_fifo_thread = thread_create_event();
         virge->fifo_not_full_event = thread_create_event();
@@ -3879,11 +3752,18 @@ static void *s3_virge_init(const device_t *info)
 static void s3_virge_close(void *p)
 {
         virge_t *virge = (virge_t *)p;
+        int c;
 
-        thread_kill(virge->render_thread);
-        thread_destroy_event(virge->not_full_event);
+        for (c = 0; c < virge->render_threads; c++)
+                thread_kill(virge->render_thread[c]);
+        for (c = 0; c < virge->render_threads; c++)
+        {
+                thread_destroy_event(virge->wake_render_thread[c]);
+                thread_destroy_event(virge->not_full_event[c]);
+                thread_destroy_event(virge->render_sync_event[c]);
+        }
         thread_destroy_event(virge->wake_main_thread);
-        thread_destroy_event(virge->wake_render_thread);
+        thread_close_mutex(virge->render_mutex);
         
         thread_kill(virge->fifo_thread);
         thread_destroy_event(virge->wake_fifo_thread);
@@ -3965,6 +3845,11 @@ static const device_config_t s3_virge_config[] =
         {
                 "dithering", "Dithering", CONFIG_BINARY, "", 1
         },
+        {
+                "render_threads", "Render threads", CONFIG_SPINNER, "", 2, "",
+                { 1, S3D_MAX_RENDER_THREADS, 1 },
+                { { 0 } }
+        },
         {
                 "", "", -1
         }
@@ -3993,6 +3878,11 @@ static const device_config_t s3_trio3d_2x_config[] =
         {
                 "dithering", "Dithering", CONFIG_BINARY, "", 1
         },
+        {
+                "render_threads", "Render threads", CONFIG_SPINNER, "", 2, "",
+                { 1, S3D_MAX_RENDER_THREADS, 1 },
+                { { 0 } }
+        },
         {
                 "", "", -1
         }
@@ -27,6 +27,7 @@
 #include <86box/timer.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/savestate.h>
 
 
 typedef struct
@@ -126,12 +127,22 @@ sc1148x_ramdac_close(void *priv)
 	free(ramdac);
 }
 
+static void
+sc1148x_ramdac_save_state(void *priv, savestate_t *st)
+{
+    sc1148x_ramdac_t *ramdac = (sc1148x_ramdac_t *) priv;
+
+    savestate_data(st, ramdac, sizeof(sc1148x_ramdac_t));
+}
+
+
 const device_t sc11483_ramdac_device =
 {
         "Sierra SC11483 RAMDAC",
         0, 0,
         sc1148x_ramdac_init, sc1148x_ramdac_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	sc1148x_ramdac_save_state
 };
 
 const device_t sc11487_ramdac_device =
@@ -139,5 +150,6 @@ const device_t sc11487_ramdac_device =
         "Sierra SC11487 RAMDAC",
         0, 1,
         sc1148x_ramdac_init, sc1148x_ramdac_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	sc1148x_ramdac_save_state
 };
@@ -29,6 +29,7 @@
 #include <86box/timer.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/savestate.h>
 
 
 typedef struct
@@ -154,10 +155,20 @@ sc1502x_ramdac_close(void *priv)
 }
 
 
+static void
+sc1502x_ramdac_save_state(void *priv, savestate_t *st)
+{
+    sc1502x_ramdac_t *ramdac = (sc1502x_ramdac_t *) priv;
+
+    savestate_data(st, ramdac, sizeof(sc1502x_ramdac_t));
+}
+
+
 const device_t sc1502x_ramdac_device =
 {
         "Sierra SC1502x RAMDAC",
         0, 0,
         sc1502x_ramdac_init, sc1502x_ramdac_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	sc1502x_ramdac_save_state
 };
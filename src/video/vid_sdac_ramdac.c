@@ -27,6 +27,7 @@
 #include <86box/timer.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/savestate.h>
 
 
 typedef struct sdac_ramdac_t
@@ -239,12 +240,22 @@ sdac_ramdac_close(void *priv)
 }
 
 
+static void
+sdac_ramdac_save_state(void *priv, savestate_t *st)
+{
+    sdac_ramdac_t *ramdac = (sdac_ramdac_t *) priv;
+
+    savestate_data(st, ramdac, sizeof(sdac_ramdac_t));
+}
+
+
 const device_t gendac_ramdac_device =
 {
     "S3 GENDAC 86c708 RAMDAC",
     0, 0,
     sdac_ramdac_init, sdac_ramdac_close,
-    NULL, { NULL }, NULL, NULL
+    NULL, { NULL }, NULL, NULL, NULL,
+    sdac_ramdac_save_state
 };
 
 
@@ -253,5 +264,6 @@ const device_t sdac_ramdac_device =
     "S3 SDAC 86c716 RAMDAC",
     0, 7,
     sdac_ramdac_init, sdac_ramdac_close,
-    NULL, { NULL }, NULL, NULL
+    NULL, { NULL }, NULL, NULL, NULL,
+    sdac_ramdac_save_state
 };
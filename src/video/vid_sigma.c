@@ -249,7 +249,7 @@ sigma_out(uint16_t addr, uint8_t val, void *p)
 		return;
 	case 0x2DD:	/* Page in RAM at 0xC1800 */
 		if (sigma->rom_paged != 0)
-			mmu_invalidate(0xC0000);
+			flushmmucache_nopc();
 		sigma->rom_paged = 0x00;
 		return;
 
@@ -295,7 +295,7 @@ sigma_in(uint16_t addr, void *p)
 	case 0x2DD:	/* Page in ROM at 0xC1800 */
 		result = (sigma->rom_paged ? 0x80 : 0);
 		if (sigma->rom_paged != 0x80)
-			mmu_invalidate(0xC0000);
+			flushmmucache_nopc();
 		sigma->rom_paged = 0x80;
 		break;
 	case 0x3D1:
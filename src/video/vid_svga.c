@@ -20,6 +20,7 @@
  *		Copyright 2016-2019 Miran Grca.
  */
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
@@ -37,6 +38,7 @@
 #include <86box/video.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/savestate.h>
 
 
 void svga_doblit(int y1, int y2, int wx, int wy, svga_t *svga);
@@ -84,6 +86,30 @@ svga_set_override(svga_t *svga, int val)
 }
 
 
+static void
+svga_set_memory_map(svga_t *svga, uint8_t val)
+{
+    switch (val & 0xc) {
+	case 0x0: /*128k at A0000*/
+		mem_mapping_set_addr(&svga->mapping, 0xa0000, 0x20000);
+		svga->banked_mask = 0xffff;
+		break;
+	case 0x4: /*64k at A0000*/
+		mem_mapping_set_addr(&svga->mapping, 0xa0000, 0x10000);
+		svga->banked_mask = 0xffff;
+		break;
+	case 0x8: /*32k at B0000*/
+		mem_mapping_set_addr(&svga->mapping, 0xb0000, 0x08000);
+		svga->banked_mask = 0x7fff;
+		break;
+	case 0xC: /*32k at B8000*/
+		mem_mapping_set_addr(&svga->mapping, 0xb8000, 0x08000);
+		svga->banked_mask = 0x7fff;
+		break;
+    }
+}
+
+
 void
 svga_out(uint16_t addr, uint8_t val, void *p)
 {
@@ -232,26 +258,8 @@ svga_out(uint16_t addr, uint8_t val, void *p)
 				svga->chain2_read = val & 0x10;
 				break;
 			case 6:
-				if ((svga->gdcreg[6] & 0xc) != (val & 0xc)) {
-					switch (val&0xC) {
-						case 0x0: /*128k at A0000*/
-							mem_mapping_set_addr(&svga->mapping, 0xa0000, 0x20000);
-							svga->banked_mask = 0xffff;
-							break;
-						case 0x4: /*64k at A0000*/
-							mem_mapping_set_addr(&svga->mapping, 0xa0000, 0x10000);
-							svga->banked_mask = 0xffff;
-							break;
-						case 0x8: /*32k at B0000*/
-							mem_mapping_set_addr(&svga->mapping, 0xb0000, 0x08000);
-							svga->banked_mask = 0x7fff;
-							break;
-						case 0xC: /*32k at B8000*/
-							mem_mapping_set_addr(&svga->mapping, 0xb8000, 0x08000);
-							svga->banked_mask = 0x7fff;
-							break;
-					}
-				}
+				if ((svga->gdcreg[6] & 0xc) != (val & 0xc))
+					svga_set_memory_map(svga, val);
 				break;
 			case 7:
 				svga->colournocare = val;
@@ -951,6 +959,50 @@ svga_init(const device_t *info, svga_t *svga, void *p, int memsize,
 }
 
 
+/* Saves the generic VGA part of the card; cards with extended registers
+   save those themselves, and must restore their own memory mappings. */
+void
+svga_save_state(svga_t *svga, savestate_t *st)
+{
+    uint32_t vram_size = svga->vram_max;
+
+    savestate_var(st, vram_size);
+    if (!st->error && (vram_size != svga->vram_max)) {
+	savestate_fail(st, "video memory size mismatch");
+	return;
+    }
+
+    savestate_data(st, &svga->fast, offsetof(svga_t, map8) - offsetof(svga_t, fast));
+    savestate_var(st, svga->pallook);
+    savestate_var(st, svga->vgapal);
+    savestate_var(st, svga->dispontime);
+    savestate_var(st, svga->dispofftime);
+    savestate_var(st, svga->latch);
+    savestate_timer(st, &svga->timer);
+    savestate_var(st, svga->hwcursor);
+    savestate_var(st, svga->hwcursor_latch);
+    savestate_var(st, svga->dac_hwcursor);
+    savestate_var(st, svga->dac_hwcursor_latch);
+    savestate_var(st, svga->overlay);
+    savestate_var(st, svga->overlay_latch);
+    savestate_var(st, svga->crtc);
+    savestate_var(st, svga->gdcreg);
+    savestate_var(st, svga->attrregs);
+    savestate_var(st, svga->seqregs);
+    savestate_var(st, svga->egapal);
+    savestate_data(st, &svga->crtcreg, offsetof(svga_t, ksc5601_swap_mode) - offsetof(svga_t, crtcreg));
+    savestate_var(st, svga->hsync_divisor);
+    savestate_data(st, svga->vram, svga->vram_max);
+
+    if (st->loading && !st->error) {
+	svga_set_memory_map(svga, svga->gdcreg[6]);
+	memset(svga->changedvram, 0xff, svga->vram_max >> 12);
+	svga_recalctimings(svga);
+	svga->fullchange = changeframecount;
+    }
+}
+
+
 void
 svga_close(svga_t *svga)
 {
@@ -18,6 +18,7 @@
  */
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 #include <86box/86box.h>
@@ -28,6 +29,430 @@
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+# define USE_RENDER_SSE2
+# include <emmintrin.h>
+# if defined(__GNUC__) || defined(_MSC_VER)
+#  define USE_RENDER_AVX2
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#   include <intrin.h>
+#   define RENDER_SSSE3
+#   define RENDER_AVX2
+#  else
+#   define RENDER_SSSE3	__attribute__((target("ssse3")))
+#   define RENDER_AVX2	__attribute__((target("avx2")))
+#  endif
+# endif
+#endif
+
+
+/* Scanline converters, used by the high resolution renderers when the
+   line is displayed and does not wrap around the end of video memory.
+   They are picked once at startup, and left NULL where there is no
+   faster version than the pixel loop in the renderer itself. */
+typedef void (*svga_line_t)(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal);
+
+static svga_line_t	svga_line_8bpp = NULL, svga_line_15bpp = NULL,
+			svga_line_16bpp = NULL, svga_line_24bpp = NULL,
+			svga_line_32bpp = NULL;
+
+
+#ifdef USE_RENDER_SSE2
+static __inline void
+svga_line_8bpp_lookup(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal)
+{
+    uint32_t dat;
+    int i = 0;
+
+    for (; i <= (n - 4); i += 4) {
+	memcpy(&dat, s + i, 4);
+	p[i]     = pal[dat & 0xff];
+	p[i + 1] = pal[(dat >> 8) & 0xff];
+	p[i + 2] = pal[(dat >> 16) & 0xff];
+	p[i + 3] = pal[dat >> 24];
+    }
+
+    for (; i < n; i++)
+	p[i] = pal[s[i]];
+}
+
+
+static void
+svga_line_8bpp_sse2(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal)
+{
+    __m128i v, c;
+    int i = 0;
+
+    /* There is no cheap vector table lookup of 256 entries, but most
+       of a typical 8 bpp screen is runs of one colour, which can be
+       stored without looking up every pixel. */
+    for (; i <= (n - 16); i += 16) {
+	v = _mm_loadu_si128((const __m128i *) (s + i));
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(s[i]))) == 0xffff) {
+		c = _mm_set1_epi32(pal[s[i]]);
+		_mm_storeu_si128((__m128i *) (p + i), c);
+		_mm_storeu_si128((__m128i *) (p + i + 4), c);
+		_mm_storeu_si128((__m128i *) (p + i + 8), c);
+		_mm_storeu_si128((__m128i *) (p + i + 12), c);
+	} else
+		svga_line_8bpp_lookup(p + i, s + i, 16, pal);
+    }
+
+    if (i < n)
+	svga_line_8bpp_lookup(p + i, s + i, n - i, pal);
+}
+
+
+/* The 5 and 6 bit channels are widened to 8 bits as (c * 1053) >> 7 and
+   (c * 259 + 3) >> 6, which give the same results as the rounded down
+   divisions that build video_15to32 and video_16to32. */
+static void
+svga_line_15bpp_sse2(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal)
+{
+    const __m128i m5 = _mm_set1_epi16(0x1f);
+    __m128i v, b, g, r, lo;
+    int i = 0;
+
+    for (; i <= (n - 8); i += 8) {
+	v = _mm_loadu_si128((const __m128i *) (s + (i << 1)));
+	b = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(v, m5), _mm_set1_epi16(1053)), 7);
+	g = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(v, 5), m5), _mm_set1_epi16(1053)), 7);
+	r = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(v, 10), m5), _mm_set1_epi16(1053)), 7);
+	lo = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+	_mm_storeu_si128((__m128i *) (p + i), _mm_unpacklo_epi16(lo, r));
+	_mm_storeu_si128((__m128i *) (p + i + 4), _mm_unpackhi_epi16(lo, r));
+    }
+
+    for (; i < n; i++)
+	p[i] = video_15to32[s[i << 1] | (s[(i << 1) + 1] << 8)];
+}
+
+
+static void
+svga_line_16bpp_sse2(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal)
+{
+    const __m128i m5 = _mm_set1_epi16(0x1f);
+    __m128i v, b, g, r, lo;
+    int i = 0;
+
+    for (; i <= (n - 8); i += 8) {
+	v = _mm_loadu_si128((const __m128i *) (s + (i << 1)));
+	b = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(v, m5), _mm_set1_epi16(1053)), 7);
+	g = _mm_and_si128(_mm_srli_epi16(v, 5), _mm_set1_epi16(0x3f));
+	g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(259)), _mm_set1_epi16(3)), 6);
+	r = _mm_srli_epi16(_mm_mullo_epi16(_mm_srli_epi16(v, 11), _mm_set1_epi16(1053)), 7);
+	lo = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+	_mm_storeu_si128((__m128i *) (p + i), _mm_unpacklo_epi16(lo, r));
+	_mm_storeu_si128((__m128i *) (p + i + 4), _mm_unpackhi_epi16(lo, r));
+    }
+
+    for (; i < n; i++)
+	p[i] = video_16to32[s[i << 1] | (s[(i << 1) + 1] << 8)];
+}
+
+
+static void
+svga_line_32bpp_sse2(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal)
+{
+    const __m128i m = _mm_set1_epi32(0x00ffffff);
+    int i = 0;
+
+    for (; i <= (n - 4); i += 4)
+	_mm_storeu_si128((__m128i *) (p + i), _mm_and_si128(_mm_loadu_si128((const __m128i *) (s + (i << 2))), m));
+
+    for (; i < n; i++)
+	p[i] = s[i << 2] | (s[(i << 2) + 1] << 8) | (s[(i << 2) + 2] << 16);
+}
+#endif
+
+
+#ifdef USE_RENDER_AVX2
+RENDER_SSSE3 static void
+svga_line_24bpp_ssse3(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal)
+{
+    const __m128i shuf = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    int i = 0;
+
+    /* Each load takes 16 bytes for 4 pixels, so stop while the last
+       one still lies within the line. */
+    for (; i <= (n - 6); i += 4)
+	_mm_storeu_si128((__m128i *) (p + i), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (s + (i * 3))), shuf));
+
+    for (; i < n; i++)
+	p[i] = s[i * 3] | (s[(i * 3) + 1] << 8) | (s[(i * 3) + 2] << 16);
+}
+
+
+RENDER_AVX2 static void
+svga_line_8bpp_avx2(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal)
+{
+    __m256i v, c;
+    int i = 0;
+
+    for (; i <= (n - 32); i += 32) {
+	v = _mm256_loadu_si256((const __m256i *) (s + i));
+	if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(s[i]))) == -1) {
+		c = _mm256_set1_epi32(pal[s[i]]);
+		_mm256_storeu_si256((__m256i *) (p + i), c);
+		_mm256_storeu_si256((__m256i *) (p + i + 8), c);
+		_mm256_storeu_si256((__m256i *) (p + i + 16), c);
+		_mm256_storeu_si256((__m256i *) (p + i + 24), c);
+	} else
+		svga_line_8bpp_lookup(p + i, s + i, 32, pal);
+    }
+
+    if (i < n)
+	svga_line_8bpp_lookup(p + i, s + i, n - i, pal);
+}
+
+
+RENDER_AVX2 static void
+svga_line_15bpp_avx2(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal)
+{
+    const __m256i m5 = _mm256_set1_epi16(0x1f), k = _mm256_set1_epi16(1053);
+    __m256i v, b, g, r, lo, o0, o1;
+    int i = 0;
+
+    for (; i <= (n - 16); i += 16) {
+	v = _mm256_loadu_si256((const __m256i *) (s + (i << 1)));
+	b = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(v, m5), k), 7);
+	g = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(v, 5), m5), k), 7);
+	r = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(v, 10), m5), k), 7);
+	lo = _mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+	/* The unpacks work within each 128-bit lane. */
+	o0 = _mm256_unpacklo_epi16(lo, r);
+	o1 = _mm256_unpackhi_epi16(lo, r);
+	_mm256_storeu_si256((__m256i *) (p + i), _mm256_permute2x128_si256(o0, o1, 0x20));
+	_mm256_storeu_si256((__m256i *) (p + i + 8), _mm256_permute2x128_si256(o0, o1, 0x31));
+    }
+
+    if (i < n)
+	svga_line_15bpp_sse2(p + i, s + (i << 1), n - i, pal);
+}
+
+
+RENDER_AVX2 static void
+svga_line_16bpp_avx2(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal)
+{
+    const __m256i m5 = _mm256_set1_epi16(0x1f), k = _mm256_set1_epi16(1053);
+    __m256i v, b, g, r, lo, o0, o1;
+    int i = 0;
+
+    for (; i <= (n - 16); i += 16) {
+	v = _mm256_loadu_si256((const __m256i *) (s + (i << 1)));
+	b = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(v, m5), k), 7);
+	g = _mm256_and_si256(_mm256_srli_epi16(v, 5), _mm256_set1_epi16(0x3f));
+	g = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(g, _mm256_set1_epi16(259)), _mm256_set1_epi16(3)), 6);
+	r = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_srli_epi16(v, 11), k), 7);
+	lo = _mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+	o0 = _mm256_unpacklo_epi16(lo, r);
+	o1 = _mm256_unpackhi_epi16(lo, r);
+	_mm256_storeu_si256((__m256i *) (p + i), _mm256_permute2x128_si256(o0, o1, 0x20));
+	_mm256_storeu_si256((__m256i *) (p + i + 8), _mm256_permute2x128_si256(o0, o1, 0x31));
+    }
+
+    if (i < n)
+	svga_line_16bpp_sse2(p + i, s + (i << 1), n - i, pal);
+}
+
+
+RENDER_AVX2 static void
+svga_line_24bpp_avx2(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal)
+{
+    const __m256i shuf = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+					  0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m256i v;
+    int i = 0;
+
+    for (; i <= (n - 10); i += 8) {
+	v = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (s + (i * 3))));
+	v = _mm256_inserti128_si256(v, _mm_loadu_si128((const __m128i *) (s + (i * 3) + 12)), 1);
+	_mm256_storeu_si256((__m256i *) (p + i), _mm256_shuffle_epi8(v, shuf));
+    }
+
+    if (i < n)
+	svga_line_24bpp_ssse3(p + i, s + (i * 3), n - i, pal);
+}
+
+
+RENDER_AVX2 static void
+svga_line_32bpp_avx2(uint32_t *p, const uint8_t *s, int n, const uint32_t *pal)
+{
+    const __m256i m = _mm256_set1_epi32(0x00ffffff);
+    int i = 0;
+
+    for (; i <= (n - 8); i += 8)
+	_mm256_storeu_si256((__m256i *) (p + i), _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (s + (i << 2))), m));
+
+    if (i < n)
+	svga_line_32bpp_sse2(p + i, s + (i << 2), n - i, pal);
+}
+
+
+/* Returns 2 with AVX2, 1 with SSSE3 and 0 otherwise. */
+static int
+svga_render_cpu_level(void)
+{
+# ifdef _MSC_VER
+    int info[4], level = 0;
+
+    __cpuid(info, 0);
+    if (info[0] < 1)
+	return 0;
+
+    __cpuid(info, 1);
+    if (info[2] & 0x00000200)
+	level = 1;
+
+    /* AVX2 also needs OSXSAVE and AVX, with the YMM state enabled. */
+    if ((info[2] & 0x18000000) != 0x18000000)
+	return level;
+    if ((_xgetbv(0) & 6) != 6)
+	return level;
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+	return level;
+    __cpuidex(info, 7, 0);
+    return (info[1] & 0x20) ? 2 : level;
+# else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+	return 2;
+    return __builtin_cpu_supports("ssse3") ? 1 : 0;
+# endif
+}
+#endif
+
+
+#ifdef USE_RENDER_SSE2
+/* What the renderers' own pixel loops produce for pixel i of a line. */
+static uint32_t
+svga_line_ref(const uint8_t *s, int i, int bpp, const uint32_t *pal)
+{
+    switch (bpp) {
+	case 8:
+		return pal[s[i]];
+	case 15: case 16:
+		return pal[s[i << 1] | (s[(i << 1) + 1] << 8)];
+	case 24:
+		return s[i * 3] | (s[(i * 3) + 1] << 8) | (s[(i * 3) + 2] << 16);
+	default:
+		return s[i << 2] | (s[(i << 2) + 1] << 8) | (s[(i << 2) + 2] << 16);
+    }
+}
+
+
+/* Make sure a converter agrees with the pixel loops before using it. The
+   test line holds every 16-bit value once, then pseudo-random data broken
+   up by runs of one byte for the 8 bpp run path; short lines at odd
+   offsets cover the tails, and nothing may be written past the end. */
+static int
+svga_line_check(svga_line_t line, int bpp, const uint32_t *pal)
+{
+    uint8_t *s = malloc(65536 * 4), *base;
+    uint32_t *p = malloc((65536 + 1) * sizeof(uint32_t));
+    uint32_t rnd = 0x12345678, rnd_pal[256];
+    int c, i, n, ret = 1;
+
+    if ((s == NULL) || (p == NULL)) {
+	free(p);
+	free(s);
+	return 0;
+    }
+
+    for (c = 0; c < 65536; c++) {
+	s[c << 1] = c & 0xff;
+	s[(c << 1) + 1] = c >> 8;
+    }
+    for (c = 65536 * 2; c < (65536 * 4); c++) {
+	rnd = (rnd * 1103515245) + 12345;
+	s[c] = (c & 0x40) ? (rnd >> 16) : (c >> 7);
+    }
+
+    if (pal == NULL) {
+	for (c = 0; c < 256; c++) {
+		rnd = (rnd * 1103515245) + 12345;
+		rnd_pal[c] = rnd & 0x00ffffff;
+	}
+	pal = rnd_pal;
+    }
+
+    /* Two long lines, from the start and to the end of the buffer, then
+       short ones from every offset within a vector. */
+    for (c = -2; (c < 64) && ret; c++) {
+	if (c >= 0) {
+		n = c + 1;
+		base = s + c;
+	} else {
+		n = (65536 * 4) / ((bpp + 7) >> 3);
+		if (n > 65536)
+			n = 65536;
+		base = (c == -2) ? s : (s + (65536 * 4) - (n * ((bpp + 7) >> 3)));
+	}
+
+	p[n] = 0xdeadbeef;
+	line(p, base, n, pal);
+	for (i = 0; i < n; i++) {
+		if (p[i] != svga_line_ref(base, i, bpp, pal)) {
+			ret = 0;
+			break;
+		}
+	}
+	if (p[n] != 0xdeadbeef)
+		ret = 0;
+    }
+
+    free(p);
+    free(s);
+
+    return ret;
+}
+#endif
+
+
+void
+svga_render_init(void)
+{
+    svga_line_8bpp = svga_line_15bpp = svga_line_16bpp = NULL;
+    svga_line_24bpp = svga_line_32bpp = NULL;
+
+#ifdef USE_RENDER_SSE2
+    svga_line_8bpp = svga_line_8bpp_sse2;
+    svga_line_15bpp = svga_line_15bpp_sse2;
+    svga_line_16bpp = svga_line_16bpp_sse2;
+    svga_line_32bpp = svga_line_32bpp_sse2;
+#endif
+#ifdef USE_RENDER_AVX2
+    switch (svga_render_cpu_level()) {
+	case 2:
+		svga_line_8bpp = svga_line_8bpp_avx2;
+		svga_line_15bpp = svga_line_15bpp_avx2;
+		svga_line_16bpp = svga_line_16bpp_avx2;
+		svga_line_24bpp = svga_line_24bpp_avx2;
+		svga_line_32bpp = svga_line_32bpp_avx2;
+		break;
+	case 1:
+		svga_line_24bpp = svga_line_24bpp_ssse3;
+		break;
+    }
+#endif
+#ifdef USE_RENDER_SSE2
+    if (svga_line_8bpp && !svga_line_check(svga_line_8bpp, 8, NULL))
+	svga_line_8bpp = NULL;
+    if ((video_15to32 == NULL) || !svga_line_check(svga_line_15bpp, 15, video_15to32))
+	svga_line_15bpp = NULL;
+    if ((video_16to32 == NULL) || !svga_line_check(svga_line_16bpp, 16, video_16to32))
+	svga_line_16bpp = NULL;
+    if (svga_line_24bpp && !svga_line_check(svga_line_24bpp, 24, NULL))
+	svga_line_24bpp = NULL;
+    if (svga_line_32bpp && !svga_line_check(svga_line_32bpp, 32, NULL))
+	svga_line_32bpp = NULL;
+#endif
+}
+
+
 void
 svga_render_null(svga_t *svga)
 {
@@ -685,8 +1110,8 @@ svga_render_8bpp_lowres(svga_t *svga)
 void
 svga_render_8bpp_highres(svga_t *svga)
 {
-    int x;
-    uint32_t *p;
+    int x, n;
+    uint32_t *p, addr;
     uint32_t dat;
 
     if ((svga->displine + svga->y_add) < 0)
@@ -699,24 +1124,32 @@ svga_render_8bpp_highres(svga_t *svga)
 		svga->firstline_draw = svga->displine;
 	svga->lastline_draw = svga->displine;
 
-	for (x = 0; x <= (svga->hdisp/* + svga->scrollcache*/); x += 8) {
-		if (svga->crtc[0x17] & 0x80) {
-			dat = *(uint32_t *)(&svga->vram[svga->ma & svga->vram_display_mask]);
-			p[0] = svga->map8[dat & 0xff];
-			p[1] = svga->map8[(dat >> 8) & 0xff];
-			p[2] = svga->map8[(dat >> 16) & 0xff];
-			p[3] = svga->map8[(dat >> 24) & 0xff];
-
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + 4) & svga->vram_display_mask]);
-			p[4] = svga->map8[dat & 0xff];
-			p[5] = svga->map8[(dat >> 8) & 0xff];
-			p[6] = svga->map8[(dat >> 16) & 0xff];
-			p[7] = svga->map8[(dat >> 24) & 0xff];
-		} else
-			memset(p, 0x00, 8 * sizeof(uint32_t));
-
-		svga->ma += 8;
-		p += 8;
+	n = (svga->hdisp & ~7) + 8;
+	addr = svga->ma & svga->vram_display_mask;
+
+	if (svga_line_8bpp && (svga->crtc[0x17] & 0x80) && ((addr + n) <= (svga->vram_display_mask + 1))) {
+		svga_line_8bpp(p, &svga->vram[addr], n, svga->map8);
+		svga->ma += n;
+	} else {
+	    for (x = 0; x <= (svga->hdisp/* + svga->scrollcache*/); x += 8) {
+		    if (svga->crtc[0x17] & 0x80) {
+			    dat = *(uint32_t *)(&svga->vram[svga->ma & svga->vram_display_mask]);
+			    p[0] = svga->map8[dat & 0xff];
+			    p[1] = svga->map8[(dat >> 8) & 0xff];
+			    p[2] = svga->map8[(dat >> 16) & 0xff];
+			    p[3] = svga->map8[(dat >> 24) & 0xff];
+
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + 4) & svga->vram_display_mask]);
+			    p[4] = svga->map8[dat & 0xff];
+			    p[5] = svga->map8[(dat >> 8) & 0xff];
+			    p[6] = svga->map8[(dat >> 16) & 0xff];
+			    p[7] = svga->map8[(dat >> 24) & 0xff];
+		    } else
+			    memset(p, 0x00, 8 * sizeof(uint32_t));
+
+		    svga->ma += 8;
+		    p += 8;
+	    }
 	}
 	svga->ma &= svga->vram_display_mask;
     }
@@ -763,8 +1196,8 @@ svga_render_15bpp_lowres(svga_t *svga)
 void
 svga_render_15bpp_highres(svga_t *svga)
 {
-    int x;
-    uint32_t *p;
+    int x, n;
+    uint32_t *p, addr;
     uint32_t dat;
 
     if ((svga->displine + svga->y_add) < 0)
@@ -777,25 +1210,33 @@ svga_render_15bpp_highres(svga_t *svga)
 		svga->firstline_draw = svga->displine;
 	svga->lastline_draw = svga->displine;
 
-	for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
-		if (svga->crtc[0x17] & 0x80) {
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
-			p[x]     = video_15to32[dat & 0xffff];
-			p[x + 1] = video_15to32[dat >> 16];
-
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 4) & svga->vram_display_mask]);
-			p[x + 2] = video_15to32[dat & 0xffff];
-			p[x + 3] = video_15to32[dat >> 16];
-
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 8) & svga->vram_display_mask]);
-			p[x + 4] = video_15to32[dat & 0xffff];
-			p[x + 5] = video_15to32[dat >> 16];
-
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 12) & svga->vram_display_mask]);
-			p[x + 6] = video_15to32[dat & 0xffff];
-			p[x + 7] = video_15to32[dat >> 16];
-		} else
-			memset(&(p[x]), 0x00, 8 * sizeof(uint32_t));
+	n = ((svga->hdisp + svga->scrollcache) & ~7) + 8;
+	addr = svga->ma & svga->vram_display_mask;
+
+	if (svga_line_15bpp && (svga->crtc[0x17] & 0x80) && ((addr + (n << 1)) <= (svga->vram_display_mask + 1))) {
+		svga_line_15bpp(p, &svga->vram[addr], n, NULL);
+		x = n;
+	} else {
+	    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
+		    if (svga->crtc[0x17] & 0x80) {
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
+			    p[x]     = video_15to32[dat & 0xffff];
+			    p[x + 1] = video_15to32[dat >> 16];
+
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 4) & svga->vram_display_mask]);
+			    p[x + 2] = video_15to32[dat & 0xffff];
+			    p[x + 3] = video_15to32[dat >> 16];
+
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 8) & svga->vram_display_mask]);
+			    p[x + 4] = video_15to32[dat & 0xffff];
+			    p[x + 5] = video_15to32[dat >> 16];
+
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 12) & svga->vram_display_mask]);
+			    p[x + 6] = video_15to32[dat & 0xffff];
+			    p[x + 7] = video_15to32[dat >> 16];
+		    } else
+			    memset(&(p[x]), 0x00, 8 * sizeof(uint32_t));
+	    }
 	}
 	svga->ma += x << 1; 
 	svga->ma &= svga->vram_display_mask;
@@ -927,8 +1368,8 @@ svga_render_16bpp_lowres(svga_t *svga)
 void
 svga_render_16bpp_highres(svga_t *svga)
 {
-    int x;
-    uint32_t *p;
+    int x, n;
+    uint32_t *p, addr;
 
     if ((svga->displine + svga->y_add) < 0)
 	return;
@@ -940,25 +1381,33 @@ svga_render_16bpp_highres(svga_t *svga)
 		svga->firstline_draw = svga->displine;
 	svga->lastline_draw = svga->displine;
 
-	for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
-		if (svga->crtc[0x17] & 0x80) {
-			uint32_t dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
-			p[x]     = video_16to32[dat & 0xffff];
-			p[x + 1] = video_16to32[dat >> 16];
-
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 4) & svga->vram_display_mask]);
-			p[x + 2] = video_16to32[dat & 0xffff];
-			p[x + 3] = video_16to32[dat >> 16];
-
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 8) & svga->vram_display_mask]);
-			p[x + 4] = video_16to32[dat & 0xffff];
-			p[x + 5] = video_16to32[dat >> 16];
-
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 12) & svga->vram_display_mask]);
-			p[x + 6] = video_16to32[dat & 0xffff];
-			p[x + 7] = video_16to32[dat >> 16];
-		} else
-			memset(&(p[x]), 0x00, 8 * sizeof(uint32_t));
+	n = ((svga->hdisp + svga->scrollcache) & ~7) + 8;
+	addr = svga->ma & svga->vram_display_mask;
+
+	if (svga_line_16bpp && (svga->crtc[0x17] & 0x80) && ((addr + (n << 1)) <= (svga->vram_display_mask + 1))) {
+		svga_line_16bpp(p, &svga->vram[addr], n, NULL);
+		x = n;
+	} else {
+	    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
+		    if (svga->crtc[0x17] & 0x80) {
+			    uint32_t dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
+			    p[x]     = video_16to32[dat & 0xffff];
+			    p[x + 1] = video_16to32[dat >> 16];
+
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 4) & svga->vram_display_mask]);
+			    p[x + 2] = video_16to32[dat & 0xffff];
+			    p[x + 3] = video_16to32[dat >> 16];
+
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 8) & svga->vram_display_mask]);
+			    p[x + 4] = video_16to32[dat & 0xffff];
+			    p[x + 5] = video_16to32[dat >> 16];
+
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 1) + 12) & svga->vram_display_mask]);
+			    p[x + 6] = video_16to32[dat & 0xffff];
+			    p[x + 7] = video_16to32[dat >> 16];
+		    } else
+			    memset(&(p[x]), 0x00, 8 * sizeof(uint32_t));
+	    }
 	}
 	svga->ma += x << 1; 
 	svga->ma &= svga->vram_display_mask;
@@ -997,8 +1446,8 @@ svga_render_24bpp_lowres(svga_t *svga)
 void
 svga_render_24bpp_highres(svga_t *svga)
 {
-    int x;
-    uint32_t *p;
+    int x, n;
+    uint32_t *p, addr;
     uint32_t dat;
 
     if ((svga->displine + svga->y_add) < 0)
@@ -1011,23 +1460,31 @@ svga_render_24bpp_highres(svga_t *svga)
 		svga->firstline_draw = svga->displine;
 	svga->lastline_draw = svga->displine;
 
-	for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
-		if (svga->crtc[0x17] & 0x80) {
-			dat = *(uint32_t *)(&svga->vram[svga->ma & svga->vram_display_mask]);
-			p[x] = dat & 0xffffff;
+	n = ((svga->hdisp + svga->scrollcache) & ~3) + 4;
+	addr = svga->ma & svga->vram_display_mask;
 
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + 3) & svga->vram_display_mask]);
-			p[x + 1] = dat & 0xffffff;
+	if (svga_line_24bpp && (svga->crtc[0x17] & 0x80) && ((addr + (n * 3)) <= (svga->vram_display_mask + 1))) {
+		svga_line_24bpp(p, &svga->vram[addr], n, NULL);
+		svga->ma += n * 3;
+	} else {
+	    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
+		    if (svga->crtc[0x17] & 0x80) {
+			    dat = *(uint32_t *)(&svga->vram[svga->ma & svga->vram_display_mask]);
+			    p[x] = dat & 0xffffff;
 
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + 6) & svga->vram_display_mask]);
-			p[x + 2] = dat & 0xffffff;
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + 3) & svga->vram_display_mask]);
+			    p[x + 1] = dat & 0xffffff;
 
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + 9) & svga->vram_display_mask]);
-			p[x + 3] = dat & 0xffffff;
-		} else
-			memset(&(p[x]), 0x0, 4 * sizeof(uint32_t));
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + 6) & svga->vram_display_mask]);
+			    p[x + 2] = dat & 0xffffff;
+
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + 9) & svga->vram_display_mask]);
+			    p[x + 3] = dat & 0xffffff;
+		    } else
+			    memset(&(p[x]), 0x0, 4 * sizeof(uint32_t));
 
-		svga->ma += 12;
+		    svga->ma += 12;
+	    }
 	}
 	svga->ma &= svga->vram_display_mask;
     }
@@ -1065,8 +1522,8 @@ svga_render_32bpp_lowres(svga_t *svga)
 void
 svga_render_32bpp_highres(svga_t *svga)
 {
-    int x;
-    uint32_t *p;
+    int x, n;
+    uint32_t *p, addr;
     uint32_t dat;
 
     if ((svga->displine + svga->y_add) < 0)
@@ -1079,12 +1536,19 @@ svga_render_32bpp_highres(svga_t *svga)
 		svga->firstline_draw = svga->displine;
 	svga->lastline_draw = svga->displine;
 
-	for (x = 0; x <= (svga->hdisp + svga->scrollcache); x++) {
-		if (svga->crtc[0x17] & 0x80)
-			dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 2)) & svga->vram_display_mask]);
-		else
-			dat = 0x00000000;
-		p[x] = dat & 0xffffff;
+	n = svga->hdisp + svga->scrollcache + 1;
+	addr = svga->ma & svga->vram_display_mask;
+
+	if (svga_line_32bpp && (svga->crtc[0x17] & 0x80) && ((addr + (n << 2)) <= (svga->vram_display_mask + 1))) {
+		svga_line_32bpp(p, &svga->vram[addr], n, NULL);
+	} else {
+	    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x++) {
+		    if (svga->crtc[0x17] & 0x80)
+			    dat = *(uint32_t *)(&svga->vram[(svga->ma + (x << 2)) & svga->vram_display_mask]);
+		    else
+			    dat = 0x00000000;
+		    p[x] = dat & 0xffffff;
+	    }
 	}
 	svga->ma += 4; 
 	svga->ma &= svga->vram_display_mask;
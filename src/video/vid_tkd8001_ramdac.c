@@ -27,6 +27,7 @@
 #include <86box/mem.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/savestate.h>
 
 
 typedef struct tkd8001_ramdac_t
@@ -118,10 +119,20 @@ tkd8001_ramdac_close(void *priv)
 }
 
 
+static void
+tkd8001_ramdac_save_state(void *priv, savestate_t *st)
+{
+    tkd8001_ramdac_t *ramdac = (tkd8001_ramdac_t *) priv;
+
+    savestate_data(st, ramdac, sizeof(tkd8001_ramdac_t));
+}
+
+
 const device_t tkd8001_ramdac_device =
 {
         "Trident TKD8001 RAMDAC",
         0, 0,
         tkd8001_ramdac_init, tkd8001_ramdac_close,
-	NULL, { NULL }, NULL, NULL
+	NULL, { NULL }, NULL, NULL, NULL,
+	tkd8001_ramdac_save_state
 };
@@ -30,6 +30,7 @@
 #include <86box/video.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/savestate.h>
 
 #define TVGA8900B_ID		0x03
 #define TVGA9000B_ID		0x23
@@ -437,6 +438,23 @@ void tvga_force_redraw(void *p)
         tvga->svga.fullchange = changeframecount;
 }
 
+static void tvga_save_state(void *p, savestate_t *st)
+{
+        tvga_t *tvga = (tvga_t *)p;
+
+        savestate_var(st, tvga->tvga_3d8);
+        savestate_var(st, tvga->tvga_3d9);
+        savestate_var(st, tvga->oldmode);
+        savestate_var(st, tvga->oldctrl1);
+        savestate_var(st, tvga->oldctrl2);
+        savestate_var(st, tvga->newctrl2);
+
+        svga_save_state(&tvga->svga, st);
+
+        if (st->loading && !st->error)
+                tvga_recalcbanking(tvga);
+}
+
 static const device_config_t tvga_config[] =
 {
         {
@@ -473,7 +491,8 @@ const device_t tvga8900b_device =
         { tvga8900b_available },
         tvga_speed_changed,
         tvga_force_redraw,
-        tvga_config
+        tvga_config,
+        tvga_save_state
 };
 
 const device_t tvga8900d_device =
@@ -487,7 +506,8 @@ const device_t tvga8900d_device =
         { tvga8900d_available },
         tvga_speed_changed,
         tvga_force_redraw,
-        tvga_config
+        tvga_config,
+        tvga_save_state
 };
 
 const device_t tvga9000b_device =
@@ -501,5 +521,6 @@ const device_t tvga9000b_device =
         { tvga9000b_available },
         tvga_speed_changed,
         tvga_force_redraw,
-        NULL
+        NULL,
+        tvga_save_state
 };
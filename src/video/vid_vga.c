@@ -29,6 +29,7 @@
 #include <86box/timer.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/savestate.h>
 
 
 typedef struct vga_t
@@ -181,6 +182,14 @@ void vga_speed_changed(void *p)
         svga_recalctimings(&vga->svga);
 }
 
+static void
+vga_save_state(void *p, savestate_t *st)
+{
+        vga_t *vga = (vga_t *)p;
+
+        svga_save_state(&vga->svga, st);
+}
+
 void vga_force_redraw(void *p)
 {
         vga_t *vga = (vga_t *)p;
@@ -199,7 +208,8 @@ const device_t vga_device =
         { vga_available },
         vga_speed_changed,
         vga_force_redraw,
-        NULL
+        NULL,
+        vga_save_state
 };
 
 const device_t ps1vga_device =
@@ -213,7 +223,8 @@ const device_t ps1vga_device =
         { vga_available },
         vga_speed_changed,
         vga_force_redraw,
-        NULL
+        NULL,
+        vga_save_state
 };
 
 const device_t ps1vga_mca_device =
@@ -227,5 +238,6 @@ const device_t ps1vga_mca_device =
         { vga_available },
         vga_speed_changed,
         vga_force_redraw,
-        NULL
+        NULL,
+        vga_save_state
 };
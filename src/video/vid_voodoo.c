@@ -914,9 +914,13 @@ void *voodoo_card_init()
         voodoo->fb_size = device_get_config_int("framebuffer_memory");
         voodoo->fb_mask = (voodoo->fb_size << 20) - 1;
         voodoo->render_threads = device_get_config_int("render_threads");
-        voodoo->odd_even_mask = voodoo->render_threads - 1;
+        if (voodoo->render_threads < 1)
+                voodoo->render_threads = 1;
+        if (voodoo->render_threads > VOODOO_MAX_RENDER_THREADS)
+                voodoo->render_threads = VOODOO_MAX_RENDER_THREADS;
 #ifndef NO_CODEGEN
         voodoo->use_recompiler = device_get_config_int("recompiler");
+        voodoo->codegen_blocks = device_get_config_int("recompiler_cache");
 #endif                        
         voodoo->type = device_get_config_int("type");
         switch (voodoo->type) {
@@ -947,17 +951,7 @@ void *voodoo_card_init()
         voodoo->tex_mem_w[0] = (uint16_t *)voodoo->tex_mem[0];
         voodoo->tex_mem_w[1] = (uint16_t *)voodoo->tex_mem[1];
         
-        for (c = 0; c < TEX_CACHE_MAX; c++) {
-                voodoo->texture_cache[0][c].data = malloc((256*256 + 256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2) * 4);
-                voodoo->texture_cache[0][c].base = -1; /*invalid*/
-                voodoo->texture_cache[0][c].refcount = 0;
-                if (voodoo->dual_tmus)
-                {
-                        voodoo->texture_cache[1][c].data = malloc((256*256 + 256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2) * 4);
-                        voodoo->texture_cache[1][c].base = -1; /*invalid*/
-                        voodoo->texture_cache[1][c].refcount = 0;
-                }
-        }
+        voodoo_texture_cache_init(voodoo, device_get_config_int("texture_cache"));
 
         timer_add(&voodoo->timer, voodoo_callback, voodoo, 1);
         
@@ -965,24 +959,10 @@ void *voodoo_card_init()
         voodoo->fbiInit0 = 0;
 
         voodoo->wake_fifo_thread = thread_create_event();
-        voodoo->wake_render_thread[0] = thread_create_event();
-        voodoo->wake_render_thread[1] = thread_create_event();
-        voodoo->wake_render_thread[2] = thread_create_event();
-        voodoo->wake_render_thread[3] = thread_create_event();
         voodoo->wake_main_thread = thread_create_event();
         voodoo->fifo_not_full_event = thread_create_event();
-        voodoo->render_not_full_event[0] = thread_create_event();
-        voodoo->render_not_full_event[1] = thread_create_event();
-        voodoo->render_not_full_event[2] = thread_create_event();
-        voodoo->render_not_full_event[3] = thread_create_event();
         voodoo->fifo_thread = thread_create(voodoo_fifo_thread, voodoo);
-        voodoo->render_thread[0] = thread_create(voodoo_render_thread_1, voodoo);
-        if (voodoo->render_threads >= 2)
-                voodoo->render_thread[1] = thread_create(voodoo_render_thread_2, voodoo);
-        if (voodoo->render_threads == 4) {
-                voodoo->render_thread[2] = thread_create(voodoo_render_thread_3, voodoo);
-                voodoo->render_thread[3] = thread_create(voodoo_render_thread_4, voodoo);
-        }
+        voodoo_render_threads_start(voodoo);
         voodoo->swap_mutex = thread_create_mutex();
         timer_add(&voodoo->wake_timer, voodoo_wake_timer, (void *)voodoo, 0);
         
@@ -1055,9 +1035,13 @@ void *voodoo_2d3d_card_init(int type)
         voodoo->bilinear_enabled = device_get_config_int("bilinear");
         voodoo->scrfilter = device_get_config_int("dacfilter");
         voodoo->render_threads = device_get_config_int("render_threads");
-        voodoo->odd_even_mask = voodoo->render_threads - 1;
+        if (voodoo->render_threads < 1)
+                voodoo->render_threads = 1;
+        if (voodoo->render_threads > VOODOO_MAX_RENDER_THREADS)
+                voodoo->render_threads = VOODOO_MAX_RENDER_THREADS;
 #ifndef NO_CODEGEN
         voodoo->use_recompiler = device_get_config_int("recompiler");
+        voodoo->codegen_blocks = device_get_config_int("recompiler_cache");
 #endif
         voodoo->type = type;
         voodoo->dual_tmus = (type == VOODOO_3) ? 1 : 0;
@@ -1065,41 +1049,17 @@ void *voodoo_2d3d_card_init(int type)
 	/*generate filter lookup tables*/
 	voodoo_generate_filter_v2(voodoo);
 
-        for (c = 0; c < TEX_CACHE_MAX; c++) {
-                voodoo->texture_cache[0][c].data = malloc((256*256 + 256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2) * 4);
-                voodoo->texture_cache[0][c].base = -1; /*invalid*/
-                voodoo->texture_cache[0][c].refcount = 0;
-                if (voodoo->dual_tmus)
-                {
-                        voodoo->texture_cache[1][c].data = malloc((256*256 + 256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2) * 4);
-                        voodoo->texture_cache[1][c].base = -1; /*invalid*/
-                        voodoo->texture_cache[1][c].refcount = 0;
-                }
-        }
+        voodoo_texture_cache_init(voodoo, device_get_config_int("texture_cache"));
 
         timer_add(&voodoo->timer, voodoo_callback, voodoo, 1);
 
         voodoo->fbiInit0 = 0;
 
         voodoo->wake_fifo_thread = thread_create_event();
-        voodoo->wake_render_thread[0] = thread_create_event();
-        voodoo->wake_render_thread[1] = thread_create_event();
-        voodoo->wake_render_thread[2] = thread_create_event();
-        voodoo->wake_render_thread[3] = thread_create_event();
         voodoo->wake_main_thread = thread_create_event();
         voodoo->fifo_not_full_event = thread_create_event();
-        voodoo->render_not_full_event[0] = thread_create_event();
-        voodoo->render_not_full_event[1] = thread_create_event();
-        voodoo->render_not_full_event[2] = thread_create_event();
-        voodoo->render_not_full_event[3] = thread_create_event();
         voodoo->fifo_thread = thread_create(voodoo_fifo_thread, voodoo);
-        voodoo->render_thread[0] = thread_create(voodoo_render_thread_1, voodoo);
-        if (voodoo->render_threads >= 2)
-                voodoo->render_thread[1] = thread_create(voodoo_render_thread_2, voodoo);
-        if (voodoo->render_threads == 4) {
-                voodoo->render_thread[2] = thread_create(voodoo_render_thread_3, voodoo);
-                voodoo->render_thread[3] = thread_create(voodoo_render_thread_4, voodoo);
-        }
+        voodoo_render_threads_start(voodoo);
         voodoo->swap_mutex = thread_create_mutex();
         timer_add(&voodoo->wake_timer, voodoo_wake_timer, (void *)voodoo, 0);
 
@@ -1226,7 +1186,6 @@ void voodoo_card_close(voodoo_t *voodoo)
 /* #ifndef RELEASE_BUILD
         FILE *f;
 #endif */
-        int c;
         
 /* #ifndef RELEASE_BUILD        
         f = rom_fopen(L"texram.dmp", L"wb");
@@ -1242,27 +1201,12 @@ void voodoo_card_close(voodoo_t *voodoo)
 
 
         thread_kill(voodoo->fifo_thread);
-        thread_kill(voodoo->render_thread[0]);
-        if (voodoo->render_threads >= 2)
-                thread_kill(voodoo->render_thread[1]);
-        if (voodoo->render_threads == 4) {
-                thread_kill(voodoo->render_thread[2]);
-                thread_kill(voodoo->render_thread[3]);
-        }
+        voodoo_render_threads_stop(voodoo);
         thread_destroy_event(voodoo->fifo_not_full_event);
         thread_destroy_event(voodoo->wake_main_thread);
         thread_destroy_event(voodoo->wake_fifo_thread);
-        thread_destroy_event(voodoo->wake_render_thread[0]);
-        thread_destroy_event(voodoo->wake_render_thread[1]);
-        thread_destroy_event(voodoo->render_not_full_event[0]);
-        thread_destroy_event(voodoo->render_not_full_event[1]);
 
-        for (c = 0; c < TEX_CACHE_MAX; c++)
-        {
-                if (voodoo->dual_tmus)
-                        free(voodoo->texture_cache[1][c].data);
-                free(voodoo->texture_cache[0][c].data);
-        }
+        voodoo_texture_cache_close(voodoo);
 #ifndef NO_CODEGEN
         voodoo_codegen_close(voodoo);
 #endif
@@ -1369,27 +1313,38 @@ static const device_config_t voodoo_config[] =
                 .default_int = 0
         },
         {
-                .name = "render_threads",
-                .description = "Render threads",
+                .name = "texture_cache",
+                .description = "Texture cache size",
                 .type = CONFIG_SELECTION,
                 .selection =
                 {
                         {
-                                .description = "1",
-                                .value = 1
+                                .description = "64 MB",
+                                .value = 64
                         },
                         {
-                                .description = "2",
-                                .value = 2
+                                .description = "128 MB",
+                                .value = 128
                         },
                         {
-                                .description = "4",
-                                .value = 4
+                                .description = "256 MB",
+                                .value = 256
                         },
                         {
                                 .description = ""
                         }
                 },
+                .default_int = 128
+        },
+        {
+                .name = "render_threads",
+                .description = "Render threads",
+                .type = CONFIG_SPINNER,
+                .spinner =
+                {
+                        .min = 1,
+                        .max = VOODOO_MAX_RENDER_THREADS
+                },
                 .default_int = 2
         },
         {
@@ -1405,6 +1360,38 @@ static const device_config_t voodoo_config[] =
                 .type = CONFIG_BINARY,
                 .default_int = 1
         },
+        {
+                .name = "recompiler_cache",
+                .description = "Recompiler cache size",
+                .type = CONFIG_SELECTION,
+                .selection =
+                {
+                        {
+                                .description = "16 pipelines",
+                                .value = 16
+                        },
+                        {
+                                .description = "32 pipelines",
+                                .value = 32
+                        },
+                        {
+                                .description = "64 pipelines",
+                                .value = 64
+                        },
+                        {
+                                .description = "128 pipelines",
+                                .value = 128
+                        },
+                        {
+                                .description = "256 pipelines",
+                                .value = 256
+                        },
+                        {
+                                .description = ""
+                        }
+                },
+                .default_int = 32
+        },
 #endif
         {
                 .type = -1
@@ -839,9 +839,7 @@ static uint32_t banshee_status(banshee_t *banshee)
         int swap_count = voodoo->swap_count;
         int written = voodoo->cmd_written + voodoo->cmd_written_fifo;
         int busy = (written - voodoo->cmd_read) || (voodoo->cmdfifo_depth_rd != voodoo->cmdfifo_depth_wr) ||
-                voodoo->render_voodoo_busy[0] || voodoo->render_voodoo_busy[1] ||
-                voodoo->render_voodoo_busy[2] || voodoo->render_voodoo_busy[3] ||
-                voodoo->voodoo_busy;
+                voodoo_render_threads_busy(voodoo) || voodoo->voodoo_busy;
         uint32_t ret;
 
         ret = 0;
@@ -2565,27 +2563,38 @@ static const device_config_t banshee_sgram_config[] =
                 .default_int = 0
         },
         {
-                .name = "render_threads",
-                .description = "Render threads",
+                .name = "texture_cache",
+                .description = "Texture cache size",
                 .type = CONFIG_SELECTION,
                 .selection =
                 {
                         {
-                                .description = "1",
-                                .value = 1
+                                .description = "64 MB",
+                                .value = 64
                         },
                         {
-                                .description = "2",
-                                .value = 2
+                                .description = "128 MB",
+                                .value = 128
                         },
                         {
-                                .description = "4",
-                                .value = 4
+                                .description = "256 MB",
+                                .value = 256
                         },
                         {
                                 .description = ""
                         }
                 },
+                .default_int = 128
+        },
+        {
+                .name = "render_threads",
+                .description = "Render threads",
+                .type = CONFIG_SPINNER,
+                .spinner =
+                {
+                        .min = 1,
+                        .max = VOODOO_MAX_RENDER_THREADS
+                },
                 .default_int = 2
         },
 #ifndef NO_CODEGEN
@@ -2595,6 +2604,38 @@ static const device_config_t banshee_sgram_config[] =
                 .type = CONFIG_BINARY,
                 .default_int = 1
         },
+        {
+                .name = "recompiler_cache",
+                .description = "Recompiler cache size",
+                .type = CONFIG_SELECTION,
+                .selection =
+                {
+                        {
+                                .description = "16 pipelines",
+                                .value = 16
+                        },
+                        {
+                                .description = "32 pipelines",
+                                .value = 32
+                        },
+                        {
+                                .description = "64 pipelines",
+                                .value = 64
+                        },
+                        {
+                                .description = "128 pipelines",
+                                .value = 128
+                        },
+                        {
+                                .description = "256 pipelines",
+                                .value = 256
+                        },
+                        {
+                                .description = ""
+                        }
+                },
+                .default_int = 32
+        },
 #endif
         {
                 .type = -1
@@ -2616,27 +2657,38 @@ static const device_config_t banshee_sdram_config[] =
                 .default_int = 0
         },
         {
-                .name = "render_threads",
-                .description = "Render threads",
+                .name = "texture_cache",
+                .description = "Texture cache size",
                 .type = CONFIG_SELECTION,
                 .selection =
                 {
                         {
-                                .description = "1",
-                                .value = 1
+                                .description = "64 MB",
+                                .value = 64
                         },
                         {
-                                .description = "2",
-                                .value = 2
+                                .description = "128 MB",
+                                .value = 128
                         },
                         {
-                                .description = "4",
-                                .value = 4
+                                .description = "256 MB",
+                                .value = 256
                         },
                         {
                                 .description = ""
                         }
                 },
+                .default_int = 128
+        },
+        {
+                .name = "render_threads",
+                .description = "Render threads",
+                .type = CONFIG_SPINNER,
+                .spinner =
+                {
+                        .min = 1,
+                        .max = VOODOO_MAX_RENDER_THREADS
+                },
                 .default_int = 2
         },
 #ifndef NO_CODEGEN
@@ -2646,6 +2698,38 @@ static const device_config_t banshee_sdram_config[] =
                 .type = CONFIG_BINARY,
                 .default_int = 1
         },
+        {
+                .name = "recompiler_cache",
+                .description = "Recompiler cache size",
+                .type = CONFIG_SELECTION,
+                .selection =
+                {
+                        {
+                                .description = "16 pipelines",
+                                .value = 16
+                        },
+                        {
+                                .description = "32 pipelines",
+                                .value = 32
+                        },
+                        {
+                                .description = "64 pipelines",
+                                .value = 64
+                        },
+                        {
+                                .description = "128 pipelines",
+                                .value = 128
+                        },
+                        {
+                                .description = "256 pipelines",
+                                .value = 256
+                        },
+                        {
+                                .description = ""
+                        }
+                },
+                .default_int = 32
+        },
 #endif
         {
                 .type = -1
@@ -692,6 +692,57 @@ static inline void voodoo_tmu_fetch_and_blend(voodoo_t *voodoo, voodoo_params_t
 int voodoo_recomp = 0;
 #endif
 
+/*Render thread that draws the given screen line. SLI cards only see every
+  other line, so bands are counted in lines of this card*/
+static inline int voodoo_line_thread(voodoo_t *voodoo, int real_y)
+{
+        if (SLI_ENABLED)
+                real_y >>= 1;
+
+        return ((uint32_t)real_y >> VOODOO_TILE_SHIFT) % voodoo->render_threads;
+}
+
+/*Whether any of lines ystart to yend-1 falls in a band drawn by this render
+  thread, so that threads can skip triangles that miss all of their bands*/
+static int voodoo_thread_covers(voodoo_t *voodoo, voodoo_params_t *params, int ystart, int yend, int odd_even)
+{
+        int lo = ystart, hi = yend - 1;
+        int band;
+
+        if (hi < lo)
+                return 0;
+        if (voodoo->render_threads == 1)
+                return 1;
+
+        if (params->fbzMode & (1 << 17))
+        {
+                int temp = (voodoo->v_disp-1) - hi;
+
+                hi = (voodoo->v_disp-1) - lo;
+                lo = temp;
+        }
+        if (lo < 0)
+                return 1; /*Leave wrapped lines to the per-line check*/
+
+        if (SLI_ENABLED)
+        {
+                lo >>= 1;
+                hi >>= 1;
+        }
+        lo >>= VOODOO_TILE_SHIFT;
+        hi >>= VOODOO_TILE_SHIFT;
+
+        if ((hi - lo) >= (voodoo->render_threads - 1))
+                return 1;
+        for (band = lo; band <= hi; band++)
+        {
+                if ((band % voodoo->render_threads) == odd_even)
+                        return 1;
+        }
+
+        return 0;
+}
+
 static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int ystart, int yend, int odd_even)
 {
 /*        int rgb_sel                 = params->fbzColorPath & 3;
@@ -813,6 +864,9 @@ static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, vood
                         state->xend += state->dx2;
                 }
         }
+        if (!voodoo_thread_covers(voodoo, params, state->y, yend, odd_even))
+                goto skip_triangle;
+
 #ifndef NO_CODEGEN
         if (voodoo->use_recompiler)
                 voodoo_draw = voodoo_get_block(voodoo, params, state, odd_even);
@@ -856,16 +910,8 @@ static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, vood
                 else
                         real_y >>= 4;
 
-                if (SLI_ENABLED)
-                {
-                        if (((real_y >> 1) & voodoo->odd_even_mask) != odd_even)
-                                goto next_line;
-                }
-                else
-                {
-                        if ((real_y & voodoo->odd_even_mask) != odd_even)
-                                goto next_line;
-                }
+                if (voodoo_line_thread(voodoo, real_y) != odd_even)
+                        goto next_line;
 
                 start_x = x;
 
@@ -1435,6 +1481,7 @@ next_line:
                 state->xend += state->dx2;
         }
 
+skip_triangle:
         voodoo->texture_cache[0][params->tex_entry[0]].refcount_r[odd_even]++;
         voodoo->texture_cache[1][params->tex_entry[1]].refcount_r[odd_even]++;
 }
@@ -1587,9 +1634,11 @@ void voodoo_triangle(voodoo_t *voodoo, voodoo_params_t *params, int odd_even)
 }
 
 
-static void render_thread(void *param, int odd_even)
+static void voodoo_render_thread(void *param)
 {
-        voodoo_t *voodoo = (voodoo_t *)param;
+        voodoo_render_thread_data_t *data = (voodoo_render_thread_data_t *)param;
+        voodoo_t *voodoo = data->voodoo;
+        int odd_even = data->thread;
 
         while (1)
         {
@@ -1619,46 +1668,49 @@ static void render_thread(void *param, int odd_even)
         }
 }
 
-void voodoo_render_thread_1(void *param)
+void voodoo_render_threads_start(voodoo_t *voodoo)
 {
-        render_thread(param, 0);
-}
-void voodoo_render_thread_2(void *param)
-{
-        render_thread(param, 1);
-}
-void voodoo_render_thread_3(void *param)
-{
-        render_thread(param, 2);
+        int c;
+
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                voodoo->wake_render_thread[c] = thread_create_event();
+                voodoo->render_not_full_event[c] = thread_create_event();
+        }
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                voodoo->render_thread_data[c].voodoo = voodoo;
+                voodoo->render_thread_data[c].thread = c;
+                voodoo->render_thread[c] = thread_create(voodoo_render_thread, &voodoo->render_thread_data[c]);
+        }
 }
-void voodoo_render_thread_4(void *param)
+
+void voodoo_render_threads_stop(voodoo_t *voodoo)
 {
-        render_thread(param, 3);
+        int c;
+
+        for (c = 0; c < voodoo->render_threads; c++)
+                thread_kill(voodoo->render_thread[c]);
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                thread_destroy_event(voodoo->wake_render_thread[c]);
+                thread_destroy_event(voodoo->render_not_full_event[c]);
+        }
 }
 
 void voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
 {
         voodoo_params_t *params_new = &voodoo->params_buffer[voodoo->params_write_idx & PARAM_MASK];
+        int c;
 
-        while (PARAM_FULL(0) || (voodoo->render_threads >= 2 && PARAM_FULL(1)) ||
-                (voodoo->render_threads == 4 && (PARAM_FULL(2) || PARAM_FULL(3))))
+        for (c = 0; c < voodoo->render_threads; c++)
         {
-                thread_reset_event(voodoo->render_not_full_event[0]);
-                if (voodoo->render_threads >= 2)
-                        thread_reset_event(voodoo->render_not_full_event[1]);
-                if (voodoo->render_threads == 4)
+                while (PARAM_FULL(c))
                 {
-                        thread_reset_event(voodoo->render_not_full_event[2]);
-                        thread_reset_event(voodoo->render_not_full_event[3]);
+                        thread_reset_event(voodoo->render_not_full_event[c]);
+                        if (PARAM_FULL(c))
+                                thread_wait_event(voodoo->render_not_full_event[c], -1); /*Wait for room in ringbuffer*/
                 }
-                if (PARAM_FULL(0))
-                        thread_wait_event(voodoo->render_not_full_event[0], -1); /*Wait for room in ringbuffer*/
-                if (voodoo->render_threads >= 2 && PARAM_FULL(1))
-                        thread_wait_event(voodoo->render_not_full_event[1], -1); /*Wait for room in ringbuffer*/
-                if (voodoo->render_threads == 4 && PARAM_FULL(2))
-                        thread_wait_event(voodoo->render_not_full_event[2], -1); /*Wait for room in ringbuffer*/
-                if (voodoo->render_threads == 4 && PARAM_FULL(3))
-                        thread_wait_event(voodoo->render_not_full_event[3], -1); /*Wait for room in ringbuffer*/
         }
 
         voodoo_use_texture(voodoo, params, 0);
@@ -1669,7 +1721,12 @@ void voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
 
         voodoo->params_write_idx++;
 
-        if (PARAM_ENTRIES(0) < 4 || (voodoo->render_threads >= 2 && PARAM_ENTRIES(1) < 4) ||
-                        (voodoo->render_threads == 4 && (PARAM_ENTRIES(2) < 4 || PARAM_ENTRIES(3) < 4)))
-                voodoo_wake_render_thread(voodoo);
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                if (PARAM_ENTRIES(c) < 4)
+                {
+                        voodoo_wake_render_thread(voodoo);
+                        break;
+                }
+        }
 }
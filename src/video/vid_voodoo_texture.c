@@ -158,13 +158,141 @@ void voodoo_recalc_tex(voodoo_t *voodoo, int tmu)
 
 #define makergba(r, g, b, a)  ((b) | ((g) << 8) | ((r) << 16) | ((a) << 24))
 
+static inline int voodoo_texture_hash(uint32_t base, uint32_t tLOD, uint32_t palette_checksum)
+{
+        uint32_t hash = (base ^ (tLOD * 0x85ebca6b) ^ (palette_checksum * 0xc2b2ae35)) * 0x9e3779b1;
+
+        return hash >> (32 - TEX_HASH_BITS);
+}
+
+/*Whether any render thread still has queued triangles using this texture*/
+static inline int voodoo_texture_busy(voodoo_t *voodoo, texture_t *texture)
+{
+        int c;
+
+        for (c = 0; c < voodoo->render_threads; c++)
+        {
+                if (texture->refcount != texture->refcount_r[c])
+                        return 1;
+        }
+
+        return 0;
+}
+
+/*Add or remove a cache entry from the reverse index of every dirty page
+  its texture memory covers. texture_present[] is kept as a quick check of
+  whether any entry uses a page*/
+static void voodoo_texture_mark_pages(voodoo_t *voodoo, int tmu, int c, int set)
+{
+        texture_t *texture = &voodoo->texture_cache[tmu][c];
+        uint32_t page_mask = voodoo->texture_mask >> TEX_DIRTY_SHIFT;
+        int d;
+
+        for (d = 0; d < 4; d++)
+        {
+                uint32_t page, end_page;
+
+                if (texture->addr_end[d] == 0)
+                        continue;
+
+                page = (texture->addr_start[d] & voodoo->texture_mask) >> TEX_DIRTY_SHIFT;
+                end_page = ((texture->addr_end[d] - 1) & voodoo->texture_mask) >> TEX_DIRTY_SHIFT;
+
+                while (1)
+                {
+                        uint32_t *entries = &voodoo->texture_pages[tmu][page * TEX_CACHE_WORDS];
+
+                        if (set)
+                        {
+                                entries[c >> 5] |= (1U << (c & 31));
+                                voodoo->texture_present[tmu][page] = 1;
+                        }
+                        else
+                        {
+                                int e;
+
+                                entries[c >> 5] &= ~(1U << (c & 31));
+                                voodoo->texture_present[tmu][page] = 0;
+                                for (e = 0; e < TEX_CACHE_WORDS; e++)
+                                {
+                                        if (entries[e])
+                                        {
+                                                voodoo->texture_present[tmu][page] = 1;
+                                                break;
+                                        }
+                                }
+                        }
+
+                        if (page == end_page)
+                                break;
+                        page = (page + 1) & page_mask;
+                }
+        }
+}
+
+static void voodoo_texture_remove(voodoo_t *voodoo, int tmu, int c)
+{
+        texture_t *texture = &voodoo->texture_cache[tmu][c];
+        int *prev = &voodoo->texture_hash[tmu][texture->hash];
+
+        while (*prev != c)
+                prev = &voodoo->texture_cache[tmu][*prev].hash_next;
+        *prev = texture->hash_next;
+
+        voodoo_texture_mark_pages(voodoo, tmu, c, 0);
+        texture->base = -1;
+}
+
+/*Find a cache entry for a new texture. Entries are allocated until the
+  cache size is used up, after that the CLOCK algorithm picks an entry no
+  queued triangle refers to, giving recently used ones a second chance*/
+static int voodoo_texture_alloc(voodoo_t *voodoo, int tmu)
+{
+        int c;
+
+        if (voodoo->texture_cache_used[tmu] < voodoo->texture_cache_entries)
+        {
+                c = voodoo->texture_cache_used[tmu]++;
+                voodoo->texture_cache[tmu][c].data = malloc(TEX_CACHE_ENTRY_SIZE);
+                return c;
+        }
+
+        while (1)
+        {
+                int d;
+
+                for (d = 0; d < voodoo->texture_cache_entries*2; d++)
+                {
+                        texture_t *texture;
+
+                        c = voodoo->texture_last_removed[tmu];
+                        voodoo->texture_last_removed[tmu] = (c + 1) % voodoo->texture_cache_entries;
+                        texture = &voodoo->texture_cache[tmu][c];
+
+                        if (voodoo_texture_busy(voodoo, texture))
+                                continue;
+                        if (texture->base == -1)
+                                return c;
+                        if (!texture->referenced)
+                        {
+                                voodoo_texture_remove(voodoo, tmu, c);
+                                return c;
+                        }
+                        texture->referenced = 0;
+                }
+
+                voodoo_wait_for_render_thread_idle(voodoo);
+        }
+}
+
 void voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
 {
-        int c, d;
+        int c;
         int lod;
         int lod_min, lod_max;
-        uint32_t addr = 0, addr_end;
+        uint32_t addr = 0;
         uint32_t palette_checksum;
+        int hash;
 
         lod_min = (params->tLOD[tmu] >> 2) & 15;
         lod_max = (params->tLOD[tmu] >> 8) & 15;
@@ -193,37 +321,22 @@ void voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
                 addr = params->texBaseAddr[tmu];
 
         /*Try to find texture in cache*/
-        for (c = 0; c < TEX_CACHE_MAX; c++)
+        hash = voodoo_texture_hash(addr, params->tLOD[tmu] & 0xf00fff, palette_checksum);
+        for (c = voodoo->texture_hash[tmu][hash]; c != -1; c = voodoo->texture_cache[tmu][c].hash_next)
         {
                 if (voodoo->texture_cache[tmu][c].base == addr &&
                     voodoo->texture_cache[tmu][c].tLOD == (params->tLOD[tmu] & 0xf00fff) &&
                     voodoo->texture_cache[tmu][c].palette_checksum == palette_checksum)
                 {
                         params->tex_entry[tmu] = c;
+                        voodoo->texture_cache[tmu][c].referenced = 1;
                         voodoo->texture_cache[tmu][c].refcount++;
                         return;
                 }
         }
         
         /*Texture not found, search for unused texture*/
-        do
-        {
-                for (c = 0; c < TEX_CACHE_MAX; c++)
-                {
-                        voodoo->texture_last_removed++;
-                        voodoo->texture_last_removed &= (TEX_CACHE_MAX-1);
-                        if (voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[0] &&
-                            (voodoo->render_threads == 1 || voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[1]))
-                                break;
-                }
-                if (c == TEX_CACHE_MAX)
-                        voodoo_wait_for_render_thread_idle(voodoo);
-        } while (c == TEX_CACHE_MAX);
-        if (c == TEX_CACHE_MAX)
-                fatal("Texture cache full!\n");
-
-        c = voodoo->texture_last_removed;
-
+        c = voodoo_texture_alloc(voodoo, tmu);
 
         if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
                 voodoo->texture_cache[tmu][c].base = params->texBaseAddr1[tmu];
@@ -500,17 +613,12 @@ void voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
                 voodoo->texture_cache[tmu][c].addr_start[3] = voodoo->texture_cache[tmu][c].addr_end[3] = 0;
 
 
-        for (d = 0; d < 4; d++)
-        {
-                addr = voodoo->texture_cache[tmu][c].addr_start[d];
-                addr_end = voodoo->texture_cache[tmu][c].addr_end[d];
+        voodoo_texture_mark_pages(voodoo, tmu, c, 1);
 
-                if (addr_end != 0)
-                {
-                        for (; addr <= addr_end; addr += (1 << TEX_DIRTY_SHIFT))
-                                voodoo->texture_present[tmu][(addr & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
-                }
-        }
+        voodoo->texture_cache[tmu][c].hash = hash;
+        voodoo->texture_cache[tmu][c].hash_next = voodoo->texture_hash[tmu][hash];
+        voodoo->texture_hash[tmu][hash] = c;
+        voodoo->texture_cache[tmu][c].referenced = 1;
 
         params->tex_entry[tmu] = c;
         voodoo->texture_cache[tmu][c].refcount++;
@@ -518,45 +626,24 @@ void voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
 
 void flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
 {
+        uint32_t *entries = &voodoo->texture_pages[tmu][(dirty_addr >> TEX_DIRTY_SHIFT) * TEX_CACHE_WORDS];
         int wait_for_idle = 0;
-        int c;
+        int c, d;
 
-        memset(voodoo->texture_present[tmu], 0, sizeof(voodoo->texture_present[0]));
-//        voodoo_texture_log("Evict %08x %i\n", dirty_addr, sizeof(voodoo->texture_present));
-        for (c = 0; c < TEX_CACHE_MAX; c++)
+//        voodoo_texture_log("Evict %08x\n", dirty_addr);
+        for (c = 0; c < TEX_CACHE_WORDS; c++)
         {
-                if (voodoo->texture_cache[tmu][c].base != -1)
+                for (d = 0; entries[c]; d++)
                 {
-                        int d;
-
-                        for (d = 0; d < 4; d++)
+                        if (entries[c] & (1U << d))
                         {
-                                int addr_start = voodoo->texture_cache[tmu][c].addr_start[d];
-                                int addr_end = voodoo->texture_cache[tmu][c].addr_end[d];
+                                int entry = c*32 + d;
+//                                voodoo_texture_log("  Evict texture %i %08x\n", entry, voodoo->texture_cache[tmu][entry].base);
 
-                                if (addr_end != 0)
-                                {
-                                        int addr_start_masked = addr_start & voodoo->texture_mask & ~0x3ff;
-                                        int addr_end_masked = ((addr_end & voodoo->texture_mask) + 0x3ff) & ~0x3ff;
-
-                                        if (addr_end_masked < addr_start_masked)
-                                                addr_end_masked = voodoo->texture_mask+1;
-                                        if (dirty_addr >= addr_start_masked && dirty_addr < addr_end_masked)
-                                        {
-//                                voodoo_texture_log("  Evict texture %i %08x\n", c, voodoo->texture_cache[tmu][c].base);
-
-                                                if (voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[0] ||
-                                                    (voodoo->render_threads == 2 && voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[1]))
-                                                        wait_for_idle = 1;
+                                if (voodoo_texture_busy(voodoo, &voodoo->texture_cache[tmu][entry]))
+                                        wait_for_idle = 1;
 
-                                                voodoo->texture_cache[tmu][c].base = -1;
-                                        }
-                                        else
-                                        {
-                                                for (; addr_start <= addr_end; addr_start += (1 << TEX_DIRTY_SHIFT))
-                                                        voodoo->texture_present[tmu][(addr_start & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
-                                        }
-                                }
+                                voodoo_texture_remove(voodoo, tmu, entry);
                         }
                 }
         }
@@ -564,6 +651,47 @@ void flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
                 voodoo_wait_for_render_thread_idle(voodoo);
 }
 
+void voodoo_texture_cache_init(voodoo_t *voodoo, int size)
+{
+        int tmu, c;
+
+        voodoo->texture_cache_entries = ((uint64_t)size << 20) / TEX_CACHE_ENTRY_SIZE;
+        if (voodoo->texture_cache_entries < 16)
+                voodoo->texture_cache_entries = 16;
+        if (voodoo->texture_cache_entries > TEX_CACHE_MAX)
+                voodoo->texture_cache_entries = TEX_CACHE_MAX;
+
+        for (tmu = 0; tmu < 2; tmu++)
+        {
+                for (c = 0; c < TEX_CACHE_MAX; c++)
+                {
+                        voodoo->texture_cache[tmu][c].data = NULL; /*allocated on first use*/
+                        voodoo->texture_cache[tmu][c].base = -1; /*invalid*/
+                        voodoo->texture_cache[tmu][c].refcount = 0;
+                }
+                for (c = 0; c < TEX_HASH_SIZE; c++)
+                        voodoo->texture_hash[tmu][c] = -1;
+
+                voodoo->texture_pages[tmu] = malloc(TEX_DIRTY_PAGES * TEX_CACHE_WORDS * sizeof(uint32_t));
+                memset(voodoo->texture_pages[tmu], 0, TEX_DIRTY_PAGES * TEX_CACHE_WORDS * sizeof(uint32_t));
+                memset(voodoo->texture_present[tmu], 0, sizeof(voodoo->texture_present[0]));
+                voodoo->texture_cache_used[tmu] = 0;
+                voodoo->texture_last_removed[tmu] = 0;
+        }
+}
+
+void voodoo_texture_cache_close(voodoo_t *voodoo)
+{
+        int tmu, c;
+
+        for (tmu = 0; tmu < 2; tmu++)
+        {
+                for (c = 0; c < TEX_CACHE_MAX; c++)
+                        free(voodoo->texture_cache[tmu][c].data);
+                free(voodoo->texture_pages[tmu]);
+        }
+}
+
 void voodoo_tex_writel(uint32_t addr, uint32_t val, void *p)
 {
         int lod, s, t;
@@ -69,10 +69,15 @@
 #include <86box/plat.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/vid_svga_render.h>
+#include <86box/vid_rop.h>
 
 #include <minitrace/minitrace.h>
 
 volatile int	screenshots = 0;
+int		video_capture_format = VIDEO_CAPTURE_PNG,
+		video_capture_level = -1,	/* -1 = libpng default */
+		video_capture_interval = 0;	/* capture every Nth frame */
 bitmap_t	*buffer32 = NULL;
 bitmap_t	*render_buffer = NULL;
 uint8_t		fontdat[2048][8];		/* IBM CGA font */
@@ -256,6 +261,37 @@ static struct {
 }		blit_data;
 
 
+/* Frames waiting to be written out by the capture thread. */
+#define CAPTURE_FRAMES	4
+
+typedef struct {
+    volatile int	state;			/* CAPTURE_FREE etc. */
+    int		w, h, size;
+    uint32_t	*dat;
+    wchar_t	path[1024];
+} capture_frame_t;
+
+enum {
+    CAPTURE_FREE = 0,
+    CAPTURE_QUEUED
+};
+
+static struct {
+    capture_frame_t	frames[CAPTURE_FRAMES];
+    int		next,			/* next frame to encode */
+		head,			/* next frame to fill */
+		stop,
+		dir_made;
+    wchar_t	dir[1024];
+    uint32_t	frame_count,
+		stream_num,
+		dropped;
+
+    thread_t	*thread;
+    event_t	*wake;
+}		capture_data;
+
+
 static void (*blit_func)(int x, int y, int y1, int y2, int w, int h);
 
 
@@ -333,103 +369,186 @@ video_wait_for_buffer(void)
 }
 
 
-static png_structp	png_ptr;
-static png_infop	info_ptr;
-
-
 static void
-video_take_screenshot(const wchar_t *fn, int startx, int starty, int y1, int y2, int w, int h)
+capture_write_png(capture_frame_t *f, FILE *fp)
 {
-    int i, x, y;
-    png_bytep *b_rgb = NULL;
-    FILE *fp = NULL;
-    uint32_t temp = 0x00000000;
-
-    /* create file */
-    fp = plat_fopen((wchar_t *) fn, (wchar_t *) L"wb");
-    if (!fp) {
-	video_log("[video_take_screenshot] File %ls could not be opened for writing", fn);
-	return;
-    }
+    png_structp png_ptr;
+    png_infop info_ptr;
+    png_bytep row;
+    uint32_t temp;
+    int x, y;
 
-    /* initialize stuff */
     png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-
     if (!png_ptr) {
-	video_log("[video_take_screenshot] png_create_write_struct failed");
-	fclose(fp);
+	video_log("[capture_write_png] png_create_write_struct failed");
 	return;
     }
 
     info_ptr = png_create_info_struct(png_ptr);
     if (!info_ptr) {
-	video_log("[video_take_screenshot] png_create_info_struct failed");
-	fclose(fp);
+	video_log("[capture_write_png] png_create_info_struct failed");
+	png_destroy_write_struct(&png_ptr, NULL);
+	return;
+    }
+
+    row = (png_bytep) malloc(f->w * 3);
+    if ((row == NULL) || setjmp(png_jmpbuf(png_ptr))) {
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+	free(row);
 	return;
     }
 
     png_init_io(png_ptr, fp);
 
-    png_set_IHDR(png_ptr, info_ptr, w, h,
+    if (video_capture_level >= 0) {
+	png_set_compression_level(png_ptr, video_capture_level);
+	/* Filtering buys little at the fastest levels. */
+	if (video_capture_level <= 1)
+		png_set_filter(png_ptr, 0, PNG_FILTER_NONE);
+    }
+
+    png_set_IHDR(png_ptr, info_ptr, f->w, f->h,
 	8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
 	PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
-    b_rgb = (png_bytep *) malloc(sizeof(png_bytep) * h);
-    if (b_rgb == NULL) {
-	video_log("[video_take_screenshot] Unable to Allocate RGB Bitmap Memory");
-	fclose(fp);
-	return;
-    }
+    png_write_info(png_ptr, info_ptr);
 
-    for (y = 0; y < h; ++y) {
-	b_rgb[y] = (png_byte *) malloc(png_get_rowbytes(png_ptr, info_ptr));
-    	for (x = 0; x < w; ++x) {
-		temp = render_buffer->dat[(y * w) + x];
+    for (y = 0; y < f->h; y++) {
+	for (x = 0; x < f->w; x++) {
+		temp = f->dat[(y * f->w) + x];
 
-		b_rgb[y][(x) * 3 + 0] = (temp >> 16) & 0xff;
-		b_rgb[y][(x) * 3 + 1] = (temp >> 8) & 0xff;
-		b_rgb[y][(x) * 3 + 2] = temp & 0xff;
+		row[(x) * 3 + 0] = (temp >> 16) & 0xff;
+		row[(x) * 3 + 1] = (temp >> 8) & 0xff;
+		row[(x) * 3 + 2] = temp & 0xff;
 	}
+	png_write_row(png_ptr, row);
     }
 
-    png_write_info(png_ptr, info_ptr);
+    png_write_end(png_ptr, NULL);
 
-    png_write_image(png_ptr, b_rgb);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    free(row);
+}
 
-    png_write_end(png_ptr, NULL);
 
-    /* cleanup heap allocation */
-    for (i = 0; i < h; i++)
-	if (b_rgb[i])  free(b_rgb[i]);
+/* Raw mode, a binary PPM needs no compression at all. */
+static void
+capture_write_ppm(capture_frame_t *f, FILE *fp)
+{
+    uint8_t *row;
+    uint32_t temp;
+    int x, y;
+
+    row = (uint8_t *) malloc(f->w * 3);
+    if (row == NULL)
+	return;
+
+    fprintf(fp, "P6\n%i %i\n255\n", f->w, f->h);
+
+    for (y = 0; y < f->h; y++) {
+	for (x = 0; x < f->w; x++) {
+		temp = f->dat[(y * f->w) + x];
 
-    if (b_rgb) free(b_rgb);
+		row[(x) * 3 + 0] = (temp >> 16) & 0xff;
+		row[(x) * 3 + 1] = (temp >> 8) & 0xff;
+		row[(x) * 3 + 2] = temp & 0xff;
+	}
+	fwrite(row, 1, f->w * 3, fp);
+    }
 
-    if (fp) fclose(fp);
+    free(row);
 }
 
 
 static void
-video_screenshot(int x, int y, int y1, int y2, int w, int h)
+capture_thread(void *param)
 {
-    wchar_t path[1024], fn[128];
+    capture_frame_t *f;
+    FILE *fp;
 
-    memset(fn, 0, sizeof(fn));
-    memset(path, 0, sizeof(path));
+    while (1) {
+	f = &capture_data.frames[capture_data.next];
 
-    plat_append_filename(path, usr_path, SCREENSHOT_PATH);
+	if (f->state != CAPTURE_QUEUED) {
+		if (capture_data.stop)
+			break;
+		thread_wait_event(capture_data.wake, -1);
+		thread_reset_event(capture_data.wake);
+		continue;
+	}
 
-    if (! plat_dir_check(path))
-	plat_dir_create(path);
+	fp = plat_fopen(f->path, (wchar_t *) L"wb");
+	if (fp != NULL) {
+		if (video_capture_format == VIDEO_CAPTURE_PPM)
+			capture_write_ppm(f, fp);
+		else
+			capture_write_png(f, fp);
+		fclose(fp);
+	} else
+		video_log("[capture_thread] File %ls could not be opened for writing", f->path);
 
-    wcscat(path, L"\\");
+	capture_data.next = (capture_data.next + 1) % CAPTURE_FRAMES;
+	f->state = CAPTURE_FREE;
+    }
+}
 
-    plat_tempfile(fn, NULL, L".png");
-    wcscat(path, fn);
 
-    video_log("taking screenshot to: %S\n", path);
+/* Copy the rendered frame into a free capture buffer for the capture
+   thread; if all of them are still being written out, the frame is
+   dropped rather than making the blit wait. */
+static int
+video_capture(int w, int h, int stream)
+{
+    capture_frame_t *f = &capture_data.frames[capture_data.head];
+    wchar_t fn[128];
+    char temp[64];
+    int size = w * h;
+
+    if (f->state != CAPTURE_FREE) {
+	capture_data.dropped++;
+	video_log("capture buffers full, %u frames dropped\n", capture_data.dropped);
+	return 0;
+    }
 
-    video_take_screenshot((const wchar_t *) path, x, y, y1, y2, w, h);
-    png_destroy_write_struct(&png_ptr, &info_ptr);
+    if (f->size < size) {
+	free(f->dat);
+	f->dat = (uint32_t *) malloc(size * sizeof(uint32_t));
+	if (f->dat == NULL) {
+		f->size = 0;
+		return 0;
+	}
+	f->size = size;
+    }
+
+    memcpy(f->dat, render_buffer->dat, size * sizeof(uint32_t));
+    f->w = w;
+    f->h = h;
+
+    /* Only the first capture has to look for the directory. */
+    if (! capture_data.dir_made) {
+	plat_append_filename(capture_data.dir, usr_path, SCREENSHOT_PATH);
+	if (! plat_dir_check(capture_data.dir))
+		plat_dir_create(capture_data.dir);
+	plat_path_slash(capture_data.dir);
+	capture_data.dir_made = 1;
+    }
+    wcscpy(f->path, capture_data.dir);
+
+    if (stream) {
+	sprintf(temp, "capture_%08u.%s", capture_data.stream_num++,
+		(video_capture_format == VIDEO_CAPTURE_PPM) ? "ppm" : "png");
+	mbstowcs(fn, temp, sizeof_w(fn));
+    } else
+	plat_tempfile(fn, NULL, (video_capture_format == VIDEO_CAPTURE_PPM) ? L".ppm" : L".png");
+    wcscat(f->path, fn);
+
+    video_log("capturing frame to: %ls\n", f->path);
+
+    f->state = CAPTURE_QUEUED;
+    capture_data.head = (capture_data.head + 1) % CAPTURE_FRAMES;
+    thread_set_event(capture_data.wake);
+
+    return 1;
 }
 
 
@@ -463,12 +582,20 @@ video_blit_memtoscreen(int x, int y, int y1, int y2, int w, int h)
 	}
     }
 
-    if (screenshots) {
-	if (render_buffer != NULL)
-		video_screenshot(x, y, y1, y2, w, h);
+    if ((render_buffer != NULL) && (w > 0) && (h > 0)) {
+	if (screenshots && video_capture(w, h, 0)) {
+		screenshots--;
+		video_log("screenshot taken, %i left\n", screenshots);
+	}
+
+	if (video_capture_interval > 0) {
+		if (++capture_data.frame_count >= (uint32_t) video_capture_interval) {
+			capture_data.frame_count = 0;
+			video_capture(w, h, 1);
+		}
+	}
+    } else if (screenshots)
 	screenshots--;
-	video_log("screenshot taken, %i left\n", screenshots);
-    }
 
     if ((w <= 0) || (h <= 0))
 	return;
@@ -869,21 +996,38 @@ video_init(void)
     for (c = 0; c < 65536; c++)
 	video_16to32[c] = calc_16to32(c);
 
+    vid_rop_init();
+    svga_render_init();
+
     blit_data.wake_blit_thread = thread_create_event();
     blit_data.blit_complete = thread_create_event();
     blit_data.buffer_not_in_use = thread_create_event();
     blit_data.blit_thread = thread_create(blit_thread, NULL);
+
+    memset(&capture_data, 0x00, sizeof(capture_data));
+    capture_data.wake = thread_create_event();
+    capture_data.thread = thread_create(capture_thread, NULL);
 }
 
 
 void
 video_close(void)
 {
+    int i;
+
     thread_kill(blit_data.blit_thread);
     thread_destroy_event(blit_data.buffer_not_in_use);
     thread_destroy_event(blit_data.blit_complete);
     thread_destroy_event(blit_data.wake_blit_thread);
 
+    /* Let the capture thread write out the frames still queued. */
+    capture_data.stop = 1;
+    thread_set_event(capture_data.wake);
+    thread_wait(capture_data.thread, -1);
+    thread_destroy_event(capture_data.wake);
+    for (i = 0; i < CAPTURE_FRAMES; i++)
+	free(capture_data.frames[i].dat);
+
     free(video_16to32);
     free(video_15to32);
     free(video_8to32);
@@ -45,6 +45,14 @@ static int	updatingSize;
 static int	allowedX,
 		allowedY;
 static int	ptr_x, ptr_y, ptr_but;
+static int	full_update;
+
+/* Statistics, updated about once a second. */
+static uint32_t	stat_ticks,
+		stat_sent,
+		stat_pixels;
+uint32_t	vnc_bytes_per_sec,
+		vnc_pixels_per_sec;
 
 
 #ifdef ENABLE_VNC_LOG
@@ -162,27 +170,126 @@ vnc_display(rfbClientPtr cl)
 
 	allowedX = rfb->width;
 	allowedY = rfb->height;
+
+	/* The new size has to be sent in full. */
+	full_update = 1;
     }
 }
 
 
+static void
+vnc_mark_rect(int x1, int y1, int x2, int y2)
+{
+    if (x2 > allowedX)
+	x2 = allowedX;
+    if (y2 > allowedY)
+	y2 = allowedY;
+
+    if ((x1 < x2) && (y1 < y2)) {
+	rfbMarkRectAsModified(rfb, x1, y1, x2, y2);
+	stat_pixels += (x2 - x1) * (y2 - y1);
+    }
+}
+
+
+/* Copy a line into the frame buffer, returning the changed span. */
+static int
+vnc_copy_line(uint32_t *dst, uint32_t *src, int w, int *x1, int *x2)
+{
+    int l, r;
+
+    if (! memcmp(dst, src, w << 2))
+	return(0);
+
+    for (l = 0; dst[l] == src[l]; l++)
+	;
+    for (r = w - 1; dst[r] == src[r]; r--)
+	;
+
+    memcpy(&dst[l], &src[l], (r - l + 1) << 2);
+
+    *x1 = l;
+    *x2 = r + 1;
+
+    return(1);
+}
+
+
+static void
+vnc_update_stats(void)
+{
+    rfbClientIteratorPtr iterator;
+    rfbClientPtr cl;
+    uint32_t ticks = plat_get_ticks();
+    uint32_t sent = 0;
+
+    if ((ticks - stat_ticks) < 1000)
+	return;
+
+    iterator = rfbGetClientIterator(rfb);
+    while ((cl = rfbClientIteratorNext(iterator)) != NULL)
+	sent += rfbStatGetSentBytes(cl);
+    rfbReleaseClientIterator(iterator);
+
+    /* Clients that went away take their counters with them. */
+    if (sent >= stat_sent)
+	vnc_bytes_per_sec = (uint32_t) (((uint64_t) (sent - stat_sent) * 1000) / (ticks - stat_ticks));
+    else
+	vnc_bytes_per_sec = 0;
+    vnc_pixels_per_sec = (uint32_t) (((uint64_t) stat_pixels * 1000) / (ticks - stat_ticks));
+
+    vnc_log("VNC: %u bytes/s sent, %u pixels/s updated\n",
+	    vnc_bytes_per_sec, vnc_pixels_per_sec);
+
+    stat_ticks = ticks;
+    stat_sent = sent;
+    stat_pixels = 0;
+}
+
+
 static void
 vnc_blit(int x, int y, int y1, int y2, int w, int h)
 {
     uint32_t *p;
-    int yy;
+    int yy, x1, x2;
+    int rx1 = 0, rx2 = 0, ry1 = -1;
 
+    /* Only send what changed since the previous frame. Consecutive
+       changed lines are merged into one rectangle. */
     for (yy=y1; yy<y2; yy++) {
 	p = (uint32_t *)&(((uint32_t *)rfb->frameBuffer)[yy*VNC_MAX_X]);
 
-	if ((y+yy) >= 0 && (y+yy) < VNC_MAX_Y)
-		memcpy(p, &(render_buffer->dat[yy * w]), w*4);
+	if ((y+yy) >= 0 && (y+yy) < VNC_MAX_Y && (w > 0) &&
+	    vnc_copy_line(p, &(render_buffer->dat[yy * w]), w, &x1, &x2)) {
+		if (ry1 < 0) {
+			ry1 = yy;
+			rx1 = x1;
+			rx2 = x2;
+		} else {
+			if (x1 < rx1)
+				rx1 = x1;
+			if (x2 > rx2)
+				rx2 = x2;
+		}
+	} else if (ry1 >= 0) {
+		if (! updatingSize)
+			vnc_mark_rect(rx1, ry1, rx2, yy);
+		ry1 = -1;
+	}
     }
  
     video_blit_complete();
 
-    if (! updatingSize)
-	rfbMarkRectAsModified(rfb, 0,0, allowedX,allowedY);
+    if (updatingSize)
+	return;
+
+    if (full_update) {
+	vnc_mark_rect(0, 0, allowedX, allowedY);
+	full_update = 0;
+    } else if (ry1 >= 0)
+	vnc_mark_rect(rx1, ry1, rx2, y2);
+
+    vnc_update_stats();
 }
 
 
@@ -211,6 +318,9 @@ vnc_init(UNUSED(void *arg))
 	updatingSize = 0;
 	allowedX = scrnsz_x;
 	allowedY = scrnsz_y;
+	full_update = 1;
+	stat_ticks = plat_get_ticks();
+	stat_sent = stat_pixels = 0;
  
 	rfb = rfbGetScreen(0, NULL, VNC_MAX_X, VNC_MAX_Y, 8, 3, 4);
 	rfb->desktopName = title;